@@ -0,0 +1,658 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.cpp
+// ============
+// timing runs of the scene systems, started from the command line
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmarks.h"
+#include "FrustumCuller.h"
+#include "LightClusters.h"
+#include "SceneBVH.h"
+#include "SceneGraph.h"
+#include "InstancedMeshes.h"
+#include "UniformBuffers.h"
+#include "TextureManager.h"
+#include "ProgramCache.h"
+#include "ShaderPermutations.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// declaration of the global variables and defines
+namespace
+{
+	// object counts of the generated scenes
+	const int CULLING_SCENE_SIZES[] = { 1000, 10000, 100000 };
+	// frames timed for each scene, turning the camera one full circle
+	const int CULLING_FRAMES = 120;
+	// share of the objects moved before a refit
+	const float REFIT_SHARE = 0.01f;
+	// rays cast and lights queried for each scene
+	const int PICK_RAYS = 1000;
+	const int LIGHT_QUERIES = 64;
+	const float LIGHT_REACH = 10.0f;
+	// nodes of the generated scene graph, the roots they hang
+	// from and the children of each node
+	const int GRAPH_NODES = 100000;
+	const int GRAPH_ROOTS = 16;
+	const int GRAPH_CHILDREN = 4;
+	// updates timed for each way of building the matrices
+	const int GRAPH_UPDATES = 20;
+	// size of the target the shader variants fill, the screen
+	// covering layers drawn into it each frame, and the frames
+	// timed for each variant
+	const int FILL_WIDTH = 3840;
+	const int FILL_HEIGHT = 2160;
+	const int FILL_LAYERS = 16;
+	const int FILL_FRAMES = 20;
+	// size of the generated texture the textured variants sample
+	const int FILL_TEXTURE_SIZE = 1024;
+	// point light counts of the generated office floors, the
+	// floor size that holds the smallest count, the reach of
+	// the lights and the height they hang at
+	const int LIGHT_SCENE_SIZES[] = { 64, 256, 1024, 4096 };
+	const float LIGHT_FLOOR_SIZE = 20.0f;
+	const float LIGHT_MIN_RADIUS = 1.0f;
+	const float LIGHT_MAX_RADIUS = 4.0f;
+	const float LIGHT_MAX_HEIGHT = 3.0f;
+	// size of the viewport the clusters are built for, the
+	// frames timed while the camera turns a full circle, and the
+	// points checked against every light
+	const int LIGHT_VIEWPORT_WIDTH = 1920;
+	const int LIGHT_VIEWPORT_HEIGHT = 1080;
+	const int LIGHT_FRAMES = 60;
+	const int LIGHT_SAMPLES = 10000;
+
+	/***********************************************************
+	 *  MillisecondsSince()
+	 *
+	 *  Time passed since a point in time, in milliseconds.
+	 ***********************************************************/
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		return(elapsed.count());
+	}
+
+	/***********************************************************
+	 *  TimeFill()
+	 *
+	 *  Draw the layers with a program for a number of frames,
+	 *  returning the GPU time of one frame in milliseconds.
+	 *  A frame that is not timed is drawn first, so the driver
+	 *  has finished preparing the program.
+	 ***********************************************************/
+	double TimeFill(
+		GLuint programID,
+		InstancedMeshes& meshes,
+		UniformBuffers& uniformBuffers,
+		const std::vector<InstancedMeshes::INSTANCE_DATA>& layers)
+	{
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		glUseProgram(programID);
+
+		GLuint64 elapsed = 0;
+		for (int frame = -1; frame < FILL_FRAMES; frame++)
+		{
+			uniformBuffers.CommitFrame();
+			meshes.BeginFrame();
+			meshes.QueueDraw(InstancedMeshes::PLANE_MESH, layers.data(), (int)layers.size());
+
+			if (frame >= 0)
+			{
+				glBeginQuery(GL_TIME_ELAPSED, query);
+			}
+			meshes.SubmitQueuedDraws();
+			if (frame >= 0)
+			{
+				glEndQuery(GL_TIME_ELAPSED);
+				GLuint64 frameElapsed = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &frameElapsed);
+				elapsed += frameElapsed;
+			}
+			else
+			{
+				glFinish();
+			}
+		}
+
+		glDeleteQueries(1, &query);
+		return((double)elapsed / 1000000.0 / FILL_FRAMES);
+	}
+
+	/***********************************************************
+	 *  MakeDeskScene()
+	 *
+	 *  Place boxes the size of desk objects at random on a
+	 *  floor that grows with their count, so every scene has
+	 *  about the same number of objects in view.
+	 ***********************************************************/
+	void MakeDeskScene(int objectCount, std::vector<SceneBVH::BOUNDS>& objectBounds)
+	{
+		std::mt19937 random(objectCount);
+		float floorSize = 4.0f * std::sqrt((float)objectCount);
+		std::uniform_real_distribution<float> floorPosition(-0.5f * floorSize, 0.5f * floorSize);
+		std::uniform_real_distribution<float> height(0.0f, 2.0f);
+		std::uniform_real_distribution<float> size(0.1f, 1.0f);
+
+		objectBounds.resize(objectCount);
+		for (int i = 0; i < objectCount; i++)
+		{
+			glm::vec3 center(floorPosition(random), height(random), floorPosition(random));
+			glm::vec3 extent(size(random), size(random), size(random));
+			objectBounds[i].minimum = center - extent;
+			objectBounds[i].maximum = center + extent;
+		}
+	}
+
+	/***********************************************************
+	 *  MakeCameraFrustum()
+	 *
+	 *  Get the view projection of a camera in the middle of
+	 *  the floor, turned to the given angle and looking
+	 *  slightly down.
+	 ***********************************************************/
+	glm::mat4 MakeCameraFrustum(float yawDegrees)
+	{
+		glm::vec3 position(0.0f, 1.5f, 0.0f);
+		glm::vec3 front(
+			std::cos(glm::radians(yawDegrees)),
+			-0.2f,
+			std::sin(glm::radians(yawDegrees)));
+		glm::mat4 view = glm::lookAt(position, position + front, glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)800 / (float)600, 0.1f, 100.0f);
+		return(projection * view);
+	}
+}
+
+/***********************************************************
+ *	BenchmarkCulling()
+ *
+ *  This function is used to time frustum culling over
+ *  generated scenes.  For each scene, the flat test of every
+ *  box is timed against walking the scene tree, with the
+ *  same camera, and the tree's build, refit, pick and light
+ *  queries are timed as well.  The visible counts of the two
+ *  are compared, and any difference is a failure.
+ ***********************************************************/
+int BenchmarkCulling(WorkerPool* pWorkerPool)
+{
+	bool bMatched = true;
+
+	for (size_t scene = 0; scene < sizeof(CULLING_SCENE_SIZES) / sizeof(CULLING_SCENE_SIZES[0]); scene++)
+	{
+		int objectCount = CULLING_SCENE_SIZES[scene];
+		std::vector<SceneBVH::BOUNDS> objectBounds;
+		MakeDeskScene(objectCount, objectBounds);
+
+		FrustumCuller frustumCuller;
+		for (int i = 0; i < objectCount; i++)
+		{
+			frustumCuller.AddBox(
+				(objectBounds[i].minimum + objectBounds[i].maximum) * 0.5f,
+				(objectBounds[i].maximum - objectBounds[i].minimum) * 0.5f);
+		}
+
+		// build on this thread alone, then on the pool
+		SceneBVH sceneBVH;
+		sceneBVH.Build(objectBounds, NULL);
+		float serialBuildMilliseconds = sceneBVH.GetStats().buildMilliseconds;
+		sceneBVH.Build(objectBounds, pWorkerPool);
+		SceneBVH::BVH_STATS buildStats = sceneBVH.GetStats();
+
+		double flatMilliseconds = 0.0;
+		double treeMilliseconds = 0.0;
+		long long visibleTotal = 0;
+		long long nodesVisited = 0;
+		int mismatchedFrames = 0;
+		std::vector<unsigned char> visible;
+		for (int frame = 0; frame < CULLING_FRAMES; frame++)
+		{
+			frustumCuller.SetFrustum(MakeCameraFrustum(frame * 360.0f / CULLING_FRAMES));
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int flatVisible = frustumCuller.Cull();
+			flatMilliseconds += MillisecondsSince(start);
+
+			start = std::chrono::steady_clock::now();
+			int treeVisible = sceneBVH.CullFrustum(frustumCuller.GetPlanes(), visible);
+			treeMilliseconds += MillisecondsSince(start);
+
+			visibleTotal += treeVisible;
+			nodesVisited += sceneBVH.GetStats().nodesVisited;
+			if (flatVisible != treeVisible)
+			{
+				mismatchedFrames++;
+			}
+		}
+
+		// move a few of the objects and carry their boxes up the tree
+		std::mt19937 random(objectCount + 1);
+		std::uniform_int_distribution<int> pickObject(0, objectCount - 1);
+		std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+		int movedCount = (int)(objectCount * REFIT_SHARE);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < movedCount; i++)
+		{
+			int objectIndex = pickObject(random);
+			SceneBVH::BOUNDS bounds = sceneBVH.GetObjectBounds(objectIndex);
+			glm::vec3 move(offset(random), 0.0f, offset(random));
+			bounds.minimum += move;
+			bounds.maximum += move;
+			sceneBVH.UpdateObject(objectIndex, bounds);
+		}
+		int nodesRefit = sceneBVH.Refit();
+		double refitMilliseconds = MillisecondsSince(start);
+
+		// pick along rays from the camera, and find the objects
+		// near lights spread over the floor
+		std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+		start = std::chrono::steady_clock::now();
+		int picked = 0;
+		for (int i = 0; i < PICK_RAYS; i++)
+		{
+			float rayAngle = angle(random);
+			float distance = 0.0f;
+			glm::vec3 direction(std::cos(rayAngle), -0.05f, std::sin(rayAngle));
+			if (sceneBVH.Raycast(glm::vec3(0.0f, 1.5f, 0.0f), direction, distance) >= 0)
+			{
+				picked++;
+			}
+		}
+		double pickMilliseconds = MillisecondsSince(start);
+
+		float floorSize = 4.0f * std::sqrt((float)objectCount);
+		std::uniform_real_distribution<float> floorPosition(-0.5f * floorSize, 0.5f * floorSize);
+		std::vector<int> litObjects;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < LIGHT_QUERIES; i++)
+		{
+			glm::vec3 lightPosition(floorPosition(random), 3.0f, floorPosition(random));
+			sceneBVH.QuerySphere(lightPosition, LIGHT_REACH, litObjects);
+		}
+		double lightMilliseconds = MillisecondsSince(start);
+
+		double flatFrame = flatMilliseconds / CULLING_FRAMES;
+		double treeFrame = treeMilliseconds / CULLING_FRAMES;
+		std::cout << "Benchmark: " << objectCount << " objects, "
+			<< buildStats.nodes << " nodes, depth " << buildStats.depth << std::endl;
+		std::cout << "  cull per frame: flat " << flatFrame << "ms, tree " << treeFrame << "ms ("
+			<< ((treeFrame > 0.0) ? flatFrame / treeFrame : 0.0) << "x), visible "
+			<< visibleTotal / CULLING_FRAMES << ", nodes visited " << nodesVisited / CULLING_FRAMES << std::endl;
+		std::cout << "  build: " << serialBuildMilliseconds << "ms on one thread, "
+			<< buildStats.buildMilliseconds << "ms with the worker pool" << std::endl;
+		std::cout << "  refit of " << movedCount << " moved objects: " << refitMilliseconds
+			<< "ms, " << nodesRefit << " nodes" << std::endl;
+		std::cout << "  " << PICK_RAYS << " picks: " << pickMilliseconds << "ms, " << picked << " hits" << std::endl;
+		std::cout << "  " << LIGHT_QUERIES << " light queries: " << lightMilliseconds << "ms, "
+			<< litObjects.size() << " objects lit" << std::endl;
+
+		if (mismatchedFrames > 0)
+		{
+			std::cerr << "Benchmark: the tree and flat culls differ in " << mismatchedFrames << " frames" << std::endl;
+			bMatched = false;
+		}
+	}
+
+	return((bMatched == true) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *	BenchmarkSceneGraph()
+ *
+ *  This function is used to time the world matrix pass of a
+ *  generated scene graph.  Every root is moved before each
+ *  update so that all of the nodes are built, first on this
+ *  thread alone and then split between the worker threads,
+ *  and the matrices of the two are compared.  Moving a
+ *  single root is timed as well.
+ ***********************************************************/
+int BenchmarkSceneGraph(WorkerPool* pWorkerPool)
+{
+	// add the nodes breadth first, each under the oldest node
+	// that has room for another child
+	std::mt19937 random(GRAPH_NODES);
+	std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> rotation(-180.0f, 180.0f);
+	SceneGraph sceneGraph;
+	std::vector<int> roots;
+	for (int node = 0; node < GRAPH_NODES; node++)
+	{
+		int parentNode = (node < GRAPH_ROOTS) ? -1 : (node - GRAPH_ROOTS) / GRAPH_CHILDREN;
+		sceneGraph.AddNode(parentNode,
+			glm::vec3(1.0f, 1.0f, 1.0f),
+			glm::vec3(0.0f, rotation(random), 0.0f),
+			glm::vec3(position(random), position(random), position(random)));
+		if (parentNode < 0)
+		{
+			roots.push_back(node);
+		}
+	}
+	sceneGraph.Update(NULL);
+
+	double timings[2] = { 0.0, 0.0 };
+	std::vector<glm::mat4> matrices[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		WorkerPool* pPool = (pass == 0) ? NULL : pWorkerPool;
+		for (int update = 0; update < GRAPH_UPDATES; update++)
+		{
+			for (size_t i = 0; i < roots.size(); i++)
+			{
+				sceneGraph.SetLocalTransform(roots[i],
+					glm::vec3(1.0f, 1.0f, 1.0f),
+					glm::vec3(0.0f, update * 10.0f, 0.0f),
+					glm::vec3((float)i, 0.0f, 0.0f));
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			sceneGraph.Update(pPool);
+			timings[pass] += MillisecondsSince(start);
+		}
+
+		matrices[pass].resize(GRAPH_NODES);
+		for (int node = 0; node < GRAPH_NODES; node++)
+		{
+			matrices[pass][node] = sceneGraph.GetWorldMatrix(node);
+		}
+	}
+
+	// move one root, which only builds the nodes under it
+	sceneGraph.SetLocalTransform(roots[0],
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 45.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int subtreeNodes = sceneGraph.Update(pWorkerPool);
+	double subtreeMilliseconds = MillisecondsSince(start);
+
+	int mismatched = 0;
+	for (int node = 0; node < GRAPH_NODES; node++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			if (glm::vec3(matrices[0][node][column]) != glm::vec3(matrices[1][node][column]))
+			{
+				mismatched++;
+				break;
+			}
+		}
+	}
+
+	double serialUpdate = timings[0] / GRAPH_UPDATES;
+	double parallelUpdate = timings[1] / GRAPH_UPDATES;
+	std::cout << "Benchmark: scene graph of " << GRAPH_NODES << " nodes, "
+		<< sceneGraph.GetDepthCount() << " depths" << std::endl;
+	std::cout << "  all nodes: " << serialUpdate << "ms on one thread, " << parallelUpdate
+		<< "ms with " << pWorkerPool->GetThreadCount() << " workers ("
+		<< ((parallelUpdate > 0.0) ? serialUpdate / parallelUpdate : 0.0) << "x)" << std::endl;
+	std::cout << "  one root: " << subtreeNodes << " nodes in " << subtreeMilliseconds << "ms" << std::endl;
+
+	if (mismatched > 0)
+	{
+		std::cerr << "Benchmark: " << mismatched << " matrices differ between the two passes" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *	BenchmarkShaderVariants()
+ *
+ *  This function is used to time how fast each shader
+ *  variant shades fragments.  Layers that each cover the
+ *  whole of a 4K target are drawn with no depth test, so
+ *  every layer shades every pixel, first with the variant
+ *  and then with the program that makes the same choices at
+ *  run time.  It needs a current GL context.
+ ***********************************************************/
+int BenchmarkShaderVariants(ProgramCache* pProgramCache, const char* vertexFilename, const char* fragmentFilename)
+{
+	ShaderPermutations variants;
+	variants.SetSources(pProgramCache, vertexFilename, fragmentFilename);
+	GLuint branchingProgram = pProgramCache->LoadProgram(vertexFilename, fragmentFilename);
+	if ((variants.Build(UniformBuffers::TOTAL_LIGHTS, true) == false) || (branchingProgram == 0))
+	{
+		glDeleteProgram(branchingProgram);
+		return(EXIT_FAILURE);
+	}
+
+	// the target, and the state that would hide shading work
+	GLuint colorTexture = 0;
+	GLuint framebuffer = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &colorTexture);
+	glTextureStorage2D(colorTexture, 1, GL_RGBA8, FILL_WIDTH, FILL_HEIGHT);
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, FILL_WIDTH, FILL_HEIGHT);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glDisable(GL_CULL_FACE);
+
+	// lights and a material in front of layers facing the camera
+	UniformBuffers uniformBuffers;
+	uniformBuffers.CreateBuffers();
+	uniformBuffers.SetViewProjection(glm::mat4(1.0f), glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 2.0f));
+	uniformBuffers.SetGlobalAmbientColor(glm::vec3(0.1f));
+	for (int i = 0; i < UniformBuffers::TOTAL_LIGHTS; i++)
+	{
+		uniformBuffers.SetLightSource(i, glm::vec3(-1.0f + 2.0f * i, 1.0f, 2.0f),
+			glm::vec3(0.8f), glm::vec3(1.0f), 32.0f, 0.5f);
+	}
+	uniformBuffers.SetMaterial(0, glm::vec3(1.0f), 0.2f, glm::vec3(0.8f), glm::vec3(0.5f), 16.0f);
+
+	// clusters with no point lights, so the cluster lookup is
+	// timed without any light to shade
+	LightClusters lightClusters;
+	lightClusters.CreateBuffers();
+
+	// a checker texture with its mipmaps
+	std::vector<unsigned char> pixels((size_t)FILL_TEXTURE_SIZE * FILL_TEXTURE_SIZE * 4);
+	for (int y = 0; y < FILL_TEXTURE_SIZE; y++)
+	{
+		for (int x = 0; x < FILL_TEXTURE_SIZE; x++)
+		{
+			unsigned char value = (((x / 32) + (y / 32)) % 2 == 0) ? 220 : 40;
+			unsigned char* pTexel = &pixels[((size_t)y * FILL_TEXTURE_SIZE + x) * 4];
+			pTexel[0] = value;
+			pTexel[1] = value;
+			pTexel[2] = (unsigned char)(255 - value);
+			pTexel[3] = 255;
+		}
+	}
+	TextureManager textureManager;
+	int textureIndex = textureManager.AddTexture("checker", pixels.data(), FILL_TEXTURE_SIZE, FILL_TEXTURE_SIZE);
+	textureManager.BuildTextures();
+	textureManager.BindTextures();
+
+	// the plane faces up, so it is turned to face the camera
+	InstancedMeshes meshes;
+	meshes.LoadPlaneMesh();
+	std::vector<InstancedMeshes::INSTANCE_DATA> layers(FILL_LAYERS);
+	for (int i = 0; i < FILL_LAYERS; i++)
+	{
+		layers[i].model = glm::rotate(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		layers[i].objectColor = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
+		layers[i].materialIndex = 0;
+		layers[i].UVscale = glm::vec2(4.0f, 4.0f);
+	}
+
+	const char* variantNames[ShaderPermutations::VARIANT_COUNT] =
+	{
+		"unlit, untextured", "unlit, textured", "lit, untextured", "lit, textured"
+	};
+	double pixelsPerFrame = (double)FILL_WIDTH * FILL_HEIGHT * FILL_LAYERS;
+	std::cout << "Benchmark: " << FILL_LAYERS << " layers of " << FILL_WIDTH << "x" << FILL_HEIGHT
+		<< " fragments per frame, " << UniformBuffers::TOTAL_LIGHTS << " lights" << std::endl;
+
+	for (int variant = 0; variant < ShaderPermutations::VARIANT_COUNT; variant++)
+	{
+		bool bTextured = ((variant & ShaderPermutations::VARIANT_TEXTURED) != 0);
+		bool bLit = ((variant & ShaderPermutations::VARIANT_LIT) != 0);
+		for (int i = 0; i < FILL_LAYERS; i++)
+		{
+			layers[i].textureIndex = (bTextured == true) ? textureIndex : -1;
+		}
+		uniformBuffers.SetUseLighting(bLit);
+
+		double variantFrame = TimeFill(variants.GetProgram(variant), meshes, uniformBuffers, layers);
+		double branchingFrame = TimeFill(branchingProgram, meshes, uniformBuffers, layers);
+		std::cout << "  " << variantNames[variant] << ": variant " << variantFrame << "ms ("
+			<< ((variantFrame > 0.0) ? pixelsPerFrame / variantFrame / 1000000.0 : 0.0) << " Gfragments/s), branching "
+			<< branchingFrame << "ms ("
+			<< ((branchingFrame > 0.0) ? pixelsPerFrame / branchingFrame / 1000000.0 : 0.0) << " Gfragments/s), "
+			<< ((variantFrame > 0.0) ? branchingFrame / variantFrame : 0.0) << "x" << std::endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &colorTexture);
+	glDeleteProgram(branchingProgram);
+	glUseProgram(0);
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *	BenchmarkLights()
+ *
+ *  This function is used to time assigning point lights to
+ *  the view clusters, over office floors with more and more
+ *  lights.  The floor grows with the light count, so about
+ *  the same number of lights reach each cluster.  Each floor
+ *  is assigned on one thread and then split between the
+ *  worker threads while the camera turns, and the two lists
+ *  must match.  Then points inside random lights are looked
+ *  up, and every light that reaches a point must be listed
+ *  by its cluster.
+ ***********************************************************/
+int BenchmarkLights(WorkerPool* pWorkerPool)
+{
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+		(float)LIGHT_VIEWPORT_WIDTH / (float)LIGHT_VIEWPORT_HEIGHT, 0.1f, 100.0f);
+	int result = EXIT_SUCCESS;
+
+	for (size_t scene = 0; scene < sizeof(LIGHT_SCENE_SIZES) / sizeof(LIGHT_SCENE_SIZES[0]); scene++)
+	{
+		int lightCount = LIGHT_SCENE_SIZES[scene];
+		float floorSize = LIGHT_FLOOR_SIZE * std::sqrt((float)lightCount / LIGHT_SCENE_SIZES[0]);
+		std::mt19937 random(lightCount);
+		std::uniform_real_distribution<float> floorPosition(-0.5f * floorSize, 0.5f * floorSize);
+		std::uniform_real_distribution<float> height(0.0f, LIGHT_MAX_HEIGHT);
+		std::uniform_real_distribution<float> radius(LIGHT_MIN_RADIUS, LIGHT_MAX_RADIUS);
+		std::uniform_real_distribution<float> color(0.0f, 1.0f);
+
+		std::vector<LightClusters::POINT_LIGHT> lights(lightCount);
+		for (int i = 0; i < lightCount; i++)
+		{
+			lights[i].positionRadius = glm::vec4(floorPosition(random), height(random), floorPosition(random), radius(random));
+			lights[i].diffuseColor = glm::vec4(color(random), color(random), color(random), 16.0f);
+			lights[i].specularColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.1f);
+		}
+
+		LightClusters clusters[2];
+		double timings[2] = { 0.0, 0.0 };
+		glm::mat4 view;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			WorkerPool* pPool = (pass == 0) ? NULL : pWorkerPool;
+			clusters[pass].SetLights(lights.data(), lightCount);
+			for (int frame = 0; frame < LIGHT_FRAMES; frame++)
+			{
+				float yaw = glm::radians(360.0f * frame / LIGHT_FRAMES);
+				glm::vec3 eye(0.0f, 1.5f, 0.0f);
+				view = glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), -0.2f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				clusters[pass].Assign(view, projection, LIGHT_VIEWPORT_WIDTH, LIGHT_VIEWPORT_HEIGHT, pPool);
+				timings[pass] += MillisecondsSince(start);
+			}
+		}
+
+		// both passes ended on the same view
+		int mismatched = 0;
+		for (int cluster = 0; cluster < LightClusters::CLUSTER_COUNT; cluster++)
+		{
+			int counts[2] = { 0, 0 };
+			const uint32_t* pLights[2] =
+			{
+				clusters[0].GetClusterLights(cluster, counts[0]),
+				clusters[1].GetClusterLights(cluster, counts[1])
+			};
+			if ((counts[0] != counts[1]) ||
+				((counts[0] > 0) && (std::equal(pLights[0], pLights[0] + counts[0], pLights[1]) == false)))
+			{
+				mismatched++;
+			}
+		}
+
+		// points a little inside random lights, so each one is
+		// reached by at least that light
+		int checkedPoints = 0;
+		int missingLights = 0;
+		std::uniform_int_distribution<int> lightIndex(0, lightCount - 1);
+		std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+		for (int sample = 0; sample < LIGHT_SAMPLES; sample++)
+		{
+			const glm::vec4& positionRadius = lights[lightIndex(random)].positionRadius;
+			glm::vec3 point = glm::vec3(positionRadius) +
+				glm::vec3(offset(random), offset(random), offset(random)) * positionRadius.w;
+			int cluster = clusters[1].GetClusterIndex(glm::vec3(view * glm::vec4(point, 1.0f)));
+			if (cluster < 0)
+			{
+				continue;
+			}
+			checkedPoints++;
+
+			int clusterLightCount = 0;
+			const uint32_t* pClusterLights = clusters[1].GetClusterLights(cluster, clusterLightCount);
+			for (int i = 0; i < lightCount; i++)
+			{
+				// lights that only just reach the point are
+				// left to rounding
+				glm::vec3 toLight = glm::vec3(lights[i].positionRadius) - point;
+				if (glm::dot(toLight, toLight) > 0.99f * lights[i].positionRadius.w * lights[i].positionRadius.w)
+				{
+					continue;
+				}
+				if ((clusterLightCount == 0) ||
+					(std::find(pClusterLights, pClusterLights + clusterLightCount, (uint32_t)i) == pClusterLights + clusterLightCount))
+				{
+					missingLights++;
+				}
+			}
+		}
+
+		const LightClusters::CLUSTER_STATS& stats = clusters[1].GetStats();
+		double serialAssign = timings[0] / LIGHT_FRAMES;
+		double parallelAssign = timings[1] / LIGHT_FRAMES;
+		std::cout << "Benchmark: " << lightCount << " point lights on a " << floorSize << " unit floor, "
+			<< LightClusters::CLUSTER_COUNT << " clusters" << std::endl;
+		std::cout << "  assign: " << serialAssign << "ms on one thread, " << parallelAssign
+			<< "ms with " << pWorkerPool->GetThreadCount() << " workers ("
+			<< ((parallelAssign > 0.0) ? serialAssign / parallelAssign : 0.0) << "x)" << std::endl;
+		std::cout << "  clusters with lights: " << stats.occupiedClusters << ", lights per cluster: "
+			<< ((stats.occupiedClusters > 0) ? (double)stats.references / stats.occupiedClusters : 0.0)
+			<< " average, " << stats.maxClusterLights << " most" << std::endl;
+		std::cout << "  checked " << checkedPoints << " points, " << missingLights << " lights missing" << std::endl;
+
+		if ((mismatched > 0) || (missingLights > 0))
+		{
+			std::cerr << "Benchmark: " << mismatched << " clusters differ between the two passes, "
+				<< missingLights << " lights were missing from their clusters" << std::endl;
+			result = EXIT_FAILURE;
+		}
+	}
+
+	return(result);
+}
@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarks.h
+// ============
+// timing runs of the scene systems, started from the command line
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WorkerPool.h"
+
+class ProgramCache;
+
+// time culling every object box against the frustum one by
+// one, and by walking the scene tree, over generated scenes of
+// 1k, 10k and 100k objects
+int BenchmarkCulling(WorkerPool* pWorkerPool);
+// time building the world matrices of a 100k node scene
+// graph on one thread, and split between the worker threads
+int BenchmarkSceneGraph(WorkerPool* pWorkerPool);
+// time the fragment throughput of each shader variant against
+// the program that branches at run time, in a 4K target - this
+// needs a current GL context
+int BenchmarkShaderVariants(ProgramCache* pProgramCache, const char* vertexFilename, const char* fragmentFilename);
+// time assigning 64 to 4096 point lights to the view clusters
+// on one thread and on the worker threads, and check the
+// clusters against testing every light
+int BenchmarkLights(WorkerPool* pWorkerPool);
@@ -0,0 +1,728 @@
+///////////////////////////////////////////////////////////////////////////////
+// blockcompressor.cpp
+// ============
+// encode RGBA images into BC1 and BC3 blocks on the CPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BlockCompressor.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// declaration of the global variables and defines
+namespace
+{
+	// texels in one block
+	const int BLOCK_TEXELS = 16;
+	// bytes in one RGBA texel
+	const int TEXEL_BYTES = 4;
+	// power iterations used to find the principal axis
+	const int POWER_ITERATIONS = 8;
+	// least squares passes over the endpoints for QUALITY_HIGH
+	const int REFINE_PASSES = 2;
+	// weight of the first endpoint in each of the four colors
+	// of a block, in the order of the BC1 indices
+	const float PALETTE_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	// the 16 texels of a block with each channel in its own
+	// vectors, one row of four texels to a vector
+	struct TEXEL_BLOCK
+	{
+		__m128 r[4];
+		__m128 g[4];
+		__m128 b[4];
+		__m128 a[4];
+	};
+
+	/***********************************************************
+	 *  LoadTexels()
+	 *
+	 *  Widen the 16 RGBA texels of a block to floats and swizzle
+	 *  them into one vector per channel and row.
+	 ***********************************************************/
+	void LoadTexels(const unsigned char* pTexels, TEXEL_BLOCK& block)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		for (int row = 0; row < 4; row++)
+		{
+			__m128i texels = _mm_loadu_si128((const __m128i*)(pTexels + row * 4 * TEXEL_BYTES));
+			__m128i low = _mm_unpacklo_epi8(texels, zero);
+			__m128i high = _mm_unpackhi_epi8(texels, zero);
+
+			__m128 texel0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+			__m128 texel1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+			__m128 texel2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+			__m128 texel3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+			_MM_TRANSPOSE4_PS(texel0, texel1, texel2, texel3);
+
+			block.r[row] = texel0;
+			block.g[row] = texel1;
+			block.b[row] = texel2;
+			block.a[row] = texel3;
+		}
+	}
+
+	/***********************************************************
+	 *  HorizontalSum()
+	 *
+	 *  Add the four lanes of a vector.
+	 ***********************************************************/
+	float HorizontalSum(__m128 value)
+	{
+		__m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(value, shuffled);
+		shuffled = _mm_movehl_ps(shuffled, sums);
+		sums = _mm_add_ss(sums, shuffled);
+		return(_mm_cvtss_f32(sums));
+	}
+
+	/***********************************************************
+	 *  HorizontalMin()
+	 *
+	 *  Smallest of the four lanes of a vector.
+	 ***********************************************************/
+	float HorizontalMin(__m128 value)
+	{
+		__m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 result = _mm_min_ps(value, shuffled);
+		shuffled = _mm_movehl_ps(shuffled, result);
+		result = _mm_min_ss(result, shuffled);
+		return(_mm_cvtss_f32(result));
+	}
+
+	/***********************************************************
+	 *  HorizontalMax()
+	 *
+	 *  Largest of the four lanes of a vector.
+	 ***********************************************************/
+	float HorizontalMax(__m128 value)
+	{
+		__m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 result = _mm_max_ps(value, shuffled);
+		shuffled = _mm_movehl_ps(shuffled, result);
+		result = _mm_max_ss(result, shuffled);
+		return(_mm_cvtss_f32(result));
+	}
+
+	/***********************************************************
+	 *  SumRows()
+	 *
+	 *  Add the four rows of one channel of a block.
+	 ***********************************************************/
+	float SumRows(const __m128 rows[4])
+	{
+		return(HorizontalSum(_mm_add_ps(_mm_add_ps(rows[0], rows[1]), _mm_add_ps(rows[2], rows[3]))));
+	}
+
+	/***********************************************************
+	 *  MinRows() / MaxRows()
+	 *
+	 *  Smallest and largest value of one channel of a block.
+	 ***********************************************************/
+	float MinRows(const __m128 rows[4])
+	{
+		return(HorizontalMin(_mm_min_ps(_mm_min_ps(rows[0], rows[1]), _mm_min_ps(rows[2], rows[3]))));
+	}
+	float MaxRows(const __m128 rows[4])
+	{
+		return(HorizontalMax(_mm_max_ps(_mm_max_ps(rows[0], rows[1]), _mm_max_ps(rows[2], rows[3]))));
+	}
+
+	/***********************************************************
+	 *  BoundingBoxEndpoints()
+	 *
+	 *  Pick the endpoints from the corners of the bounding box
+	 *  of the colors.  The diagonal that follows the colors is
+	 *  found from the signs of their covariance, and the ends
+	 *  are inset a little, as the extreme colors are rarely
+	 *  worth representing exactly.
+	 ***********************************************************/
+	void BoundingBoxEndpoints(const TEXEL_BLOCK& block, const float mean[3], float endpoint0[3], float endpoint1[3])
+	{
+		float minimum[3] = { MinRows(block.r), MinRows(block.g), MinRows(block.b) };
+		float maximum[3] = { MaxRows(block.r), MaxRows(block.g), MaxRows(block.b) };
+
+		__m128 meanR = _mm_set1_ps(mean[0]);
+		__m128 meanG = _mm_set1_ps(mean[1]);
+		__m128 meanB = _mm_set1_ps(mean[2]);
+		__m128 covarianceRG = _mm_setzero_ps();
+		__m128 covarianceRB = _mm_setzero_ps();
+		for (int row = 0; row < 4; row++)
+		{
+			__m128 r = _mm_sub_ps(block.r[row], meanR);
+			covarianceRG = _mm_add_ps(covarianceRG, _mm_mul_ps(r, _mm_sub_ps(block.g[row], meanG)));
+			covarianceRB = _mm_add_ps(covarianceRB, _mm_mul_ps(r, _mm_sub_ps(block.b[row], meanB)));
+		}
+
+		if (HorizontalSum(covarianceRG) < 0.0f)
+		{
+			std::swap(minimum[1], maximum[1]);
+		}
+		if (HorizontalSum(covarianceRB) < 0.0f)
+		{
+			std::swap(minimum[2], maximum[2]);
+		}
+
+		for (int channel = 0; channel < 3; channel++)
+		{
+			float inset = (maximum[channel] - minimum[channel]) / 16.0f;
+			endpoint0[channel] = maximum[channel] - inset;
+			endpoint1[channel] = minimum[channel] + inset;
+		}
+	}
+
+	/***********************************************************
+	 *  PrincipalAxisEndpoints()
+	 *
+	 *  Pick the endpoints from the extent of the colors along
+	 *  the axis they vary the most on.  The axis is found by
+	 *  power iteration on the covariance matrix of the colors.
+	 ***********************************************************/
+	void PrincipalAxisEndpoints(const TEXEL_BLOCK& block, const float mean[3], float endpoint0[3], float endpoint1[3])
+	{
+		__m128 meanR = _mm_set1_ps(mean[0]);
+		__m128 meanG = _mm_set1_ps(mean[1]);
+		__m128 meanB = _mm_set1_ps(mean[2]);
+
+		__m128 sumRR = _mm_setzero_ps();
+		__m128 sumRG = _mm_setzero_ps();
+		__m128 sumRB = _mm_setzero_ps();
+		__m128 sumGG = _mm_setzero_ps();
+		__m128 sumGB = _mm_setzero_ps();
+		__m128 sumBB = _mm_setzero_ps();
+		for (int row = 0; row < 4; row++)
+		{
+			__m128 r = _mm_sub_ps(block.r[row], meanR);
+			__m128 g = _mm_sub_ps(block.g[row], meanG);
+			__m128 b = _mm_sub_ps(block.b[row], meanB);
+			sumRR = _mm_add_ps(sumRR, _mm_mul_ps(r, r));
+			sumRG = _mm_add_ps(sumRG, _mm_mul_ps(r, g));
+			sumRB = _mm_add_ps(sumRB, _mm_mul_ps(r, b));
+			sumGG = _mm_add_ps(sumGG, _mm_mul_ps(g, g));
+			sumGB = _mm_add_ps(sumGB, _mm_mul_ps(g, b));
+			sumBB = _mm_add_ps(sumBB, _mm_mul_ps(b, b));
+		}
+
+		float covariance[3][3];
+		covariance[0][0] = HorizontalSum(sumRR);
+		covariance[0][1] = covariance[1][0] = HorizontalSum(sumRG);
+		covariance[0][2] = covariance[2][0] = HorizontalSum(sumRB);
+		covariance[1][1] = HorizontalSum(sumGG);
+		covariance[1][2] = covariance[2][1] = HorizontalSum(sumGB);
+		covariance[2][2] = HorizontalSum(sumBB);
+
+		// start from the row of the channel that varies the most
+		int start = 0;
+		for (int channel = 1; channel < 3; channel++)
+		{
+			if (covariance[channel][channel] > covariance[start][start])
+			{
+				start = channel;
+			}
+		}
+		float axis[3] = { covariance[start][0], covariance[start][1], covariance[start][2] };
+
+		for (int iteration = 0; iteration < POWER_ITERATIONS; iteration++)
+		{
+			float next[3];
+			for (int channel = 0; channel < 3; channel++)
+			{
+				next[channel] = covariance[channel][0] * axis[0] + covariance[channel][1] * axis[1] + covariance[channel][2] * axis[2];
+			}
+
+			float largest = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+			if (largest <= 0.0f)
+			{
+				break;
+			}
+			for (int channel = 0; channel < 3; channel++)
+			{
+				axis[channel] = next[channel] / largest;
+			}
+		}
+
+		// a block of one color has no axis
+		float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		if (length < 1e-6f)
+		{
+			for (int channel = 0; channel < 3; channel++)
+			{
+				endpoint0[channel] = mean[channel];
+				endpoint1[channel] = mean[channel];
+			}
+			return;
+		}
+		for (int channel = 0; channel < 3; channel++)
+		{
+			axis[channel] /= length;
+		}
+
+		__m128 axisR = _mm_set1_ps(axis[0]);
+		__m128 axisG = _mm_set1_ps(axis[1]);
+		__m128 axisB = _mm_set1_ps(axis[2]);
+		__m128 minimum = _mm_set1_ps(1e30f);
+		__m128 maximum = _mm_set1_ps(-1e30f);
+		for (int row = 0; row < 4; row++)
+		{
+			__m128 projection = _mm_add_ps(
+				_mm_mul_ps(_mm_sub_ps(block.r[row], meanR), axisR),
+				_mm_add_ps(
+					_mm_mul_ps(_mm_sub_ps(block.g[row], meanG), axisG),
+					_mm_mul_ps(_mm_sub_ps(block.b[row], meanB), axisB)));
+			minimum = _mm_min_ps(minimum, projection);
+			maximum = _mm_max_ps(maximum, projection);
+		}
+
+		float lowest = HorizontalMin(minimum);
+		float highest = HorizontalMax(maximum);
+		for (int channel = 0; channel < 3; channel++)
+		{
+			endpoint0[channel] = mean[channel] + axis[channel] * highest;
+			endpoint1[channel] = mean[channel] + axis[channel] * lowest;
+		}
+	}
+
+	/***********************************************************
+	 *  QuantizeColor()
+	 *
+	 *  Round a color to the nearest RGB 5:6:5 value.
+	 ***********************************************************/
+	uint16_t QuantizeColor(const float color[3])
+	{
+		int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+		int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		return((uint16_t)((r << 11) | (g << 5) | b));
+	}
+
+	/***********************************************************
+	 *  ExpandColor()
+	 *
+	 *  Widen an RGB 5:6:5 value back to 8 bits per channel, the
+	 *  way the GPU decodes it.
+	 ***********************************************************/
+	void ExpandColor(uint16_t packed, float color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+	}
+
+	/***********************************************************
+	 *  SelectColorIndices()
+	 *
+	 *  Pick the nearest of the four colors of a block for each
+	 *  texel, four texels at a time, returning the summed
+	 *  squared error.
+	 ***********************************************************/
+	float SelectColorIndices(const TEXEL_BLOCK& block, uint16_t color0, uint16_t color1, int indices[BLOCK_TEXELS])
+	{
+		float endpoint0[3];
+		float endpoint1[3];
+		ExpandColor(color0, endpoint0);
+		ExpandColor(color1, endpoint1);
+
+		__m128 paletteR[4];
+		__m128 paletteG[4];
+		__m128 paletteB[4];
+		for (int entry = 0; entry < 4; entry++)
+		{
+			float weight = PALETTE_WEIGHTS[entry];
+			paletteR[entry] = _mm_set1_ps(endpoint0[0] * weight + endpoint1[0] * (1.0f - weight));
+			paletteG[entry] = _mm_set1_ps(endpoint0[1] * weight + endpoint1[1] * (1.0f - weight));
+			paletteB[entry] = _mm_set1_ps(endpoint0[2] * weight + endpoint1[2] * (1.0f - weight));
+		}
+
+		__m128 error = _mm_setzero_ps();
+		for (int row = 0; row < 4; row++)
+		{
+			__m128 best = _mm_set1_ps(1e30f);
+			__m128i bestIndex = _mm_setzero_si128();
+
+			for (int entry = 0; entry < 4; entry++)
+			{
+				__m128 r = _mm_sub_ps(block.r[row], paletteR[entry]);
+				__m128 g = _mm_sub_ps(block.g[row], paletteG[entry]);
+				__m128 b = _mm_sub_ps(block.b[row], paletteB[entry]);
+				__m128 distance = _mm_add_ps(_mm_mul_ps(r, r), _mm_add_ps(_mm_mul_ps(g, g), _mm_mul_ps(b, b)));
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				best = _mm_min_ps(best, distance);
+				bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(entry)));
+			}
+
+			error = _mm_add_ps(error, best);
+			_mm_storeu_si128((__m128i*)(indices + row * 4), bestIndex);
+		}
+
+		return(HorizontalSum(error));
+	}
+
+	/***********************************************************
+	 *  RefineEndpoints()
+	 *
+	 *  Solve for the endpoints that best fit the texels with
+	 *  the indices picked for them, by least squares.  Returns
+	 *  false when the indices do not pin both endpoints down.
+	 ***********************************************************/
+	bool RefineEndpoints(const unsigned char* pTexels, const int indices[BLOCK_TEXELS], float endpoint0[3], float endpoint1[3])
+	{
+		float alpha2 = 0.0f;
+		float beta2 = 0.0f;
+		float alphaBeta = 0.0f;
+		float alphaX[3] = { 0.0f, 0.0f, 0.0f };
+		float betaX[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (int i = 0; i < BLOCK_TEXELS; i++)
+		{
+			float alpha = PALETTE_WEIGHTS[indices[i]];
+			float beta = 1.0f - alpha;
+			alpha2 += alpha * alpha;
+			beta2 += beta * beta;
+			alphaBeta += alpha * beta;
+			for (int channel = 0; channel < 3; channel++)
+			{
+				float texel = (float)pTexels[i * TEXEL_BYTES + channel];
+				alphaX[channel] += alpha * texel;
+				betaX[channel] += beta * texel;
+			}
+		}
+
+		float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+		if (std::fabs(determinant) < 1e-6f)
+		{
+			return(false);
+		}
+
+		for (int channel = 0; channel < 3; channel++)
+		{
+			endpoint0[channel] = (alphaX[channel] * beta2 - betaX[channel] * alphaBeta) / determinant;
+			endpoint1[channel] = (betaX[channel] * alpha2 - alphaX[channel] * alphaBeta) / determinant;
+		}
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  GatherBlock()
+	 *
+	 *  Copy the texels of one block out of an image.  Blocks
+	 *  that hang over the edge repeat the edge texels.
+	 ***********************************************************/
+	void GatherBlock(const unsigned char* pPixels, int width, int height, int blockX, int blockY, unsigned char* pTexels)
+	{
+		for (int y = 0; y < BlockCompressor::BLOCK_SIZE; y++)
+		{
+			int sourceY = std::min(blockY * BlockCompressor::BLOCK_SIZE + y, height - 1);
+			for (int x = 0; x < BlockCompressor::BLOCK_SIZE; x++)
+			{
+				int sourceX = std::min(blockX * BlockCompressor::BLOCK_SIZE + x, width - 1);
+				memcpy(pTexels + (y * BlockCompressor::BLOCK_SIZE + x) * TEXEL_BYTES,
+					pPixels + ((size_t)sourceY * width + sourceX) * TEXEL_BYTES, TEXEL_BYTES);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  MirrorIndex()
+	 *
+	 *  Texel of a block that lands on (x, y) after mirroring.
+	 ***********************************************************/
+	int MirrorIndex(int x, int y, bool bMirrorX, bool bMirrorY)
+	{
+		int sourceX = (bMirrorX == true) ? (3 - x) : x;
+		int sourceY = (bMirrorY == true) ? (3 - y) : y;
+		return(sourceY * 4 + sourceX);
+	}
+}
+
+/***********************************************************
+ *  BlockCompressor()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BlockCompressor::BlockCompressor(QUALITY quality)
+{
+	m_quality = quality;
+}
+
+/***********************************************************
+ *  ~BlockCompressor()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+BlockCompressor::~BlockCompressor()
+{
+}
+
+/***********************************************************
+ *  GetCompressedSize()
+ *
+ *  This method is used for getting the number of bytes of an
+ *  image stored as blocks - partial blocks at the right and
+ *  bottom edges take a whole block.
+ ***********************************************************/
+size_t BlockCompressor::GetCompressedSize(int width, int height, size_t blockBytes)
+{
+	size_t blocksWide = (size_t)(width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	size_t blocksHigh = (size_t)(height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	return(blocksWide * blocksHigh * blockBytes);
+}
+
+/***********************************************************
+ *  CompressBC1()
+ *
+ *  This method is used for encoding an RGBA image into BC1
+ *  blocks, left to right and bottom row of blocks first, in
+ *  the same order as the rows of the image.
+ ***********************************************************/
+void BlockCompressor::CompressBC1(const unsigned char* pPixels, int width, int height, unsigned char* pBlocks) const
+{
+	int blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int blocksHigh = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	unsigned char texels[BLOCK_TEXELS * TEXEL_BYTES];
+
+	for (int blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			GatherBlock(pPixels, width, height, blockX, blockY, texels);
+			EncodeColorBlock(texels, pBlocks + ((size_t)blockY * blocksWide + blockX) * BC1_BLOCK_BYTES);
+		}
+	}
+}
+
+/***********************************************************
+ *  CompressBC3()
+ *
+ *  This method is used for encoding an RGBA image into BC3
+ *  blocks, each an alpha block followed by a color block.
+ ***********************************************************/
+void BlockCompressor::CompressBC3(const unsigned char* pPixels, int width, int height, unsigned char* pBlocks) const
+{
+	int blocksWide = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int blocksHigh = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	unsigned char texels[BLOCK_TEXELS * TEXEL_BYTES];
+
+	for (int blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			unsigned char* pBlock = pBlocks + ((size_t)blockY * blocksWide + blockX) * BC3_BLOCK_BYTES;
+			GatherBlock(pPixels, width, height, blockX, blockY, texels);
+			EncodeAlphaBlock(texels, pBlock);
+			EncodeColorBlock(texels, pBlock + BC1_BLOCK_BYTES);
+		}
+	}
+}
+
+/***********************************************************
+ *  EncodeColorBlock()
+ *
+ *  This method is used for encoding the colors of a block.
+ *  The endpoints are picked by the quality setting, and the
+ *  larger one is stored first so the block always uses the
+ *  four color mode.
+ ***********************************************************/
+void BlockCompressor::EncodeColorBlock(const unsigned char* pTexels, unsigned char* pBlock) const
+{
+	TEXEL_BLOCK block;
+	LoadTexels(pTexels, block);
+
+	float mean[3] = {
+		SumRows(block.r) / BLOCK_TEXELS,
+		SumRows(block.g) / BLOCK_TEXELS,
+		SumRows(block.b) / BLOCK_TEXELS };
+
+	float endpoint0[3];
+	float endpoint1[3];
+	if (m_quality == QUALITY_FAST)
+	{
+		BoundingBoxEndpoints(block, mean, endpoint0, endpoint1);
+	}
+	else
+	{
+		PrincipalAxisEndpoints(block, mean, endpoint0, endpoint1);
+	}
+
+	uint16_t color0 = QuantizeColor(endpoint0);
+	uint16_t color1 = QuantizeColor(endpoint1);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	// with equal endpoints every index selects the one color
+	int indices[BLOCK_TEXELS] = { 0 };
+	if (color0 != color1)
+	{
+		float error = SelectColorIndices(block, color0, color1, indices);
+
+		for (int pass = 0; (m_quality == QUALITY_HIGH) && (pass < REFINE_PASSES); pass++)
+		{
+			if (RefineEndpoints(pTexels, indices, endpoint0, endpoint1) == false)
+			{
+				break;
+			}
+
+			uint16_t refined0 = QuantizeColor(endpoint0);
+			uint16_t refined1 = QuantizeColor(endpoint1);
+			if (refined0 < refined1)
+			{
+				std::swap(refined0, refined1);
+			}
+			if (refined0 == refined1)
+			{
+				break;
+			}
+
+			int refinedIndices[BLOCK_TEXELS];
+			float refinedError = SelectColorIndices(block, refined0, refined1, refinedIndices);
+			if (refinedError >= error)
+			{
+				break;
+			}
+
+			color0 = refined0;
+			color1 = refined1;
+			error = refinedError;
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	uint32_t packedIndices = 0;
+	for (int i = 0; i < BLOCK_TEXELS; i++)
+	{
+		packedIndices |= (uint32_t)indices[i] << (2 * i);
+	}
+
+	pBlock[0] = (unsigned char)(color0 & 0xFF);
+	pBlock[1] = (unsigned char)(color0 >> 8);
+	pBlock[2] = (unsigned char)(color1 & 0xFF);
+	pBlock[3] = (unsigned char)(color1 >> 8);
+	for (int i = 0; i < 4; i++)
+	{
+		pBlock[4 + i] = (unsigned char)(packedIndices >> (8 * i));
+	}
+}
+
+/***********************************************************
+ *  EncodeAlphaBlock()
+ *
+ *  This method is used for encoding the alpha of a block.
+ *  The endpoints are the smallest and largest alpha, and each
+ *  texel takes the nearest of the eight evenly spaced values
+ *  between them.
+ ***********************************************************/
+void BlockCompressor::EncodeAlphaBlock(const unsigned char* pTexels, unsigned char* pBlock) const
+{
+	TEXEL_BLOCK block;
+	LoadTexels(pTexels, block);
+
+	float minimum = MinRows(block.a);
+	float maximum = MaxRows(block.a);
+
+	memset(pBlock, 0, BC1_BLOCK_BYTES);
+	pBlock[0] = (unsigned char)maximum;
+	pBlock[1] = (unsigned char)minimum;
+	if (maximum == minimum)
+	{
+		return;
+	}
+
+	// the position of each texel on the ramp from the smallest
+	// alpha at 0 to the largest at 7
+	int steps[BLOCK_TEXELS];
+	__m128 lowest = _mm_set1_ps(minimum);
+	__m128 scale = _mm_set1_ps(7.0f / (maximum - minimum));
+	for (int row = 0; row < 4; row++)
+	{
+		__m128i step = _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(block.a[row], lowest), scale));
+		_mm_storeu_si128((__m128i*)(steps + row * 4), step);
+	}
+
+	// index 0 is the largest alpha, 1 the smallest, and 2 to 7
+	// step down from the largest
+	uint64_t packedIndices = 0;
+	for (int i = 0; i < BLOCK_TEXELS; i++)
+	{
+		int index = (steps[i] >= 7) ? 0 : ((steps[i] <= 0) ? 1 : (8 - steps[i]));
+		packedIndices |= (uint64_t)index << (3 * i);
+	}
+	for (int i = 0; i < 6; i++)
+	{
+		pBlock[2 + i] = (unsigned char)(packedIndices >> (8 * i));
+	}
+}
+
+/***********************************************************
+ *  MirrorBlock()
+ *
+ *  This method is used for mirroring an encoded block across
+ *  its vertical or horizontal center.  The endpoints stay as
+ *  they are and the indices are moved, so the result has
+ *  exactly the texels of the original, mirrored.
+ ***********************************************************/
+void BlockCompressor::MirrorBlock(unsigned char* pBlock, size_t blockBytes, bool bMirrorX, bool bMirrorY)
+{
+	if ((bMirrorX == false) && (bMirrorY == false))
+	{
+		return;
+	}
+
+	unsigned char* pColorBlock = pBlock;
+	if (blockBytes == BC3_BLOCK_BYTES)
+	{
+		uint64_t alphaIndices = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			alphaIndices |= (uint64_t)pBlock[2 + i] << (8 * i);
+		}
+
+		uint64_t mirrored = 0;
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				uint64_t index = (alphaIndices >> (3 * MirrorIndex(x, y, bMirrorX, bMirrorY))) & 7;
+				mirrored |= index << (3 * (y * 4 + x));
+			}
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			pBlock[2 + i] = (unsigned char)(mirrored >> (8 * i));
+		}
+		pColorBlock = pBlock + BC1_BLOCK_BYTES;
+	}
+
+	uint32_t colorIndices = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		colorIndices |= (uint32_t)pColorBlock[4 + i] << (8 * i);
+	}
+
+	uint32_t mirrored = 0;
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			uint32_t index = (colorIndices >> (2 * MirrorIndex(x, y, bMirrorX, bMirrorY))) & 3;
+			mirrored |= index << (2 * (y * 4 + x));
+		}
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		pColorBlock[4 + i] = (unsigned char)(mirrored >> (8 * i));
+	}
+}
@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// blockcompressor.h
+// ============
+// encode RGBA images into BC1 and BC3 blocks on the CPU
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  BlockCompressor
+ *
+ *  This class encodes RGBA images into the S3TC block
+ *  formats the GPU samples directly - BC1 for opaque images
+ *  at 8 bytes per 4x4 block, and BC3 for images with alpha
+ *  at 16 bytes per block.  The texels of each block are
+ *  processed four at a time with SSE2.  The quality picks
+ *  how the color endpoints are searched for, trading the
+ *  encoding time against the error of the result.  The
+ *  encode methods only use their own locals and can be
+ *  called from several threads at once.
+ ***********************************************************/
+class BlockCompressor
+{
+public:
+	// how hard the color endpoints are searched for
+	enum QUALITY
+	{
+		// the corners of the bounding box of the colors
+		QUALITY_FAST = 0,
+		// the extent of the colors along their principal axis
+		QUALITY_NORMAL,
+		// the principal axis, then refined by least squares
+		QUALITY_HIGH
+	};
+
+	// texels along each side of a block
+	static const int BLOCK_SIZE = 4;
+	// bytes in one encoded block
+	static const size_t BC1_BLOCK_BYTES = 8;
+	static const size_t BC3_BLOCK_BYTES = 16;
+
+	// constructor
+	BlockCompressor(QUALITY quality = QUALITY_NORMAL);
+	// destructor
+	~BlockCompressor();
+
+	// encode an RGBA image into rows of BC1 blocks
+	void CompressBC1(const unsigned char* pPixels, int width, int height, unsigned char* pBlocks) const;
+	// encode an RGBA image into rows of BC3 blocks
+	void CompressBC3(const unsigned char* pPixels, int width, int height, unsigned char* pBlocks) const;
+
+	// bytes needed for an image of encoded blocks
+	static size_t GetCompressedSize(int width, int height, size_t blockBytes);
+	// mirror the texels of an encoded block in place, which
+	// only reorders its indices
+	static void MirrorBlock(unsigned char* pBlock, size_t blockBytes, bool bMirrorX, bool bMirrorY);
+
+private:
+	QUALITY m_quality;
+
+	// encode the color of 16 RGBA texels into a BC1 block
+	void EncodeColorBlock(const unsigned char* pTexels, unsigned char* pBlock) const;
+	// encode the alpha of 16 RGBA texels into a BC3 alpha block
+	void EncodeAlphaBlock(const unsigned char* pTexels, unsigned char* pBlock) const;
+};
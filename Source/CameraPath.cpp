@@ -0,0 +1,235 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// record the camera along a path and play it back at a fixed step
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// declaration of the global variables and defines
+namespace
+{
+	/***********************************************************
+	 *  CatmullRom()
+	 *
+	 *  The point a share of the way from p1 to p2, on the curve
+	 *  that passes through them with the slopes set by the
+	 *  points around them.  The slopes are scaled by the time
+	 *  between the keyframes, so the speed of the camera does
+	 *  not jump where keyframes are unevenly spaced.
+	 ***********************************************************/
+	glm::vec3 CatmullRom(
+		const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3,
+		float t0, float t1, float t2, float t3,
+		float share)
+	{
+		float interval = t2 - t1;
+		glm::vec3 slope1 = (t2 > t0) ? (p2 - p0) * (interval / (t2 - t0)) : glm::vec3(0.0f);
+		glm::vec3 slope2 = (t3 > t1) ? (p3 - p1) * (interval / (t3 - t1)) : glm::vec3(0.0f);
+
+		float share2 = share * share;
+		float share3 = share2 * share;
+		return((2.0f * share3 - 3.0f * share2 + 1.0f) * p1 +
+			(share3 - 2.0f * share2 + share) * slope1 +
+			(-2.0f * share3 + 3.0f * share2) * p2 +
+			(share3 - share2) * slope2);
+	}
+}
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+}
+
+/***********************************************************
+ *  ~CameraPath()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+CameraPath::~CameraPath()
+{
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading the keyframes of a path
+ *  file.  A line that cannot be read, or a keyframe earlier
+ *  than the one before it, fails the whole file.
+ ***********************************************************/
+bool CameraPath::Load(const std::string& filename)
+{
+	std::ifstream file(filename.c_str());
+	if (!file)
+	{
+		std::cout << "CameraPath: could not open " << filename << std::endl;
+		return(false);
+	}
+
+	std::vector<CAMERA_KEYFRAME> keyframes;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream tokens(line);
+		std::string keyword;
+		if (!(tokens >> keyword))
+		{
+			continue;
+		}
+
+		CAMERA_KEYFRAME keyframe;
+		bool bValid = (keyword == "key") &&
+			(tokens >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+				>> keyframe.yaw >> keyframe.pitch) &&
+			((keyframes.empty() == true) || (keyframe.time >= keyframes.back().time));
+		if (bValid == false)
+		{
+			std::cout << "CameraPath: " << filename << ":" << lineNumber << ": could not read '" << line << "'" << std::endl;
+			return(false);
+		}
+		keyframes.push_back(keyframe);
+	}
+
+	m_keyframes.swap(keyframes);
+	std::cout << "CameraPath: loaded " << m_keyframes.size() << " keyframes, "
+		<< GetDuration() << " seconds, from " << filename << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method is used for writing the keyframes to a path
+ *  file, in the form Load() reads.
+ ***********************************************************/
+bool CameraPath::Save(const std::string& filename) const
+{
+	std::ofstream file(filename.c_str());
+	if (!file)
+	{
+		std::cout << "CameraPath: could not write " << filename << std::endl;
+		return(false);
+	}
+
+	file << "# " << filename << "\n";
+	file << "# recorded camera path - the layout of each line is described in Source/CameraPath.h\n\n";
+	file << "#   time  position  yaw  pitch\n";
+	for (size_t i = 0; i < m_keyframes.size(); i++)
+	{
+		const CAMERA_KEYFRAME& keyframe = m_keyframes[i];
+		file << "key " << keyframe.time << "  "
+			<< keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << "  "
+			<< keyframe.yaw << " " << keyframe.pitch << "\n";
+	}
+
+	return(file.good());
+}
+
+/***********************************************************
+ *  AddKeyframe()
+ *
+ *  This method is used for adding a keyframe at the end of
+ *  the path.  A keyframe earlier than the last one is left
+ *  out.
+ ***********************************************************/
+void CameraPath::AddKeyframe(float time, const glm::vec3& position, float yaw, float pitch)
+{
+	if ((m_keyframes.empty() == false) && (time < m_keyframes.back().time))
+	{
+		return;
+	}
+
+	CAMERA_KEYFRAME keyframe;
+	keyframe.time = time;
+	keyframe.position = position;
+	keyframe.yaw = yaw;
+	keyframe.pitch = pitch;
+	m_keyframes.push_back(keyframe);
+}
+
+/***********************************************************
+ *  Sample()
+ *
+ *  This method is used for finding the camera at a time.
+ *  The keyframes around it, and one more on each side, set
+ *  the spline the position follows, and the angles follow
+ *  one of their own.  The yaw is not wrapped, so a camera
+ *  that turned past a full circle keeps turning the same
+ *  way.
+ ***********************************************************/
+void CameraPath::Sample(float time, glm::vec3& position, float& yaw, float& pitch) const
+{
+	if (m_keyframes.empty() == true)
+	{
+		return;
+	}
+
+	// the first keyframe after the time
+	struct KEYFRAME_TIME
+	{
+		bool operator()(float time, const CAMERA_KEYFRAME& keyframe) const { return(time < keyframe.time); }
+	};
+	int next = (int)(std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time, KEYFRAME_TIME()) - m_keyframes.begin());
+	if ((next == 0) || (next == (int)m_keyframes.size()))
+	{
+		const CAMERA_KEYFRAME& keyframe = m_keyframes[(next == 0) ? 0 : next - 1];
+		position = keyframe.position;
+		yaw = keyframe.yaw;
+		pitch = keyframe.pitch;
+		return;
+	}
+
+	int last = (int)m_keyframes.size() - 1;
+	const CAMERA_KEYFRAME& k0 = m_keyframes[std::max(next - 2, 0)];
+	const CAMERA_KEYFRAME& k1 = m_keyframes[next - 1];
+	const CAMERA_KEYFRAME& k2 = m_keyframes[next];
+	const CAMERA_KEYFRAME& k3 = m_keyframes[std::min(next + 1, last)];
+	float share = (k2.time > k1.time) ? (time - k1.time) / (k2.time - k1.time) : 1.0f;
+
+	position = CatmullRom(
+		k0.position, k1.position, k2.position, k3.position,
+		k0.time, k1.time, k2.time, k3.time,
+		share);
+	glm::vec3 angles = CatmullRom(
+		glm::vec3(k0.yaw, k0.pitch, 0.0f), glm::vec3(k1.yaw, k1.pitch, 0.0f),
+		glm::vec3(k2.yaw, k2.pitch, 0.0f), glm::vec3(k3.yaw, k3.pitch, 0.0f),
+		k0.time, k1.time, k2.time, k3.time,
+		share);
+	yaw = angles.x;
+	pitch = angles.y;
+}
+
+/***********************************************************
+ *  GetDuration()
+ *
+ *  This method is used for getting the time of the last
+ *  keyframe, which is how long the path takes to play.
+ ***********************************************************/
+float CameraPath::GetDuration() const
+{
+	if (m_keyframes.empty() == true)
+	{
+		return(0.0f);
+	}
+
+	return(m_keyframes.back().time);
+}
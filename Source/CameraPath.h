@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// record the camera along a path and play it back at a fixed step
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class keeps the keyframes of a camera path - where
+ *  the camera is and the way it looks at points in time -
+ *  and gives the camera at any time in between, on a
+ *  Catmull-Rom spline through the keyframes, so it moves
+ *  smoothly through them without stopping at each one.
+ *  Paths are written as text, one keyframe per line:
+ *
+ *    key <time> <position xyz> <yaw> <pitch>
+ *
+ *  with the time in seconds and the angles in degrees, in
+ *  the order of their times.  Everything after a # is a
+ *  comment.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// constructor
+	CameraPath();
+	// destructor
+	~CameraPath();
+
+	// a pose of the camera at a point in time
+	struct CAMERA_KEYFRAME
+	{
+		float time;
+		glm::vec3 position;
+		float yaw;
+		float pitch;
+	};
+
+	// read the keyframes of a path file
+	bool Load(const std::string& filename);
+	// write the keyframes to a path file
+	bool Save(const std::string& filename) const;
+
+	// remove every keyframe
+	void Clear() { m_keyframes.clear(); }
+	// add a keyframe after the last one
+	void AddKeyframe(float time, const glm::vec3& position, float yaw, float pitch);
+
+	// the camera at a time - before the first keyframe and after
+	// the last one the camera holds still at them
+	void Sample(float time, glm::vec3& position, float& yaw, float& pitch) const;
+
+	int GetKeyframeCount() const { return((int)m_keyframes.size()); }
+	// the time of the last keyframe
+	float GetDuration() const;
+
+private:
+	std::vector<CAMERA_KEYFRAME> m_keyframes;
+};
@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredrenderer.cpp
+// ============
+// draw the scene into a G-buffer and shade it in a second pass
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeferredRenderer.h"
+#include "ProgramCache.h"
+#include "ShaderPermutations.h"
+
+#include <iostream>
+#include <vector>
+
+// declaration of the global variables and defines
+namespace
+{
+	// storage of each color target - the normal keeps half
+	// floats so lighting does not band, and the material index
+	// is read back exactly
+	const GLenum TARGET_FORMATS[DeferredRenderer::TARGET_COUNT] =
+	{
+		GL_RGBA8,
+		GL_RGBA16F,
+		GL_R16UI
+	};
+}
+
+/***********************************************************
+ *  DeferredRenderer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeferredRenderer::DeferredRenderer()
+{
+	for (int target = 0; target < TARGET_COUNT; target++)
+	{
+		m_targets[target] = 0;
+	}
+	m_depthTarget = 0;
+	m_framebuffer = 0;
+	m_width = 0;
+	m_height = 0;
+	m_program = 0;
+	m_inverseViewProjectionLocation = -1;
+	m_emptyVAO = 0;
+	m_previousFramebuffer = 0;
+	m_bPreviousBlend = GL_FALSE;
+}
+
+/***********************************************************
+ *  ~DeferredRenderer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeferredRenderer::~DeferredRenderer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  BuildProgram()
+ *
+ *  This method is used for building the program of the
+ *  lighting pass, with the same light loop and cluster
+ *  lookup as the lit forward variants.  It is called again
+ *  when the shaders or the lights change.
+ ***********************************************************/
+bool DeferredRenderer::BuildProgram(
+	ProgramCache* pProgramCache,
+	const std::string& vertexFilename,
+	const std::string& fragmentFilename,
+	int lightCount,
+	bool bClusteredLights)
+{
+	if (pProgramCache == NULL)
+	{
+		return(false);
+	}
+
+	std::vector<std::string> defines;
+	ShaderPermutations::GetDefines(
+		ShaderPermutations::VARIANT_LIT,
+		lightCount,
+		bClusteredLights,
+		ShaderPermutations::LIGHTING_PASS,
+		defines);
+	GLuint program = pProgramCache->LoadProgram(vertexFilename.c_str(), fragmentFilename.c_str(), defines);
+	if (program == 0)
+	{
+		std::cout << "DeferredRenderer: the lighting pass did not build, the old program is kept" << std::endl;
+		return(false);
+	}
+
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+	}
+	m_program = program;
+	m_inverseViewProjectionLocation = glGetUniformLocation(m_program, "inverseViewProjection");
+
+	if (m_emptyVAO == 0)
+	{
+		glCreateVertexArrays(1, &m_emptyVAO);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for creating the G-buffer targets at
+ *  the size of the viewport.  Nothing is done while the size
+ *  is unchanged.
+ ***********************************************************/
+void DeferredRenderer::Resize(int width, int height)
+{
+	if ((width <= 0) || (height <= 0) ||
+		((width == m_width) && (height == m_height) && (m_framebuffer != 0)))
+	{
+		return;
+	}
+
+	DestroyTargets();
+	m_width = width;
+	m_height = height;
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	GLenum drawBuffers[TARGET_COUNT];
+	for (int target = 0; target < TARGET_COUNT; target++)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_targets[target]);
+		glTextureStorage2D(m_targets[target], 1, TARGET_FORMATS[target], width, height);
+		glTextureParameteri(m_targets[target], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_targets[target], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0 + target, m_targets[target], 0);
+		drawBuffers[target] = GL_COLOR_ATTACHMENT0 + target;
+	}
+	glNamedFramebufferDrawBuffers(m_framebuffer, TARGET_COUNT, drawBuffers);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depthTarget);
+	glTextureStorage2D(m_depthTarget, 1, GL_DEPTH_COMPONENT32F, width, height);
+	glTextureParameteri(m_depthTarget, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_depthTarget, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glNamedFramebufferTexture(m_framebuffer, GL_DEPTH_ATTACHMENT, m_depthTarget, 0);
+
+	if (glCheckNamedFramebufferStatus(m_framebuffer, GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "DeferredRenderer: the G-buffer is not complete at "
+			<< width << "x" << height << std::endl;
+		DestroyTargets();
+	}
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ *
+ *  This method is used for freeing the G-buffer targets and
+ *  their framebuffer.
+ ***********************************************************/
+void DeferredRenderer::DestroyTargets()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	for (int target = 0; target < TARGET_COUNT; target++)
+	{
+		if (m_targets[target] != 0)
+		{
+			glDeleteTextures(1, &m_targets[target]);
+			m_targets[target] = 0;
+		}
+	}
+	if (m_depthTarget != 0)
+	{
+		glDeleteTextures(1, &m_depthTarget);
+		m_depthTarget = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the G-buffer and the
+ *  lighting pass program.
+ ***********************************************************/
+void DeferredRenderer::Destroy()
+{
+	DestroyTargets();
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+	if (m_emptyVAO != 0)
+	{
+		glDeleteVertexArrays(1, &m_emptyVAO);
+		m_emptyVAO = 0;
+	}
+	m_inverseViewProjectionLocation = -1;
+}
+
+/***********************************************************
+ *  BeginGeometryPass()
+ *
+ *  This method is used for binding and clearing the G-buffer
+ *  so the scene is drawn into it.  Blending is turned off,
+ *  since each target holds a surface value rather than a
+ *  color that could be mixed.
+ ***********************************************************/
+void DeferredRenderer::BeginGeometryPass()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+	m_bPreviousBlend = glIsEnabled(GL_BLEND);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glDisable(GL_BLEND);
+
+	const GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLuint clearMaterial[4] = { 0, 0, 0, 0 };
+	const GLfloat clearDepth = 1.0f;
+	glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, ALBEDO_TARGET, clearColor);
+	glClearNamedFramebufferfv(m_framebuffer, GL_COLOR, NORMAL_TARGET, clearColor);
+	glClearNamedFramebufferuiv(m_framebuffer, GL_COLOR, MATERIAL_TARGET, clearMaterial);
+	glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &clearDepth);
+}
+
+/***********************************************************
+ *  EndGeometryPass()
+ *
+ *  This method is used for binding the framebuffer and the
+ *  blending that were in use before the geometry pass.
+ ***********************************************************/
+void DeferredRenderer::EndGeometryPass()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)m_previousFramebuffer);
+	if (m_bPreviousBlend == GL_TRUE)
+	{
+		glEnable(GL_BLEND);
+	}
+}
+
+/***********************************************************
+ *  LightingPass()
+ *
+ *  This method is used for shading the G-buffer into the
+ *  bound framebuffer.  The pass writes the G-buffer depth as
+ *  it shades, so anything drawn after it is still depth
+ *  tested against the scene.
+ ***********************************************************/
+void DeferredRenderer::LightingPass(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (IsReady() == false)
+	{
+		return;
+	}
+
+	for (int target = 0; target < TARGET_COUNT; target++)
+	{
+		glBindTextureUnit(GBUFFER_TEXTURE_UNIT + target, m_targets[target]);
+	}
+	glBindTextureUnit(GBUFFER_TEXTURE_UNIT + TARGET_COUNT, m_depthTarget);
+
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glProgramUniformMatrix4fv(m_program, m_inverseViewProjectionLocation, 1, GL_FALSE, &inverseViewProjection[0][0]);
+
+	// every pixel of the triangle is drawn, the depth test
+	// only matters for the depth it writes
+	glUseProgram(m_program);
+	glBindVertexArray(m_emptyVAO);
+	glDepthFunc(GL_ALWAYS);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDepthFunc(GL_LESS);
+	glBindVertexArray(0);
+}
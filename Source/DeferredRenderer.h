@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredrenderer.h
+// ============
+// draw the scene into a G-buffer and shade it in a second pass
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+class ProgramCache;
+
+/***********************************************************
+ *  DeferredRenderer
+ *
+ *  This class keeps the G-buffer that the deferred render
+ *  path draws the scene into - the base color, the normal
+ *  with whether the surface is lit, the material index and
+ *  the depth of every pixel - and the program that shades
+ *  it.  The geometry pass draws the scene with the G-buffer
+ *  variants into its framebuffer, and the lighting pass then
+ *  shades each covered pixel once with a triangle that covers
+ *  the screen, so the cost of the lights no longer grows with
+ *  the fragments that are overdrawn.
+ ***********************************************************/
+class DeferredRenderer
+{
+public:
+	// constructor
+	DeferredRenderer();
+	// destructor
+	~DeferredRenderer();
+
+	// the color targets of the G-buffer - these must match the
+	// outputs of the G-buffer pass in the shader code
+	enum GBUFFER_TARGET
+	{
+		ALBEDO_TARGET = 0,
+		NORMAL_TARGET,
+		MATERIAL_TARGET,
+		TARGET_COUNT
+	};
+
+	// the G-buffer is sampled on the texture units after the
+	// texture arrays - the depth follows the color targets
+	static const GLuint GBUFFER_TEXTURE_UNIT = 8;
+
+	// build the lighting pass program for a number of lights,
+	// with or without the clustered point lights - the old
+	// program is kept when the new one fails to build
+	bool BuildProgram(
+		ProgramCache* pProgramCache,
+		const std::string& vertexFilename,
+		const std::string& fragmentFilename,
+		int lightCount,
+		bool bClusteredLights);
+	// create the targets for a viewport size, when it changed
+	void Resize(int width, int height);
+	// free the targets, the framebuffer and the program
+	void Destroy();
+
+	// draw into the G-buffer until EndGeometryPass()
+	void BeginGeometryPass();
+	void EndGeometryPass();
+	// shade the G-buffer into the framebuffer that was bound
+	// before the geometry pass
+	void LightingPass(const glm::mat4& view, const glm::mat4& projection);
+
+	bool IsReady() const { return((m_program != 0) && (m_framebuffer != 0)); }
+
+private:
+	// the G-buffer targets and the framebuffer they form
+	GLuint m_targets[TARGET_COUNT];
+	GLuint m_depthTarget;
+	GLuint m_framebuffer;
+	int m_width;
+	int m_height;
+	// the lighting pass program, and where its inverse
+	// view-projection matrix is set
+	GLuint m_program;
+	GLint m_inverseViewProjectionLocation;
+	// vertex array with no attributes - the triangle that
+	// covers the screen is made from the vertex index
+	GLuint m_emptyVAO;
+	// framebuffer and blending in use before the geometry pass
+	GLint m_previousFramebuffer;
+	GLboolean m_bPreviousBlend;
+
+	// free the targets and the framebuffer
+	void DestroyTargets();
+};
@@ -0,0 +1,561 @@
+///////////////////////////////////////////////////////////////////////////////
+// deflateencoder.cpp
+// ============
+// compress data into zlib streams for the PNG files
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeflateEncoder.h"
+#include "ImageEncoder.h"
+
+#include <queue>
+#include <utility>
+
+// declaration of the global variables and defines
+namespace
+{
+	// the distances a match can reach back
+	const int WINDOW_SIZE = 32768;
+	const int WINDOW_MASK = WINDOW_SIZE - 1;
+	// the hash of the next three bytes picks the chain to search
+	const int HASH_BITS = 15;
+	const int HASH_SIZE = 1 << HASH_BITS;
+	// the shortest and longest matches
+	const int MIN_MATCH = 3;
+	const int MAX_MATCH = 258;
+	// the most earlier positions tried for each match, and the
+	// length of a match good enough to stop looking
+	const int MAX_CHAIN = 24;
+	const int NICE_MATCH = 128;
+	// the most symbols put in one block
+	const size_t BLOCK_SYMBOLS = 32768;
+
+	// the symbols of each alphabet, and the longest codes allowed
+	const int LITERAL_LENGTH_CODES = 286;
+	const int DISTANCE_CODES = 30;
+	const int CODE_LENGTH_CODES = 19;
+	const int MAX_CODE_BITS = 15;
+	const int MAX_CODE_LENGTH_BITS = 7;
+	const int END_OF_BLOCK = 256;
+
+	// the first length and the extra bits of each length code
+	const int LENGTH_BASE[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const int LENGTH_EXTRA[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	// the first distance and the extra bits of each distance code
+	const int DISTANCE_BASE[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const int DISTANCE_EXTRA[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	// the order the lengths of the code length codes are written in
+	const int CODE_LENGTH_ORDER[CODE_LENGTH_CODES] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// the code of every match length, and of every distance -
+	// distances up to 256 directly, and the longer ones by
+	// their distance over 128
+	struct CODE_TABLES
+	{
+		unsigned char lengthCodes[MAX_MATCH + 1];
+		unsigned char distanceCodes[512];
+
+		CODE_TABLES()
+		{
+			for (int code = 0; code < 29; code++)
+			{
+				int last = (code < 28) ? LENGTH_BASE[code + 1] : MAX_MATCH + 1;
+				for (int length = LENGTH_BASE[code]; length < last; length++)
+				{
+					lengthCodes[length] = (unsigned char)code;
+				}
+			}
+
+			for (int code = 0; code < DISTANCE_CODES; code++)
+			{
+				int last = (code < DISTANCE_CODES - 1) ? DISTANCE_BASE[code + 1] : WINDOW_SIZE + 1;
+				for (int distance = DISTANCE_BASE[code]; distance < last; distance++)
+				{
+					int index = (distance <= 256) ? distance - 1 : 256 + ((distance - 1) >> 7);
+					distanceCodes[index] = (unsigned char)code;
+				}
+			}
+		}
+	};
+	const CODE_TABLES& GetCodeTables()
+	{
+		static const CODE_TABLES tables;
+		return(tables);
+	}
+
+	inline int GetDistanceCode(const CODE_TABLES& tables, int distance)
+	{
+		return((distance <= 256) ? tables.distanceCodes[distance - 1] : tables.distanceCodes[256 + ((distance - 1) >> 7)]);
+	}
+
+	inline int GetHash(const unsigned char* pData)
+	{
+		return(((pData[0] << 10) ^ (pData[1] << 5) ^ pData[2]) & (HASH_SIZE - 1));
+	}
+
+	// give the first symbols a count, so every code has at least
+	// two symbols - a code of one symbol is not complete
+	void KeepTwoSymbols(unsigned int* pCounts)
+	{
+		int used = 0;
+		for (int i = 0; (i < 2) && (used < 2); i++)
+		{
+			used += (pCounts[i] > 0) ? 1 : 0;
+		}
+		for (int i = 0; (i < 2) && (used < 2); i++)
+		{
+			if (pCounts[i] == 0)
+			{
+				pCounts[i] = 1;
+				used++;
+			}
+		}
+	}
+
+	// make the Huffman code lengths of symbols from their counts,
+	// no longer than the most bits - when the tree is too deep
+	// the counts are halved, which flattens it, and it is made again
+	void GetCodeLengths(const unsigned int* pCounts, int symbolCount, int maxBits, unsigned char* pLengths)
+	{
+		std::vector<unsigned int> counts(pCounts, pCounts + symbolCount);
+		std::vector<int> parents;
+		std::vector<int> depths;
+
+		while (true)
+		{
+			typedef std::pair<unsigned int, int> NODE;
+			std::priority_queue<NODE, std::vector<NODE>, std::greater<NODE> > queue;
+			parents.assign(symbolCount, -1);
+			for (int i = 0; i < symbolCount; i++)
+			{
+				pLengths[i] = 0;
+				if (counts[i] > 0)
+				{
+					queue.push(NODE(counts[i], i));
+				}
+			}
+
+			// the leaves are the symbols, and each node made after
+			// them joins the two lightest left
+			while (queue.size() > 1)
+			{
+				NODE first = queue.top();
+				queue.pop();
+				NODE second = queue.top();
+				queue.pop();
+				int node = (int)parents.size();
+				parents.push_back(-1);
+				parents[first.second] = node;
+				parents[second.second] = node;
+				queue.push(NODE(first.first + second.first, node));
+			}
+
+			// the nodes are made after their children, so the depth
+			// of each is known once the ones after it are
+			depths.assign(parents.size(), 0);
+			int deepest = 0;
+			for (int node = (int)parents.size() - 1; node >= 0; node--)
+			{
+				if (parents[node] >= 0)
+				{
+					depths[node] = depths[parents[node]] + 1;
+				}
+				if ((node < symbolCount) && (counts[node] > 0))
+				{
+					pLengths[node] = (unsigned char)depths[node];
+					if (depths[node] > deepest)
+					{
+						deepest = depths[node];
+					}
+				}
+			}
+
+			if (deepest <= maxBits)
+			{
+				return;
+			}
+			for (int i = 0; i < symbolCount; i++)
+			{
+				if (counts[i] > 0)
+				{
+					counts[i] = (counts[i] + 1) / 2;
+				}
+			}
+		}
+	}
+
+	// give each symbol its canonical code, with the bits reversed
+	// since deflate writes Huffman codes highest bit first
+	void GetCodes(const unsigned char* pLengths, int symbolCount, unsigned short* pCodes)
+	{
+		int lengthCounts[MAX_CODE_BITS + 1] = { 0 };
+		for (int i = 0; i < symbolCount; i++)
+		{
+			lengthCounts[pLengths[i]]++;
+		}
+		lengthCounts[0] = 0;
+
+		int nextCodes[MAX_CODE_BITS + 1] = { 0 };
+		int code = 0;
+		for (int bits = 1; bits <= MAX_CODE_BITS; bits++)
+		{
+			code = (code + lengthCounts[bits - 1]) << 1;
+			nextCodes[bits] = code;
+		}
+
+		for (int i = 0; i < symbolCount; i++)
+		{
+			int length = pLengths[i];
+			pCodes[i] = 0;
+			if (length == 0)
+			{
+				continue;
+			}
+			int value = nextCodes[length]++;
+			int reversed = 0;
+			for (int bit = 0; bit < length; bit++)
+			{
+				reversed = (reversed << 1) | ((value >> bit) & 1);
+			}
+			pCodes[i] = (unsigned short)reversed;
+		}
+	}
+}
+
+/***********************************************************
+ *  DeflateEncoder()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeflateEncoder::DeflateEncoder()
+{
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+}
+
+/***********************************************************
+ *  ~DeflateEncoder()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeflateEncoder::~DeflateEncoder()
+{
+}
+
+/***********************************************************
+ *  Compress()
+ *
+ *  This method is used for compressing data into a zlib
+ *  stream.  At each position the chain of earlier positions
+ *  with the same next three bytes is searched for the
+ *  longest match, and the match or the literal byte is
+ *  added to the block.  Every position is added to the
+ *  chains, including the ones inside matches.
+ ***********************************************************/
+void DeflateEncoder::Compress(const unsigned char* pData, size_t size, std::vector<unsigned char>& output)
+{
+	m_hashHeads.assign(HASH_SIZE, -1);
+	m_hashChain.assign(WINDOW_SIZE, -1);
+	m_symbols.clear();
+	m_symbols.reserve(BLOCK_SYMBOLS);
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+
+	// the zlib header - deflate with a 32KB window
+	output.push_back(0x78);
+	output.push_back(0x9C);
+
+	size_t position = 0;
+	while (position < size)
+	{
+		int bestLength = 0;
+		int bestDistance = 0;
+		if (position + MIN_MATCH <= size)
+		{
+			int maxLength = (size - position < (size_t)MAX_MATCH) ? (int)(size - position) : MAX_MATCH;
+			int hash = GetHash(&pData[position]);
+			int candidate = m_hashHeads[hash];
+			int chainLeft = MAX_CHAIN;
+			while ((candidate >= 0) && ((int)position - candidate < WINDOW_SIZE) && (chainLeft-- > 0))
+			{
+				const unsigned char* pCandidate = &pData[candidate];
+				const unsigned char* pCurrent = &pData[position];
+				if (pCandidate[bestLength] == pCurrent[bestLength])
+				{
+					int length = 0;
+					while ((length < maxLength) && (pCandidate[length] == pCurrent[length]))
+					{
+						length++;
+					}
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = (int)position - candidate;
+						if ((length >= NICE_MATCH) || (length == maxLength))
+						{
+							break;
+						}
+					}
+				}
+
+				int next = m_hashChain[candidate & WINDOW_MASK];
+				if (next >= candidate)
+				{
+					break;
+				}
+				candidate = next;
+			}
+		}
+
+		int advance = 1;
+		DEFLATE_SYMBOL symbol;
+		if (bestLength >= MIN_MATCH)
+		{
+			symbol.literalLength = (unsigned short)bestLength;
+			symbol.distance = (unsigned short)bestDistance;
+			advance = bestLength;
+		}
+		else
+		{
+			symbol.literalLength = pData[position];
+			symbol.distance = 0;
+		}
+		m_symbols.push_back(symbol);
+
+		for (int i = 0; i < advance; i++, position++)
+		{
+			if (position + MIN_MATCH <= size)
+			{
+				int hash = GetHash(&pData[position]);
+				m_hashChain[position & WINDOW_MASK] = m_hashHeads[hash];
+				m_hashHeads[hash] = (int)position;
+			}
+		}
+
+		if (m_symbols.size() >= BLOCK_SYMBOLS)
+		{
+			WriteBlock(false, output);
+		}
+	}
+	WriteBlock(true, output);
+	FlushBits(output);
+
+	// the checksum of the data, highest byte first
+	unsigned int adler = ImageEncoder::UpdateAdler32(1, pData, size);
+	output.push_back((unsigned char)(adler >> 24));
+	output.push_back((unsigned char)(adler >> 16));
+	output.push_back((unsigned char)(adler >> 8));
+	output.push_back((unsigned char)adler);
+}
+
+/***********************************************************
+ *  WriteBlock()
+ *
+ *  This method is used for coding the symbols made so far
+ *  as a block.  The Huffman codes are made from how often
+ *  each symbol is used, and their lengths are written at
+ *  the start of the block, with the runs of equal lengths
+ *  shortened and coded with a small Huffman code of their
+ *  own.
+ ***********************************************************/
+void DeflateEncoder::WriteBlock(bool bFinal, std::vector<unsigned char>& output)
+{
+	const CODE_TABLES& tables = GetCodeTables();
+
+	unsigned int literalCounts[LITERAL_LENGTH_CODES] = { 0 };
+	unsigned int distanceCounts[DISTANCE_CODES] = { 0 };
+	for (size_t i = 0; i < m_symbols.size(); i++)
+	{
+		const DEFLATE_SYMBOL& symbol = m_symbols[i];
+		if (symbol.distance == 0)
+		{
+			literalCounts[symbol.literalLength]++;
+		}
+		else
+		{
+			literalCounts[257 + tables.lengthCodes[symbol.literalLength]]++;
+			distanceCounts[GetDistanceCode(tables, symbol.distance)]++;
+		}
+	}
+	literalCounts[END_OF_BLOCK] = 1;
+	KeepTwoSymbols(literalCounts);
+	KeepTwoSymbols(distanceCounts);
+
+	unsigned char literalLengths[LITERAL_LENGTH_CODES];
+	unsigned char distanceLengths[DISTANCE_CODES];
+	unsigned short literalCodes[LITERAL_LENGTH_CODES];
+	unsigned short distanceCodes[DISTANCE_CODES];
+	GetCodeLengths(literalCounts, LITERAL_LENGTH_CODES, MAX_CODE_BITS, literalLengths);
+	GetCodeLengths(distanceCounts, DISTANCE_CODES, MAX_CODE_BITS, distanceLengths);
+	GetCodes(literalLengths, LITERAL_LENGTH_CODES, literalCodes);
+	GetCodes(distanceLengths, DISTANCE_CODES, distanceCodes);
+
+	// the unused codes at the end are left out
+	int literalCount = LITERAL_LENGTH_CODES;
+	while ((literalCount > 257) && (literalLengths[literalCount - 1] == 0))
+	{
+		literalCount--;
+	}
+	int distanceCount = DISTANCE_CODES;
+	while ((distanceCount > 1) && (distanceLengths[distanceCount - 1] == 0))
+	{
+		distanceCount--;
+	}
+
+	// the lengths of both codes, one after the other, with
+	// repeats of a length as code 16 and runs of zeros as
+	// codes 17 and 18, each with the run in its extra bits
+	std::vector<unsigned char> lengths(literalLengths, literalLengths + literalCount);
+	lengths.insert(lengths.end(), distanceLengths, distanceLengths + distanceCount);
+	std::vector<std::pair<int, int> > runs;
+	size_t index = 0;
+	while (index < lengths.size())
+	{
+		int length = lengths[index];
+		int run = 1;
+		while ((index + run < lengths.size()) && (lengths[index + run] == length))
+		{
+			run++;
+		}
+		index += run;
+
+		if (length == 0)
+		{
+			while (run >= 11)
+			{
+				int count = (run < 138) ? run : 138;
+				runs.push_back(std::make_pair(18, count - 11));
+				run -= count;
+			}
+			if (run >= 3)
+			{
+				runs.push_back(std::make_pair(17, run - 3));
+				run = 0;
+			}
+		}
+		else
+		{
+			runs.push_back(std::make_pair(length, 0));
+			run--;
+			while (run >= 3)
+			{
+				int count = (run < 6) ? run : 6;
+				runs.push_back(std::make_pair(16, count - 3));
+				run -= count;
+			}
+		}
+		for (; run > 0; run--)
+		{
+			runs.push_back(std::make_pair(length, 0));
+		}
+	}
+
+	unsigned int runCounts[CODE_LENGTH_CODES] = { 0 };
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		runCounts[runs[i].first]++;
+	}
+	unsigned char runLengths[CODE_LENGTH_CODES];
+	unsigned short runCodes[CODE_LENGTH_CODES];
+	KeepTwoSymbols(runCounts);
+	GetCodeLengths(runCounts, CODE_LENGTH_CODES, MAX_CODE_LENGTH_BITS, runLengths);
+	GetCodes(runLengths, CODE_LENGTH_CODES, runCodes);
+	int runCodeCount = CODE_LENGTH_CODES;
+	while ((runCodeCount > 4) && (runLengths[CODE_LENGTH_ORDER[runCodeCount - 1]] == 0))
+	{
+		runCodeCount--;
+	}
+
+	// the block header, with its codes
+	WriteBits((bFinal == true) ? 1 : 0, 1, output);
+	WriteBits(2, 2, output);
+	WriteBits(literalCount - 257, 5, output);
+	WriteBits(distanceCount - 1, 5, output);
+	WriteBits(runCodeCount - 4, 4, output);
+	for (int i = 0; i < runCodeCount; i++)
+	{
+		WriteBits(runLengths[CODE_LENGTH_ORDER[i]], 3, output);
+	}
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		int code = runs[i].first;
+		WriteBits(runCodes[code], runLengths[code], output);
+		if (code == 16)
+		{
+			WriteBits(runs[i].second, 2, output);
+		}
+		else if (code == 17)
+		{
+			WriteBits(runs[i].second, 3, output);
+		}
+		else if (code == 18)
+		{
+			WriteBits(runs[i].second, 7, output);
+		}
+	}
+
+	// the symbols, and the end of the block
+	for (size_t i = 0; i < m_symbols.size(); i++)
+	{
+		const DEFLATE_SYMBOL& symbol = m_symbols[i];
+		if (symbol.distance == 0)
+		{
+			WriteBits(literalCodes[symbol.literalLength], literalLengths[symbol.literalLength], output);
+			continue;
+		}
+
+		int lengthCode = tables.lengthCodes[symbol.literalLength];
+		WriteBits(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode], output);
+		WriteBits(symbol.literalLength - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode], output);
+		int distanceCode = GetDistanceCode(tables, symbol.distance);
+		WriteBits(distanceCodes[distanceCode], distanceLengths[distanceCode], output);
+		WriteBits(symbol.distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode], output);
+	}
+	WriteBits(literalCodes[END_OF_BLOCK], literalLengths[END_OF_BLOCK], output);
+
+	m_symbols.clear();
+}
+
+/***********************************************************
+ *  WriteBits()
+ *
+ *  This method is used for adding the lowest bits of a
+ *  value to the output, lowest bit first, writing out every
+ *  whole byte.
+ ***********************************************************/
+void DeflateEncoder::WriteBits(unsigned int value, int count, std::vector<unsigned char>& output)
+{
+	m_bitBuffer |= value << m_bitCount;
+	m_bitCount += count;
+	while (m_bitCount >= 8)
+	{
+		output.push_back((unsigned char)m_bitBuffer);
+		m_bitBuffer >>= 8;
+		m_bitCount -= 8;
+	}
+}
+
+/***********************************************************
+ *  FlushBits()
+ *
+ *  This method is used for writing out the bits of the last
+ *  byte, padded with zeros.
+ ***********************************************************/
+void DeflateEncoder::FlushBits(std::vector<unsigned char>& output)
+{
+	if (m_bitCount > 0)
+	{
+		output.push_back((unsigned char)m_bitBuffer);
+	}
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+}
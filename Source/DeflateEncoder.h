@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// deflateencoder.h
+// ============
+// compress data into zlib streams for the PNG files
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  DeflateEncoder
+ *
+ *  This class compresses data into a zlib stream of deflate
+ *  blocks.  Repeated runs are found through hash chains
+ *  over the last 32KB of the data, and each block is coded
+ *  with Huffman codes made for the symbols in it.  The
+ *  chains are searched only so far, trading a little size
+ *  for speed, since captured frames are compressed while
+ *  they are being rendered.  An encoder is used by one
+ *  thread at a time, and keeps its tables between calls.
+ ***********************************************************/
+class DeflateEncoder
+{
+public:
+	// constructor
+	DeflateEncoder();
+	// destructor
+	~DeflateEncoder();
+
+	// compress the data into a zlib stream, appended to the output
+	void Compress(const unsigned char* pData, size_t size, std::vector<unsigned char>& output);
+
+private:
+	// a literal byte, or a match of a length and distance
+	struct DEFLATE_SYMBOL
+	{
+		unsigned short literalLength;
+		unsigned short distance;
+	};
+
+	// the first position with each hash, and the position
+	// before each one with the same hash
+	std::vector<int> m_hashHeads;
+	std::vector<int> m_hashChain;
+	// the symbols of the block being made
+	std::vector<DEFLATE_SYMBOL> m_symbols;
+
+	// bits not yet written, lowest first
+	unsigned int m_bitBuffer;
+	int m_bitCount;
+
+	// code the symbols as a block with its own Huffman codes
+	void WriteBlock(bool bFinal, std::vector<unsigned char>& output);
+	// write the lowest bits of a value
+	void WriteBits(unsigned int value, int count, std::vector<unsigned char>& output);
+	// write the bits left over, padded to a byte
+	void FlushBits(std::vector<unsigned char>& output);
+};
@@ -0,0 +1,255 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.cpp
+// ============
+// lay down the depth of the opaque draws before they are shaded
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DepthPrepass.h"
+#include "ProgramCache.h"
+#include "ShaderPermutations.h"
+
+#include <iostream>
+#include <vector>
+
+/***********************************************************
+ *  DepthPrepass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DepthPrepass::DepthPrepass()
+{
+	m_program = 0;
+	m_bEnabled = false;
+	for (int frame = 0; frame < FRAME_LATENCY; frame++)
+	{
+		m_depthQueries[frame] = 0;
+		m_shadeQueries[frame] = 0;
+		m_bDepthIssued[frame] = false;
+		m_bShadeIssued[frame] = false;
+	}
+	m_frame = 0;
+	m_shadedTotal = 0;
+	m_savedTotal = 0;
+	m_framesRead = 0;
+	m_stats.fragmentsShaded = 0.0;
+	m_stats.fragmentsSaved = 0.0;
+	m_averageCount = 0;
+}
+
+/***********************************************************
+ *  ~DepthPrepass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DepthPrepass::~DepthPrepass()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  BuildProgram()
+ *
+ *  This method is used for building the depth pass program
+ *  from the scene shaders.  It is called again when the
+ *  shaders change.
+ ***********************************************************/
+bool DepthPrepass::BuildProgram(
+	ProgramCache* pProgramCache,
+	const std::string& vertexFilename,
+	const std::string& fragmentFilename)
+{
+	if (pProgramCache == NULL)
+	{
+		return(false);
+	}
+
+	// the depth does not depend on the lights, so the
+	// variant is built for none
+	std::vector<std::string> defines;
+	ShaderPermutations::GetDefines(0, 0, false, ShaderPermutations::DEPTH_PASS, defines);
+	GLuint program = pProgramCache->LoadProgram(vertexFilename.c_str(), fragmentFilename.c_str(), defines);
+	if (program == 0)
+	{
+		std::cout << "DepthPrepass: the depth pass did not build, the old program is kept" << std::endl;
+		return(false);
+	}
+
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+	}
+	m_program = program;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the program and the
+ *  query objects.
+ ***********************************************************/
+void DepthPrepass::Destroy()
+{
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+	if (m_depthQueries[0] != 0)
+	{
+		glDeleteQueries(FRAME_LATENCY, m_depthQueries);
+		glDeleteQueries(FRAME_LATENCY, m_shadeQueries);
+		for (int frame = 0; frame < FRAME_LATENCY; frame++)
+		{
+			m_depthQueries[frame] = 0;
+			m_shadeQueries[frame] = 0;
+			m_bDepthIssued[frame] = false;
+			m_bShadeIssued[frame] = false;
+		}
+	}
+}
+
+/***********************************************************
+ *  CreateQueries()
+ *
+ *  This method is used for creating the query objects of
+ *  every frame in flight.
+ ***********************************************************/
+void DepthPrepass::CreateQueries()
+{
+	if (m_depthQueries[0] == 0)
+	{
+		glGenQueries(FRAME_LATENCY, m_depthQueries);
+		glGenQueries(FRAME_LATENCY, m_shadeQueries);
+	}
+}
+
+/***********************************************************
+ *  BeginDepthPass()
+ *
+ *  This method is used for binding the depth pass program
+ *  with color writes off.  The depth is tested and written
+ *  as usual, so the fragments counted here are the ones a
+ *  shading pass without it would have shaded.
+ ***********************************************************/
+void DepthPrepass::BeginDepthPass()
+{
+	CreateQueries();
+
+	glUseProgram(m_program);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glBeginQuery(GL_SAMPLES_PASSED, m_depthQueries[m_frame]);
+}
+
+/***********************************************************
+ *  EndDepthPass()
+ *
+ *  This method is used for turning the color writes back on
+ *  after the depth pass.
+ ***********************************************************/
+void DepthPrepass::EndDepthPass()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	m_bDepthIssued[m_frame] = true;
+}
+
+/***********************************************************
+ *  BeginShading()
+ *
+ *  This method is used for starting the shading of the
+ *  opaque draws.  After a depth pass only the fragments at
+ *  the depth it wrote pass, and the depth is not written
+ *  again.
+ ***********************************************************/
+void DepthPrepass::BeginShading()
+{
+	CreateQueries();
+
+	if (m_bDepthIssued[m_frame] == true)
+	{
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	glBeginQuery(GL_SAMPLES_PASSED, m_shadeQueries[m_frame]);
+}
+
+/***********************************************************
+ *  EndShading()
+ *
+ *  This method is used for restoring the depth test after
+ *  the opaque draws are shaded.
+ ***********************************************************/
+void DepthPrepass::EndShading()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	m_bShadeIssued[m_frame] = true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for moving on to the next frame.  Its
+ *  queries were issued FRAME_LATENCY frames ago, so their
+ *  results are read before they are issued again.  A frame
+ *  whose results are still not available is skipped rather
+ *  than waited for.
+ ***********************************************************/
+void DepthPrepass::EndFrame()
+{
+	if (m_shadeQueries[0] == 0)
+	{
+		return;
+	}
+
+	m_frame = (m_frame + 1) % FRAME_LATENCY;
+	bool bDepthIssued = m_bDepthIssued[m_frame];
+	bool bShadeIssued = m_bShadeIssued[m_frame];
+	m_bDepthIssued[m_frame] = false;
+	m_bShadeIssued[m_frame] = false;
+	if (bShadeIssued == false)
+	{
+		return;
+	}
+
+	GLint bAvailable = 0;
+	glGetQueryObjectiv(m_shadeQueries[m_frame], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+	if (bAvailable == 0)
+	{
+		return;
+	}
+
+	GLuint64 shaded = 0;
+	GLuint64 tested = 0;
+	glGetQueryObjectui64v(m_shadeQueries[m_frame], GL_QUERY_RESULT, &shaded);
+	if (bDepthIssued == true)
+	{
+		// the depth pass ended before the shading began, so
+		// its result is available as well
+		glGetQueryObjectui64v(m_depthQueries[m_frame], GL_QUERY_RESULT, &tested);
+	}
+	m_shadedTotal += shaded;
+	if (tested > shaded)
+	{
+		m_savedTotal += tested - shaded;
+	}
+
+	m_framesRead++;
+	if (m_framesRead < AVERAGE_FRAMES)
+	{
+		return;
+	}
+
+	m_stats.fragmentsShaded = (double)m_shadedTotal / m_framesRead;
+	m_stats.fragmentsSaved = (double)m_savedTotal / m_framesRead;
+	m_shadedTotal = 0;
+	m_savedTotal = 0;
+	m_framesRead = 0;
+	m_averageCount++;
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.h
+// ============
+// lay down the depth of the opaque draws before they are shaded
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+
+class ProgramCache;
+
+/***********************************************************
+ *  DepthPrepass
+ *
+ *  This class keeps the program that writes only the depth
+ *  of the opaque draws, reading only their positions.  The
+ *  opaque draws are then shaded with an equal depth test, so
+ *  each pixel is shaded once, by the surface that ends up in
+ *  front.  The fragments that pass the depth test of each
+ *  pass are counted with occlusion queries - the fragments
+ *  passing the depth pass are the ones that shading without
+ *  it would have shaded - and the counts are read a few
+ *  frames later so the queries never stall the frame.
+ ***********************************************************/
+class DepthPrepass
+{
+public:
+	// constructor
+	DepthPrepass();
+	// destructor
+	~DepthPrepass();
+
+	// frames that the queries are read behind
+	static const int FRAME_LATENCY = 4;
+	// frames each average is taken over
+	static const int AVERAGE_FRAMES = 60;
+
+	// average fragments per frame of the opaque draws - the
+	// ones shaded, and the ones the depth pass kept from being
+	// shaded
+	struct PREPASS_STATS
+	{
+		double fragmentsShaded;
+		double fragmentsSaved;
+	};
+
+	// build the depth pass program - the old program is kept
+	// when the new one fails to build
+	bool BuildProgram(
+		ProgramCache* pProgramCache,
+		const std::string& vertexFilename,
+		const std::string& fragmentFilename);
+	// free the program and the queries
+	void Destroy();
+
+	// turn the depth pass on or off from the next frame on
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+	bool IsEnabled() const { return(m_bEnabled); }
+	bool IsReady() const { return(m_program != 0); }
+
+	// write the depth of the opaque draws issued in between,
+	// with color writes off
+	void BeginDepthPass();
+	void EndDepthPass();
+	// shade the opaque draws issued in between, against the
+	// depth pass when it ran this frame
+	void BeginShading();
+	void EndShading();
+	// finish the frame, reading the queries of the oldest one
+	void EndFrame();
+
+	const PREPASS_STATS& GetStats() const { return(m_stats); }
+	// number of averages made so far
+	int GetAverageCount() const { return(m_averageCount); }
+
+private:
+	GLuint m_program;
+	bool m_bEnabled;
+	// the samples passed by the depth pass and by the shading
+	// of each frame in flight, and whether they were issued
+	GLuint m_depthQueries[FRAME_LATENCY];
+	GLuint m_shadeQueries[FRAME_LATENCY];
+	bool m_bDepthIssued[FRAME_LATENCY];
+	bool m_bShadeIssued[FRAME_LATENCY];
+	// the frame whose queries are being written
+	int m_frame;
+	// counts read since the last average
+	GLuint64 m_shadedTotal;
+	GLuint64 m_savedTotal;
+	int m_framesRead;
+	PREPASS_STATS m_stats;
+	int m_averageCount;
+
+	// create the query objects the first time they are needed
+	void CreateQueries();
+};
@@ -0,0 +1,307 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.cpp
+// ============
+// report the files that were written since they were last checked
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// time a changed file must go unwritten before it is reported
+	const int SETTLE_MILLISECONDS = 100;
+
+#ifdef _WIN32
+	/***********************************************************
+	 *  GetLastWriteTime()
+	 *
+	 *  Last write time of a file, or 0 when it cannot be read.
+	 ***********************************************************/
+	unsigned long long GetLastWriteTime(const std::string& filename)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes) == 0)
+		{
+			return(0);
+		}
+		return(((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+			attributes.ftLastWriteTime.dwLowDateTime);
+	}
+#endif
+}
+
+/***********************************************************
+ *  FileWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FileWatcher::FileWatcher()
+{
+#ifndef _WIN32
+	m_inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotifyDescriptor < 0)
+	{
+		std::cout << "FileWatcher: could not start inotify, files will not be watched" << std::endl;
+	}
+#endif
+}
+
+/***********************************************************
+ *  ~FileWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FileWatcher::~FileWatcher()
+{
+	Clear();
+#ifndef _WIN32
+	if (m_inotifyDescriptor >= 0)
+	{
+		close(m_inotifyDescriptor);
+		m_inotifyDescriptor = -1;
+	}
+#endif
+}
+
+/***********************************************************
+ *  WatchFile()
+ *
+ *  This method is used for starting to watch a file.  The
+ *  directory it is in is watched, since editors often save
+ *  by writing a new file and renaming it over the old one.
+ ***********************************************************/
+bool FileWatcher::WatchFile(const std::string& filename)
+{
+	for (size_t i = 0; i < m_files.size(); i++)
+	{
+		if (m_files[i].filename == filename)
+		{
+			return(true);
+		}
+	}
+
+	size_t slash = filename.find_last_of("/\\");
+	std::string path = (slash == std::string::npos) ? std::string(".") : filename.substr(0, slash);
+	int directory = AddDirectory(path);
+	if (directory < 0)
+	{
+		std::cout << "FileWatcher: could not watch " << filename << std::endl;
+		return(false);
+	}
+
+	WATCHED_FILE file;
+	file.filename = filename;
+	file.name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+	file.directory = directory;
+#ifdef _WIN32
+	file.lastWriteTime = GetLastWriteTime(filename);
+#endif
+	file.bChanged = false;
+	m_files.push_back(file);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for no longer watching any file.
+ ***********************************************************/
+void FileWatcher::Clear()
+{
+	for (size_t i = 0; i < m_directories.size(); i++)
+	{
+#ifdef _WIN32
+		FindCloseChangeNotification((HANDLE)m_directories[i].changeHandle);
+#else
+		inotify_rm_watch(m_inotifyDescriptor, m_directories[i].watchDescriptor);
+#endif
+	}
+	m_directories.clear();
+	m_files.clear();
+}
+
+/***********************************************************
+ *  AddDirectory()
+ *
+ *  This method is used for asking for the changes to the
+ *  files of a directory, returning its index.
+ ***********************************************************/
+int FileWatcher::AddDirectory(const std::string& path)
+{
+	for (size_t i = 0; i < m_directories.size(); i++)
+	{
+		if (m_directories[i].path == path)
+		{
+			return((int)i);
+		}
+	}
+
+	WATCHED_DIRECTORY directory;
+	directory.path = path;
+#ifdef _WIN32
+	HANDLE changeHandle = FindFirstChangeNotificationA(path.c_str(), FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE);
+	if (changeHandle == INVALID_HANDLE_VALUE)
+	{
+		return(-1);
+	}
+	directory.changeHandle = changeHandle;
+#else
+	if (m_inotifyDescriptor < 0)
+	{
+		return(-1);
+	}
+	directory.watchDescriptor = inotify_add_watch(m_inotifyDescriptor, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (directory.watchDescriptor < 0)
+	{
+		return(-1);
+	}
+#endif
+
+	m_directories.push_back(directory);
+	return((int)m_directories.size() - 1);
+}
+
+/***********************************************************
+ *  MarkChanged()
+ *
+ *  This method is used for restarting the settle time of a
+ *  watched file that was just written.
+ ***********************************************************/
+void FileWatcher::MarkChanged(int directory, const std::string& name)
+{
+	for (size_t i = 0; i < m_files.size(); i++)
+	{
+		if ((m_files[i].directory == directory) && (m_files[i].name == name))
+		{
+			m_files[i].bChanged = true;
+			m_files[i].changeTime = CLOCK::now();
+		}
+	}
+}
+
+/***********************************************************
+ *  ReadChanges()
+ *
+ *  This method is used for taking the pending notifications
+ *  without waiting for more.  Windows only reports that
+ *  something in a directory changed, so the write times of
+ *  its watched files tell which ones did.
+ ***********************************************************/
+void FileWatcher::ReadChanges()
+{
+#ifdef _WIN32
+	for (size_t directory = 0; directory < m_directories.size(); directory++)
+	{
+		HANDLE changeHandle = (HANDLE)m_directories[directory].changeHandle;
+		if (WaitForSingleObject(changeHandle, 0) != WAIT_OBJECT_0)
+		{
+			continue;
+		}
+		FindNextChangeNotification(changeHandle);
+
+		for (size_t i = 0; i < m_files.size(); i++)
+		{
+			if (m_files[i].directory != (int)directory)
+			{
+				continue;
+			}
+
+			unsigned long long lastWriteTime = GetLastWriteTime(m_files[i].filename);
+			if ((lastWriteTime != 0) && (lastWriteTime != m_files[i].lastWriteTime))
+			{
+				m_files[i].lastWriteTime = lastWriteTime;
+				MarkChanged((int)directory, m_files[i].name);
+			}
+		}
+	}
+#else
+	if (m_inotifyDescriptor < 0)
+	{
+		return;
+	}
+
+	alignas(struct inotify_event) char buffer[4096];
+	for (;;)
+	{
+		ssize_t bytes = read(m_inotifyDescriptor, buffer, sizeof(buffer));
+		if (bytes <= 0)
+		{
+			break;
+		}
+
+		for (ssize_t offset = 0; offset < bytes; )
+		{
+			const struct inotify_event* pEvent = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+			offset += sizeof(struct inotify_event) + pEvent->len;
+
+			// events were dropped, so any of the files may have changed
+			if ((pEvent->mask & IN_Q_OVERFLOW) != 0)
+			{
+				for (size_t i = 0; i < m_files.size(); i++)
+				{
+					MarkChanged(m_files[i].directory, m_files[i].name);
+				}
+				continue;
+			}
+			if (pEvent->len == 0)
+			{
+				continue;
+			}
+
+			for (size_t directory = 0; directory < m_directories.size(); directory++)
+			{
+				if (m_directories[directory].watchDescriptor == pEvent->wd)
+				{
+					MarkChanged((int)directory, pEvent->name);
+				}
+			}
+		}
+	}
+#endif
+}
+
+/***********************************************************
+ *  Poll()
+ *
+ *  This method is used for getting the watched files that
+ *  were written and then left alone for the settle time.
+ *  Each change is reported once.
+ ***********************************************************/
+int FileWatcher::Poll(std::vector<std::string>& changedFiles)
+{
+	ReadChanges();
+
+	CLOCK::time_point now = CLOCK::now();
+	int changedCount = 0;
+	for (size_t i = 0; i < m_files.size(); i++)
+	{
+		if ((m_files[i].bChanged == true) &&
+			(now - m_files[i].changeTime >= std::chrono::milliseconds(SETTLE_MILLISECONDS)))
+		{
+			m_files[i].bChanged = false;
+			changedFiles.push_back(m_files[i].filename);
+			changedCount++;
+		}
+	}
+
+	return(changedCount);
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.h
+// ============
+// report the files that were written since they were last checked
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FileWatcher
+ *
+ *  This class asks the operating system to report changes
+ *  to the directories of the watched files - inotify on
+ *  Linux and change notifications on Windows - so checking
+ *  for edits costs nothing while no file is written.  A
+ *  changed file is only reported once it has not been
+ *  written for a short time, since editors often save a
+ *  file in several writes.  Poll() never blocks, and is
+ *  meant to be called once per frame.
+ ***********************************************************/
+class FileWatcher
+{
+public:
+	// constructor
+	FileWatcher();
+	// destructor
+	~FileWatcher();
+
+	// start watching a file - watching a file again does nothing
+	bool WatchFile(const std::string& filename);
+	// stop watching every file
+	void Clear();
+
+	// add the files that changed and then settled since the
+	// last call to the list, returning how many were added
+	int Poll(std::vector<std::string>& changedFiles);
+
+	int GetFileCount() const { return((int)m_files.size()); }
+
+private:
+	typedef std::chrono::steady_clock CLOCK;
+
+	// a directory that change notifications are asked for
+	struct WATCHED_DIRECTORY
+	{
+		std::string path;
+#ifdef _WIN32
+		// change notification handle
+		void* changeHandle;
+#else
+		// inotify watch descriptor
+		int watchDescriptor;
+#endif
+	};
+
+	// a watched file, and its change waiting to settle
+	struct WATCHED_FILE
+	{
+		// the name the file was watched by, which is reported
+		std::string filename;
+		// the name within its directory
+		std::string name;
+		int directory;
+#ifdef _WIN32
+		// last write time, to tell which file of a directory changed
+		unsigned long long lastWriteTime;
+#endif
+		bool bChanged;
+		CLOCK::time_point changeTime;
+	};
+
+	std::vector<WATCHED_DIRECTORY> m_directories;
+	std::vector<WATCHED_FILE> m_files;
+#ifndef _WIN32
+	// inotify instance every directory is watched through
+	int m_inotifyDescriptor;
+#endif
+
+	// find the watched directory for a path, or start watching it
+	int AddDirectory(const std::string& path);
+	// mark the files of a directory that were written
+	void ReadChanges();
+	// mark a watched file as changed now
+	void MarkChanged(int directory, const std::string& name);
+
+	// a watcher owns its notification handles
+	FileWatcher(const FileWatcher&);
+	FileWatcher& operator=(const FileWatcher&);
+};
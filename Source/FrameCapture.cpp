@@ -0,0 +1,716 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.cpp
+// ============
+// read rendered frames back without stalling and write them out
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCapture.h"
+#include "ImageEncoder.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// the longest a single wait for a fence lasts, in nanoseconds,
+	// before it is made again
+	const GLuint64 FENCE_WAIT_NANOSECONDS = 100000000;
+	// flags the ring buffers are created and mapped with - they
+	// stay mapped, and the reads are seen once the fence signals
+	const GLbitfield CAPTURE_MAP_FLAGS = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	// frames between the convert and write stages beyond one
+	// for each worker thread
+	const int EXTRA_FRAMES = 2;
+
+}
+
+FILE* FrameCapture::s_pStandardOutput = NULL;
+
+/***********************************************************
+ *  FrameCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCapture::FrameCapture()
+{
+	m_bCapturing = false;
+	m_width = 0;
+	m_height = 0;
+	m_format = CAPTURE_PPM;
+	m_pStream = NULL;
+	m_pWorkerPool = NULL;
+	m_nextSlot = 0;
+	m_oldestReading = 0;
+	m_readingCount = 0;
+	m_frameNumber = 0;
+	m_nextWrite = 0;
+	m_bStopping = false;
+	m_bConvertDone = false;
+	m_framesConverted = 0;
+	m_framesWritten = 0;
+	m_framesTimed = 0;
+	m_convertTotal = 0.0;
+	m_compressTotal = 0.0;
+	m_writeTotal = 0.0;
+	m_captureTotal = 0.0;
+	m_stallTotal = 0.0;
+	m_queueTotal = 0;
+	m_queueMost = 0;
+	m_framesCaptured = 0;
+	m_writtenAtAverage = 0;
+	m_stats.captureMilliseconds = 0.0;
+	m_stats.stallMilliseconds = 0.0;
+	m_stats.convertMilliseconds = 0.0;
+	m_stats.compressMilliseconds = 0.0;
+	m_stats.writeMilliseconds = 0.0;
+	m_stats.queueDepth = 0.0;
+	m_stats.maxQueueDepth = 0;
+	m_stats.framesPerSecond = 0.0;
+	m_averageCount = 0;
+}
+
+/***********************************************************
+ *  ~FrameCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCapture::~FrameCapture()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for creating the ring of pixel
+ *  buffers and the frames of the later stages, opening the
+ *  stream when the frames are written to one, and starting
+ *  the convert and write threads.
+ ***********************************************************/
+bool FrameCapture::Start(
+	int width,
+	int height,
+	CAPTURE_FORMAT format,
+	const std::string& outputPrefix,
+	WorkerPool* pWorkerPool,
+	int framesPerSecond,
+	int ringSize)
+{
+	Stop();
+	if ((width <= 0) || (height <= 0) || (ringSize < 2))
+	{
+		return(false);
+	}
+
+	bool bStream = ((format == CAPTURE_Y4M) || (format == CAPTURE_RAW));
+	if ((outputPrefix == "-") && (bStream == false))
+	{
+		std::cout << "FrameCapture: only y4m and raw frames can be written to the standard output" << std::endl;
+		return(false);
+	}
+
+	m_width = width;
+	m_height = height;
+	m_format = format;
+	m_outputPrefix = outputPrefix;
+	m_pWorkerPool = pWorkerPool;
+
+	GLsizeiptr frameSize = (GLsizeiptr)width * height * 3;
+	m_slots.resize(ringSize);
+	for (int i = 0; i < ringSize; i++)
+	{
+		CAPTURE_SLOT& slot = m_slots[i];
+		glCreateBuffers(1, &slot.buffer);
+		glNamedBufferStorage(slot.buffer, frameSize, NULL, CAPTURE_MAP_FLAGS);
+		slot.pMapped = (const unsigned char*)glMapNamedBufferRange(slot.buffer, 0, frameSize, CAPTURE_MAP_FLAGS);
+		slot.fence = 0;
+		slot.frameNumber = 0;
+		slot.state = SLOT_FREE;
+		if (slot.pMapped == NULL)
+		{
+			std::cout << "FrameCapture: the pixel buffers could not be mapped" << std::endl;
+			DestroySlots();
+			return(false);
+		}
+	}
+
+	if (bStream == true)
+	{
+		std::string filename = m_outputPrefix + ((format == CAPTURE_Y4M) ? ".y4m" : ".rgb");
+		m_pStream = (outputPrefix == "-") ? s_pStandardOutput : fopen(filename.c_str(), "wb");
+		if (m_pStream == NULL)
+		{
+			std::cout << "FrameCapture: could not write " << ((outputPrefix == "-") ? "the standard output" : filename)
+				<< std::endl;
+			DestroySlots();
+			return(false);
+		}
+		if (format == CAPTURE_Y4M)
+		{
+			std::string header = ImageEncoder::GetY4MHeader(width, height, framesPerSecond);
+			fwrite(header.data(), 1, header.size(), m_pStream);
+		}
+	}
+
+	// enough frames to keep every worker thread compressing
+	int frameCount = EXTRA_FRAMES + ((m_pWorkerPool != NULL) ? m_pWorkerPool->GetThreadCount() : 0);
+	m_frames.resize(frameCount);
+	m_freeFrames.clear();
+	for (int i = 0; i < frameCount; i++)
+	{
+		m_freeFrames.push_back(i);
+	}
+	m_encodedFrames.clear();
+
+	m_nextSlot = 0;
+	m_oldestReading = 0;
+	m_readingCount = 0;
+	m_frameNumber = 0;
+	m_nextWrite = 0;
+	m_bStopping = false;
+	m_bConvertDone = false;
+	m_framesConverted = 0;
+	m_framesWritten = 0;
+	m_framesTimed = 0;
+	m_convertTotal = 0.0;
+	m_compressTotal = 0.0;
+	m_writeTotal = 0.0;
+	m_writtenAtAverage = 0;
+	m_averageStart = CLOCK::now();
+	m_converter = std::thread(&FrameCapture::ConverterMain, this);
+	m_writer = std::thread(&FrameCapture::WriterMain, this);
+	m_bCapturing = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for waiting for the frames still
+ *  being read, letting each stage finish every frame it was
+ *  handed, and freeing the ring and the frames.
+ ***********************************************************/
+void FrameCapture::Stop()
+{
+	if (m_bCapturing == false)
+	{
+		return;
+	}
+
+	while (m_readingCount > 0)
+	{
+		HandOverFinished(true);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_slotReady.notify_all();
+	m_converter.join();
+
+	// the writer waits for the frames still being compressed,
+	// since it writes them in order
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bConvertDone = true;
+	}
+	m_frameEncoded.notify_all();
+	m_writer.join();
+
+	DestroySlots();
+	m_frames.clear();
+	m_freeFrames.clear();
+	if (m_pStream == s_pStandardOutput)
+	{
+		// taken over for the whole run, and closed as it ends
+		fflush(m_pStream);
+	}
+	else if (m_pStream != NULL)
+	{
+		fclose(m_pStream);
+	}
+	m_pStream = NULL;
+	m_bCapturing = false;
+}
+
+/***********************************************************
+ *  DestroySlots()
+ *
+ *  This method is used for unmapping and freeing the pixel
+ *  buffers of the ring, and the fences still waited on.
+ ***********************************************************/
+void FrameCapture::DestroySlots()
+{
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		CAPTURE_SLOT& slot = m_slots[i];
+		if (slot.fence != 0)
+		{
+			glDeleteSync(slot.fence);
+		}
+		if (slot.buffer != 0)
+		{
+			if (slot.pMapped != NULL)
+			{
+				glUnmapNamedBuffer(slot.buffer);
+			}
+			glDeleteBuffers(1, &slot.buffer);
+		}
+	}
+	m_slots.clear();
+}
+
+/***********************************************************
+ *  Capture()
+ *
+ *  This method is used for queueing the read of a frame into
+ *  the next buffer of the ring, after handing the buffers
+ *  whose reads have finished to the convert thread.  The
+ *  read goes into the buffer on the GPU, so it returns at
+ *  once unless the next buffer is still being read or
+ *  converted - then the frame stalls until it is free.
+ ***********************************************************/
+void FrameCapture::Capture(GLuint framebuffer)
+{
+	ProfileScope scope("CaptureFrame");
+
+	if (m_bCapturing == false)
+	{
+		return;
+	}
+
+	CLOCK::time_point start = CLOCK::now();
+	double stallMilliseconds = 0.0;
+
+	HandOverFinished(false);
+
+	CAPTURE_SLOT& slot = m_slots[m_nextSlot];
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (slot.state != SLOT_FREE)
+	{
+		CLOCK::time_point stallStart = CLOCK::now();
+		if (slot.state == SLOT_READING)
+		{
+			// every buffer is being read, and this is the oldest
+			lock.unlock();
+			HandOverFinished(true);
+			lock.lock();
+		}
+		m_slotFree.wait(lock, [&slot]() { return(slot.state == SLOT_FREE); });
+		std::chrono::duration<double, std::milli> stalled = CLOCK::now() - stallStart;
+		stallMilliseconds = stalled.count();
+	}
+	lock.unlock();
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frameNumber = m_frameNumber++;
+
+	lock.lock();
+	slot.state = SLOT_READING;
+	int queueDepth = (int)(m_frames.size() - m_freeFrames.size());
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		if (m_slots[i].state != SLOT_FREE)
+		{
+			queueDepth++;
+		}
+	}
+	lock.unlock();
+	m_nextSlot = (m_nextSlot + 1) % (int)m_slots.size();
+	m_readingCount++;
+
+	std::chrono::duration<double, std::milli> elapsed = CLOCK::now() - start;
+	m_captureTotal += elapsed.count();
+	m_stallTotal += stallMilliseconds;
+	m_queueTotal += queueDepth;
+	if (queueDepth > m_queueMost)
+	{
+		m_queueMost = queueDepth;
+	}
+
+	m_framesCaptured++;
+	if (m_framesCaptured >= AVERAGE_FRAMES)
+	{
+		UpdateStats();
+	}
+}
+
+/***********************************************************
+ *  UpdateStats()
+ *
+ *  This method is used for averaging the times of the
+ *  frames captured, and of the frames written, since the
+ *  last average, and the rate they were written at.
+ ***********************************************************/
+void FrameCapture::UpdateStats()
+{
+	m_stats.captureMilliseconds = m_captureTotal / m_framesCaptured;
+	m_stats.stallMilliseconds = m_stallTotal / m_framesCaptured;
+	m_stats.queueDepth = (double)m_queueTotal / m_framesCaptured;
+	m_stats.maxQueueDepth = m_queueMost;
+	m_captureTotal = 0.0;
+	m_stallTotal = 0.0;
+	m_queueTotal = 0;
+	m_queueMost = 0;
+	m_framesCaptured = 0;
+
+	int framesWritten = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_framesTimed > 0)
+		{
+			m_stats.convertMilliseconds = m_convertTotal / m_framesTimed;
+			m_stats.compressMilliseconds = m_compressTotal / m_framesTimed;
+			m_stats.writeMilliseconds = m_writeTotal / m_framesTimed;
+		}
+		m_framesTimed = 0;
+		m_convertTotal = 0.0;
+		m_compressTotal = 0.0;
+		m_writeTotal = 0.0;
+		framesWritten = m_framesWritten;
+	}
+
+	CLOCK::time_point now = CLOCK::now();
+	std::chrono::duration<double> seconds = now - m_averageStart;
+	if (seconds.count() > 0.0)
+	{
+		m_stats.framesPerSecond = (framesWritten - m_writtenAtAverage) / seconds.count();
+	}
+	m_writtenAtAverage = framesWritten;
+	m_averageStart = now;
+	m_averageCount++;
+}
+
+/***********************************************************
+ *  HandOverFinished()
+ *
+ *  This method is used for handing the buffers whose fences
+ *  have signalled to the convert thread, oldest first.  The
+ *  fences are only polled, apart from the oldest one when
+ *  asked to wait for it.  Polling also flushes the commands,
+ *  so a fence is seen by the GPU even when no buffer swap
+ *  follows.
+ ***********************************************************/
+void FrameCapture::HandOverFinished(bool bWaitOldest)
+{
+	while (m_readingCount > 0)
+	{
+		CAPTURE_SLOT& slot = m_slots[m_oldestReading];
+		GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+			(bWaitOldest == true) ? FENCE_WAIT_NANOSECONDS : 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			if (bWaitOldest == true)
+			{
+				continue;
+			}
+			break;
+		}
+		if (result == GL_WAIT_FAILED)
+		{
+			std::cout << "FrameCapture: waiting for the read of frame " << slot.frameNumber << " failed" << std::endl;
+		}
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			slot.state = SLOT_CONVERTING;
+			m_convertQueue.push_back(m_oldestReading);
+		}
+		m_slotReady.notify_one();
+
+		m_oldestReading = (m_oldestReading + 1) % (int)m_slots.size();
+		m_readingCount--;
+		bWaitOldest = false;
+	}
+}
+
+/***********************************************************
+ *  GetFramesWritten()
+ *
+ *  This method is used for getting the number of frames the
+ *  write thread has written out.
+ ***********************************************************/
+int FrameCapture::GetFramesWritten()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return(m_framesWritten);
+}
+
+/***********************************************************
+ *  ConverterMain()
+ *
+ *  This method is used for converting the frames in the
+ *  buffers handed over, in the order they were read, until
+ *  capture stops and every buffer has been converted.  Each
+ *  frame waits for a free frame of the later stages, and
+ *  frees its buffer as soon as its rows are copied out.
+ *  The frames are then encoded on the worker pool, apart
+ *  from the raw ones, which go straight to the write thread.
+ ***********************************************************/
+void FrameCapture::ConverterMain()
+{
+	Profiler::SetThreadName("capture convert");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_slotReady.wait(lock, [this]() { return((m_bStopping == true) || (m_convertQueue.empty() == false)); });
+
+		if (m_convertQueue.empty() == true)
+		{
+			// stopping, and every buffer is converted
+			break;
+		}
+
+		int slotIndex = m_convertQueue.front();
+		m_convertQueue.pop_front();
+		m_frameFree.wait(lock, [this]() { return(m_freeFrames.empty() == false); });
+		int frameIndex = m_freeFrames.front();
+		m_freeFrames.pop_front();
+
+		lock.unlock();
+		CLOCK::time_point start = CLOCK::now();
+		CAPTURE_SLOT& slot = m_slots[slotIndex];
+		CAPTURE_FRAME& frame = m_frames[frameIndex];
+		frame.frameNumber = slot.frameNumber;
+		frame.pixels.resize((size_t)m_width * m_height * 3);
+		{
+			ProfileScope scope("ConvertFrame");
+			ImageEncoder::FlipRows(slot.pMapped, m_width, m_height, frame.pixels.data());
+		}
+		std::chrono::duration<double, std::milli> elapsed = CLOCK::now() - start;
+		frame.convertMilliseconds = elapsed.count();
+		frame.compressMilliseconds = 0.0;
+		lock.lock();
+
+		slot.state = SLOT_FREE;
+		m_slotFree.notify_all();
+		m_framesConverted++;
+
+		if (m_format == CAPTURE_RAW)
+		{
+			m_encodedFrames[frame.frameNumber] = frameIndex;
+			m_frameEncoded.notify_one();
+		}
+		else if (m_pWorkerPool != NULL)
+		{
+			lock.unlock();
+			m_pWorkerPool->Submit([this, frameIndex]() { CompressFrame(frameIndex); });
+			lock.lock();
+		}
+		else
+		{
+			lock.unlock();
+			CompressFrame(frameIndex);
+			lock.lock();
+		}
+	}
+}
+
+/***********************************************************
+ *  CompressFrame()
+ *
+ *  This method is used for encoding a converted frame - as
+ *  its image file, or as YUV for the Y4M stream - and
+ *  handing it to the write thread.
+ ***********************************************************/
+void FrameCapture::CompressFrame(int frameIndex)
+{
+	ProfileScope scope("CompressFrame");
+	CAPTURE_FRAME& frame = m_frames[frameIndex];
+
+	CLOCK::time_point start = CLOCK::now();
+	if (m_format == CAPTURE_PNG)
+	{
+		ImageEncoder::EncodePNG(frame.pixels.data(), m_width, m_height, frame.encoded);
+	}
+	else if (m_format == CAPTURE_Y4M)
+	{
+		ImageEncoder::EncodeY4MFrame(frame.pixels.data(), m_width, m_height, frame.encoded);
+	}
+	else
+	{
+		ImageEncoder::EncodePPM(frame.pixels.data(), m_width, m_height, frame.encoded);
+	}
+	std::chrono::duration<double, std::milli> elapsed = CLOCK::now() - start;
+	frame.compressMilliseconds = elapsed.count();
+
+	// the write thread is woken with the lock held, since once
+	// it has written the last frame the capture can be stopped
+	// and gone before this job returns
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_encodedFrames[frame.frameNumber] = frameIndex;
+	m_frameEncoded.notify_one();
+}
+
+/***********************************************************
+ *  WriterMain()
+ *
+ *  This method is used for writing out the encoded frames
+ *  in the order they were read, waiting for the next one
+ *  when later ones finish compressing first, until the
+ *  convert thread has stopped and every frame it converted
+ *  is written.  Each frame is freed once it is written.
+ ***********************************************************/
+void FrameCapture::WriterMain()
+{
+	Profiler::SetThreadName("capture write");
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_frameEncoded.wait(lock, [this]() {
+			return((m_encodedFrames.count(m_nextWrite) > 0) ||
+				((m_bConvertDone == true) && (m_nextWrite == m_framesConverted))); });
+
+		std::map<int, int>::iterator next = m_encodedFrames.find(m_nextWrite);
+		if (next == m_encodedFrames.end())
+		{
+			// stopping, and every frame is written
+			break;
+		}
+		int frameIndex = next->second;
+		m_encodedFrames.erase(next);
+
+		lock.unlock();
+		CLOCK::time_point start = CLOCK::now();
+		const CAPTURE_FRAME& frame = m_frames[frameIndex];
+		bool bWritten = WriteFrame(frame);
+		std::chrono::duration<double, std::milli> elapsed = CLOCK::now() - start;
+		lock.lock();
+
+		m_nextWrite++;
+		if (bWritten == true)
+		{
+			m_framesWritten++;
+		}
+		m_framesTimed++;
+		m_convertTotal += frame.convertMilliseconds;
+		m_compressTotal += frame.compressMilliseconds;
+		m_writeTotal += elapsed.count();
+		m_freeFrames.push_back(frameIndex);
+		m_frameFree.notify_one();
+	}
+}
+
+/***********************************************************
+ *  WriteFrame()
+ *
+ *  This method is used for writing out an encoded frame,
+ *  either as its own file or as the next frame of the
+ *  stream.
+ ***********************************************************/
+bool FrameCapture::WriteFrame(const CAPTURE_FRAME& frame)
+{
+	ProfileScope scope("WriteFrame");
+
+	if (m_format == CAPTURE_RAW)
+	{
+		return(fwrite(frame.pixels.data(), 1, frame.pixels.size(), m_pStream) == frame.pixels.size());
+	}
+	if (m_format == CAPTURE_Y4M)
+	{
+		return(fwrite(frame.encoded.data(), 1, frame.encoded.size(), m_pStream) == frame.encoded.size());
+	}
+
+	char filename[512];
+	snprintf(filename, sizeof(filename), "%s_%04d.%s", m_outputPrefix.c_str(), frame.frameNumber,
+		(m_format == CAPTURE_PNG) ? "png" : "ppm");
+	FILE* pFile = fopen(filename, "wb");
+	if (pFile == NULL)
+	{
+		std::cout << "FrameCapture: could not write " << filename << std::endl;
+		return(false);
+	}
+	bool bWritten = (fwrite(frame.encoded.data(), 1, frame.encoded.size(), pFile) == frame.encoded.size());
+	fclose(pFile);
+
+	return(bWritten);
+}
+
+/***********************************************************
+ *  TakeStandardOutput()
+ *
+ *  This method is used for taking the standard output over
+ *  for a stream of frames written to "-".  The stream gets
+ *  its own handle to it, and the standard output is pointed
+ *  at the standard error, so the log cannot mix into the
+ *  frames.  It must be called before anything is logged.
+ ***********************************************************/
+bool FrameCapture::TakeStandardOutput()
+{
+	if (s_pStandardOutput != NULL)
+	{
+		return(true);
+	}
+
+	std::cout.flush();
+	fflush(stdout);
+#ifdef _WIN32
+	int streamHandle = _dup(_fileno(stdout));
+	_dup2(_fileno(stderr), _fileno(stdout));
+	_setmode(streamHandle, _O_BINARY);
+	s_pStandardOutput = (streamHandle >= 0) ? _fdopen(streamHandle, "wb") : NULL;
+#else
+	int streamHandle = dup(STDOUT_FILENO);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+	s_pStandardOutput = (streamHandle >= 0) ? fdopen(streamHandle, "wb") : NULL;
+#endif
+
+	return(s_pStandardOutput != NULL);
+}
+
+/***********************************************************
+ *  ParseFormat()
+ *
+ *  This method is used for getting the capture format from
+ *  its name on the command line.
+ ***********************************************************/
+bool FrameCapture::ParseFormat(const char* name, CAPTURE_FORMAT& format)
+{
+	if (strcmp(name, "ppm") == 0)
+	{
+		format = CAPTURE_PPM;
+	}
+	else if (strcmp(name, "png") == 0)
+	{
+		format = CAPTURE_PNG;
+	}
+	else if (strcmp(name, "y4m") == 0)
+	{
+		format = CAPTURE_Y4M;
+	}
+	else if (strcmp(name, "raw") == 0)
+	{
+		format = CAPTURE_RAW;
+	}
+	else
+	{
+		return(false);
+	}
+
+	return(true);
+}
@@ -0,0 +1,249 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.h
+// ============
+// read rendered frames back without stalling and write them out
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class WorkerPool;
+
+/***********************************************************
+ *  FrameCapture
+ *
+ *  This class captures the frames drawn into a framebuffer,
+ *  passing each through the stages of a pipeline:
+ *
+ *  - readback: the frame is read into the next of a ring of
+ *    pixel buffers with a fence behind the read, so the read
+ *    is only queued on the GPU and the frame goes on.
+ *  - convert: once the fence signals, a thread copies the
+ *    rows out of the mapped buffer, top row first, freeing
+ *    the buffer for a new read.
+ *  - compress: the frames are encoded on the worker pool,
+ *    several at once - as PNG or PPM files, or into the YUV
+ *    of a Y4M stream.
+ *  - write: a thread writes the frames out in the order they
+ *    were read, to their own files or to one stream.
+ *
+ *  A fixed number of frames can be between the convert and
+ *  write stages.  When the writing falls behind, the convert
+ *  thread waits for a frame to be written, the ring fills,
+ *  and only then does the rendering thread wait - stall -
+ *  for a free buffer.
+ ***********************************************************/
+class FrameCapture
+{
+public:
+	// constructor
+	FrameCapture();
+	// destructor
+	~FrameCapture();
+
+	// what the frames are written as
+	enum CAPTURE_FORMAT
+	{
+		// a binary PPM file for each frame
+		CAPTURE_PPM = 0,
+		// a PNG file for each frame
+		CAPTURE_PNG,
+		// one Y4M video stream of every frame
+		CAPTURE_Y4M,
+		// one stream of the raw RGB frames
+		CAPTURE_RAW
+	};
+
+	// pixel buffers in the ring when none is given
+	static const int DEFAULT_RING_SIZE = 6;
+	// frames each average is taken over
+	static const int AVERAGE_FRAMES = 60;
+
+	// averages over the last frames captured
+	struct CAPTURE_STATS
+	{
+		// time Capture() took on the rendering thread
+		double captureMilliseconds;
+		// part of it spent waiting for a free buffer
+		double stallMilliseconds;
+		// time each frame took in each of the later stages
+		double convertMilliseconds;
+		double compressMilliseconds;
+		double writeMilliseconds;
+		// frames in the pipeline after each capture, and the
+		// most there were
+		double queueDepth;
+		int maxQueueDepth;
+		// frames written each second
+		double framesPerSecond;
+	};
+
+	// start capturing frames of the given size, compressing
+	// them on the worker pool - the PPM and PNG files are named
+	// <output>_<frame>, and the streams are written to
+	// <output>.y4m or <output>.rgb, or to the standard output
+	// taken over by TakeStandardOutput() when the output is "-"
+	bool Start(
+		int width,
+		int height,
+		CAPTURE_FORMAT format,
+		const std::string& outputPrefix,
+		WorkerPool* pWorkerPool,
+		int framesPerSecond = 60,
+		int ringSize = DEFAULT_RING_SIZE);
+	// write out every frame still in the pipeline and stop
+	void Stop();
+	bool IsCapturing() const { return(m_bCapturing); }
+
+	// queue the read of the color of a framebuffer - zero for
+	// the back buffer of the window
+	void Capture(GLuint framebuffer);
+
+	const CAPTURE_STATS& GetStats() const { return(m_stats); }
+	// number of averages made so far
+	int GetAverageCount() const { return(m_averageCount); }
+	// frames written since capture started
+	int GetFramesWritten();
+
+	// the format of a name given on the command line
+	static bool ParseFormat(const char* name, CAPTURE_FORMAT& format);
+	// keep the standard output for the frames written to "-" and
+	// send the log to the standard error - called before the
+	// first line is logged
+	static bool TakeStandardOutput();
+
+private:
+	typedef std::chrono::steady_clock CLOCK;
+
+	// where the frame in a buffer of the ring is
+	enum SLOT_STATE
+	{
+		// free to read the next frame into
+		SLOT_FREE = 0,
+		// the read is queued on the GPU behind the fence
+		SLOT_READING,
+		// handed to the convert thread
+		SLOT_CONVERTING
+	};
+
+	// a pixel buffer of the ring
+	struct CAPTURE_SLOT
+	{
+		GLuint buffer;
+		// the buffer as mapped for the whole capture
+		const unsigned char* pMapped;
+		GLsync fence;
+		int frameNumber;
+		// set by the rendering thread, and set back to free by
+		// the convert thread, guarded by the mutex
+		SLOT_STATE state;
+	};
+
+	// a frame between the convert and write stages
+	struct CAPTURE_FRAME
+	{
+		int frameNumber;
+		// the frame top row first
+		std::vector<unsigned char> pixels;
+		// the bytes written out for it
+		std::vector<unsigned char> encoded;
+		double convertMilliseconds;
+		double compressMilliseconds;
+	};
+
+	bool m_bCapturing;
+	int m_width;
+	int m_height;
+	CAPTURE_FORMAT m_format;
+	std::string m_outputPrefix;
+	// the stream, when the frames are written to one
+	FILE* m_pStream;
+	// the standard output, once it is taken over for a stream
+	static FILE* s_pStandardOutput;
+	// compresses the frames, or NULL to compress them on the
+	// convert thread
+	WorkerPool* m_pWorkerPool;
+
+	std::vector<CAPTURE_SLOT> m_slots;
+	// the slot the next frame is read into, and the oldest
+	// slot being read
+	int m_nextSlot;
+	int m_oldestReading;
+	// slots being read on the GPU
+	int m_readingCount;
+	int m_frameNumber;
+
+	// the frames of the later stages, those not in use, and
+	// those encoded and waiting to be written by frame number
+	std::vector<CAPTURE_FRAME> m_frames;
+	std::deque<int> m_freeFrames;
+	std::map<int, int> m_encodedFrames;
+	int m_nextWrite;
+
+	// the convert and write threads, and the slots handed to
+	// the convert thread in the order they were read
+	std::thread m_converter;
+	std::thread m_writer;
+	std::deque<int> m_convertQueue;
+	// guards the queue, the slot states, the frames and the
+	// stage counters
+	std::mutex m_mutex;
+	// signalled when a slot is handed over or capture stops
+	std::condition_variable m_slotReady;
+	// signalled when the convert thread frees a slot
+	std::condition_variable m_slotFree;
+	// signalled when a frame is encoded or converting stops
+	std::condition_variable m_frameEncoded;
+	// signalled when the writer frees a frame
+	std::condition_variable m_frameFree;
+	bool m_bStopping;
+	bool m_bConvertDone;
+	// frames converted and written, and the stage times of
+	// the ones written since the last average
+	int m_framesConverted;
+	int m_framesWritten;
+	int m_framesTimed;
+	double m_convertTotal;
+	double m_compressTotal;
+	double m_writeTotal;
+
+	// totals since the last average
+	double m_captureTotal;
+	double m_stallTotal;
+	int m_queueTotal;
+	int m_queueMost;
+	int m_framesCaptured;
+	int m_writtenAtAverage;
+	CLOCK::time_point m_averageStart;
+	CAPTURE_STATS m_stats;
+	int m_averageCount;
+
+	// hand the slots whose reads have finished to the convert
+	// thread, waiting for the oldest one when asked to
+	void HandOverFinished(bool bWaitOldest);
+	// make an average of the totals of the last frames
+	void UpdateStats();
+	// free the buffers and the fences
+	void DestroySlots();
+
+	// loop run by the convert thread
+	void ConverterMain();
+	// encode a converted frame - runs on the worker pool
+	void CompressFrame(int frameIndex);
+	// loop run by the write thread
+	void WriterMain();
+	// write out an encoded frame - runs on the write thread
+	bool WriteFrame(const CAPTURE_FRAME& frame);
+};
@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.cpp
+// ============
+// test world space bounding boxes against the view frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+
+#include <immintrin.h>
+
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	// boxes tested together by the widest vectors in use - the
+	// box arrays are padded to a multiple of this
+	const int BATCH_SIZE = 8;
+	// frustum planes
+	const int PLANE_COUNT = 6;
+}
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+	m_boxCount = 0;
+	m_stats = CULL_STATS();
+
+	// until a frustum is set, every box is visible
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		m_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+/***********************************************************
+ *  ~FrustumCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrustumCuller::~FrustumCuller()
+{
+}
+
+/***********************************************************
+ *  AddBox()
+ *
+ *  This method is used for adding a world space bounding box.
+ *  The box is visible until the next Cull() says otherwise.
+ ***********************************************************/
+int FrustumCuller::AddBox(const glm::vec3& center, const glm::vec3& extent)
+{
+	int index = m_boxCount;
+	m_boxCount++;
+
+	size_t paddedCount = (size_t)(m_boxCount + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+	if (paddedCount > m_centerX.size())
+	{
+		m_centerX.resize(paddedCount, 0.0f);
+		m_centerY.resize(paddedCount, 0.0f);
+		m_centerZ.resize(paddedCount, 0.0f);
+		m_extentX.resize(paddedCount, 0.0f);
+		m_extentY.resize(paddedCount, 0.0f);
+		m_extentZ.resize(paddedCount, 0.0f);
+	}
+	m_visible.push_back(1);
+
+	SetBox(index, center, extent);
+
+	return(index);
+}
+
+/***********************************************************
+ *  SetBox()
+ *
+ *  This method is used for moving an added bounding box.
+ ***********************************************************/
+void FrustumCuller::SetBox(int index, const glm::vec3& center, const glm::vec3& extent)
+{
+	if ((index < 0) || (index >= m_boxCount))
+	{
+		return;
+	}
+
+	m_centerX[index] = center.x;
+	m_centerY[index] = center.y;
+	m_centerZ[index] = center.z;
+	m_extentX[index] = extent.x;
+	m_extentY[index] = extent.y;
+	m_extentZ[index] = extent.z;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all of the boxes.
+ ***********************************************************/
+void FrustumCuller::Clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+	m_visible.clear();
+	m_boxCount = 0;
+	m_stats = CULL_STATS();
+}
+
+/***********************************************************
+ *  SetFrustum()
+ *
+ *  This method is used for taking the six frustum planes
+ *  from the rows of a view projection matrix.  Each plane is
+ *  normalized, so the plane equation of a point is its
+ *  distance from the plane.
+ ***********************************************************/
+void FrustumCuller::SetFrustum(const glm::mat4& viewProjection)
+{
+	// glm matrices are indexed by column, then row
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+	{
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row],
+			viewProjection[2][row], viewProjection[3][row]);
+	}
+
+	m_planes[0] = rows[3] + rows[0];
+	m_planes[1] = rows[3] - rows[0];
+	m_planes[2] = rows[3] + rows[1];
+	m_planes[3] = rows[3] - rows[1];
+	m_planes[4] = rows[3] + rows[2];
+	m_planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < PLANE_COUNT; i++)
+	{
+		float length = glm::length(glm::vec3(m_planes[i]));
+		if (length > 0.0f)
+		{
+			m_planes[i] /= length;
+		}
+	}
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for testing every box against the
+ *  frustum.  A box is culled when it is entirely behind any
+ *  one of the planes.
+ ***********************************************************/
+int FrustumCuller::Cull()
+{
+#ifdef __AVX__
+	CullAVX();
+#else
+	CullSSE();
+#endif
+
+	m_stats.boxes = m_boxCount;
+	m_stats.visible = 0;
+	for (int i = 0; i < m_boxCount; i++)
+	{
+		m_stats.visible += m_visible[i];
+	}
+	m_stats.culled = m_boxCount - m_stats.visible;
+
+	return(m_stats.visible);
+}
+
+/***********************************************************
+ *  CullSSE()
+ *
+ *  This method is used for testing the boxes four at a time.
+ *  For each plane, the distance of the box center is compared
+ *  with the box's extent projected onto the plane normal.
+ ***********************************************************/
+void FrustumCuller::CullSSE()
+{
+	__m128 normalX[PLANE_COUNT];
+	__m128 normalY[PLANE_COUNT];
+	__m128 normalZ[PLANE_COUNT];
+	__m128 offset[PLANE_COUNT];
+	__m128 absoluteX[PLANE_COUNT];
+	__m128 absoluteY[PLANE_COUNT];
+	__m128 absoluteZ[PLANE_COUNT];
+	for (int plane = 0; plane < PLANE_COUNT; plane++)
+	{
+		normalX[plane] = _mm_set1_ps(m_planes[plane].x);
+		normalY[plane] = _mm_set1_ps(m_planes[plane].y);
+		normalZ[plane] = _mm_set1_ps(m_planes[plane].z);
+		offset[plane] = _mm_set1_ps(m_planes[plane].w);
+		absoluteX[plane] = _mm_set1_ps(std::fabs(m_planes[plane].x));
+		absoluteY[plane] = _mm_set1_ps(std::fabs(m_planes[plane].y));
+		absoluteZ[plane] = _mm_set1_ps(std::fabs(m_planes[plane].z));
+	}
+
+	for (int first = 0; first < m_boxCount; first += 4)
+	{
+		__m128 centerX = _mm_loadu_ps(&m_centerX[first]);
+		__m128 centerY = _mm_loadu_ps(&m_centerY[first]);
+		__m128 centerZ = _mm_loadu_ps(&m_centerZ[first]);
+		__m128 extentX = _mm_loadu_ps(&m_extentX[first]);
+		__m128 extentY = _mm_loadu_ps(&m_extentY[first]);
+		__m128 extentZ = _mm_loadu_ps(&m_extentZ[first]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(centerX, normalX[plane]), _mm_mul_ps(centerY, normalY[plane])),
+				_mm_add_ps(_mm_mul_ps(centerZ, normalZ[plane]), offset[plane]));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(extentX, absoluteX[plane]), _mm_mul_ps(extentY, absoluteY[plane])),
+				_mm_mul_ps(extentZ, absoluteZ[plane]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		int outsideMask = _mm_movemask_ps(outside);
+		int last = (first + 4 < m_boxCount) ? (first + 4) : m_boxCount;
+		for (int i = first; i < last; i++)
+		{
+			m_visible[i] = ((outsideMask >> (i - first)) & 1) ? 0 : 1;
+		}
+	}
+}
+
+/***********************************************************
+ *  CullAVX()
+ *
+ *  This method is used for testing the boxes eight at a
+ *  time, the same way as CullSSE().  It is only built when
+ *  the compiler targets AVX.
+ ***********************************************************/
+void FrustumCuller::CullAVX()
+{
+#ifdef __AVX__
+	__m256 normalX[PLANE_COUNT];
+	__m256 normalY[PLANE_COUNT];
+	__m256 normalZ[PLANE_COUNT];
+	__m256 offset[PLANE_COUNT];
+	__m256 absoluteX[PLANE_COUNT];
+	__m256 absoluteY[PLANE_COUNT];
+	__m256 absoluteZ[PLANE_COUNT];
+	for (int plane = 0; plane < PLANE_COUNT; plane++)
+	{
+		normalX[plane] = _mm256_set1_ps(m_planes[plane].x);
+		normalY[plane] = _mm256_set1_ps(m_planes[plane].y);
+		normalZ[plane] = _mm256_set1_ps(m_planes[plane].z);
+		offset[plane] = _mm256_set1_ps(m_planes[plane].w);
+		absoluteX[plane] = _mm256_set1_ps(std::fabs(m_planes[plane].x));
+		absoluteY[plane] = _mm256_set1_ps(std::fabs(m_planes[plane].y));
+		absoluteZ[plane] = _mm256_set1_ps(std::fabs(m_planes[plane].z));
+	}
+
+	for (int first = 0; first < m_boxCount; first += BATCH_SIZE)
+	{
+		__m256 centerX = _mm256_loadu_ps(&m_centerX[first]);
+		__m256 centerY = _mm256_loadu_ps(&m_centerY[first]);
+		__m256 centerZ = _mm256_loadu_ps(&m_centerZ[first]);
+		__m256 extentX = _mm256_loadu_ps(&m_extentX[first]);
+		__m256 extentY = _mm256_loadu_ps(&m_extentY[first]);
+		__m256 extentZ = _mm256_loadu_ps(&m_extentZ[first]);
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(centerX, normalX[plane]), _mm256_mul_ps(centerY, normalY[plane])),
+				_mm256_add_ps(_mm256_mul_ps(centerZ, normalZ[plane]), offset[plane]));
+			__m256 radius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(extentX, absoluteX[plane]), _mm256_mul_ps(extentY, absoluteY[plane])),
+				_mm256_mul_ps(extentZ, absoluteZ[plane]));
+			outside = _mm256_or_ps(outside,
+				_mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		int outsideMask = _mm256_movemask_ps(outside);
+		int last = (first + BATCH_SIZE < m_boxCount) ? (first + BATCH_SIZE) : m_boxCount;
+		for (int i = first; i < last; i++)
+		{
+			m_visible[i] = ((outsideMask >> (i - first)) & 1) ? 0 : 1;
+		}
+	}
+#else
+	CullSSE();
+#endif
+}
+
+/***********************************************************
+ *  TransformBox()
+ *
+ *  This method is used for getting the world space box that
+ *  holds a local box after it is transformed.  The center is
+ *  transformed as a point, and the half extent of the result
+ *  is the local half extent through the absolute values of
+ *  the rotation and scale part of the matrix.
+ ***********************************************************/
+void FrustumCuller::TransformBox(
+	const glm::mat4& model,
+	const glm::vec3& localCenter,
+	const glm::vec3& localExtent,
+	glm::vec3& center,
+	glm::vec3& extent)
+{
+	center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	extent =
+		glm::abs(glm::vec3(model[0])) * localExtent.x +
+		glm::abs(glm::vec3(model[1])) * localExtent.y +
+		glm::abs(glm::vec3(model[2])) * localExtent.z;
+}
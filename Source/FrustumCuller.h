@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.h
+// ============
+// test world space bounding boxes against the view frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class keeps a world space bounding box for each
+ *  object and tests all of them against the six planes of
+ *  the view frustum.  The boxes are stored as separate
+ *  arrays of centers and half extents, so a batch of boxes
+ *  is tested against a plane with a few vector instructions
+ *  - eight at a time with AVX, or four with SSE.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// constructor
+	FrustumCuller();
+	// destructor
+	~FrustumCuller();
+
+	// counts of the last Cull()
+	struct CULL_STATS
+	{
+		int boxes;
+		int visible;
+		int culled;
+	};
+
+	// add a box by its center and half extent, returning its index
+	int AddBox(const glm::vec3& center, const glm::vec3& extent);
+	// move an added box
+	void SetBox(int index, const glm::vec3& center, const glm::vec3& extent);
+	// remove all of the boxes
+	void Clear();
+
+	// take the frustum planes from a view projection matrix
+	void SetFrustum(const glm::mat4& viewProjection);
+	// test every box against the frustum, returning how many
+	// of them are visible
+	int Cull();
+
+	// whether a box was inside or crossing the frustum in the last Cull()
+	bool IsVisible(int index) const { return(m_visible[index] != 0); }
+	int GetBoxCount() const { return(m_boxCount); }
+	const CULL_STATS& GetStats() const { return(m_stats); }
+	// the six planes set by the last SetFrustum()
+	const glm::vec4* GetPlanes() const { return(m_planes); }
+
+	// get the world space box around a transformed local box
+	static void TransformBox(
+		const glm::mat4& model,
+		const glm::vec3& localCenter,
+		const glm::vec3& localExtent,
+		glm::vec3& center,
+		glm::vec3& extent);
+
+private:
+	// box centers and half extents, one array per component,
+	// padded to a whole number of vectors
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+	// result of the last Cull() for each box
+	std::vector<unsigned char> m_visible;
+	int m_boxCount;
+
+	// left, right, bottom, top, near and far planes, with the
+	// normals pointing into the frustum
+	glm::vec4 m_planes[6];
+
+	CULL_STATS m_stats;
+
+	// test the boxes with 4 or 8 lane vectors
+	void CullSSE();
+	void CullAVX();
+};
@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+// gputimers.cpp
+// ============
+// measure the GPU time of the passes of a frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuTimers.h"
+
+/***********************************************************
+ *  GpuTimers()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuTimers::GpuTimers()
+{
+	for (int frame = 0; frame < FRAME_LATENCY; frame++)
+	{
+		for (int timer = 0; timer < MAX_TIMERS; timer++)
+		{
+			m_queries[frame][timer][0] = 0;
+			m_queries[frame][timer][1] = 0;
+			m_bTimed[frame][timer] = false;
+		}
+	}
+	for (int timer = 0; timer < MAX_TIMERS; timer++)
+	{
+		m_elapsed[timer] = 0;
+		m_samples[timer] = 0;
+		m_averages[timer] = -1.0;
+	}
+	m_frame = 0;
+	m_framesRead = 0;
+	m_averageCount = 0;
+}
+
+/***********************************************************
+ *  ~GpuTimers()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuTimers::~GpuTimers()
+{
+	DestroyQueries();
+}
+
+/***********************************************************
+ *  CreateQueries()
+ *
+ *  This method is used for creating the query objects of
+ *  every pass in every frame in flight.
+ ***********************************************************/
+void GpuTimers::CreateQueries()
+{
+	glGenQueries(FRAME_LATENCY * MAX_TIMERS * 2, &m_queries[0][0][0]);
+}
+
+/***********************************************************
+ *  DestroyQueries()
+ *
+ *  This method is used for freeing the query objects.
+ ***********************************************************/
+void GpuTimers::DestroyQueries()
+{
+	if (m_queries[0][0][0] != 0)
+	{
+		glDeleteQueries(FRAME_LATENCY * MAX_TIMERS * 2, &m_queries[0][0][0]);
+		for (int frame = 0; frame < FRAME_LATENCY; frame++)
+		{
+			for (int timer = 0; timer < MAX_TIMERS; timer++)
+			{
+				m_queries[frame][timer][0] = 0;
+				m_queries[frame][timer][1] = 0;
+				m_bTimed[frame][timer] = false;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for writing the timestamp at the
+ *  start of a pass.
+ ***********************************************************/
+void GpuTimers::Begin(int timer)
+{
+	if ((timer < 0) || (timer >= MAX_TIMERS) || (m_queries[0][0][0] == 0))
+	{
+		return;
+	}
+
+	glQueryCounter(m_queries[m_frame][timer][0], GL_TIMESTAMP);
+}
+
+/***********************************************************
+ *  End()
+ *
+ *  This method is used for writing the timestamp at the end
+ *  of a pass.
+ ***********************************************************/
+void GpuTimers::End(int timer)
+{
+	if ((timer < 0) || (timer >= MAX_TIMERS) || (m_queries[0][0][0] == 0))
+	{
+		return;
+	}
+
+	glQueryCounter(m_queries[m_frame][timer][1], GL_TIMESTAMP);
+	m_bTimed[m_frame][timer] = true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for moving on to the next frame.  Its
+ *  queries were written FRAME_LATENCY frames ago, so their
+ *  results are read before they are written again.  A
+ *  result that is still not available is skipped rather
+ *  than waited for.
+ ***********************************************************/
+void GpuTimers::EndFrame()
+{
+	if (m_queries[0][0][0] == 0)
+	{
+		return;
+	}
+
+	m_frame = (m_frame + 1) % FRAME_LATENCY;
+
+	bool bAnyTimed = false;
+	for (int timer = 0; timer < MAX_TIMERS; timer++)
+	{
+		if (m_bTimed[m_frame][timer] == false)
+		{
+			continue;
+		}
+		m_bTimed[m_frame][timer] = false;
+		bAnyTimed = true;
+
+		GLint bAvailable = 0;
+		glGetQueryObjectiv(m_queries[m_frame][timer][1], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (bAvailable == 0)
+		{
+			continue;
+		}
+
+		GLuint64 start = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(m_queries[m_frame][timer][0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(m_queries[m_frame][timer][1], GL_QUERY_RESULT, &end);
+		if (end > start)
+		{
+			m_elapsed[timer] += end - start;
+		}
+		m_samples[timer]++;
+	}
+
+	if (bAnyTimed == false)
+	{
+		return;
+	}
+
+	m_framesRead++;
+	if (m_framesRead < AVERAGE_FRAMES)
+	{
+		return;
+	}
+
+	for (int timer = 0; timer < MAX_TIMERS; timer++)
+	{
+		m_averages[timer] = (m_samples[timer] > 0) ?
+			(double)m_elapsed[timer] / 1000000.0 / m_samples[timer] : -1.0;
+		m_elapsed[timer] = 0;
+		m_samples[timer] = 0;
+	}
+	m_framesRead = 0;
+	m_averageCount++;
+}
+
+/***********************************************************
+ *  GetAverage()
+ *
+ *  This method is used for getting the last average GPU
+ *  time of a pass, in milliseconds.
+ ***********************************************************/
+double GpuTimers::GetAverage(int timer) const
+{
+	if ((timer < 0) || (timer >= MAX_TIMERS))
+	{
+		return(-1.0);
+	}
+
+	return(m_averages[timer]);
+}
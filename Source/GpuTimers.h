@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// gputimers.h
+// ============
+// measure the GPU time of the passes of a frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GpuTimers
+ *
+ *  This class times passes of a frame on the GPU with
+ *  timestamp queries written at the start and end of each
+ *  pass.  The queries of a frame are read a few frames
+ *  later, when the GPU has long finished them, so reading
+ *  them never stalls the frame.  The times are averaged over
+ *  a number of frames, and a new average is made available
+ *  each time that many frames have been read.
+ ***********************************************************/
+class GpuTimers
+{
+public:
+	// constructor
+	GpuTimers();
+	// destructor
+	~GpuTimers();
+
+	// most passes that can be timed
+	static const int MAX_TIMERS = 8;
+	// frames that the queries are read behind
+	static const int FRAME_LATENCY = 4;
+	// frames each average is taken over
+	static const int AVERAGE_FRAMES = 60;
+
+	// create the query objects
+	void CreateQueries();
+	// free the query objects
+	void DestroyQueries();
+
+	// write the timestamps at the start and end of a pass
+	void Begin(int timer);
+	void End(int timer);
+	// finish the frame, reading the queries of the oldest one
+	void EndFrame();
+
+	// average GPU time of a pass in milliseconds, or a negative
+	// value when it did not run in the frames of the average
+	double GetAverage(int timer) const;
+	// number of averages made so far
+	int GetAverageCount() const { return(m_averageCount); }
+
+private:
+	// start and end queries of each pass in each frame in flight
+	GLuint m_queries[FRAME_LATENCY][MAX_TIMERS][2];
+	// whether a pass was timed in a frame in flight
+	bool m_bTimed[FRAME_LATENCY][MAX_TIMERS];
+	// the frame whose queries are being written
+	int m_frame;
+	// times and counts read since the last average
+	GLuint64 m_elapsed[MAX_TIMERS];
+	int m_samples[MAX_TIMERS];
+	int m_framesRead;
+	// the last averages
+	double m_averages[MAX_TIMERS];
+	int m_averageCount;
+};
@@ -0,0 +1,348 @@
+///////////////////////////////////////////////////////////////////////////////
+// imageencoder.cpp
+// ============
+// encode captured RGB frames into image files and video streams
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageEncoder.h"
+#include "DeflateEncoder.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// declaration of the global variables and defines
+namespace
+{
+	// the first bytes of every PNG file
+	const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	// the filters a PNG row can be stored with
+	enum PNG_FILTER
+	{
+		PNG_FILTER_NONE = 0,
+		PNG_FILTER_SUB,
+		PNG_FILTER_UP,
+		PNG_FILTER_AVERAGE,
+		PNG_FILTER_PAETH
+	};
+
+	// append a 32 bit value, most significant byte first
+	void AppendBigEndian(std::vector<unsigned char>& output, unsigned int value)
+	{
+		output.push_back((unsigned char)(value >> 24));
+		output.push_back((unsigned char)(value >> 16));
+		output.push_back((unsigned char)(value >> 8));
+		output.push_back((unsigned char)value);
+	}
+
+	// append a PNG chunk - its length, type, data and CRC
+	void AppendChunk(std::vector<unsigned char>& output, const char* type, const unsigned char* pData, size_t size)
+	{
+		AppendBigEndian(output, (unsigned int)size);
+		size_t typeStart = output.size();
+		output.insert(output.end(), type, type + 4);
+		output.insert(output.end(), pData, pData + size);
+		AppendBigEndian(output, ImageEncoder::UpdateCRC(0, &output[typeStart], size + 4));
+	}
+
+	// the neighbour of the Paeth filter closest to the gradient
+	inline int GetPaethPredictor(int left, int above, int aboveLeft)
+	{
+		int estimate = left + above - aboveLeft;
+		int leftDistance = abs(estimate - left);
+		int aboveDistance = abs(estimate - above);
+		int aboveLeftDistance = abs(estimate - aboveLeft);
+		if ((leftDistance <= aboveDistance) && (leftDistance <= aboveLeftDistance))
+		{
+			return(left);
+		}
+		if (aboveDistance <= aboveLeftDistance)
+		{
+			return(above);
+		}
+		return(aboveLeft);
+	}
+
+	// filter an RGB row against the row above it, returning the
+	// sum of the differences as signed bytes
+	unsigned int FilterRow(int filter, const unsigned char* pRow, const unsigned char* pAbove, size_t rowSize, unsigned char* pFiltered)
+	{
+		unsigned int cost = 0;
+		for (size_t i = 0; i < rowSize; i++)
+		{
+			int left = (i >= 3) ? pRow[i - 3] : 0;
+			int aboveLeft = (i >= 3) ? pAbove[i - 3] : 0;
+			int predicted = 0;
+			switch (filter)
+			{
+			case PNG_FILTER_SUB:
+				predicted = left;
+				break;
+			case PNG_FILTER_UP:
+				predicted = pAbove[i];
+				break;
+			case PNG_FILTER_AVERAGE:
+				predicted = (left + pAbove[i]) / 2;
+				break;
+			case PNG_FILTER_PAETH:
+				predicted = GetPaethPredictor(left, pAbove[i], aboveLeft);
+				break;
+			}
+			pFiltered[i] = (unsigned char)(pRow[i] - predicted);
+			cost += abs((int)(signed char)pFiltered[i]);
+		}
+
+		return(cost);
+	}
+
+	// the luma and chroma of a color, in the video range of BT.601
+	inline unsigned char GetLuma(int r, int g, int b)
+	{
+		return((unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16));
+	}
+	inline unsigned char GetBlueChroma(int r, int g, int b)
+	{
+		return((unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128));
+	}
+	inline unsigned char GetRedChroma(int r, int g, int b)
+	{
+		return((unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128));
+	}
+}
+
+/***********************************************************
+ *  EncodePPM()
+ *
+ *  This method is used for encoding an RGB image as a
+ *  binary PPM file - a short text header and the raw rows.
+ ***********************************************************/
+void ImageEncoder::EncodePPM(const unsigned char* pPixels, int width, int height, std::vector<unsigned char>& output)
+{
+	char header[64];
+	int headerSize = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+	size_t imageSize = (size_t)width * height * 3;
+
+	output.resize(headerSize + imageSize);
+	memcpy(&output[0], header, headerSize);
+	memcpy(&output[headerSize], pPixels, imageSize);
+}
+
+/***********************************************************
+ *  EncodePNG()
+ *
+ *  This method is used for encoding an RGB image as a PNG
+ *  file.  Each row is filtered with the filter that leaves
+ *  the smallest differences, which is what compresses best
+ *  in most images, and the rows are compressed together.
+ ***********************************************************/
+void ImageEncoder::EncodePNG(const unsigned char* pPixels, int width, int height, std::vector<unsigned char>& output)
+{
+	output.clear();
+	output.insert(output.end(), PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+
+	// 8 bits per channel RGB, with no interlacing
+	std::vector<unsigned char> header;
+	AppendBigEndian(header, (unsigned int)width);
+	AppendBigEndian(header, (unsigned int)height);
+	header.push_back(8);
+	header.push_back(2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	AppendChunk(output, "IHDR", header.data(), header.size());
+
+	// every row starts with the byte of its filter
+	size_t rowSize = (size_t)width * 3;
+	std::vector<unsigned char> rows((rowSize + 1) * height);
+	std::vector<unsigned char> zeroRow(rowSize, 0);
+	std::vector<unsigned char> filtered(rowSize);
+	for (int row = 0; row < height; row++)
+	{
+		const unsigned char* pRow = &pPixels[row * rowSize];
+		const unsigned char* pAbove = (row > 0) ? &pPixels[(row - 1) * rowSize] : zeroRow.data();
+		unsigned char* pOutput = &rows[row * (rowSize + 1)];
+
+		unsigned int bestCost = 0xFFFFFFFF;
+		for (int filter = PNG_FILTER_NONE; filter <= PNG_FILTER_PAETH; filter++)
+		{
+			unsigned int cost = FilterRow(filter, pRow, pAbove, rowSize, filtered.data());
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				pOutput[0] = (unsigned char)filter;
+				memcpy(&pOutput[1], filtered.data(), rowSize);
+			}
+		}
+	}
+
+	std::vector<unsigned char> stream;
+	DeflateEncoder encoder;
+	encoder.Compress(rows.data(), rows.size(), stream);
+	AppendChunk(output, "IDAT", stream.data(), stream.size());
+
+	AppendChunk(output, "IEND", NULL, 0);
+}
+
+/***********************************************************
+ *  GetY4MHeader()
+ *
+ *  This method is used for getting the line that starts a
+ *  Y4M stream - the frame size and rate, progressive frames
+ *  with square pixels, and 4:2:0 chroma.
+ ***********************************************************/
+std::string ImageEncoder::GetY4MHeader(int width, int height, int framesPerSecond)
+{
+	char header[128];
+	snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond);
+
+	return(header);
+}
+
+/***********************************************************
+ *  EncodeY4MFrame()
+ *
+ *  This method is used for encoding an RGB image as a Y4M
+ *  frame - the frame marker, then the luma plane and the two
+ *  chroma planes at half the size each way.  Each chroma
+ *  sample is the average of the 2x2 pixels it covers, with
+ *  the last row and column repeated for odd sizes.
+ ***********************************************************/
+void ImageEncoder::EncodeY4MFrame(const unsigned char* pPixels, int width, int height, std::vector<unsigned char>& output)
+{
+	static const char FRAME_MARKER[] = "FRAME\n";
+	const size_t markerSize = sizeof(FRAME_MARKER) - 1;
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	size_t lumaSize = (size_t)width * height;
+	size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+
+	output.resize(markerSize + lumaSize + chromaSize * 2);
+	memcpy(&output[0], FRAME_MARKER, markerSize);
+	unsigned char* pLuma = &output[markerSize];
+	unsigned char* pBlue = pLuma + lumaSize;
+	unsigned char* pRed = pBlue + chromaSize;
+
+	for (size_t i = 0; i < lumaSize; i++)
+	{
+		const unsigned char* pPixel = &pPixels[i * 3];
+		pLuma[i] = GetLuma(pPixel[0], pPixel[1], pPixel[2]);
+	}
+
+	for (int y = 0; y < chromaHeight; y++)
+	{
+		int row0 = y * 2;
+		int row1 = (row0 + 1 < height) ? row0 + 1 : row0;
+		for (int x = 0; x < chromaWidth; x++)
+		{
+			int column0 = x * 2;
+			int column1 = (column0 + 1 < width) ? column0 + 1 : column0;
+			const unsigned char* pCorners[4] = {
+				&pPixels[((size_t)row0 * width + column0) * 3],
+				&pPixels[((size_t)row0 * width + column1) * 3],
+				&pPixels[((size_t)row1 * width + column0) * 3],
+				&pPixels[((size_t)row1 * width + column1) * 3] };
+			int r = 0;
+			int g = 0;
+			int b = 0;
+			for (int corner = 0; corner < 4; corner++)
+			{
+				r += pCorners[corner][0];
+				g += pCorners[corner][1];
+				b += pCorners[corner][2];
+			}
+			r = (r + 2) / 4;
+			g = (g + 2) / 4;
+			b = (b + 2) / 4;
+			pBlue[y * chromaWidth + x] = GetBlueChroma(r, g, b);
+			pRed[y * chromaWidth + x] = GetRedChroma(r, g, b);
+		}
+	}
+}
+
+/***********************************************************
+ *  FlipRows()
+ *
+ *  This method is used for reversing the rows of an RGB
+ *  image.  OpenGL reads the bottom row first, and the image
+ *  formats start with the top row.
+ ***********************************************************/
+void ImageEncoder::FlipRows(const unsigned char* pPixels, int width, int height, unsigned char* pFlipped)
+{
+	size_t rowSize = (size_t)width * 3;
+	for (int row = 0; row < height; row++)
+	{
+		memcpy(&pFlipped[row * rowSize], &pPixels[(height - 1 - row) * rowSize], rowSize);
+	}
+}
+
+/***********************************************************
+ *  UpdateCRC()
+ *
+ *  This method is used for computing the CRC-32 that ends
+ *  each PNG chunk, a byte at a time from a table made the
+ *  first time it is called.  The CRC of a first block of
+ *  data is continued from zero.
+ ***********************************************************/
+unsigned int ImageEncoder::UpdateCRC(unsigned int crc, const unsigned char* pData, size_t size)
+{
+	struct CRC_TABLE
+	{
+		unsigned int entries[256];
+		CRC_TABLE()
+		{
+			for (unsigned int n = 0; n < 256; n++)
+			{
+				unsigned int c = n;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				entries[n] = c;
+			}
+		}
+	};
+	static const CRC_TABLE table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table.entries[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return(~crc);
+}
+
+/***********************************************************
+ *  UpdateAdler32()
+ *
+ *  This method is used for computing the Adler-32 checksum
+ *  of the uncompressed data of a zlib stream.  The sums are
+ *  only reduced every few thousand bytes, as often as is
+ *  needed to keep them from overflowing.  The checksum of a
+ *  first block of data is continued from one.
+ ***********************************************************/
+unsigned int ImageEncoder::UpdateAdler32(unsigned int adler, const unsigned char* pData, size_t size)
+{
+	// the most bytes that can be summed before the sums overflow
+	const size_t REDUCE_BYTES = 5552;
+	const unsigned int ADLER_MODULUS = 65521;
+
+	unsigned int a = adler & 0xFFFF;
+	unsigned int b = adler >> 16;
+	while (size > 0)
+	{
+		size_t count = (size < REDUCE_BYTES) ? size : REDUCE_BYTES;
+		size -= count;
+		for (size_t i = 0; i < count; i++)
+		{
+			a += pData[i];
+			b += a;
+		}
+		pData += count;
+		a %= ADLER_MODULUS;
+		b %= ADLER_MODULUS;
+	}
+
+	return((b << 16) | a);
+}
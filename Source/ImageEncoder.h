@@ -0,0 +1,45 @@
+///////////////////////////////////////////////////////////////////////////////
+// imageencoder.h
+// ============
+// encode captured RGB frames into image files and video streams
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ImageEncoder
+ *
+ *  This class turns RGB frames, top row first, into the
+ *  bytes of the formats frames are captured in - binary PPM
+ *  and PNG images, and the planar YUV 4:2:0 frames of a Y4M
+ *  stream that video encoders read.  The methods only use
+ *  their arguments and can be called from several threads
+ *  at once, so frames can be encoded in parallel.
+ ***********************************************************/
+class ImageEncoder
+{
+public:
+	// encode an RGB image as a binary PPM file
+	static void EncodePPM(const unsigned char* pPixels, int width, int height, std::vector<unsigned char>& output);
+	// encode an RGB image as a PNG file
+	static void EncodePNG(const unsigned char* pPixels, int width, int height, std::vector<unsigned char>& output);
+
+	// the header of a Y4M stream of frames of the given size
+	static std::string GetY4MHeader(int width, int height, int framesPerSecond);
+	// encode an RGB image as one frame of a Y4M stream
+	static void EncodeY4MFrame(const unsigned char* pPixels, int width, int height, std::vector<unsigned char>& output);
+
+	// copy an RGB image read from OpenGL, bottom row first, into
+	// an image with the top row first
+	static void FlipRows(const unsigned char* pPixels, int width, int height, unsigned char* pFlipped);
+
+	// the CRC of the PNG chunks, continued from an earlier one
+	static unsigned int UpdateCRC(unsigned int crc, const unsigned char* pData, size_t size);
+	// the checksum that ends a zlib stream, continued from an
+	// earlier one
+	static unsigned int UpdateAdler32(unsigned int adler, const unsigned char* pData, size_t size);
+};
@@ -0,0 +1,688 @@
+///////////////////////////////////////////////////////////////////////////////
+// instancedmeshes.cpp
+// ============
+// basic shape meshes that are drawn many times with one draw command
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InstancedMeshes.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+// declaration of the global variables and defines
+namespace
+{
+	// number of floats in one interleaved vertex
+	const int FLOATS_PER_VERTEX = 8;
+	// vertex buffer binding points of the vertex array object
+	const GLuint VERTEX_BINDING = 0;
+	const GLuint DRAW_INDEX_BINDING = 1;
+	// number of draw records and commands the buffers start with
+	const size_t INITIAL_RECORD_CAPACITY = 1024;
+	const size_t INITIAL_COMMAND_CAPACITY = 256;
+
+	// subdivisions of the round meshes
+	const int CYLINDER_SIDES = 36;
+	const int TORUS_MAIN_SEGMENTS = 36;
+	const int TORUS_TUBE_SEGMENTS = 18;
+	const float TORUS_MAIN_RADIUS = 1.0f;
+	const float TORUS_TUBE_RADIUS = 0.2f;
+
+	/***********************************************************
+	 *  AppendVertex()
+	 *
+	 *  Add one interleaved vertex and return its index.
+	 ***********************************************************/
+	GLuint AppendVertex(
+		std::vector<GLfloat>& vertices,
+		glm::vec3 position,
+		glm::vec3 normal,
+		glm::vec2 uv)
+	{
+		GLuint index = (GLuint)(vertices.size() / FLOATS_PER_VERTEX);
+		vertices.push_back(position.x);
+		vertices.push_back(position.y);
+		vertices.push_back(position.z);
+		vertices.push_back(normal.x);
+		vertices.push_back(normal.y);
+		vertices.push_back(normal.z);
+		vertices.push_back(uv.x);
+		vertices.push_back(uv.y);
+		return(index);
+	}
+
+	/***********************************************************
+	 *  AppendTriangle()
+	 *
+	 *  Add one triangle, flipping the winding when needed so
+	 *  that it is counter-clockwise when seen from the side
+	 *  that its vertex normals face.
+	 ***********************************************************/
+	void AppendTriangle(
+		const std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		GLuint a, GLuint b, GLuint c)
+	{
+		const GLfloat* pA = &vertices[a * FLOATS_PER_VERTEX];
+		const GLfloat* pB = &vertices[b * FLOATS_PER_VERTEX];
+		const GLfloat* pC = &vertices[c * FLOATS_PER_VERTEX];
+
+		glm::vec3 edge1 = glm::vec3(pB[0] - pA[0], pB[1] - pA[1], pB[2] - pA[2]);
+		glm::vec3 edge2 = glm::vec3(pC[0] - pA[0], pC[1] - pA[1], pC[2] - pA[2]);
+		glm::vec3 normal = glm::vec3(pA[3] + pB[3] + pC[3], pA[4] + pB[4] + pC[4], pA[5] + pB[5] + pC[5]);
+
+		indices.push_back(a);
+		if (glm::dot(glm::cross(edge1, edge2), normal) >= 0.0f)
+		{
+			indices.push_back(b);
+			indices.push_back(c);
+		}
+		else
+		{
+			indices.push_back(c);
+			indices.push_back(b);
+		}
+	}
+
+	/***********************************************************
+	 *  AppendQuad()
+	 *
+	 *  Add a flat quad around a center point, spanning the
+	 *  passed in half extent vectors.
+	 ***********************************************************/
+	void AppendQuad(
+		std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		glm::vec3 center,
+		glm::vec3 halfU,
+		glm::vec3 halfV,
+		glm::vec3 normal)
+	{
+		GLuint v0 = AppendVertex(vertices, center - halfU - halfV, normal, glm::vec2(0.0f, 0.0f));
+		GLuint v1 = AppendVertex(vertices, center + halfU - halfV, normal, glm::vec2(1.0f, 0.0f));
+		GLuint v2 = AppendVertex(vertices, center + halfU + halfV, normal, glm::vec2(1.0f, 1.0f));
+		GLuint v3 = AppendVertex(vertices, center - halfU + halfV, normal, glm::vec2(0.0f, 1.0f));
+
+		AppendTriangle(vertices, indices, v0, v1, v2);
+		AppendTriangle(vertices, indices, v0, v2, v3);
+	}
+
+	/***********************************************************
+	 *  FillDrawIndexBuffer()
+	 *
+	 *  Size the draw index buffer and fill it with 0..count-1.
+	 ***********************************************************/
+	void FillDrawIndexBuffer(GLuint buffer, size_t count)
+	{
+		std::vector<GLuint> drawIndices(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			drawIndices[i] = (GLuint)i;
+		}
+		glNamedBufferData(buffer, count * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+	}
+}
+
+/***********************************************************
+ *  InstancedMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+InstancedMeshes::InstancedMeshes()
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		m_meshRanges[i] = MESH_RANGE();
+	}
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_positionVao = 0;
+	m_positionBuffer = 0;
+	m_indexBuffer = 0;
+	m_drawIndexBuffer = 0;
+	m_recordBuffer = 0;
+	m_commandBuffer = 0;
+	m_uploadedRecords = 0;
+	m_uploadedCommands = 0;
+	m_recordCapacity = 0;
+	m_commandCapacity = 0;
+}
+
+/***********************************************************
+ *  ~InstancedMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+InstancedMeshes::~InstancedMeshes()
+{
+	DestroyBuffers();
+}
+
+/***********************************************************
+ *  LoadPlaneMesh()
+ *
+ *  This method is used for building a flat plane that spans
+ *  from -1 to 1 along the X and Z axes, facing up.
+ ***********************************************************/
+void InstancedMeshes::LoadPlaneMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	AppendQuad(vertices, indices,
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::vec3(1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f));
+
+	AddMesh(PLANE_MESH, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadBoxMesh()
+ *
+ *  This method is used for building a unit box centered on
+ *  the origin, with separate vertices for each face so that
+ *  every face has flat normals and its own texture mapping.
+ ***********************************************************/
+void InstancedMeshes::LoadBoxMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	// face normal, then the half extent vectors across the face
+	const glm::vec3 faces[6][3] =
+	{
+		{ glm::vec3( 1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(0.0f, 0.5f, 0.0f) },
+		{ glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f,  0.5f), glm::vec3(0.0f, 0.5f, 0.0f) },
+		{ glm::vec3(0.0f,  1.0f, 0.0f), glm::vec3(0.5f, 0.0f,  0.0f), glm::vec3(0.0f, 0.0f, -0.5f) },
+		{ glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.5f, 0.0f,  0.0f), glm::vec3(0.0f, 0.0f,  0.5f) },
+		{ glm::vec3(0.0f, 0.0f,  1.0f), glm::vec3( 0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f) },
+		{ glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f) }
+	};
+
+	for (int face = 0; face < 6; face++)
+	{
+		AppendQuad(vertices, indices,
+			faces[face][0] * 0.5f,
+			faces[face][1],
+			faces[face][2],
+			faces[face][0]);
+	}
+
+	AddMesh(BOX_MESH, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadCylinderMesh()
+ *
+ *  This method is used for building a cylinder with a radius
+ *  of 1 that stands from 0 to 1 along the Y axis, with caps
+ *  on the top and the bottom.
+ ***********************************************************/
+void InstancedMeshes::LoadCylinderMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	// the side, with a duplicated seam so the texture wraps once
+	for (int side = 0; side < CYLINDER_SIDES; side++)
+	{
+		float angle0 = glm::two_pi<float>() * side / CYLINDER_SIDES;
+		float angle1 = glm::two_pi<float>() * (side + 1) / CYLINDER_SIDES;
+		glm::vec3 normal0 = glm::vec3(cos(angle0), 0.0f, sin(angle0));
+		glm::vec3 normal1 = glm::vec3(cos(angle1), 0.0f, sin(angle1));
+		float u0 = (float)side / CYLINDER_SIDES;
+		float u1 = (float)(side + 1) / CYLINDER_SIDES;
+
+		GLuint bottom0 = AppendVertex(vertices, normal0, normal0, glm::vec2(u0, 0.0f));
+		GLuint top0 = AppendVertex(vertices, normal0 + glm::vec3(0.0f, 1.0f, 0.0f), normal0, glm::vec2(u0, 1.0f));
+		GLuint bottom1 = AppendVertex(vertices, normal1, normal1, glm::vec2(u1, 0.0f));
+		GLuint top1 = AppendVertex(vertices, normal1 + glm::vec3(0.0f, 1.0f, 0.0f), normal1, glm::vec2(u1, 1.0f));
+
+		AppendTriangle(vertices, indices, bottom0, top0, bottom1);
+		AppendTriangle(vertices, indices, bottom1, top0, top1);
+	}
+
+	// the bottom and top caps as triangle fans
+	for (int cap = 0; cap < 2; cap++)
+	{
+		float y = (float)cap;
+		glm::vec3 normal = glm::vec3(0.0f, (cap == 0) ? -1.0f : 1.0f, 0.0f);
+		GLuint center = AppendVertex(vertices, glm::vec3(0.0f, y, 0.0f), normal, glm::vec2(0.5f, 0.5f));
+		GLuint previous = 0;
+
+		for (int side = 0; side <= CYLINDER_SIDES; side++)
+		{
+			float angle = glm::two_pi<float>() * side / CYLINDER_SIDES;
+			GLuint current = AppendVertex(vertices,
+				glm::vec3(cos(angle), y, sin(angle)),
+				normal,
+				glm::vec2(0.5f + 0.5f * cos(angle), 0.5f + 0.5f * sin(angle)));
+
+			if (side > 0)
+			{
+				AppendTriangle(vertices, indices, center, previous, current);
+			}
+			previous = current;
+		}
+	}
+
+	AddMesh(CYLINDER_MESH, vertices, indices);
+}
+
+/***********************************************************
+ *  LoadTorusMesh()
+ *
+ *  This method is used for building a torus around the Z
+ *  axis, so that it faces the front of the scene.
+ ***********************************************************/
+void InstancedMeshes::LoadTorusMesh()
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+
+	// a grid of vertices with the seams duplicated for texturing
+	for (int main = 0; main <= TORUS_MAIN_SEGMENTS; main++)
+	{
+		float theta = glm::two_pi<float>() * main / TORUS_MAIN_SEGMENTS;
+		for (int tube = 0; tube <= TORUS_TUBE_SEGMENTS; tube++)
+		{
+			float phi = glm::two_pi<float>() * tube / TORUS_TUBE_SEGMENTS;
+			glm::vec3 normal = glm::vec3(cos(phi) * cos(theta), cos(phi) * sin(theta), sin(phi));
+			glm::vec3 position = glm::vec3(
+				(TORUS_MAIN_RADIUS + TORUS_TUBE_RADIUS * cos(phi)) * cos(theta),
+				(TORUS_MAIN_RADIUS + TORUS_TUBE_RADIUS * cos(phi)) * sin(theta),
+				TORUS_TUBE_RADIUS * sin(phi));
+
+			AppendVertex(vertices, position, normal,
+				glm::vec2((float)main / TORUS_MAIN_SEGMENTS, (float)tube / TORUS_TUBE_SEGMENTS));
+		}
+	}
+
+	const GLuint rowLength = TORUS_TUBE_SEGMENTS + 1;
+	for (GLuint main = 0; main < TORUS_MAIN_SEGMENTS; main++)
+	{
+		for (GLuint tube = 0; tube < TORUS_TUBE_SEGMENTS; tube++)
+		{
+			GLuint v0 = main * rowLength + tube;
+			GLuint v1 = (main + 1) * rowLength + tube;
+			AppendTriangle(vertices, indices, v0, v1, v1 + 1);
+			AppendTriangle(vertices, indices, v0, v1 + 1, v0 + 1);
+		}
+	}
+
+	AddMesh(TORUS_MESH, vertices, indices);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting to queue the draws of a
+ *  new frame.  The buffer storage is orphaned so that the
+ *  writes never wait on draws from the previous frame.
+ ***********************************************************/
+void InstancedMeshes::BeginFrame()
+{
+	if (m_recordBuffer != 0)
+	{
+		glNamedBufferData(m_recordBuffer, m_recordCapacity * sizeof(INSTANCE_DATA), NULL, GL_STREAM_DRAW);
+		glNamedBufferData(m_commandBuffer, m_commandCapacity * sizeof(DRAW_COMMAND), NULL, GL_STREAM_DRAW);
+	}
+
+	m_records.clear();
+	m_commands.clear();
+	m_uploadedRecords = 0;
+	m_uploadedCommands = 0;
+}
+
+/***********************************************************
+ *  Draw*MeshInstanced()
+ *
+ *  These methods are used for drawing a batch of instances
+ *  of one of the meshes right away.
+ ***********************************************************/
+void InstancedMeshes::DrawPlaneMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	QueueDraw(PLANE_MESH, pInstances, instanceCount);
+	SubmitQueuedDraws();
+}
+
+void InstancedMeshes::DrawBoxMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	QueueDraw(BOX_MESH, pInstances, instanceCount);
+	SubmitQueuedDraws();
+}
+
+void InstancedMeshes::DrawCylinderMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	QueueDraw(CYLINDER_MESH, pInstances, instanceCount);
+	SubmitQueuedDraws();
+}
+
+void InstancedMeshes::DrawTorusMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	QueueDraw(TORUS_MESH, pInstances, instanceCount);
+	SubmitQueuedDraws();
+}
+
+/***********************************************************
+ *  QueueDraw()
+ *
+ *  This method is used for queueing a batch of instances of
+ *  a mesh.  The instances are appended to the draw records
+ *  and an indirect command is added whose base instance
+ *  points at the first of them.
+ ***********************************************************/
+void InstancedMeshes::QueueDraw(int meshIndex, const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	if ((meshIndex < 0) || (meshIndex >= MESH_COUNT) || (instanceCount <= 0))
+	{
+		return;
+	}
+
+	const MESH_RANGE& range = m_meshRanges[meshIndex];
+	if (range.indexCount == 0)
+	{
+		return;
+	}
+
+	DRAW_COMMAND command;
+	command.count = range.indexCount;
+	command.instanceCount = (GLuint)instanceCount;
+	command.firstIndex = range.firstIndex;
+	command.baseVertex = range.baseVertex;
+	command.baseInstance = (GLuint)m_records.size();
+
+	m_records.insert(m_records.end(), pInstances, pInstances + instanceCount);
+	m_commands.push_back(command);
+}
+
+/***********************************************************
+ *  SubmitQueuedDraws()
+ *
+ *  This method is used for uploading the queued draw records
+ *  and commands and drawing all of them with one call.
+ ***********************************************************/
+int InstancedMeshes::SubmitQueuedDraws()
+{
+	size_t firstCommand = m_uploadedCommands;
+	int commandCount = (int)(m_commands.size() - firstCommand);
+	if ((commandCount <= 0) || (m_vao == 0))
+	{
+		return(0);
+	}
+
+	UploadQueued();
+
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		(const void*)(firstCommand * sizeof(DRAW_COMMAND)),
+		commandCount, 0);
+	glBindVertexArray(0);
+
+	return(commandCount);
+}
+
+/***********************************************************
+ *  DrawQueuedRange()
+ *
+ *  This method is used for drawing a range of the commands
+ *  queued this frame.  Unlike SubmitQueuedDraws(), the range
+ *  is not marked as submitted, so a pass that only writes
+ *  depth can draw the same commands with the position stream
+ *  before they are shaded.
+ ***********************************************************/
+void InstancedMeshes::DrawQueuedRange(int firstCommand, int commandCount, bool bPositionsOnly)
+{
+	if ((firstCommand < 0) || (commandCount <= 0) ||
+		(firstCommand + commandCount > (int)m_commands.size()) || (m_vao == 0))
+	{
+		return;
+	}
+
+	UploadQueued();
+
+	glBindVertexArray((bPositionsOnly == true) ? m_positionVao : m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		(const void*)(firstCommand * sizeof(DRAW_COMMAND)),
+		commandCount, 0);
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  UploadQueued()
+ *
+ *  This method is used for copying the records and commands
+ *  queued since the last upload into the buffers.  When the
+ *  frame outgrows a buffer, it is reallocated and the whole
+ *  frame is copied again - the draws already issued keep
+ *  using the old storage.
+ ***********************************************************/
+void InstancedMeshes::UploadQueued()
+{
+	if (m_records.size() > m_recordCapacity)
+	{
+		while (m_recordCapacity < m_records.size())
+		{
+			m_recordCapacity *= 2;
+		}
+		glNamedBufferData(m_recordBuffer, m_recordCapacity * sizeof(INSTANCE_DATA), NULL, GL_STREAM_DRAW);
+		FillDrawIndexBuffer(m_drawIndexBuffer, m_recordCapacity);
+		m_uploadedRecords = 0;
+	}
+
+	if (m_commands.size() > m_commandCapacity)
+	{
+		while (m_commandCapacity < m_commands.size())
+		{
+			m_commandCapacity *= 2;
+		}
+		glNamedBufferData(m_commandBuffer, m_commandCapacity * sizeof(DRAW_COMMAND), NULL, GL_STREAM_DRAW);
+		m_uploadedCommands = 0;
+	}
+
+	if (m_records.size() > m_uploadedRecords)
+	{
+		glNamedBufferSubData(m_recordBuffer,
+			m_uploadedRecords * sizeof(INSTANCE_DATA),
+			(m_records.size() - m_uploadedRecords) * sizeof(INSTANCE_DATA),
+			&m_records[m_uploadedRecords]);
+		m_uploadedRecords = m_records.size();
+	}
+
+	if (m_commands.size() > m_uploadedCommands)
+	{
+		glNamedBufferSubData(m_commandBuffer,
+			m_uploadedCommands * sizeof(DRAW_COMMAND),
+			(m_commands.size() - m_uploadedCommands) * sizeof(DRAW_COMMAND),
+			&m_commands[m_uploadedCommands]);
+		m_uploadedCommands = m_commands.size();
+	}
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is used for appending a mesh to the shared
+ *  vertex and index data and uploading the shared buffers.
+ *  The meshes are only loaded at startup, so the whole data
+ *  is simply uploaded again each time.
+ ***********************************************************/
+void InstancedMeshes::AddMesh(
+	int meshIndex,
+	const std::vector<GLfloat>& vertices,
+	const std::vector<GLuint>& indices)
+{
+	if (m_vao == 0)
+	{
+		CreateBuffers();
+	}
+
+	MESH_RANGE& range = m_meshRanges[meshIndex];
+	range.firstIndex = (GLuint)m_indices.size();
+	range.indexCount = (GLuint)indices.size();
+	range.baseVertex = (GLint)(m_vertices.size() / FLOATS_PER_VERTEX);
+
+	// the position is the first three floats of a vertex
+	range.boundsMin = glm::vec3(0.0f);
+	range.boundsMax = glm::vec3(0.0f);
+	for (size_t i = 0; i < vertices.size(); i += FLOATS_PER_VERTEX)
+	{
+		glm::vec3 position = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]);
+		range.boundsMin = (i == 0) ? position : glm::min(range.boundsMin, position);
+		range.boundsMax = (i == 0) ? position : glm::max(range.boundsMax, position);
+	}
+
+	m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+	m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+	for (size_t i = 0; i < vertices.size(); i += FLOATS_PER_VERTEX)
+	{
+		m_positions.insert(m_positions.end(), &vertices[i], &vertices[i] + 3);
+	}
+
+	glNamedBufferData(m_vertexBuffer, m_vertices.size() * sizeof(GLfloat), m_vertices.data(), GL_STATIC_DRAW);
+	glNamedBufferData(m_positionBuffer, m_positions.size() * sizeof(GLfloat), m_positions.data(), GL_STATIC_DRAW);
+	glNamedBufferData(m_indexBuffer, m_indices.size() * sizeof(GLuint), m_indices.data(), GL_STATIC_DRAW);
+}
+
+/***********************************************************
+ *  GetMeshBounds()
+ *
+ *  This method is used for getting the center and half
+ *  extent of the bounding box of a mesh in its own space.
+ ***********************************************************/
+void InstancedMeshes::GetMeshBounds(int meshIndex, glm::vec3& center, glm::vec3& extent) const
+{
+	if ((meshIndex < 0) || (meshIndex >= MESH_COUNT))
+	{
+		center = glm::vec3(0.0f);
+		extent = glm::vec3(0.0f);
+		return;
+	}
+
+	const MESH_RANGE& range = m_meshRanges[meshIndex];
+	center = (range.boundsMin + range.boundsMax) * 0.5f;
+	extent = (range.boundsMax - range.boundsMin) * 0.5f;
+}
+
+/***********************************************************
+ *  IsMeshLoaded()
+ *
+ *  This method is used for checking whether a mesh has been
+ *  added to the shared buffers.
+ ***********************************************************/
+bool InstancedMeshes::IsMeshLoaded(int meshIndex) const
+{
+	if ((meshIndex < 0) || (meshIndex >= MESH_COUNT))
+	{
+		return(false);
+	}
+
+	return(m_meshRanges[meshIndex].indexCount > 0);
+}
+
+/***********************************************************
+ *  CreateBuffers()
+ *
+ *  This method is used for creating the shared vertex array
+ *  object and its buffers.  Location 3 is a per-instance
+ *  draw index that the vertex shader uses to read its draw
+ *  record - the base instance of each command offsets it.
+ *  The position stream has a vertex array of its own, with
+ *  the same index buffer and draw index.
+ ***********************************************************/
+void InstancedMeshes::CreateBuffers()
+{
+	glCreateVertexArrays(1, &m_vao);
+	glCreateVertexArrays(1, &m_positionVao);
+	glCreateBuffers(1, &m_vertexBuffer);
+	glCreateBuffers(1, &m_positionBuffer);
+	glCreateBuffers(1, &m_indexBuffer);
+	glCreateBuffers(1, &m_drawIndexBuffer);
+	glCreateBuffers(1, &m_recordBuffer);
+	glCreateBuffers(1, &m_commandBuffer);
+
+	glVertexArrayVertexBuffer(m_vao, VERTEX_BINDING, m_vertexBuffer, 0, FLOATS_PER_VERTEX * sizeof(GLfloat));
+	glVertexArrayElementBuffer(m_vao, m_indexBuffer);
+
+	// position, normal and texture coordinate
+	glEnableVertexArrayAttrib(m_vao, 0);
+	glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(m_vao, 0, VERTEX_BINDING);
+	glEnableVertexArrayAttrib(m_vao, 1);
+	glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat));
+	glVertexArrayAttribBinding(m_vao, 1, VERTEX_BINDING);
+	glEnableVertexArrayAttrib(m_vao, 2);
+	glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat));
+	glVertexArrayAttribBinding(m_vao, 2, VERTEX_BINDING);
+
+	// per-instance draw index
+	glVertexArrayVertexBuffer(m_vao, DRAW_INDEX_BINDING, m_drawIndexBuffer, 0, sizeof(GLuint));
+	glVertexArrayBindingDivisor(m_vao, DRAW_INDEX_BINDING, 1);
+	glEnableVertexArrayAttrib(m_vao, 3);
+	glVertexArrayAttribIFormat(m_vao, 3, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(m_vao, 3, DRAW_INDEX_BINDING);
+
+	// the positions alone, tightly packed
+	glVertexArrayVertexBuffer(m_positionVao, VERTEX_BINDING, m_positionBuffer, 0, 3 * sizeof(GLfloat));
+	glVertexArrayElementBuffer(m_positionVao, m_indexBuffer);
+	glEnableVertexArrayAttrib(m_positionVao, 0);
+	glVertexArrayAttribFormat(m_positionVao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(m_positionVao, 0, VERTEX_BINDING);
+	glVertexArrayVertexBuffer(m_positionVao, DRAW_INDEX_BINDING, m_drawIndexBuffer, 0, sizeof(GLuint));
+	glVertexArrayBindingDivisor(m_positionVao, DRAW_INDEX_BINDING, 1);
+	glEnableVertexArrayAttrib(m_positionVao, 3);
+	glVertexArrayAttribIFormat(m_positionVao, 3, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(m_positionVao, 3, DRAW_INDEX_BINDING);
+
+	m_recordCapacity = INITIAL_RECORD_CAPACITY;
+	m_commandCapacity = INITIAL_COMMAND_CAPACITY;
+	glNamedBufferData(m_recordBuffer, m_recordCapacity * sizeof(INSTANCE_DATA), NULL, GL_STREAM_DRAW);
+	glNamedBufferData(m_commandBuffer, m_commandCapacity * sizeof(DRAW_COMMAND), NULL, GL_STREAM_DRAW);
+	FillDrawIndexBuffer(m_drawIndexBuffer, m_recordCapacity);
+	m_records.reserve(INITIAL_RECORD_CAPACITY);
+	m_commands.reserve(INITIAL_COMMAND_CAPACITY);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_RECORD_BINDING, m_recordBuffer);
+}
+
+/***********************************************************
+ *  DestroyBuffers()
+ *
+ *  This method is used for freeing the vertex array object
+ *  and all of the buffers.
+ ***********************************************************/
+void InstancedMeshes::DestroyBuffers()
+{
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	if (m_positionVao != 0)
+	{
+		glDeleteVertexArrays(1, &m_positionVao);
+		m_positionVao = 0;
+	}
+
+	GLuint buffers[6] = { m_vertexBuffer, m_positionBuffer, m_indexBuffer, m_drawIndexBuffer, m_recordBuffer, m_commandBuffer };
+	for (int i = 0; i < 6; i++)
+	{
+		if (buffers[i] != 0)
+		{
+			glDeleteBuffers(1, &buffers[i]);
+		}
+	}
+	m_vertexBuffer = 0;
+	m_positionBuffer = 0;
+	m_indexBuffer = 0;
+	m_drawIndexBuffer = 0;
+	m_recordBuffer = 0;
+	m_commandBuffer = 0;
+}
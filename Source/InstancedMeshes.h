@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+// instancedmeshes.h
+// ============
+// basic shape meshes that are drawn many times with one draw command
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  InstancedMeshes
+ *
+ *  This class builds the same unit sized plane, box,
+ *  cylinder and torus as ShapeMeshes, packed into one shared
+ *  vertex and index buffer.  Draws are queued as indirect
+ *  draw commands with their per-draw values in a shader
+ *  storage buffer, so any number of objects can be submitted
+ *  with a single multi-draw-indirect command.  The positions
+ *  are also kept on their own in a second vertex stream, for
+ *  the passes that only write depth.
+ ***********************************************************/
+class InstancedMeshes
+{
+public:
+	// constructor
+	InstancedMeshes();
+	// destructor
+	~InstancedMeshes();
+
+	// the meshes in the shared buffers
+	enum MESH_INDEX
+	{
+		PLANE_MESH = 0,
+		BOX_MESH,
+		CYLINDER_MESH,
+		TORUS_MESH,
+		MESH_COUNT
+	};
+
+	// values for one drawn instance - the std430 layout must
+	// match the DrawRecord struct in the vertex shader
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 objectColor;
+		int materialIndex;
+		int textureIndex;
+		glm::vec2 UVscale;
+	};
+
+	// shader storage buffer binding of the draw records
+	static const GLuint DRAW_RECORD_BINDING = 0;
+
+	// load the meshes into the shared buffers
+	void LoadPlaneMesh();
+	void LoadBoxMesh();
+	void LoadCylinderMesh();
+	void LoadTorusMesh();
+
+	// draw a batch of instances of a mesh right away
+	void DrawPlaneMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount);
+	void DrawBoxMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount);
+	void DrawCylinderMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount);
+	void DrawTorusMeshInstanced(const INSTANCE_DATA* pInstances, int instanceCount);
+
+	// queue a batch of instances of a mesh as one indirect command
+	void QueueDraw(int meshIndex, const INSTANCE_DATA* pInstances, int instanceCount);
+	// submit every queued command with one multi-draw call,
+	// returning the number of commands submitted
+	int SubmitQueuedDraws();
+	// number of commands queued so far this frame
+	int GetQueuedCommandCount() const { return((int)m_commands.size()); }
+	// draw a range of the queued commands with one multi-draw
+	// call, reading only the positions when asked - a range
+	// can be drawn any number of times
+	void DrawQueuedRange(int firstCommand, int commandCount, bool bPositionsOnly);
+
+	// start queueing the draws of a new frame
+	void BeginFrame();
+
+	// get the local bounding box of a loaded mesh
+	void GetMeshBounds(int meshIndex, glm::vec3& center, glm::vec3& extent) const;
+	// whether a mesh has been loaded into the shared buffers
+	bool IsMeshLoaded(int meshIndex) const;
+
+private:
+	// where a mesh lives in the shared buffers
+	struct MESH_RANGE
+	{
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+		// local bounding box of the vertex positions
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// layout of glMultiDrawElementsIndirect commands
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// interleaved vertex and index data of all of the meshes,
+	// and the positions alone
+	std::vector<GLfloat> m_vertices;
+	std::vector<GLfloat> m_positions;
+	std::vector<GLuint> m_indices;
+	MESH_RANGE m_meshRanges[MESH_COUNT];
+
+	// shared vertex array and geometry buffers
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	// vertex array and buffer of the position stream
+	GLuint m_positionVao;
+	GLuint m_positionBuffer;
+	GLuint m_indexBuffer;
+	// per-instance draw index 0..n, offset by the base instance
+	GLuint m_drawIndexBuffer;
+	// per-draw values read by the vertex shader
+	GLuint m_recordBuffer;
+	// indirect draw commands
+	GLuint m_commandBuffer;
+
+	// draw records and commands of the current frame
+	std::vector<INSTANCE_DATA> m_records;
+	std::vector<DRAW_COMMAND> m_commands;
+	// how many of them are already in the buffers
+	size_t m_uploadedRecords;
+	size_t m_uploadedCommands;
+	// how many records and commands the buffers can hold
+	size_t m_recordCapacity;
+	size_t m_commandCapacity;
+
+	// create the vertex array and buffer objects
+	void CreateBuffers();
+	// add a mesh from the vertex and index lists to the shared data
+	void AddMesh(int meshIndex, const std::vector<GLfloat>& vertices, const std::vector<GLuint>& indices);
+	// upload the records and commands queued since the last upload
+	void UploadQueued();
+	// free the buffers
+	void DestroyBuffers();
+};
@@ -0,0 +1,561 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.cpp
+// ============
+// assign the point lights of a scene to clusters of the view volume
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusters.h"
+#include "Profiler.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// declaration of the global variables and defines
+namespace
+{
+	// lights tested together against a cluster
+	const int BATCH_SIZE = 4;
+	// fewer lights than this are assigned on the calling thread
+	const int PARALLEL_LIGHTS = 64;
+	// clusters in one depth slice
+	const int SLICE_CLUSTERS = LightClusters::GRID_X * LightClusters::GRID_Y;
+	// records the light and index buffers start with room for
+	const size_t INITIAL_LIGHT_CAPACITY = 64;
+	const size_t INITIAL_INDEX_CAPACITY = 4096;
+	// nearest view depth a slice may start at
+	const float MIN_NEAR_DEPTH = 0.001f;
+
+	/***********************************************************
+	 *  UnprojectPoint()
+	 *
+	 *  Get the view space point of a normalized device point.
+	 ***********************************************************/
+	glm::vec3 UnprojectPoint(const glm::mat4& inverseProjection, float x, float y, float z)
+	{
+		glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+		return(glm::vec3(point) / point.w);
+	}
+}
+
+/***********************************************************
+ *  LightClusters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusters::LightClusters()
+{
+	m_projection = glm::mat4(0.0f);
+	m_nearDepth = 1.0f;
+	m_farDepth = 1.0f;
+	m_sliceScale = 0.0f;
+	m_sliceBias = 0.0f;
+	m_width = 1;
+	m_height = 1;
+	m_stats = CLUSTER_STATS();
+	m_pendingRanges = 0;
+	m_lightBuffer = 0;
+	m_clusterBuffer = 0;
+	m_indexBuffer = 0;
+	m_lightCapacity = 0;
+	m_indexCapacity = 0;
+	m_bLightsDirty = true;
+	m_bClustersDirty = true;
+
+	// until the first Assign(), every cluster is empty
+	m_clusterCounts.resize(CLUSTER_COUNT, 0);
+	m_clusterRanges.resize(CLUSTER_COUNT * 2, 0);
+	m_header.gridSize = glm::uvec4(GRID_X, GRID_Y, GRID_Z, 0);
+	m_header.sliceParams = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+}
+
+/***********************************************************
+ *  ~LightClusters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusters::~LightClusters()
+{
+	DestroyBuffers();
+}
+
+/***********************************************************
+ *  CreateBuffers()
+ *
+ *  This method is used for creating the shader storage
+ *  buffers and binding each of them to the binding point
+ *  used by its block in the shader code.  The buffers are
+ *  never empty, so the blocks are valid with no lights.
+ ***********************************************************/
+void LightClusters::CreateBuffers()
+{
+	m_lightCapacity = std::max(INITIAL_LIGHT_CAPACITY, m_lights.size());
+	m_indexCapacity = std::max(INITIAL_INDEX_CAPACITY, m_lightIndices.size());
+
+	glCreateBuffers(1, &m_lightBuffer);
+	glCreateBuffers(1, &m_clusterBuffer);
+	glCreateBuffers(1, &m_indexBuffer);
+	glNamedBufferData(m_lightBuffer, m_lightCapacity * sizeof(POINT_LIGHT), NULL, GL_DYNAMIC_DRAW);
+	glNamedBufferData(m_clusterBuffer,
+		sizeof(CLUSTER_HEADER) + m_clusterRanges.size() * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+	glNamedBufferData(m_indexBuffer, m_indexCapacity * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BUFFER_BINDING, m_lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BUFFER_BINDING, m_clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BUFFER_BINDING, m_indexBuffer);
+
+	m_bLightsDirty = true;
+	m_bClustersDirty = true;
+	Upload();
+}
+
+/***********************************************************
+ *  DestroyBuffers()
+ *
+ *  This method is used for freeing the buffers.
+ ***********************************************************/
+void LightClusters::DestroyBuffers()
+{
+	GLuint* buffers[] = { &m_lightBuffer, &m_clusterBuffer, &m_indexBuffer };
+	for (int i = 0; i < 3; i++)
+	{
+		if (*buffers[i] != 0)
+		{
+			glDeleteBuffers(1, buffers[i]);
+			*buffers[i] = 0;
+		}
+	}
+	m_lightCapacity = 0;
+	m_indexCapacity = 0;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for replacing the point lights.  The
+ *  clusters keep listing the old lights until the next
+ *  Assign().
+ ***********************************************************/
+void LightClusters::SetLights(const POINT_LIGHT* pLights, int lightCount)
+{
+	m_lights.assign(pLights, pLights + lightCount);
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  BuildClusterBounds()
+ *
+ *  This method is used for building the view space box of
+ *  every cluster.  The corners of each screen tile are
+ *  unprojected onto the near and far planes, and the lines
+ *  between them are cut at the depths where a slice starts
+ *  and ends, which works for orthographic projections as
+ *  well as perspective ones.  The slices split the depth
+ *  range evenly in log space, so they are thin near the
+ *  camera and deep far from it.
+ ***********************************************************/
+void LightClusters::BuildClusterBounds(const glm::mat4& projection)
+{
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	m_nearDepth = std::max(-UnprojectPoint(inverseProjection, 0.0f, 0.0f, -1.0f).z, MIN_NEAR_DEPTH);
+	m_farDepth = std::max(-UnprojectPoint(inverseProjection, 0.0f, 0.0f, 1.0f).z, m_nearDepth * 2.0f);
+	float depthRatio = std::log(m_farDepth / m_nearDepth);
+	m_sliceScale = GRID_Z / depthRatio;
+	m_sliceBias = -GRID_Z * std::log(m_nearDepth) / depthRatio;
+
+	// the tile corners on the near and far planes
+	const int cornerColumns = GRID_X + 1;
+	std::vector<glm::vec3> nearCorners(cornerColumns * (GRID_Y + 1));
+	std::vector<glm::vec3> farCorners(cornerColumns * (GRID_Y + 1));
+	for (int y = 0; y <= GRID_Y; y++)
+	{
+		for (int x = 0; x <= GRID_X; x++)
+		{
+			float ndcX = -1.0f + 2.0f * x / GRID_X;
+			float ndcY = -1.0f + 2.0f * y / GRID_Y;
+			nearCorners[y * cornerColumns + x] = UnprojectPoint(inverseProjection, ndcX, ndcY, -1.0f);
+			farCorners[y * cornerColumns + x] = UnprojectPoint(inverseProjection, ndcX, ndcY, 1.0f);
+		}
+	}
+
+	m_minX.resize(CLUSTER_COUNT);
+	m_minY.resize(CLUSTER_COUNT);
+	m_minZ.resize(CLUSTER_COUNT);
+	m_maxX.resize(CLUSTER_COUNT);
+	m_maxY.resize(CLUSTER_COUNT);
+	m_maxZ.resize(CLUSTER_COUNT);
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		float sliceDepths[2] =
+		{
+			m_nearDepth * std::pow(m_farDepth / m_nearDepth, (float)z / GRID_Z),
+			m_nearDepth * std::pow(m_farDepth / m_nearDepth, (float)(z + 1) / GRID_Z)
+		};
+
+		for (int y = 0; y < GRID_Y; y++)
+		{
+			for (int x = 0; x < GRID_X; x++)
+			{
+				glm::vec3 boxMin(std::numeric_limits<float>::max());
+				glm::vec3 boxMax(-std::numeric_limits<float>::max());
+				for (int corner = 0; corner < 4; corner++)
+				{
+					int cornerIndex = (y + corner / 2) * cornerColumns + x + corner % 2;
+					const glm::vec3& nearCorner = nearCorners[cornerIndex];
+					const glm::vec3& farCorner = farCorners[cornerIndex];
+					for (int end = 0; end < 2; end++)
+					{
+						float t = (sliceDepths[end] + nearCorner.z) / (nearCorner.z - farCorner.z);
+						glm::vec3 point = nearCorner + (farCorner - nearCorner) * t;
+						boxMin = glm::min(boxMin, point);
+						boxMax = glm::max(boxMax, point);
+					}
+				}
+
+				int cluster = x + GRID_X * (y + GRID_Y * z);
+				m_minX[cluster] = boxMin.x;
+				m_minY[cluster] = boxMin.y;
+				m_minZ[cluster] = boxMin.z;
+				m_maxX[cluster] = boxMax.x;
+				m_maxY[cluster] = boxMax.y;
+				m_maxZ[cluster] = boxMax.z;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  GetSlice()
+ *
+ *  This method is used for getting the slice a view depth
+ *  is in.  Depths outside of the slices are clamped to the
+ *  nearest and farthest one.
+ ***********************************************************/
+int LightClusters::GetSlice(float depth) const
+{
+	if (depth <= m_nearDepth)
+	{
+		return(0);
+	}
+
+	int slice = (int)std::floor(std::log(depth) * m_sliceScale + m_sliceBias);
+	return(std::min(std::max(slice, 0), GRID_Z - 1));
+}
+
+/***********************************************************
+ *  Assign()
+ *
+ *  This method is used for listing the lights that reach
+ *  each cluster.  The cluster boxes are only built again
+ *  when the projection changes.  Each light's sphere is
+ *  moved into view space and given the range of slices its
+ *  depth covers, then each slice tests its lights against
+ *  its clusters, and the lists of the slices are joined
+ *  into one index list in cluster order.
+ ***********************************************************/
+void LightClusters::Assign(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	int width,
+	int height,
+	WorkerPool* pWorkerPool)
+{
+	ProfileScope scope("AssignLightClusters");
+
+	if ((m_minX.empty() == true) || (projection != m_projection))
+	{
+		BuildClusterBounds(projection);
+		m_projection = projection;
+	}
+	m_width = std::max(width, 1);
+	m_height = std::max(height, 1);
+
+	int lightCount = (int)m_lights.size();
+	m_viewLights.resize(lightCount);
+	m_firstSlices.resize(lightCount);
+	m_lastSlices.resize(lightCount);
+	for (int i = 0; i < lightCount; i++)
+	{
+		const glm::vec4& positionRadius = m_lights[i].positionRadius;
+		glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(positionRadius), 1.0f));
+		float radius = positionRadius.w;
+		m_viewLights[i] = glm::vec4(center, radius);
+
+		float depth = -center.z;
+		if ((depth + radius < m_nearDepth) || (depth - radius > m_farDepth))
+		{
+			m_firstSlices[i] = -1;
+			m_lastSlices[i] = -1;
+			continue;
+		}
+		m_firstSlices[i] = GetSlice(depth - radius);
+		m_lastSlices[i] = GetSlice(depth + radius);
+	}
+
+	if ((pWorkerPool == NULL) || (pWorkerPool->GetThreadCount() == 0) || (lightCount < PARALLEL_LIGHTS))
+	{
+		AssignSlices(0, GRID_Z);
+	}
+	else
+	{
+		int rangeCount = std::min(pWorkerPool->GetThreadCount() + 1, (int)GRID_Z);
+		int rangeSize = (GRID_Z + rangeCount - 1) / rangeCount;
+		rangeCount = (GRID_Z + rangeSize - 1) / rangeSize;
+
+		{
+			std::lock_guard<std::mutex> lock(m_sliceMutex);
+			m_pendingRanges += rangeCount - 1;
+		}
+		for (int range = 1; range < rangeCount; range++)
+		{
+			int rangeFirst = range * rangeSize;
+			int rangeLast = std::min(rangeFirst + rangeSize, (int)GRID_Z);
+			pWorkerPool->Submit([this, rangeFirst, rangeLast]() {
+				AssignSlices(rangeFirst, rangeLast);
+
+				std::lock_guard<std::mutex> lock(m_sliceMutex);
+				m_pendingRanges--;
+				if (m_pendingRanges == 0)
+				{
+					m_slicesDone.notify_all();
+				}
+			});
+		}
+
+		// assign the first range here while the others run
+		AssignSlices(0, std::min(rangeSize, (int)GRID_Z));
+
+		std::unique_lock<std::mutex> lock(m_sliceMutex);
+		m_slicesDone.wait(lock, [this]() { return(m_pendingRanges == 0); });
+	}
+
+	// join the lists of the slices
+	m_lightIndices.clear();
+	m_stats = CLUSTER_STATS();
+	m_stats.lights = lightCount;
+	uint32_t offset = 0;
+	for (int slice = 0; slice < GRID_Z; slice++)
+	{
+		for (int cluster = slice * SLICE_CLUSTERS; cluster < (slice + 1) * SLICE_CLUSTERS; cluster++)
+		{
+			uint32_t count = m_clusterCounts[cluster];
+			m_clusterRanges[cluster * 2] = offset;
+			m_clusterRanges[cluster * 2 + 1] = count;
+			offset += count;
+			if (count > 0)
+			{
+				m_stats.occupiedClusters++;
+				m_stats.maxClusterLights = std::max(m_stats.maxClusterLights, (int)count);
+			}
+		}
+		m_lightIndices.insert(m_lightIndices.end(), m_slices[slice].indices.begin(), m_slices[slice].indices.end());
+	}
+	m_stats.references = (int)m_lightIndices.size();
+
+	m_header.gridSize = glm::uvec4(GRID_X, GRID_Y, GRID_Z, (unsigned int)lightCount);
+	m_header.sliceParams = glm::vec4((float)m_width, (float)m_height, m_sliceScale, m_sliceBias);
+	m_bClustersDirty = true;
+}
+
+/***********************************************************
+ *  AssignSlices()
+ *
+ *  This method is used for listing the lights of the
+ *  clusters of a range of slices.  Only the lists and
+ *  counts of the range are written.
+ ***********************************************************/
+void LightClusters::AssignSlices(int firstSlice, int lastSlice)
+{
+	for (int slice = firstSlice; slice < lastSlice; slice++)
+	{
+		AssignSlice(slice);
+	}
+}
+
+/***********************************************************
+ *  AssignSlice()
+ *
+ *  This method is used for listing the lights of the
+ *  clusters of one slice.  The lights whose depth reaches
+ *  the slice are gathered into separate arrays of centers
+ *  and squared radii, then each cluster's box is tested
+ *  against four spheres at a time - the distance from a
+ *  sphere's center to the box is compared with its radius.
+ ***********************************************************/
+void LightClusters::AssignSlice(int slice)
+{
+	SLICE_WORK& work = m_slices[slice];
+	work.candidates.clear();
+	work.lightX.clear();
+	work.lightY.clear();
+	work.lightZ.clear();
+	work.radiusSquared.clear();
+	work.indices.clear();
+
+	for (size_t i = 0; i < m_viewLights.size(); i++)
+	{
+		if ((m_firstSlices[i] <= slice) && (slice <= m_lastSlices[i]))
+		{
+			work.candidates.push_back((uint32_t)i);
+			work.lightX.push_back(m_viewLights[i].x);
+			work.lightY.push_back(m_viewLights[i].y);
+			work.lightZ.push_back(m_viewLights[i].z);
+			work.radiusSquared.push_back(m_viewLights[i].w * m_viewLights[i].w);
+		}
+	}
+
+	// the padding never reaches a cluster
+	int candidateCount = (int)work.candidates.size();
+	while (work.lightX.size() % BATCH_SIZE != 0)
+	{
+		work.lightX.push_back(0.0f);
+		work.lightY.push_back(0.0f);
+		work.lightZ.push_back(0.0f);
+		work.radiusSquared.push_back(-1.0f);
+	}
+
+	int firstCluster = slice * SLICE_CLUSTERS;
+	if (candidateCount == 0)
+	{
+		std::fill(m_clusterCounts.begin() + firstCluster, m_clusterCounts.begin() + firstCluster + SLICE_CLUSTERS, 0u);
+		return;
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (int cluster = firstCluster; cluster < firstCluster + SLICE_CLUSTERS; cluster++)
+	{
+		__m128 minX = _mm_set1_ps(m_minX[cluster]);
+		__m128 minY = _mm_set1_ps(m_minY[cluster]);
+		__m128 minZ = _mm_set1_ps(m_minZ[cluster]);
+		__m128 maxX = _mm_set1_ps(m_maxX[cluster]);
+		__m128 maxY = _mm_set1_ps(m_maxY[cluster]);
+		__m128 maxZ = _mm_set1_ps(m_maxZ[cluster]);
+
+		size_t firstIndex = work.indices.size();
+		for (int first = 0; first < candidateCount; first += BATCH_SIZE)
+		{
+			__m128 centerX = _mm_loadu_ps(&work.lightX[first]);
+			__m128 centerY = _mm_loadu_ps(&work.lightY[first]);
+			__m128 centerZ = _mm_loadu_ps(&work.lightZ[first]);
+
+			// distance outside of the box along each axis
+			__m128 distanceX = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, centerX), _mm_sub_ps(centerX, maxX)), zero);
+			__m128 distanceY = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, centerY), _mm_sub_ps(centerY, maxY)), zero);
+			__m128 distanceZ = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, centerZ), _mm_sub_ps(centerZ, maxZ)), zero);
+			__m128 distanceSquared = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(distanceX, distanceX), _mm_mul_ps(distanceY, distanceY)),
+				_mm_mul_ps(distanceZ, distanceZ));
+
+			int insideMask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_loadu_ps(&work.radiusSquared[first])));
+			for (int lane = 0; lane < BATCH_SIZE; lane++)
+			{
+				if (((insideMask >> lane) & 1) != 0)
+				{
+					work.indices.push_back(work.candidates[first + lane]);
+				}
+			}
+		}
+		m_clusterCounts[cluster] = (uint32_t)(work.indices.size() - firstIndex);
+	}
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for copying the lights and the
+ *  cluster lists into their buffers when they changed.  A
+ *  buffer that is too small is reallocated to twice the
+ *  size it needs.
+ ***********************************************************/
+void LightClusters::Upload()
+{
+	if (m_lightBuffer == 0)
+	{
+		return;
+	}
+
+	if (m_bLightsDirty == true)
+	{
+		if (m_lights.size() > m_lightCapacity)
+		{
+			m_lightCapacity = m_lights.size() * 2;
+			glNamedBufferData(m_lightBuffer, m_lightCapacity * sizeof(POINT_LIGHT), NULL, GL_DYNAMIC_DRAW);
+		}
+		if (m_lights.empty() == false)
+		{
+			glNamedBufferSubData(m_lightBuffer, 0, m_lights.size() * sizeof(POINT_LIGHT), m_lights.data());
+		}
+		m_bLightsDirty = false;
+	}
+
+	if (m_bClustersDirty == true)
+	{
+		glNamedBufferSubData(m_clusterBuffer, 0, sizeof(CLUSTER_HEADER), &m_header);
+		glNamedBufferSubData(m_clusterBuffer, sizeof(CLUSTER_HEADER),
+			m_clusterRanges.size() * sizeof(uint32_t), m_clusterRanges.data());
+
+		if (m_lightIndices.size() > m_indexCapacity)
+		{
+			m_indexCapacity = m_lightIndices.size() * 2;
+			glNamedBufferData(m_indexBuffer, m_indexCapacity * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+		}
+		if (m_lightIndices.empty() == false)
+		{
+			glNamedBufferSubData(m_indexBuffer, 0, m_lightIndices.size() * sizeof(uint32_t), m_lightIndices.data());
+		}
+		m_bClustersDirty = false;
+	}
+}
+
+/***********************************************************
+ *  GetClusterIndex()
+ *
+ *  This method is used for getting the cluster that holds a
+ *  view space position - the tile it projects into and the
+ *  slice of its depth, as the fragment shader finds it.
+ ***********************************************************/
+int LightClusters::GetClusterIndex(const glm::vec3& viewPosition) const
+{
+	if (m_minX.empty() == true)
+	{
+		return(-1);
+	}
+
+	glm::vec4 clip = m_projection * glm::vec4(viewPosition, 1.0f);
+	float depth = -viewPosition.z;
+	if ((clip.w <= 0.0f) || (depth < m_nearDepth) || (depth > m_farDepth))
+	{
+		return(-1);
+	}
+
+	glm::vec2 ndc = glm::vec2(clip) / clip.w;
+	if ((std::fabs(ndc.x) > 1.0f) || (std::fabs(ndc.y) > 1.0f))
+	{
+		return(-1);
+	}
+
+	int x = std::min((int)((ndc.x * 0.5f + 0.5f) * GRID_X), GRID_X - 1);
+	int y = std::min((int)((ndc.y * 0.5f + 0.5f) * GRID_Y), GRID_Y - 1);
+	return(x + GRID_X * (y + GRID_Y * GetSlice(depth)));
+}
+
+/***********************************************************
+ *  GetClusterLights()
+ *
+ *  This method is used for getting the light indices of a
+ *  cluster from the last Assign().
+ ***********************************************************/
+const uint32_t* LightClusters::GetClusterLights(int clusterIndex, int& lightCount) const
+{
+	lightCount = 0;
+	if ((clusterIndex < 0) || (clusterIndex >= CLUSTER_COUNT) || (m_lightIndices.empty() == true))
+	{
+		return(NULL);
+	}
+
+	lightCount = (int)m_clusterRanges[clusterIndex * 2 + 1];
+	return(m_lightIndices.data() + m_clusterRanges[clusterIndex * 2]);
+}
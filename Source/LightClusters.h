@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.h
+// ============
+// assign the point lights of a scene to clusters of the view volume
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/***********************************************************
+ *  LightClusters
+ *
+ *  This class splits the view volume into a grid of
+ *  clusters - screen tiles that are cut into slices by
+ *  depth, with the slices growing with distance - and lists
+ *  the point lights that reach each cluster.  The lights,
+ *  the offset and count of each cluster's lights and the
+ *  list of light indices are kept in shader storage buffers,
+ *  so a fragment only shades the lights of its own cluster.
+ *  The lights are assigned on the CPU a slice at a time,
+ *  with the slices split between the worker threads and
+ *  each light tested against four clusters with SSE.
+ ***********************************************************/
+class LightClusters
+{
+public:
+	// constructor
+	LightClusters();
+	// destructor
+	~LightClusters();
+
+	// size of the cluster grid - the shader reads it from
+	// the cluster buffer
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+	// shader storage binding points of the buffers - binding
+	// zero holds the draw records of InstancedMeshes
+	enum BUFFER_BINDING
+	{
+		LIGHT_BUFFER_BINDING = 1,
+		CLUSTER_BUFFER_BINDING = 2,
+		INDEX_BUFFER_BINDING = 3
+	};
+
+	// std430 layout of one point light - the world position
+	// with the radius in w, the diffuse color with the focal
+	// strength in w and the specular color with the specular
+	// intensity in w
+	struct POINT_LIGHT
+	{
+		glm::vec4 positionRadius;
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+	};
+
+	// std430 layout of the start of the cluster buffer - the
+	// grid size with the light count in w, and the viewport
+	// size with the scale and bias that turn the log of a
+	// view depth into a slice.  The offset and count of the
+	// lights of each cluster follow it.
+	struct CLUSTER_HEADER
+	{
+		glm::uvec4 gridSize;
+		glm::vec4 sliceParams;
+	};
+
+	// counts of the last Assign()
+	struct CLUSTER_STATS
+	{
+		int lights;
+		int references;
+		int occupiedClusters;
+		int maxClusterLights;
+	};
+
+	// create the buffers and attach them to their binding points
+	void CreateBuffers();
+	// free the buffers
+	void DestroyBuffers();
+
+	// replace the point lights
+	void SetLights(const POINT_LIGHT* pLights, int lightCount);
+	int GetLightCount() const { return((int)m_lights.size()); }
+	const POINT_LIGHT* GetLights() const { return(m_lights.data()); }
+
+	// list the lights reaching each cluster for a camera and
+	// viewport, on the pool's threads when one is given
+	void Assign(const glm::mat4& view, const glm::mat4& projection, int width, int height, WorkerPool* pWorkerPool);
+	// upload the lights and the clusters that changed since
+	// the last upload
+	void Upload();
+
+	// get the cluster a view space position is in, the same
+	// way the fragment shader does, or -1 outside of the grid
+	int GetClusterIndex(const glm::vec3& viewPosition) const;
+	// get the indices of the lights of a cluster
+	const uint32_t* GetClusterLights(int clusterIndex, int& lightCount) const;
+	const CLUSTER_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// the lights set by SetLights()
+	std::vector<POINT_LIGHT> m_lights;
+	// the projection the cluster bounds were built for
+	glm::mat4 m_projection;
+	// view depths of the nearest and farthest slice, and how
+	// the log of a depth maps to a slice
+	float m_nearDepth;
+	float m_farDepth;
+	float m_sliceScale;
+	float m_sliceBias;
+	int m_width;
+	int m_height;
+
+	// view space bounds of each cluster, one array per component
+	std::vector<float> m_minX;
+	std::vector<float> m_minY;
+	std::vector<float> m_minZ;
+	std::vector<float> m_maxX;
+	std::vector<float> m_maxY;
+	std::vector<float> m_maxZ;
+
+	// view space centers of the lights, the first and last
+	// slice each one reaches, or -1 when it is out of view
+	std::vector<glm::vec4> m_viewLights;
+	std::vector<int> m_firstSlices;
+	std::vector<int> m_lastSlices;
+
+	// the lights reaching one slice, one array per component
+	// padded to a whole number of vectors, and the light
+	// indices of its clusters in cluster order
+	struct SLICE_WORK
+	{
+		std::vector<uint32_t> candidates;
+		std::vector<float> lightX;
+		std::vector<float> lightY;
+		std::vector<float> lightZ;
+		std::vector<float> radiusSquared;
+		std::vector<uint32_t> indices;
+	};
+	SLICE_WORK m_slices[GRID_Z];
+
+	// light count of each cluster, then the offset and count
+	// of each cluster in the index list as they are uploaded
+	std::vector<uint32_t> m_clusterCounts;
+	CLUSTER_HEADER m_header;
+	std::vector<uint32_t> m_clusterRanges;
+	std::vector<uint32_t> m_lightIndices;
+	CLUSTER_STATS m_stats;
+
+	// slice ranges still being assigned on the worker threads
+	std::mutex m_sliceMutex;
+	std::condition_variable m_slicesDone;
+	int m_pendingRanges;
+
+	// the buffers, and the records each one has room for
+	GLuint m_lightBuffer;
+	GLuint m_clusterBuffer;
+	GLuint m_indexBuffer;
+	size_t m_lightCapacity;
+	size_t m_indexCapacity;
+	bool m_bLightsDirty;
+	bool m_bClustersDirty;
+
+	// build the view space bounds of the clusters for a projection
+	void BuildClusterBounds(const glm::mat4& projection);
+	// get the slice a view depth is in
+	int GetSlice(float depth) const;
+	// list the lights of the clusters of a range of slices
+	void AssignSlices(int firstSlice, int lastSlice);
+	void AssignSlice(int slice);
+};
@@ -7,8 +7,15 @@
 //	Created for CS-330-Computational Graphics and Visualization, Nov. 1st, 2023
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>        // std::sort
+#include <cmath>            // ceil
 #include <iostream>         // error handling and output
+#include <chrono>           // reload timing
+#include <cstdio>           // sscanf
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <string>           // std::string
+#include <vector>           // std::vector
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -22,6 +29,17 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "UniformCache.h"
+#include "UniformBuffers.h"
+#include "WorkerPool.h"
+#include "TextureCache.h"
+#include "FileWatcher.h"
+#include "ProgramCache.h"
+#include "OffscreenTarget.h"
+#include "FrameCapture.h"
+#include "Benchmarks.h"
+#include "CameraPath.h"
+#include "Profiler.h"
 
 // Namespace for declaring global variables
 namespace
@@ -29,6 +47,10 @@ namespace
 	// Macro for window title
 	const char* const WINDOW_TITLE = "7-1 FinalProject and Milestones"; 
 
+	// GLSL files of the shader program
+	const char* const VERTEX_SHADER_FILE = "shaders/vertexShader.glsl";
+	const char* const FRAGMENT_SHADER_FILE = "shaders/fragmentShader.glsl";
+
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
 
@@ -36,14 +58,97 @@ namespace
 	SceneManager* g_SceneManager = nullptr;
 	// shader manager object for dynamic interaction with the shader code
 	ShaderManager* g_ShaderManager = nullptr;
+	// resolved shader uniform handles for the per-frame updates
+	UniformCache* g_UniformCache = nullptr;
+	// uniform buffer blocks shared by the shaders
+	UniformBuffers* g_UniformBuffers = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// worker threads for the jobs that run off of the rendering thread
+	WorkerPool* g_WorkerPool = nullptr;
+	// reports the edited shader, scene and texture files
+	FileWatcher* g_FileWatcher = nullptr;
+	// linked shader programs kept on disk between launches
+	ProgramCache* g_ProgramCache = nullptr;
+	// reads the shown frames back and writes them out
+	FrameCapture* g_FrameCapture = nullptr;
+
+	// block compression of the cooked textures
+	bool g_bCompressTextures = true;
+	BlockCompressor::QUALITY g_TextureQuality = BlockCompressor::QUALITY_NORMAL;
+
+	// the scene description to load
+	std::string g_SceneFilename = "scenes/desk.scene";
+
+	// frames rendered with no display - their size, how many
+	// are rendered, where they are written, and the circle the
+	// camera turns on around the middle of the scene
+	struct HEADLESS_SETTINGS
+	{
+		bool bHeadless;
+		bool bEGLContext;
+		int width;
+		int height;
+		int frameCount;
+		std::string outputPrefix;
+		float orbitRadius;
+		float orbitHeight;
+	};
+	HEADLESS_SETTINGS g_Headless = { false, false, 1280, 720, 1, "frame", 10.0f, 5.0f };
+
+	// where the shown frames are captured to, when they are,
+	// and what the captured frames are written as
+	std::string g_CapturePrefix;
+	FrameCapture::CAPTURE_FORMAT g_CaptureFormat = FrameCapture::CAPTURE_PPM;
+
+	// the camera path recorded from the keyboard and mouse, or
+	// played back at a fixed step to time the frames along it,
+	// and how many times it is played
+	struct PATH_SETTINGS
+	{
+		std::string recordFilename;
+		std::string playFilename;
+		float timeStep;
+		int runs;
+	};
+	PATH_SETTINGS g_PathSettings = { "", "", 1.0f / 60.0f, 3 };
+	// seconds between the keyframes of a recorded path
+	const float RECORD_INTERVAL = 0.5f;
+
+	// the path being recorded or played, and where it is - the
+	// time recording started or the frame and run played, and
+	// the time of each frame of the run
+	struct PATH_STATE
+	{
+		CameraPath* pPath;
+		float recordStart;
+		float lastKeyframe;
+		int frame;
+		int run;
+		std::vector<double> frameMilliseconds;
+	};
+	PATH_STATE g_Path = { nullptr, 0.0f, 0.0f, 0, 0, std::vector<double>() };
+
+	// where the trace of the timed scopes is written, when the
+	// profiler is on
+	std::string g_TraceFilename;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
-bool InitializeGLFW();
+bool InitializeGLFW(bool bHeadless, bool bEGLContext);
 bool InitializeGLEW();
+bool ParseTextureQuality(const char* name);
+int CookTextures(const std::vector<std::string>& filenames);
+void WatchSourceFiles();
+void ReloadChangedFiles();
+bool ReloadShaders();
+int RenderHeadless();
+bool StartCameraPath();
+void MoveAlongCameraPath();
+void EndPathFrame(double frameMilliseconds);
+void StopCameraPath();
+void WriteTraceOnRequest();
 
 
 /***********************************************************
@@ -54,20 +159,223 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// every argument after --cook-textures is an image to cook
+	bool bCookTextures = false;
+	std::vector<std::string> cookFilenames;
+	bool bBenchCulling = false;
+	bool bBenchGraph = false;
+	bool bBenchShaders = false;
+	bool bBenchLights = false;
+	bool bDeferred = false;
+	bool bDepthPrepass = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--texture-quality") == 0) && (i + 1 < argc))
+		{
+			if (ParseTextureQuality(argv[++i]) == false)
+			{
+				std::cerr << "Unknown texture quality " << argv[i] << ", use uncompressed, fast, normal or high" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--scene") == 0) && (i + 1 < argc))
+		{
+			g_SceneFilename = argv[++i];
+		}
+		else if (strcmp(argv[i], "--cook-textures") == 0)
+		{
+			bCookTextures = true;
+		}
+		else if (strcmp(argv[i], "--bench-culling") == 0)
+		{
+			bBenchCulling = true;
+		}
+		else if (strcmp(argv[i], "--bench-graph") == 0)
+		{
+			bBenchGraph = true;
+		}
+		else if (strcmp(argv[i], "--bench-shaders") == 0)
+		{
+			bBenchShaders = true;
+		}
+		else if (strcmp(argv[i], "--bench-lights") == 0)
+		{
+			bBenchLights = true;
+		}
+		else if (strcmp(argv[i], "--deferred") == 0)
+		{
+			bDeferred = true;
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			bDepthPrepass = true;
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			g_Headless.bHeadless = true;
+		}
+		else if ((strcmp(argv[i], "--context") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if ((strcmp(argv[i], "egl") != 0) && (strcmp(argv[i], "osmesa") != 0))
+			{
+				std::cerr << "Unknown context " << argv[i] << ", use egl or osmesa" << std::endl;
+				return(EXIT_FAILURE);
+			}
+			g_Headless.bEGLContext = (strcmp(argv[i], "egl") == 0);
+		}
+		else if ((strcmp(argv[i], "--size") == 0) && (i + 1 < argc))
+		{
+			if ((sscanf(argv[++i], "%dx%d", &g_Headless.width, &g_Headless.height) != 2) ||
+				(g_Headless.width <= 0) || (g_Headless.height <= 0))
+			{
+				std::cerr << "Unknown frame size " << argv[i] << ", use <width>x<height>" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc))
+		{
+			g_Headless.frameCount = atoi(argv[++i]);
+			if (g_Headless.frameCount <= 0)
+			{
+				std::cerr << "The number of frames must be at least one" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--output") == 0) && (i + 1 < argc))
+		{
+			g_Headless.outputPrefix = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--capture") == 0) && (i + 1 < argc))
+		{
+			g_CapturePrefix = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--capture-format") == 0) && (i + 1 < argc))
+		{
+			if (FrameCapture::ParseFormat(argv[++i], g_CaptureFormat) == false)
+			{
+				std::cerr << "Unknown capture format " << argv[i] << ", use ppm, png, y4m or raw" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--record-path") == 0) && (i + 1 < argc))
+		{
+			g_PathSettings.recordFilename = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--play-path") == 0) && (i + 1 < argc))
+		{
+			g_PathSettings.playFilename = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--path-step") == 0) && (i + 1 < argc))
+		{
+			g_PathSettings.timeStep = (float)atof(argv[++i]);
+			if (g_PathSettings.timeStep <= 0.0f)
+			{
+				std::cerr << "The path step must be more than zero seconds" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--path-runs") == 0) && (i + 1 < argc))
+		{
+			g_PathSettings.runs = atoi(argv[++i]);
+			if (g_PathSettings.runs <= 0)
+			{
+				std::cerr << "The number of path runs must be at least one" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--profile") == 0) && (i + 1 < argc))
+		{
+			g_TraceFilename = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--orbit") == 0) && (i + 2 < argc))
+		{
+			g_Headless.orbitRadius = (float)atof(argv[++i]);
+			g_Headless.orbitHeight = (float)atof(argv[++i]);
+		}
+		else if (bCookTextures == true)
+		{
+			cookFilenames.push_back(argv[i]);
+		}
+	}
+
+	// frames streamed to the standard output need it from the
+	// start, before anything is logged to it
+	std::string capturePrefix = (g_Headless.bHeadless == true) ? g_Headless.outputPrefix : g_CapturePrefix;
+	if ((capturePrefix == "-") && (FrameCapture::TakeStandardOutput() == false))
+	{
+		std::cerr << "Could not take over the standard output for the frames" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	// time the scopes of every thread from the start, so the
+	// loading of the scene is in the trace
+	Profiler::SetThreadName("main");
+	if (g_TraceFilename.empty() == false)
+	{
+		Profiler::SetEnabled(true);
+	}
+
+	// cooking the textures ahead of time needs no window
+	if (bCookTextures == true)
+	{
+		return(CookTextures(cookFilenames));
+	}
+
+	// the benchmarks run on generated scenes with no window
+	if ((bBenchCulling == true) || (bBenchGraph == true) || (bBenchLights == true))
+	{
+		WorkerPool workerPool;
+		int result = EXIT_SUCCESS;
+		if ((bBenchCulling == true) && (BenchmarkCulling(&workerPool) != EXIT_SUCCESS))
+		{
+			result = EXIT_FAILURE;
+		}
+		if ((bBenchGraph == true) && (BenchmarkSceneGraph(&workerPool) != EXIT_SUCCESS))
+		{
+			result = EXIT_FAILURE;
+		}
+		if ((bBenchLights == true) && (BenchmarkLights(&workerPool) != EXIT_SUCCESS))
+		{
+			result = EXIT_FAILURE;
+		}
+		return(result);
+	}
+
 	// if GLFW fails initialization, then terminate the application
-	if (InitializeGLFW() == false)
+	if (InitializeGLFW(g_Headless.bHeadless, g_Headless.bEGLContext) == false)
 	{
 		return(EXIT_FAILURE);
 	}
 
+	// start the worker threads first so loading can use them
+	g_WorkerPool = new WorkerPool();
 	// try to create a new shader manager object
 	g_ShaderManager = new ShaderManager();
+	// create the uniform cache - it is built after the shaders load
+	g_UniformCache = new UniformCache();
+	// create the uniform buffers - the buffer objects are created
+	// after OpenGL has been initialized
+	g_UniformBuffers = new UniformBuffers();
 	// try to create a new view manager object
 	g_ViewManager = new ViewManager(
-		g_ShaderManager);
+		g_ShaderManager,
+		g_UniformBuffers);
 
-	// try to create the main display window
-	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	// try to create the main display window, or only a context
+	// for rendering with no display
+	if (g_Headless.bHeadless == true)
+	{
+		g_Window = g_ViewManager->CreateHeadlessWindow(WINDOW_TITLE, g_Headless.width, g_Headless.height);
+	}
+	else
+	{
+		g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	}
+	if (g_Window == NULL)
+	{
+		return(EXIT_FAILURE);
+	}
 
 	// if GLEW fails initialization, then terminate the application
 	if (InitializeGLEW() == false)
@@ -75,20 +383,116 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"shaders/vertexShader.glsl",
-		"shaders/fragmentShader.glsl");
+	g_ProgramCache = new ProgramCache();
+
+	// the shader benchmark draws into its own target, so it
+	// only needs the context of the window
+	if (bBenchShaders == true)
+	{
+		return(BenchmarkShaderVariants(g_ProgramCache, VERTEX_SHADER_FILE, FRAGMENT_SHADER_FILE));
+	}
+
+	// build the shader program from the external GLSL files,
+	// or load it from the binary saved by an earlier launch
+	g_ShaderManager->m_programID = g_ProgramCache->LoadProgram(
+		VERTEX_SHADER_FILE,
+		FRAGMENT_SHADER_FILE);
+	if (g_ShaderManager->m_programID == 0)
+	{
+		return(EXIT_FAILURE);
+	}
 	g_ShaderManager->use();
 
+	// resolve all of the active uniforms from the bound program
+	g_UniformCache->Build();
+	// create the uniform buffer objects for the shader blocks
+	g_UniformBuffers->CreateBuffers();
+
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(
+		g_ShaderManager,
+		g_UniformCache,
+		g_UniformBuffers,
+		g_WorkerPool);
+	g_SceneManager->SetTextureCompression(g_bCompressTextures, g_TextureQuality);
+	g_SceneManager->SetSceneFile(g_SceneFilename);
+	g_SceneManager->SetShaderSources(g_ProgramCache, VERTEX_SHADER_FILE, FRAGMENT_SHADER_FILE);
 	g_SceneManager->PrepareScene();
+	if (bDeferred == true)
+	{
+		g_SceneManager->SetRenderMode(SceneManager::DEFERRED_RENDERING);
+	}
+	g_SceneManager->SetDepthPrepass(bDepthPrepass);
+
+	// load the camera path to play, or start one to record
+	if (StartCameraPath() == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// with no display the frames are rendered and written out,
+	// and the interactive loop is skipped
+	int result = EXIT_SUCCESS;
+	if (g_Headless.bHeadless == true)
+	{
+		result = RenderHeadless();
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+	else
+	{
+		// watch the files the shaders and the scene were loaded
+		// from, so they can be edited while the scene is shown
+		g_FileWatcher = new FileWatcher();
+		WatchSourceFiles();
+
+		// capture the frames at the size of the window when the
+		// capture started
+		if (g_CapturePrefix.empty() == false)
+		{
+			int width = 0;
+			int height = 0;
+			glfwGetFramebufferSize(g_Window, &width, &height);
+			g_FrameCapture = new FrameCapture();
+			if (g_FrameCapture->Start(width, height, g_CaptureFormat, g_CapturePrefix, g_WorkerPool) == false)
+			{
+				return(EXIT_FAILURE);
+			}
+		}
+	}
+
+	// the number of uniform name lookups and buffer uploads last reported
+	int reportedLookups = -1;
+	int reportedUploads = -1;
+	int reportedAvoided = -1;
+	int reportedVisible = -1;
+	int reportedMatrices = -1;
+	int reportedClusterLights = -1;
+	int reportedGpuTimes = 0;
+	int reportedFragments = 0;
+	int reportedCapture = 0;
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		ProfileScope frameScope("Frame");
+
+		// start counting uniform name lookups for this frame and
+		// report whenever the count from the last frame changes
+		g_UniformCache->BeginFrame();
+		if (g_UniformCache->GetLastFrameLookups() != reportedLookups)
+		{
+			reportedLookups = g_UniformCache->GetLastFrameLookups();
+			std::cout << "INFO: uniform lookups per frame: " << reportedLookups << std::endl;
+		}
+		g_UniformBuffers->BeginFrame();
+		if (g_UniformBuffers->GetLastFrameUploads() != reportedUploads)
+		{
+			reportedUploads = g_UniformBuffers->GetLastFrameUploads();
+			std::cout << "INFO: uniform buffer uploads per frame: " << reportedUploads << std::endl;
+		}
+
 		// Enable z-depth
 		glEnable(GL_DEPTH_TEST);
 
@@ -99,18 +503,144 @@ int main(int argc, char* argv[])
 		// convert from 3D object space to 2D view
 		g_ViewManager->PrepareSceneView();
 
+		// load the files that were edited since the last frame
+		ReloadChangedFiles();
+
+		// place the camera on the path being played, or add to
+		// the path being recorded
+		MoveAlongCameraPath();
+
 		// refresh the 3D scene
 		g_SceneManager->RenderScene();
 
+		// queue the read of the frame, before it is swapped out
+		if (NULL != g_FrameCapture)
+		{
+			g_FrameCapture->Capture(0);
+		}
+
+		// report the state changes that sorting the draws avoided
+		const RenderQueue::QUEUE_STATS& renderStats = g_SceneManager->GetRenderStats();
+		if (renderStats.stateChangesAvoided != reportedAvoided)
+		{
+			reportedAvoided = renderStats.stateChangesAvoided;
+			std::cout << "INFO: objects per frame: " << renderStats.packets
+				<< ", transparent: " << renderStats.transparentPackets
+				<< ", multi-draw calls: " << renderStats.drawCalls
+				<< ", draw commands: " << renderStats.drawCommands
+				<< ", instanced batches: " << renderStats.instancedBatches
+				<< ", texture changes: " << renderStats.textureChanges
+				<< ", material changes: " << renderStats.materialChanges
+				<< ", state changes avoided: " << reportedAvoided << std::endl;
+		}
+
+		// report the objects that frustum culling left out
+		const FrustumCuller::CULL_STATS& cullStats = g_SceneManager->GetCullStats();
+		if (cullStats.visible != reportedVisible)
+		{
+			reportedVisible = cullStats.visible;
+			std::cout << "INFO: objects visible: " << cullStats.visible
+				<< ", culled: " << cullStats.culled << std::endl;
+		}
+
+		// report the object matrices built again for moved objects
+		if (g_SceneManager->GetMatricesRebuilt() != reportedMatrices)
+		{
+			reportedMatrices = g_SceneManager->GetMatricesRebuilt();
+			std::cout << "INFO: object matrices rebuilt per frame: " << reportedMatrices << std::endl;
+		}
+
+		// report how many point lights the clusters in view list
+		const LightClusters::CLUSTER_STATS& clusterStats = g_SceneManager->GetLightClusterStats();
+		if (clusterStats.references != reportedClusterLights)
+		{
+			reportedClusterLights = clusterStats.references;
+			std::cout << "INFO: point lights: " << clusterStats.lights
+				<< ", clusters with lights: " << clusterStats.occupiedClusters
+				<< ", listed lights: " << reportedClusterLights
+				<< ", most in a cluster: " << clusterStats.maxClusterLights << std::endl;
+		}
+
+		// report the GPU time of the passes each time a new
+		// average is ready - passes that did not run are left out
+		const GpuTimers& gpuTimers = g_SceneManager->GetGpuTimers();
+		if (gpuTimers.GetAverageCount() != reportedGpuTimes)
+		{
+			reportedGpuTimes = gpuTimers.GetAverageCount();
+			const char* passNames[] = { "forward", "geometry", "lighting", "depth prepass", "transparent" };
+			std::cout << "INFO: GPU time per frame -";
+			for (int pass = SceneManager::FORWARD_TIMER; pass <= SceneManager::TRANSPARENT_TIMER; pass++)
+			{
+				if (gpuTimers.GetAverage(pass) >= 0.0)
+				{
+					std::cout << " " << passNames[pass] << ": " << gpuTimers.GetAverage(pass) << "ms";
+				}
+			}
+			std::cout << std::endl;
+		}
+
+		// report the opaque fragments shaded, and the ones the
+		// depth prepass kept from being shaded
+		const DepthPrepass& depthPrepass = g_SceneManager->GetDepthPrepass();
+		if (depthPrepass.GetAverageCount() != reportedFragments)
+		{
+			reportedFragments = depthPrepass.GetAverageCount();
+			std::cout << "INFO: opaque fragments shaded per frame: " << (long long)depthPrepass.GetStats().fragmentsShaded
+				<< ", saved by the depth prepass: " << (long long)depthPrepass.GetStats().fragmentsSaved << std::endl;
+		}
+
+		// report what capturing the frames costs the loop, and
+		// how far behind the encoder is
+		if ((NULL != g_FrameCapture) && (g_FrameCapture->GetAverageCount() != reportedCapture))
+		{
+			reportedCapture = g_FrameCapture->GetAverageCount();
+			const FrameCapture::CAPTURE_STATS& captureStats = g_FrameCapture->GetStats();
+			std::cout << "INFO: capture per frame: " << captureStats.captureMilliseconds
+				<< "ms, stalled: " << captureStats.stallMilliseconds
+				<< "ms, frames queued: " << captureStats.queueDepth
+				<< " (most " << captureStats.maxQueueDepth << ")"
+				<< ", convert: " << captureStats.convertMilliseconds
+				<< "ms, compress: " << captureStats.compressMilliseconds
+				<< "ms, write: " << captureStats.writeMilliseconds
+				<< "ms, written per second: " << captureStats.framesPerSecond << std::endl;
+		}
+
 
 		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		{
+			ProfileScope scope("SwapBuffers");
+			glfwSwapBuffers(g_Window);
+		}
 
 		// query the latest GLFW events
-		glfwPollEvents();
+		{
+			ProfileScope scope("PollEvents");
+			glfwPollEvents();
+		}
+
+		// write the trace when T is pressed
+		WriteTraceOnRequest();
+
+		// time the whole frame for the camera path benchmark
+		std::chrono::duration<double, std::milli> frameElapsed = std::chrono::steady_clock::now() - frameStart;
+		EndPathFrame(frameElapsed.count());
 	}
 
-	// clear the allocated manager objects from memory
+	// save the path recorded while the scene was shown
+	StopCameraPath();
+
+	// clear the allocated manager objects from memory - the
+	// frames still being captured are written out first
+	if (NULL != g_FrameCapture)
+	{
+		delete g_FrameCapture;
+		g_FrameCapture = NULL;
+	}
+	if (NULL != g_FileWatcher)
+	{
+		delete g_FileWatcher;
+		g_FileWatcher = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
@@ -121,26 +651,76 @@ int main(int argc, char* argv[])
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_UniformBuffers)
+	{
+		delete g_UniformBuffers;
+		g_UniformBuffers = NULL;
+	}
+	if (NULL != g_UniformCache)
+	{
+		delete g_UniformCache;
+		g_UniformCache = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
+	if (NULL != g_ProgramCache)
+	{
+		delete g_ProgramCache;
+		g_ProgramCache = NULL;
+	}
+	if (NULL != g_WorkerPool)
+	{
+		delete g_WorkerPool;
+		g_WorkerPool = NULL;
+	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
+	// the trace ends once everything is shut down, so it holds
+	// the last frames being written out by the capture
+	if (g_TraceFilename.empty() == false)
+	{
+		Profiler::WriteChromeTrace(g_TraceFilename);
+	}
+
+	// Terminates the program
+	exit(result); 
 }
 
 /***********************************************************
  *	InitializeGLFW()
  * 
  *  This function is used to initialize the GLFW library.   
+ *  With no display, GLFW 3.4 and later run on their null
+ *  platform, which needs no window system, with an OSMesa
+ *  or a surfaceless EGL context.  Older versions fall back
+ *  to a hidden window on the native platform.
  ***********************************************************/
-bool InitializeGLFW()
+bool InitializeGLFW(bool bHeadless, bool bEGLContext)
 {
 	// GLFW: initialize and configure library
 	// --------------------------------------
-	glfwInit();
+#if defined(GLFW_PLATFORM_NULL)
+	if (bHeadless == true)
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
+	if (glfwInit() == GLFW_FALSE)
+	{
+		std::cerr << "Failed to initialize GLFW" << std::endl;
+		return(false);
+	}
+
+	if (bHeadless == true)
+	{
+#if defined(GLFW_PLATFORM_NULL)
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, (bEGLContext == true) ? GLFW_EGL_CONTEXT_API : GLFW_OSMESA_CONTEXT_API);
+#else
+		std::cout << "INFO: this GLFW has no null platform, rendering in a hidden window" << std::endl;
+#endif
+	}
 
 #ifdef __APPLE__
 	// set the version of OpenGL and profile to use
@@ -183,4 +763,431 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
 	return(true);
-}
\ No newline at end of file
+}
+
+/***********************************************************
+ *	ParseTextureQuality()
+ *
+ *  This function is used to set the texture compression
+ *  from its name on the command line.
+ ***********************************************************/
+bool ParseTextureQuality(const char* name)
+{
+	if (strcmp(name, "uncompressed") == 0)
+	{
+		g_bCompressTextures = false;
+		return(true);
+	}
+
+	g_bCompressTextures = true;
+	if (strcmp(name, "fast") == 0)
+	{
+		g_TextureQuality = BlockCompressor::QUALITY_FAST;
+	}
+	else if (strcmp(name, "normal") == 0)
+	{
+		g_TextureQuality = BlockCompressor::QUALITY_NORMAL;
+	}
+	else if (strcmp(name, "high") == 0)
+	{
+		g_TextureQuality = BlockCompressor::QUALITY_HIGH;
+	}
+	else
+	{
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *	CookTextures()
+ *
+ *  This function is used to cook the texture cache files of
+ *  the given image files on the worker threads, so the first
+ *  run of the scene only has to map them.
+ ***********************************************************/
+int CookTextures(const std::vector<std::string>& filenames)
+{
+	WorkerPool workerPool;
+	TextureCache textureCache;
+	textureCache.SetCompression(g_bCompressTextures, g_TextureQuality);
+
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		std::string filename = filenames[i];
+		workerPool.Submit([&textureCache, filename]() { textureCache.CookTexture(filename); });
+	}
+	workerPool.WaitIdle();
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *	WatchSourceFiles()
+ *
+ *  This function is used to watch the shader files and the
+ *  files the scene was loaded from.  Files already watched
+ *  are left as they are.
+ ***********************************************************/
+void WatchSourceFiles()
+{
+	g_FileWatcher->WatchFile(VERTEX_SHADER_FILE);
+	g_FileWatcher->WatchFile(FRAGMENT_SHADER_FILE);
+
+	std::vector<std::string> sceneFiles;
+	g_SceneManager->GetSourceFiles(sceneFiles);
+	for (size_t i = 0; i < sceneFiles.size(); i++)
+	{
+		g_FileWatcher->WatchFile(sceneFiles[i]);
+	}
+}
+
+/***********************************************************
+ *	ReloadChangedFiles()
+ *
+ *  This function is used to load the edited files again,
+ *  each into only the resources made from it, and to report
+ *  how long that took.  An edited image is uploaded later,
+ *  once it has been decoded on the worker threads.
+ ***********************************************************/
+void ReloadChangedFiles()
+{
+	ProfileScope scope("ReloadChangedFiles");
+
+	std::vector<std::string> changedFiles;
+	if (g_FileWatcher->Poll(changedFiles) == 0)
+	{
+		return;
+	}
+
+	bool bShadersChanged = false;
+	for (size_t i = 0; i < changedFiles.size(); i++)
+	{
+		const std::string& filename = changedFiles[i];
+		if ((filename == VERTEX_SHADER_FILE) || (filename == FRAGMENT_SHADER_FILE))
+		{
+			bShadersChanged = true;
+			continue;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool bReloaded = g_SceneManager->ReloadFile(filename);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (bReloaded == true)
+		{
+			std::cout << "INFO: reloaded " << filename << " in " << elapsed.count() << "ms" << std::endl;
+		}
+	}
+
+	// both shaders are linked into one program, so it is only
+	// linked once when both of them were saved
+	if (bShadersChanged == true)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool bReloaded = ReloadShaders();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (bReloaded == true)
+		{
+			std::cout << "INFO: reloaded the shaders in " << elapsed.count() << "ms" << std::endl;
+		}
+	}
+
+	// a scene that was edited may use new textures
+	WatchSourceFiles();
+}
+
+/***********************************************************
+ *	ReloadShaders()
+ *
+ *  This function is used to build the shader program again
+ *  from the edited GLSL files.  The buffers, textures and
+ *  meshes are kept, since the blocks are bound by their
+ *  binding points - only the uniform handles and the
+ *  sampler units are set again.  When the edited shaders do
+ *  not build, the old program is kept.
+ ***********************************************************/
+bool ReloadShaders()
+{
+	GLuint programID = g_ProgramCache->LoadProgram(
+		VERTEX_SHADER_FILE,
+		FRAGMENT_SHADER_FILE);
+	if (programID == 0)
+	{
+		std::cout << "INFO: the edited shaders did not build, the old program is kept" << std::endl;
+		return(false);
+	}
+
+	glDeleteProgram(g_ShaderManager->m_programID);
+	g_ShaderManager->m_programID = programID;
+	g_ShaderManager->use();
+	g_UniformCache->Build();
+	g_SceneManager->SetTextureUnits();
+
+	// the variants the scene is drawn with come from the same files
+	g_SceneManager->BuildShaderVariants();
+
+	return(true);
+}
+
+/***********************************************************
+ *	RenderHeadless()
+ *
+ *  This function is used to render the scene with no
+ *  display.  The camera turns once around the middle of the
+ *  scene over the frames, looking at it from the orbit set
+ *  on the command line, or follows the camera path played
+ *  at its fixed step, and each frame is drawn into an
+ *  offscreen target and captured from there, so the next
+ *  frame is drawn while the last ones are read back and
+ *  written out.  Every texture is loaded before the first
+ *  frame.
+ ***********************************************************/
+int RenderHeadless()
+{
+	OffscreenTarget target;
+	if (target.Create(g_Headless.width, g_Headless.height) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	FrameCapture capture;
+	if (capture.Start(target.GetWidth(), target.GetHeight(), g_CaptureFormat, g_Headless.outputPrefix, g_WorkerPool) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	g_SceneManager->FinishLoading();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < g_Headless.frameCount; frame++)
+	{
+		ProfileScope frameScope("Frame");
+
+		if (g_PathSettings.playFilename.empty() == false)
+		{
+			g_Path.frame = frame;
+			MoveAlongCameraPath();
+		}
+		else
+		{
+			float angle = glm::radians(360.0f * frame / g_Headless.frameCount);
+			glm::vec3 position = glm::vec3(
+				sin(angle) * g_Headless.orbitRadius,
+				g_Headless.orbitHeight,
+				cos(angle) * g_Headless.orbitRadius);
+			g_SceneManager->SetCamera(position, glm::vec3(0.0f));
+		}
+
+		g_UniformCache->BeginFrame();
+		g_UniformBuffers->BeginFrame();
+
+		target.Bind();
+		glEnable(GL_DEPTH_TEST);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		g_SceneManager->RenderScene();
+
+		capture.Capture(target.GetFramebuffer());
+	}
+	capture.Stop();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "INFO: rendered " << g_Headless.frameCount << " frames of " << g_Headless.width << "x"
+		<< g_Headless.height << " to " << g_Headless.outputPrefix << " in " << elapsed.count() << "ms ("
+		<< g_Headless.frameCount * 1000.0 / elapsed.count() << " frames per second)" << std::endl;
+	if (capture.GetAverageCount() > 0)
+	{
+		const FrameCapture::CAPTURE_STATS& captureStats = capture.GetStats();
+		std::cout << "INFO: capture per frame: " << captureStats.captureMilliseconds
+			<< "ms, stalled: " << captureStats.stallMilliseconds
+			<< "ms, convert: " << captureStats.convertMilliseconds
+			<< "ms, compress: " << captureStats.compressMilliseconds
+			<< "ms, write: " << captureStats.writeMilliseconds << "ms" << std::endl;
+	}
+
+	if (capture.GetFramesWritten() != g_Headless.frameCount)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	return(EXIT_SUCCESS);
+}
+
+/***********************************************************
+ *	StartCameraPath()
+ *
+ *  This function is used to load the camera path played
+ *  from the command line, or to start the one recorded.
+ *  While a path is played the keyboard and mouse leave the
+ *  camera alone, the time steps by the fixed step, the
+ *  frames are not held to the display refresh, and every
+ *  texture is loaded before the first frame, so each run
+ *  draws the same frames.
+ ***********************************************************/
+bool StartCameraPath()
+{
+	if (g_PathSettings.playFilename.empty() == false)
+	{
+		g_Path.pPath = new CameraPath();
+		if ((g_Path.pPath->Load(g_PathSettings.playFilename) == false) ||
+			(g_Path.pPath->GetKeyframeCount() == 0))
+		{
+			std::cerr << "Could not play the camera path " << g_PathSettings.playFilename << std::endl;
+			return(false);
+		}
+
+		g_SceneManager->SetCameraInput(false);
+		g_SceneManager->SetFixedTimeStep(g_PathSettings.timeStep);
+		g_SceneManager->FinishLoading();
+		glfwSwapInterval(0);
+		g_Path.frameMilliseconds.reserve((size_t)(g_Path.pPath->GetDuration() / g_PathSettings.timeStep) + 2);
+	}
+	else if ((g_PathSettings.recordFilename.empty() == false) && (g_Headless.bHeadless == false))
+	{
+		g_Path.pPath = new CameraPath();
+		g_Path.recordStart = (float)glfwGetTime();
+		g_Path.lastKeyframe = -RECORD_INTERVAL;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *	MoveAlongCameraPath()
+ *
+ *  This function is used to place the camera where the path
+ *  played is at the time of the frame, or to add the camera
+ *  to the path recorded when it is time for a keyframe.
+ ***********************************************************/
+void MoveAlongCameraPath()
+{
+	if (NULL == g_Path.pPath)
+	{
+		return;
+	}
+
+	glm::vec3 position;
+	float yaw = 0.0f;
+	float pitch = 0.0f;
+	if (g_PathSettings.playFilename.empty() == false)
+	{
+		g_SceneManager->GetCameraView(position, yaw, pitch);
+		g_Path.pPath->Sample(g_Path.frame * g_PathSettings.timeStep, position, yaw, pitch);
+		g_SceneManager->SetCameraView(position, yaw, pitch);
+	}
+	else
+	{
+		float time = (float)glfwGetTime() - g_Path.recordStart;
+		if (time - g_Path.lastKeyframe >= RECORD_INTERVAL)
+		{
+			g_SceneManager->GetCameraView(position, yaw, pitch);
+			g_Path.pPath->AddKeyframe(time, position, yaw, pitch);
+			g_Path.lastKeyframe = time;
+		}
+	}
+}
+
+/***********************************************************
+ *	EndPathFrame()
+ *
+ *  This function is used to keep the time of a frame drawn
+ *  along the path played.  At the end of the path the
+ *  shortest, average and 99th percentile frame times of the
+ *  run are reported and the path is played again, until
+ *  every run is done and the window closes.
+ ***********************************************************/
+void EndPathFrame(double frameMilliseconds)
+{
+	if ((NULL == g_Path.pPath) || (g_PathSettings.playFilename.empty() == true))
+	{
+		return;
+	}
+
+	g_Path.frameMilliseconds.push_back(frameMilliseconds);
+	g_Path.frame++;
+	if (g_Path.frame * g_PathSettings.timeStep <= g_Path.pPath->GetDuration())
+	{
+		return;
+	}
+
+	std::vector<double>& frameTimes = g_Path.frameMilliseconds;
+	std::sort(frameTimes.begin(), frameTimes.end());
+	double total = 0.0;
+	for (size_t i = 0; i < frameTimes.size(); i++)
+	{
+		total += frameTimes[i];
+	}
+	size_t percentile = (size_t)ceil(frameTimes.size() * 0.99) - 1;
+
+	g_Path.run++;
+	std::cout << "Benchmark: run " << g_Path.run << " of " << g_PathSettings.runs << ", "
+		<< frameTimes.size() << " frames along " << g_PathSettings.playFilename
+		<< " at " << g_PathSettings.timeStep * 1000.0f << "ms steps" << std::endl;
+	std::cout << "  frame time: min " << frameTimes.front() << "ms, average " << total / frameTimes.size()
+		<< "ms, 99th percentile " << frameTimes[percentile] << "ms" << std::endl;
+
+	frameTimes.clear();
+	g_Path.frame = 0;
+	if (g_Path.run >= g_PathSettings.runs)
+	{
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
+}
+
+/***********************************************************
+ *	StopCameraPath()
+ *
+ *  This function is used to save the path recorded, ending
+ *  it where the camera was at the last frame, and to free
+ *  the path.
+ ***********************************************************/
+void StopCameraPath()
+{
+	if (NULL == g_Path.pPath)
+	{
+		return;
+	}
+
+	if (g_PathSettings.playFilename.empty() == true)
+	{
+		glm::vec3 position;
+		float yaw = 0.0f;
+		float pitch = 0.0f;
+		g_SceneManager->GetCameraView(position, yaw, pitch);
+		g_Path.pPath->AddKeyframe((float)glfwGetTime() - g_Path.recordStart, position, yaw, pitch);
+		if (g_Path.pPath->Save(g_PathSettings.recordFilename) == true)
+		{
+			std::cout << "INFO: recorded " << g_Path.pPath->GetKeyframeCount() << " keyframes, "
+				<< g_Path.pPath->GetDuration() << " seconds, to " << g_PathSettings.recordFilename << std::endl;
+		}
+	}
+
+	delete g_Path.pPath;
+	g_Path.pPath = NULL;
+}
+
+/***********************************************************
+ *	WriteTraceOnRequest()
+ *
+ *  This function is used to write the trace of the scopes
+ *  timed so far when T goes down, while the profiler is on,
+ *  so the frames around a slow moment can be looked at
+ *  without closing the window.
+ ***********************************************************/
+void WriteTraceOnRequest()
+{
+	static bool bTraceKeyHeld = false;
+
+	if (g_TraceFilename.empty() == true)
+	{
+		return;
+	}
+
+	bool bTraceKeyDown = (glfwGetKey(g_Window, GLFW_KEY_T) == GLFW_PRESS);
+	if ((bTraceKeyDown == true) && (bTraceKeyHeld == false))
+	{
+		Profiler::WriteChromeTrace(g_TraceFilename);
+	}
+	bTraceKeyHeld = bTraceKeyDown;
+}
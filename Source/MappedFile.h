@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// read-only memory mapping of a whole file
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a file into memory for reading, so its
+ *  contents can be used in place without copying them into
+ *  a buffer first.  The mapping is released when the file
+ *  is closed or the object is destroyed.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map a whole file, returning false when it cannot be
+	// opened or is empty
+	bool Open(const std::string& filename);
+	// release the mapping
+	void Close();
+
+	// the mapped contents of the file
+	const unsigned char* GetData() const { return(m_pData); }
+	size_t GetSize() const { return(m_size); }
+	bool IsOpen() const { return(m_pData != NULL); }
+
+private:
+	// start and size of the mapping
+	const unsigned char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	// file and file mapping handles
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#else
+	// file descriptor of the mapped file
+	int m_fileDescriptor;
+#endif
+
+	// a mapping has one owner
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
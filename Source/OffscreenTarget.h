@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+// offscreentarget.h
+// ============
+// a framebuffer to render frames into and read them back from
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  OffscreenTarget
+ *
+ *  This class keeps a framebuffer with a color and a depth
+ *  buffer of a chosen size, so frames can be rendered with
+ *  no window to show them in, and captured from there.
+ ***********************************************************/
+class OffscreenTarget
+{
+public:
+	// constructor
+	OffscreenTarget();
+	// destructor
+	~OffscreenTarget();
+
+	// create the buffers, returning false when the framebuffer
+	// is not complete
+	bool Create(int width, int height);
+	// free the buffers
+	void Destroy();
+
+	// draw into the target, over its whole size
+	void Bind();
+
+	GLuint GetFramebuffer() const { return(m_framebuffer); }
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+
+private:
+	GLuint m_framebuffer;
+	GLuint m_colorBuffer;
+	GLuint m_depthBuffer;
+	int m_width;
+	int m_height;
+};
@@ -0,0 +1,270 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.cpp
+// ============
+// time scopes of the CPU work on each thread and write them as a trace
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::s_bEnabled(false);
+
+// declaration of the global variables and defines
+namespace
+{
+	// a scope that ended
+	struct PROFILE_EVENT
+	{
+		const char* name;
+		long long startTicks;
+		long long endTicks;
+	};
+
+	// the ring of scopes of one thread - only that thread
+	// writes into it
+	struct PROFILE_THREAD
+	{
+		int threadID;
+		// guarded by the mutex of the thread list
+		std::string name;
+		// scopes written so far - the next one goes into the
+		// ring at this count
+		std::atomic<unsigned int> written;
+		PROFILE_EVENT events[Profiler::RING_EVENTS];
+	};
+
+	// the ring of every thread that timed a scope, kept until
+	// the program ends so the scopes of threads that ended are
+	// still written out
+	struct PROFILE_THREAD_LIST
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<PROFILE_THREAD> > threads;
+	};
+
+	PROFILE_THREAD_LIST& GetThreadList()
+	{
+		static PROFILE_THREAD_LIST threadList;
+		return(threadList);
+	}
+
+	// the ring of the calling thread, made the first time it
+	// times a scope, and the name given to the thread before
+	// that
+	thread_local PROFILE_THREAD* t_pThread = NULL;
+	thread_local std::string t_threadName;
+
+	/***********************************************************
+	 *  GetThreadRing()
+	 *
+	 *  The ring of the calling thread.
+	 ***********************************************************/
+	PROFILE_THREAD* GetThreadRing()
+	{
+		if (NULL == t_pThread)
+		{
+			PROFILE_THREAD_LIST& threadList = GetThreadList();
+			std::lock_guard<std::mutex> lock(threadList.mutex);
+
+			std::unique_ptr<PROFILE_THREAD> pThread(new PROFILE_THREAD);
+			pThread->threadID = (int)threadList.threads.size() + 1;
+			pThread->name = t_threadName;
+			if (pThread->name.empty() == true)
+			{
+				pThread->name = "thread " + std::to_string(pThread->threadID);
+			}
+			pThread->written.store(0, std::memory_order_relaxed);
+			t_pThread = pThread.get();
+			threadList.threads.push_back(std::move(pThread));
+		}
+
+		return(t_pThread);
+	}
+
+	/***********************************************************
+	 *  WriteJSONString()
+	 *
+	 *  Write a string as a quoted JSON string.
+	 ***********************************************************/
+	void WriteJSONString(std::ostream& output, const char* text)
+	{
+		output << '"';
+		for (const char* pChar = text; *pChar != '\0'; pChar++)
+		{
+			if ((*pChar == '"') || (*pChar == '\\'))
+			{
+				output << '\\';
+			}
+			output << *pChar;
+		}
+		output << '"';
+	}
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is used for starting or stopping the timing
+ *  of scopes.  Scopes that began before the change finish
+ *  the way they began.
+ ***********************************************************/
+void Profiler::SetEnabled(bool bEnabled)
+{
+	s_bEnabled.store(bEnabled, std::memory_order_relaxed);
+}
+
+/***********************************************************
+ *  SetThreadName()
+ *
+ *  This method is used for naming the calling thread in the
+ *  trace - threads left unnamed are numbered.  The name is
+ *  kept until the thread times its first scope, so threads
+ *  only get a ring while the profiler is on.
+ ***********************************************************/
+void Profiler::SetThreadName(const char* name)
+{
+	t_threadName = name;
+	if (NULL == t_pThread)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(GetThreadList().mutex);
+	t_pThread->name = t_threadName;
+}
+
+/***********************************************************
+ *  Record()
+ *
+ *  This method is used for keeping a scope in the ring of
+ *  the calling thread, over the oldest one once the ring is
+ *  full.  The count is stored after the scope, so a trace
+ *  written at the same time sees the scope whole or not at
+ *  all.
+ ***********************************************************/
+void Profiler::Record(const char* name, long long startTicks, long long endTicks)
+{
+	PROFILE_THREAD* pThread = GetThreadRing();
+
+	unsigned int written = pThread->written.load(std::memory_order_relaxed);
+	PROFILE_EVENT& event = pThread->events[written % RING_EVENTS];
+	event.name = name;
+	event.startTicks = startTicks;
+	event.endTicks = endTicks;
+	pThread->written.store(written + 1, std::memory_order_release);
+}
+
+/***********************************************************
+ *  WriteChromeTrace()
+ *
+ *  This method is used for writing the scopes kept on every
+ *  thread as the complete events of a Chrome trace, in
+ *  microseconds from the earliest one.  The threads go on
+ *  timing scopes while the rings are copied, and a scope
+ *  written over during the copy is left out.
+ ***********************************************************/
+bool Profiler::WriteChromeTrace(const std::string& filename)
+{
+	struct THREAD_EVENTS
+	{
+		int threadID;
+		std::string name;
+		std::vector<PROFILE_EVENT> events;
+	};
+	std::vector<THREAD_EVENTS> threads;
+
+	long long firstTicks = 0;
+	bool bAnyEvents = false;
+	{
+		PROFILE_THREAD_LIST& threadList = GetThreadList();
+		std::lock_guard<std::mutex> lock(threadList.mutex);
+		threads.resize(threadList.threads.size());
+		for (size_t i = 0; i < threadList.threads.size(); i++)
+		{
+			const PROFILE_THREAD& thread = *threadList.threads[i];
+			THREAD_EVENTS& copy = threads[i];
+			copy.threadID = thread.threadID;
+			copy.name = thread.name;
+
+			unsigned int written = thread.written.load(std::memory_order_acquire);
+			unsigned int first = (written > (unsigned int)RING_EVENTS) ? written - RING_EVENTS : 0;
+			copy.events.reserve(written - first);
+			for (unsigned int index = first; index != written; index++)
+			{
+				copy.events.push_back(thread.events[index % RING_EVENTS]);
+			}
+
+			// the scopes the thread wrote over while they were
+			// copied, and the one it may be writing now
+			std::atomic_thread_fence(std::memory_order_acquire);
+			unsigned int writtenAfter = thread.written.load(std::memory_order_relaxed) + 1;
+			if (writtenAfter - first > (unsigned int)RING_EVENTS)
+			{
+				unsigned int overwritten = std::min(writtenAfter - first - RING_EVENTS, written - first);
+				copy.events.erase(copy.events.begin(), copy.events.begin() + overwritten);
+			}
+
+			for (size_t event = 0; event < copy.events.size(); event++)
+			{
+				if ((bAnyEvents == false) || (copy.events[event].startTicks < firstTicks))
+				{
+					firstTicks = copy.events[event].startTicks;
+					bAnyEvents = true;
+				}
+			}
+		}
+	}
+
+	std::ofstream file(filename.c_str());
+	if (!file)
+	{
+		std::cout << "Profiler: could not write " << filename << std::endl;
+		return(false);
+	}
+
+	// the clock ticks in microseconds
+	const double tickMicroseconds = 1000000.0 *
+		std::chrono::steady_clock::period::num / std::chrono::steady_clock::period::den;
+
+	size_t eventCount = 0;
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"scene\"}}";
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		const THREAD_EVENTS& thread = threads[i];
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.threadID << ",\"args\":{\"name\":";
+		WriteJSONString(file, thread.name.c_str());
+		file << "}}";
+
+		for (size_t event = 0; event < thread.events.size(); event++)
+		{
+			const PROFILE_EVENT& scope = thread.events[event];
+			file << ",\n{\"name\":";
+			WriteJSONString(file, scope.name);
+			file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.threadID
+				<< ",\"ts\":" << (scope.startTicks - firstTicks) * tickMicroseconds
+				<< ",\"dur\":" << (scope.endTicks - scope.startTicks) * tickMicroseconds << "}";
+		}
+		eventCount += thread.events.size();
+	}
+	file << "\n]}\n";
+
+	if (file.good() == false)
+	{
+		std::cout << "Profiler: could not write " << filename << std::endl;
+		return(false);
+	}
+
+	std::cout << "Profiler: wrote " << eventCount << " scopes on " << threads.size()
+		<< " threads to " << filename << std::endl;
+	return(true);
+}
@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.h
+// ============
+// time scopes of the CPU work on each thread and write them as a trace
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/***********************************************************
+ *  Profiler
+ *
+ *  This class keeps the scopes timed on each thread, for
+ *  finding where the time of a frame goes.  Each thread
+ *  writes the scopes it ends into a ring of its own with no
+ *  lock, so timing a scope costs two reads of the clock and
+ *  a few stores, and only the latest RING_EVENTS of each
+ *  thread are kept.  The rings are written out as a Chrome
+ *  trace, which chrome://tracing and Perfetto show as a
+ *  timeline of the threads.  While the profiler is off a
+ *  scope only reads whether it is on.
+ ***********************************************************/
+class Profiler
+{
+public:
+	// scopes each thread keeps - older ones are written over
+	static const int RING_EVENTS = 1 << 15;
+
+	// start or stop timing scopes
+	static void SetEnabled(bool bEnabled);
+	static bool IsEnabled() { return(s_bEnabled.load(std::memory_order_relaxed)); }
+
+	// name the calling thread in the trace
+	static void SetThreadName(const char* name);
+
+	// the clock the scopes are timed with
+	static long long GetTicks() { return((long long)std::chrono::steady_clock::now().time_since_epoch().count()); }
+	// keep a scope that ended on the calling thread - the name
+	// must live as long as the program, like a string literal
+	static void Record(const char* name, long long startTicks, long long endTicks);
+
+	// write the scopes kept on every thread as a Chrome trace
+	static bool WriteChromeTrace(const std::string& filename);
+
+private:
+	static std::atomic<bool> s_bEnabled;
+};
+
+/***********************************************************
+ *  ProfileScope
+ *
+ *  This class times the scope it is declared in, from its
+ *  constructor to its destructor, and keeps it under a name
+ *  while the profiler is on.
+ ***********************************************************/
+class ProfileScope
+{
+public:
+	// constructor
+	explicit ProfileScope(const char* name)
+	{
+		m_name = NULL;
+		m_startTicks = 0;
+		if (Profiler::IsEnabled() == true)
+		{
+			m_name = name;
+			m_startTicks = Profiler::GetTicks();
+		}
+	}
+	// destructor
+	~ProfileScope()
+	{
+		if (NULL != m_name)
+		{
+			Profiler::Record(m_name, m_startTicks, Profiler::GetTicks());
+		}
+	}
+
+private:
+	// NULL when the profiler was off as the scope began
+	const char* m_name;
+	long long m_startTicks;
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
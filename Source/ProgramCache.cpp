@@ -0,0 +1,401 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.cpp
+// ============
+// keep linked shader programs on disk as driver program binaries
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ProgramCache.h"
+#include "MappedFile.h"
+#include "TextureCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// "PGB1" - identifies a cached program binary
+	const uint32_t BINARY_MAGIC = 0x31424750;
+	// bumped whenever the file layout changes
+	const uint32_t BINARY_VERSION = 1;
+
+	// layout of the start of a cached program binary, followed
+	// by the binary itself
+	struct BINARY_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t programHash;
+		uint32_t binaryFormat;
+		uint32_t binarySize;
+	};
+
+	/***********************************************************
+	 *  MakeDirectory()
+	 *
+	 *  Create a directory, which is fine when it already exists.
+	 ***********************************************************/
+	void MakeDirectory(const std::string& path)
+	{
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+
+	/***********************************************************
+	 *  MillisecondsSince()
+	 *
+	 *  Time passed since a point in time, in milliseconds.
+	 ***********************************************************/
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		return(elapsed.count());
+	}
+}
+
+/***********************************************************
+ *  ProgramCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ProgramCache::ProgramCache(const std::string& cacheDirectory)
+{
+	m_cacheDirectory = cacheDirectory;
+	m_bBinariesSupported = false;
+	m_cacheHits = 0;
+	m_cacheMisses = 0;
+}
+
+/***********************************************************
+ *  ~ProgramCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ProgramCache::~ProgramCache()
+{
+}
+
+/***********************************************************
+ *  LoadProgram()
+ *
+ *  This method is used for getting a linked program for a
+ *  pair of shader files.  The sources are read and hashed
+ *  with the driver's name, and when the cache has a binary
+ *  for that hash which the driver accepts, it is used
+ *  without compiling.  Otherwise the sources are compiled,
+ *  and the binary is saved for the next launch.
+ ***********************************************************/
+GLuint ProgramCache::LoadProgram(
+	const char* vertexFilename,
+	const char* fragmentFilename,
+	const std::vector<std::string>& defines)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (m_driverName.empty() == true)
+	{
+		m_driverName = std::string((const char*)glGetString(GL_VENDOR)) + "\n" +
+			(const char*)glGetString(GL_RENDERER) + "\n" +
+			(const char*)glGetString(GL_VERSION);
+
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		m_bBinariesSupported = (formatCount > 0);
+	}
+
+	std::string vertexSource;
+	std::string fragmentSource;
+	if ((ReadSource(vertexFilename, defines, vertexSource) == false) ||
+		(ReadSource(fragmentFilename, defines, fragmentSource) == false))
+	{
+		return(0);
+	}
+
+	// the sources are kept apart by a character GLSL cannot have
+	std::string key = m_driverName + '\0' + vertexSource + '\0' + fragmentSource;
+	uint64_t programHash = TextureCache::HashBytes((const unsigned char*)key.data(), key.size());
+	std::string cachePath = GetCachePath(programHash);
+
+	if (m_bBinariesSupported == true)
+	{
+		GLuint programID = LoadBinary(cachePath, programHash);
+		if (programID != 0)
+		{
+			m_cacheHits++;
+			std::cout << "ProgramCache: loaded " << vertexFilename << " and " << fragmentFilename
+				<< " from " << cachePath << " in " << MillisecondsSince(start) << "ms" << std::endl;
+			return(programID);
+		}
+	}
+
+	GLuint programID = CompileProgram(vertexFilename, vertexSource, fragmentFilename, fragmentSource);
+	if (programID == 0)
+	{
+		return(0);
+	}
+	m_cacheMisses++;
+
+	double compileMilliseconds = MillisecondsSince(start);
+	bool bSaved = (m_bBinariesSupported == true) && (SaveBinary(cachePath, programHash, programID) == true);
+	std::cout << "ProgramCache: compiled " << vertexFilename << " and " << fragmentFilename
+		<< " in " << compileMilliseconds << "ms" << ((bSaved == true) ? ", saved to " + cachePath : std::string())
+		<< std::endl;
+
+	return(programID);
+}
+
+/***********************************************************
+ *  ReadSource()
+ *
+ *  This method is used for reading a GLSL file into a string
+ *  with the defines inserted after its #version line, which
+ *  must stay the first line of the source.
+ ***********************************************************/
+bool ProgramCache::ReadSource(const char* filename, const std::vector<std::string>& defines, std::string& source)
+{
+	MappedFile file;
+	if (file.Open(filename) == false)
+	{
+		std::cout << "ProgramCache: could not read " << filename << std::endl;
+		return(false);
+	}
+	source.assign((const char*)file.GetData(), file.GetSize());
+
+	if (defines.empty() == true)
+	{
+		return(true);
+	}
+
+	std::string defineLines;
+	for (size_t i = 0; i < defines.size(); i++)
+	{
+		defineLines += "#define " + defines[i] + "\n";
+	}
+
+	size_t insertAt = 0;
+	if (source.compare(0, 8, "#version") == 0)
+	{
+		size_t lineEnd = source.find('\n');
+		insertAt = (lineEnd == std::string::npos) ? source.size() : lineEnd + 1;
+		if (lineEnd == std::string::npos)
+		{
+			defineLines = "\n" + defineLines;
+		}
+	}
+	source.insert(insertAt, defineLines);
+
+	return(true);
+}
+
+/***********************************************************
+ *  CompileShader()
+ *
+ *  This method is used for compiling one stage of a program,
+ *  writing the compiler's log when it fails.
+ ***********************************************************/
+GLuint ProgramCache::CompileShader(GLenum stage, const char* filename, const std::string& source)
+{
+	GLuint shaderID = glCreateShader(stage);
+	const char* pSource = source.c_str();
+	GLint sourceLength = (GLint)source.size();
+	glShaderSource(shaderID, 1, &pSource, &sourceLength);
+	glCompileShader(shaderID);
+
+	GLint compileStatus = GL_FALSE;
+	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compileStatus);
+	if (compileStatus == GL_FALSE)
+	{
+		GLint logLength = 0;
+		glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> log(logLength + 1, '\0');
+		glGetShaderInfoLog(shaderID, logLength, NULL, log.data());
+		std::cout << "ProgramCache: " << filename << " did not compile:" << std::endl << log.data() << std::endl;
+
+		glDeleteShader(shaderID);
+		return(0);
+	}
+
+	return(shaderID);
+}
+
+/***********************************************************
+ *  CompileProgram()
+ *
+ *  This method is used for compiling and linking a program
+ *  from its sources.  The driver is told before linking that
+ *  the binary will be read back.
+ ***********************************************************/
+GLuint ProgramCache::CompileProgram(
+	const char* vertexFilename,
+	const std::string& vertexSource,
+	const char* fragmentFilename,
+	const std::string& fragmentSource)
+{
+	GLuint vertexShaderID = CompileShader(GL_VERTEX_SHADER, vertexFilename, vertexSource);
+	GLuint fragmentShaderID = CompileShader(GL_FRAGMENT_SHADER, fragmentFilename, fragmentSource);
+	if ((vertexShaderID == 0) || (fragmentShaderID == 0))
+	{
+		glDeleteShader(vertexShaderID);
+		glDeleteShader(fragmentShaderID);
+		return(0);
+	}
+
+	GLuint programID = glCreateProgram();
+	glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(programID, vertexShaderID);
+	glAttachShader(programID, fragmentShaderID);
+	glLinkProgram(programID);
+
+	// the program keeps its code after the stages are freed
+	glDetachShader(programID, vertexShaderID);
+	glDetachShader(programID, fragmentShaderID);
+	glDeleteShader(vertexShaderID);
+	glDeleteShader(fragmentShaderID);
+
+	GLint linkStatus = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus == GL_FALSE)
+	{
+		GLint logLength = 0;
+		glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> log(logLength + 1, '\0');
+		glGetProgramInfoLog(programID, logLength, NULL, log.data());
+		std::cout << "ProgramCache: " << vertexFilename << " and " << fragmentFilename
+			<< " did not link:" << std::endl << log.data() << std::endl;
+
+		glDeleteProgram(programID);
+		return(0);
+	}
+
+	return(programID);
+}
+
+/***********************************************************
+ *  LoadBinary()
+ *
+ *  This method is used for creating a program from a cached
+ *  binary.  The driver may still reject a binary whose hash
+ *  matches, and then 0 is returned so it is compiled again.
+ ***********************************************************/
+GLuint ProgramCache::LoadBinary(const std::string& cachePath, uint64_t programHash)
+{
+	MappedFile file;
+	if (file.Open(cachePath) == false)
+	{
+		return(0);
+	}
+
+	BINARY_HEADER header;
+	if (file.GetSize() < sizeof(header))
+	{
+		return(0);
+	}
+	memcpy(&header, file.GetData(), sizeof(header));
+	if ((header.magic != BINARY_MAGIC) || (header.version != BINARY_VERSION) ||
+		(header.programHash != programHash) ||
+		(header.binarySize > file.GetSize() - sizeof(header)))
+	{
+		return(0);
+	}
+
+	GLuint programID = glCreateProgram();
+	glProgramBinary(programID, (GLenum)header.binaryFormat,
+		file.GetData() + sizeof(header), (GLsizei)header.binarySize);
+
+	GLint linkStatus = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus == GL_FALSE)
+	{
+		std::cout << "ProgramCache: the driver did not accept " << cachePath << ", compiling again" << std::endl;
+		glDeleteProgram(programID);
+		return(0);
+	}
+
+	return(programID);
+}
+
+/***********************************************************
+ *  SaveBinary()
+ *
+ *  This method is used for writing the binary of a linked
+ *  program to its cache file.  The file is written under a
+ *  temporary name and then renamed, so a file that is only
+ *  partly written is never read.
+ ***********************************************************/
+bool ProgramCache::SaveBinary(const std::string& cachePath, uint64_t programHash, GLuint programID)
+{
+	GLint binarySize = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+	if (binarySize <= 0)
+	{
+		return(false);
+	}
+
+	std::vector<unsigned char> binary(binarySize);
+	GLenum binaryFormat = 0;
+	GLsizei length = 0;
+	glGetProgramBinary(programID, binarySize, &length, &binaryFormat, binary.data());
+	if (length <= 0)
+	{
+		return(false);
+	}
+
+	MakeDirectory(m_cacheDirectory);
+
+	std::string tempPath = cachePath + ".tmp";
+	FILE* pFile = fopen(tempPath.c_str(), "wb");
+	if (NULL == pFile)
+	{
+		return(false);
+	}
+
+	BINARY_HEADER header;
+	header.magic = BINARY_MAGIC;
+	header.version = BINARY_VERSION;
+	header.programHash = programHash;
+	header.binaryFormat = (uint32_t)binaryFormat;
+	header.binarySize = (uint32_t)length;
+
+	bool bWritten =
+		(fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+		(fwrite(binary.data(), 1, (size_t)length, pFile) == (size_t)length);
+	if (fclose(pFile) != 0)
+	{
+		bWritten = false;
+	}
+
+	// a binary the driver rejected is replaced
+	remove(cachePath.c_str());
+	if ((bWritten == false) || (rename(tempPath.c_str(), cachePath.c_str()) != 0))
+	{
+		remove(tempPath.c_str());
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This method is used for getting the name of the cache
+ *  file for a program hash.
+ ***********************************************************/
+std::string ProgramCache::GetCachePath(uint64_t programHash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)programHash);
+	return(m_cacheDirectory + "/" + name);
+}
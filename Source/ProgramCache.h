@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.h
+// ============
+// keep linked shader programs on disk as driver program binaries
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ProgramCache
+ *
+ *  This class builds shader programs from GLSL files and
+ *  keeps each linked program as a driver program binary in
+ *  a cache directory.  The file is named by a hash of the
+ *  driver's vendor, renderer and version and of both
+ *  sources with their defines, so the next launch loads the
+ *  binary instead of compiling.  A binary that is missing,
+ *  or that the driver rejects after an update, falls back
+ *  to compiling the sources, and the cache file is written
+ *  again.
+ ***********************************************************/
+class ProgramCache
+{
+public:
+	// constructor
+	ProgramCache(const std::string& cacheDirectory = "shader_cache");
+	// destructor
+	~ProgramCache();
+
+	// build a program from a vertex and a fragment shader file,
+	// with each define inserted after the #version line as
+	// "#define <define>", returning 0 when it does not link
+	GLuint LoadProgram(
+		const char* vertexFilename,
+		const char* fragmentFilename,
+		const std::vector<std::string>& defines = std::vector<std::string>());
+
+	// programs loaded from binaries, and compiled from source
+	int GetCacheHits() const { return(m_cacheHits); }
+	int GetCacheMisses() const { return(m_cacheMisses); }
+
+private:
+	// directory the program binaries are kept in
+	std::string m_cacheDirectory;
+	// vendor, renderer and version of the driver, read when
+	// the first program is loaded
+	std::string m_driverName;
+	// whether the driver can save program binaries at all
+	bool m_bBinariesSupported;
+	int m_cacheHits;
+	int m_cacheMisses;
+
+	// read a GLSL file and insert the defines after its #version line
+	static bool ReadSource(const char* filename, const std::vector<std::string>& defines, std::string& source);
+	// compile one shader stage, returning 0 on failure
+	static GLuint CompileShader(GLenum stage, const char* filename, const std::string& source);
+	// compile and link a program that can be read back as a binary
+	GLuint CompileProgram(
+		const char* vertexFilename,
+		const std::string& vertexSource,
+		const char* fragmentFilename,
+		const std::string& fragmentSource);
+	// create a program from a cached binary, or return 0
+	GLuint LoadBinary(const std::string& cachePath, uint64_t programHash);
+	// write the binary of a linked program to the cache
+	bool SaveBinary(const std::string& cachePath, uint64_t programHash, GLuint programID);
+	// get the cache file name for a program hash
+	std::string GetCachePath(uint64_t programHash) const;
+};
@@ -0,0 +1,281 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ============
+// collect, sort and submit the draw packets for a frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <cstring>
+
+// declaration of the global variables and defines
+namespace
+{
+	// bit layout of the sort key of an opaque packet, most
+	// significant first:
+	// transparent (1) | shader (3) | texture (16) | mesh (8) | material (12) | depth (24)
+	// a transparent packet moves the depth, counted down from
+	// the farthest, to just below the transparent bit:
+	// transparent (1) | far depth (24) | shader (3) | texture (16) | mesh (8) | material (12)
+	const int TRANSPARENT_SHIFT = 63;
+	const int SHADER_SHIFT = 60;
+	const int TEXTURE_SHIFT = 44;
+	const int MESH_SHIFT = 36;
+	const int MATERIAL_SHIFT = 24;
+	const int FAR_DEPTH_SHIFT = 39;
+	const uint64_t SHADER_MASK = 0x7;
+	const uint64_t TEXTURE_MASK = 0xFFFF;
+	const uint64_t MESH_MASK = 0xFF;
+	const uint64_t MATERIAL_MASK = 0xFFF;
+	const uint32_t DEPTH_MASK = 0x00FFFFFF;
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+	m_viewPosition = glm::vec3(0.0f);
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~RenderQueue()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderQueue::~RenderQueue()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing the packets of the
+ *  previous frame.  The storage is kept for the next frame.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	m_packets.clear();
+	m_keys.clear();
+	m_sortedIndices.clear();
+}
+
+/***********************************************************
+ *  SetViewPosition()
+ *
+ *  This method is used for setting the camera position that
+ *  the depth part of the sort keys is measured from.
+ ***********************************************************/
+void RenderQueue::SetViewPosition(const glm::vec3& viewPosition)
+{
+	m_viewPosition = viewPosition;
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for adding a draw packet to the queue
+ *  and building its sort key.
+ ***********************************************************/
+void RenderQueue::Submit(const DRAW_PACKET& packet)
+{
+	glm::vec3 offset = glm::vec3(packet.model[3][0], packet.model[3][1], packet.model[3][2]) - m_viewPosition;
+	float viewDistance = glm::dot(offset, offset);
+
+	m_keys.push_back(MakeSortKey(packet, viewDistance));
+	m_sortedIndices.push_back((uint32_t)m_packets.size());
+	m_packets.push_back(packet);
+}
+
+/***********************************************************
+ *  MakeSortKey()
+ *
+ *  This method is used for building the 64-bit sort key of a
+ *  packet.  The bits of a non-negative float keep their order
+ *  when compared as an integer, so the top bits of the
+ *  distance are used as the depth directly.  Transparent
+ *  packets sort after every opaque one, farthest first, so
+ *  they blend over what is behind them.
+ ***********************************************************/
+uint64_t RenderQueue::MakeSortKey(const DRAW_PACKET& packet, float viewDistance)
+{
+	uint32_t distanceBits = 0;
+	if (viewDistance > 0.0f)
+	{
+		memcpy(&distanceBits, &viewDistance, sizeof(distanceBits));
+	}
+
+	uint64_t depth = (uint64_t)((distanceBits >> 8) & DEPTH_MASK);
+
+	// untextured draws use texture 0 so they sort first
+	uint64_t key = 0;
+	key |= ((uint64_t)packet.shaderID & SHADER_MASK) << SHADER_SHIFT;
+	key |= ((uint64_t)(packet.textureID + 1) & TEXTURE_MASK) << TEXTURE_SHIFT;
+	key |= ((uint64_t)packet.meshID & MESH_MASK) << MESH_SHIFT;
+	key |= ((uint64_t)(packet.materialID + 1) & MATERIAL_MASK) << MATERIAL_SHIFT;
+
+	if (packet.bTransparent == true)
+	{
+		// the state bits move down to make room for the depth
+		key >>= MATERIAL_SHIFT;
+		key |= ((uint64_t)DEPTH_MASK - depth) << FAR_DEPTH_SHIFT;
+		key |= 1ULL << TRANSPARENT_SHIFT;
+	}
+	else
+	{
+		key |= depth;
+	}
+
+	return(key);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used for ordering the submitted packets
+ *  by their sort keys.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+	if (m_packets.size() > 1)
+	{
+		RadixSort();
+	}
+}
+
+/***********************************************************
+ *  RadixSort()
+ *
+ *  This method is used for sorting the packet indices by
+ *  key, one byte per pass starting with the lowest byte.
+ *  Passes where every key has the same byte are skipped,
+ *  which is the common case for the shader byte.
+ ***********************************************************/
+void RenderQueue::RadixSort()
+{
+	size_t count = m_sortedIndices.size();
+	m_scratchIndices.resize(count);
+
+	uint32_t* pSource = m_sortedIndices.data();
+	uint32_t* pDestination = m_scratchIndices.data();
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		int shift = pass * 8;
+		size_t histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+
+		for (size_t i = 0; i < count; i++)
+		{
+			histogram[(m_keys[pSource[i]] >> shift) & 0xFF]++;
+		}
+
+		// skip the pass when every key has the same byte
+		if (histogram[(m_keys[pSource[0]] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// turn the counts into starting offsets
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			size_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t index = pSource[i];
+			pDestination[histogram[(m_keys[index] >> shift) & 0xFF]++] = index;
+		}
+
+		uint32_t* pSwap = pSource;
+		pSource = pDestination;
+		pDestination = pSwap;
+	}
+
+	// make sure the sorted order ends up in m_sortedIndices
+	if (pSource != m_sortedIndices.data())
+	{
+		memcpy(m_sortedIndices.data(), pSource, count * sizeof(uint32_t));
+	}
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method is used for counting the state changes that
+ *  submitting the sorted packets needs.  A state that is the
+ *  same as in the previous packet is elided, and is counted
+ *  as a state change avoided.
+ ***********************************************************/
+void RenderQueue::CountStateChanges()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.packets = (int)m_packets.size();
+
+	const DRAW_PACKET* pLast = NULL;
+	for (size_t i = 0; i < m_sortedIndices.size(); i++)
+	{
+		const DRAW_PACKET& packet = m_packets[m_sortedIndices[i]];
+		if (packet.bTransparent == true)
+		{
+			m_stats.transparentPackets++;
+		}
+
+		if ((pLast == NULL) || (pLast->shaderID != packet.shaderID))
+			m_stats.shaderChanges++;
+		else
+			m_stats.stateChangesAvoided++;
+
+		if ((pLast == NULL) || (pLast->meshID != packet.meshID))
+			m_stats.meshChanges++;
+		else
+			m_stats.stateChangesAvoided++;
+
+		if ((pLast == NULL) || (pLast->textureID != packet.textureID))
+			m_stats.textureChanges++;
+		else
+			m_stats.stateChangesAvoided++;
+
+		if ((pLast == NULL) || (pLast->materialID != packet.materialID))
+			m_stats.materialChanges++;
+		else
+			m_stats.stateChangesAvoided++;
+
+		pLast = &packet;
+	}
+}
+
+/***********************************************************
+ *  CountDrawCommand()
+ *
+ *  This method is used for counting an indirect draw command
+ *  queued for the sorted packets, and whether it was instanced.
+ ***********************************************************/
+void RenderQueue::CountDrawCommand(int instanceCount)
+{
+	m_stats.drawCommands++;
+	if (instanceCount > 1)
+	{
+		m_stats.instancedBatches++;
+	}
+}
+
+/***********************************************************
+ *  CountDrawCall()
+ *
+ *  This method is used for counting a multi-draw call that
+ *  submitted the queued draw commands.
+ ***********************************************************/
+void RenderQueue::CountDrawCall()
+{
+	m_stats.drawCalls++;
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ============
+// collect, sort and submit the draw packets for a frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class collects the draw packets submitted for a
+ *  frame and orders them by a 64-bit sort key so that draws
+ *  sharing a shader, texture, mesh and material are submitted
+ *  together, nearest first.  Transparent packets follow the
+ *  opaque ones, farthest first.  Runs of packets with the same
+ *  shader, texture and mesh can be drawn as one instanced
+ *  indirect draw command.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	// constructor
+	RenderQueue();
+	// destructor
+	~RenderQueue();
+
+	// everything needed to issue one draw command
+	struct DRAW_PACKET
+	{
+		int shaderID;
+		int meshID;
+		int materialID;
+		int textureID;
+		glm::vec2 UVscale;
+		glm::mat4 model;
+		// blended over the opaque packets
+		bool bTransparent;
+	};
+
+	// state change counters for the last flushed frame
+	struct QUEUE_STATS
+	{
+		int packets;
+		int transparentPackets;
+		int shaderChanges;
+		int meshChanges;
+		int textureChanges;
+		int materialChanges;
+		int stateChangesAvoided;
+		int drawCalls;
+		int drawCommands;
+		int instancedBatches;
+	};
+
+	// remove all of the packets from the previous frame
+	void Clear();
+	// set the camera position used for the depth part of the key
+	void SetViewPosition(const glm::vec3& viewPosition);
+	// add a packet to the queue
+	void Submit(const DRAW_PACKET& packet);
+	// order the submitted packets by their sort keys
+	void Sort();
+
+	// number of packets in the queue
+	int GetPacketCount() const { return((int)m_packets.size()); }
+	// get a packet in sorted order
+	const DRAW_PACKET& GetSortedPacket(int index) const { return(m_packets[m_sortedIndices[index]]); }
+
+	// count the state changes needed to submit the sorted packets
+	// and the ones avoided compared to changing every state per draw
+	void CountStateChanges();
+	const QUEUE_STATS& GetStats() const { return(m_stats); }
+	// count an indirect draw command queued for the sorted packets
+	void CountDrawCommand(int instanceCount);
+	// count a multi-draw call that submitted queued commands
+	void CountDrawCall();
+
+	// build the sort key for a packet at a view distance
+	static uint64_t MakeSortKey(const DRAW_PACKET& packet, float viewDistance);
+
+private:
+	// camera position for the depth part of the sort key
+	glm::vec3 m_viewPosition;
+	// packets submitted this frame
+	std::vector<DRAW_PACKET> m_packets;
+	// sort key of each packet
+	std::vector<uint64_t> m_keys;
+	// packet indices in sorted order, and scratch space for sorting
+	std::vector<uint32_t> m_sortedIndices;
+	std::vector<uint32_t> m_scratchIndices;
+	// counters for the last flushed frame
+	QUEUE_STATS m_stats;
+
+	// least significant digit radix sort of the indices by key
+	void RadixSort();
+};
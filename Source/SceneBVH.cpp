@@ -0,0 +1,760 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.cpp
+// ============
+// bounding volume hierarchy over the world space boxes of the scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBVH.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	// objects a node may hold before it is always split
+	const int MAX_LEAF_OBJECTS = 4;
+	// a node with more objects than this is split even when the
+	// surface area heuristic prefers a leaf
+	const int MAX_SAH_LEAF_OBJECTS = 16;
+	// buckets the centroids are sorted into to pick a split
+	const int BIN_COUNT = 16;
+	// subtrees with at least this many objects are built on
+	// the worker threads
+	const int PARALLEL_BUILD_OBJECTS = 4096;
+	// nodes this deep become leaves, which bounds the stacks
+	// of the queries
+	const int MAX_DEPTH = 60;
+	const int STACK_SIZE = 64;
+	// frustum planes, one bit each in the plane masks
+	const int PLANE_COUNT = 6;
+	const int ALL_PLANES = (1 << PLANE_COUNT) - 1;
+
+	/***********************************************************
+	 *  SurfaceArea()
+	 *
+	 *  This function is used for getting the surface area of a
+	 *  box, which is proportional to the chance that a random
+	 *  ray or frustum touches it.
+	 ***********************************************************/
+	float SurfaceArea(const glm::vec3& minimum, const glm::vec3& maximum)
+	{
+		glm::vec3 size = maximum - minimum;
+		return(2.0f * (size.x * size.y + size.y * size.z + size.z * size.x));
+	}
+
+	/***********************************************************
+	 *  IntersectRay()
+	 *
+	 *  This function is used for testing a ray against a box
+	 *  with the slab method.  The distance where the ray enters
+	 *  the box, or zero if it starts inside, is returned in
+	 *  entry.
+	 ***********************************************************/
+	bool IntersectRay(
+		const glm::vec3& origin,
+		const glm::vec3& inverseDirection,
+		const glm::vec3& minimum,
+		const glm::vec3& maximum,
+		float maxDistance,
+		float& entry)
+	{
+		glm::vec3 t0 = (minimum - origin) * inverseDirection;
+		glm::vec3 t1 = (maximum - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		if (enter > exit)
+		{
+			return(false);
+		}
+
+		entry = enter;
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ClassifyBox()
+	 *
+	 *  This function is used for testing a box against the
+	 *  frustum planes set in the mask.  It returns -1 when the
+	 *  box is entirely outside of a plane, and otherwise the
+	 *  mask of the planes it still crosses - zero means it is
+	 *  entirely inside.
+	 ***********************************************************/
+	int ClassifyBox(const glm::vec4* pPlanes, int planeMask, const glm::vec3& minimum, const glm::vec3& maximum)
+	{
+		glm::vec3 center = (minimum + maximum) * 0.5f;
+		glm::vec3 extent = (maximum - minimum) * 0.5f;
+
+		for (int plane = 0; plane < PLANE_COUNT; plane++)
+		{
+			if ((planeMask & (1 << plane)) == 0)
+			{
+				continue;
+			}
+
+			const glm::vec4& p = pPlanes[plane];
+			float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+			float radius = std::fabs(p.x) * extent.x + std::fabs(p.y) * extent.y + std::fabs(p.z) * extent.z;
+			if (distance + radius < 0.0f)
+			{
+				return(-1);
+			}
+			if (distance - radius >= 0.0f)
+			{
+				planeMask &= ~(1 << plane);
+			}
+		}
+
+		return(planeMask);
+	}
+}
+
+/***********************************************************
+ *  SceneBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBVH::SceneBVH()
+{
+	m_nodeCount = 0;
+	m_pendingBuilds = 0;
+	m_pWorkerPool = NULL;
+	m_stats = BVH_STATS();
+}
+
+/***********************************************************
+ *  ~SceneBVH()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneBVH::~SceneBVH()
+{
+	m_pWorkerPool = NULL;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the tree over the boxes
+ *  of the objects.  The nodes are allocated up front, since
+ *  a tree over N objects never has more than 2N-1 of them,
+ *  so the subtrees can be built on several threads at once
+ *  with only a shared counter to hand out the nodes.
+ ***********************************************************/
+void SceneBVH::Build(const std::vector<BOUNDS>& objectBounds, WorkerPool* pWorkerPool)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	int objectCount = (int)objectBounds.size();
+	m_objectBounds = objectBounds;
+	m_objectOrder.resize(objectCount);
+	m_centroids.resize(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		m_objectOrder[i] = i;
+		m_centroids[i] = (objectBounds[i].minimum + objectBounds[i].maximum) * 0.5f;
+	}
+
+	size_t maxNodes = (objectCount > 0) ? (size_t)(2 * objectCount - 1) : 0;
+	m_nodes.assign(maxNodes, BVH_NODE());
+	m_parents.assign(maxNodes, -1);
+	m_objectLeaves.assign(objectCount, -1);
+	m_dirtyLeaves.clear();
+	m_pWorkerPool = pWorkerPool;
+	m_pendingBuilds = 0;
+	m_nodeCount = 0;
+
+	if (objectCount > 0)
+	{
+		m_nodeCount = 1;
+		BuildNode(0, 0, objectCount, 0);
+
+		// wait for the subtrees handed to the worker threads
+		std::unique_lock<std::mutex> lock(m_buildMutex);
+		m_buildDone.wait(lock, [this]() { return(m_pendingBuilds == 0); });
+	}
+
+	m_nodes.resize(m_nodeCount);
+	m_parents.resize(m_nodeCount);
+	m_bLeafDirty.assign(m_nodeCount, 0);
+	m_centroids.clear();
+	m_pWorkerPool = NULL;
+
+	std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	m_stats = BVH_STATS();
+	m_stats.objects = objectCount;
+	m_stats.nodes = m_nodeCount;
+	m_stats.depth = (m_nodeCount > 0) ? MeasureDepth(0, m_stats.leaves) : 0;
+	m_stats.buildMilliseconds = elapsed.count();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing the tree and the boxes.
+ ***********************************************************/
+void SceneBVH::Clear()
+{
+	m_objectBounds.clear();
+	m_objectOrder.clear();
+	m_nodes.clear();
+	m_parents.clear();
+	m_objectLeaves.clear();
+	m_dirtyLeaves.clear();
+	m_bLeafDirty.clear();
+	m_nodeCount = 0;
+	m_stats = BVH_STATS();
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used for splitting the objects of a node
+ *  between two children.  The centroids are sorted into
+ *  bins along the longest axis of their bounds, and the
+ *  split between bins with the lowest surface area cost is
+ *  used.  Small nodes, or nodes that are cheaper to test
+ *  object by object, become leaves.
+ ***********************************************************/
+void SceneBVH::BuildNode(int nodeIndex, int firstObject, int objectCount, int depth)
+{
+	BVH_NODE& node = m_nodes[nodeIndex];
+	node.firstChild = -1;
+	node.firstObject = firstObject;
+	node.objectCount = objectCount;
+	UpdateNodeBounds(nodeIndex);
+
+	bool bLeaf = (objectCount <= MAX_LEAF_OBJECTS) || (depth >= MAX_DEPTH);
+
+	int splitObject = firstObject + objectCount / 2;
+	int* pFirst = &m_objectOrder[firstObject];
+	int* pLast = pFirst + objectCount;
+	if (bLeaf == false)
+	{
+		glm::vec3 centroidMin(FLT_MAX);
+		glm::vec3 centroidMax(-FLT_MAX);
+		for (int* pObject = pFirst; pObject != pLast; pObject++)
+		{
+			centroidMin = glm::min(centroidMin, m_centroids[*pObject]);
+			centroidMax = glm::max(centroidMax, m_centroids[*pObject]);
+		}
+
+		glm::vec3 centroidSize = centroidMax - centroidMin;
+		int axis = 0;
+		if (centroidSize.y > centroidSize[axis])
+		{
+			axis = 1;
+		}
+		if (centroidSize.z > centroidSize[axis])
+		{
+			axis = 2;
+		}
+
+		if (centroidSize[axis] > 0.0f)
+		{
+			// sort the objects into the bins
+			int binCounts[BIN_COUNT] = {};
+			BOUNDS binBounds[BIN_COUNT];
+			for (int bin = 0; bin < BIN_COUNT; bin++)
+			{
+				binBounds[bin].minimum = glm::vec3(FLT_MAX);
+				binBounds[bin].maximum = glm::vec3(-FLT_MAX);
+			}
+
+			float binScale = (float)BIN_COUNT / centroidSize[axis];
+			for (int* pObject = pFirst; pObject != pLast; pObject++)
+			{
+				int bin = std::min((int)((m_centroids[*pObject][axis] - centroidMin[axis]) * binScale), BIN_COUNT - 1);
+				binCounts[bin]++;
+				binBounds[bin].minimum = glm::min(binBounds[bin].minimum, m_objectBounds[*pObject].minimum);
+				binBounds[bin].maximum = glm::max(binBounds[bin].maximum, m_objectBounds[*pObject].maximum);
+			}
+
+			// sweep from the left to get the cost of the objects
+			// on the left of each split
+			float leftCosts[BIN_COUNT];
+			int leftCount = 0;
+			BOUNDS leftBounds = binBounds[0];
+			for (int split = 1; split < BIN_COUNT; split++)
+			{
+				leftCount += binCounts[split - 1];
+				leftBounds.minimum = glm::min(leftBounds.minimum, binBounds[split - 1].minimum);
+				leftBounds.maximum = glm::max(leftBounds.maximum, binBounds[split - 1].maximum);
+				leftCosts[split] = (leftCount > 0) ? leftCount * SurfaceArea(leftBounds.minimum, leftBounds.maximum) : 0.0f;
+			}
+
+			// then from the right, adding the cost of the objects
+			// on the right of each split
+			float bestCost = FLT_MAX;
+			int bestSplit = -1;
+			int rightCount = 0;
+			BOUNDS rightBounds = binBounds[BIN_COUNT - 1];
+			for (int split = BIN_COUNT - 1; split > 0; split--)
+			{
+				rightCount += binCounts[split];
+				rightBounds.minimum = glm::min(rightBounds.minimum, binBounds[split].minimum);
+				rightBounds.maximum = glm::max(rightBounds.maximum, binBounds[split].maximum);
+				if ((rightCount == 0) || (rightCount == objectCount))
+				{
+					continue;
+				}
+
+				float cost = leftCosts[split] + rightCount * SurfaceArea(rightBounds.minimum, rightBounds.maximum);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = split;
+				}
+			}
+
+			// testing the objects of a leaf costs one box each,
+			// and testing children costs their area weighted counts
+			float leafCost = objectCount * SurfaceArea(node.boundsMin, node.boundsMax);
+			if ((bestCost >= leafCost) && (objectCount <= MAX_SAH_LEAF_OBJECTS))
+			{
+				bLeaf = true;
+			}
+			else if (bestSplit > 0)
+			{
+				int* pSplit = std::partition(pFirst, pLast, [&](int objectIndex) {
+					int bin = std::min((int)((m_centroids[objectIndex][axis] - centroidMin[axis]) * binScale), BIN_COUNT - 1);
+					return(bin < bestSplit);
+				});
+				splitObject = firstObject + (int)(pSplit - pFirst);
+			}
+		}
+		else
+		{
+			// the centroids are all at one point, so the order
+			// does not matter and the objects are halved
+			splitObject = firstObject + objectCount / 2;
+		}
+
+		if ((splitObject == firstObject) || (splitObject == firstObject + objectCount))
+		{
+			splitObject = firstObject + objectCount / 2;
+		}
+	}
+
+	if (bLeaf == true)
+	{
+		for (int* pObject = pFirst; pObject != pLast; pObject++)
+		{
+			m_objectLeaves[*pObject] = nodeIndex;
+		}
+		return;
+	}
+
+	// the two children are allocated together, after their parent
+	int childIndex = m_nodeCount.fetch_add(2);
+	node.firstChild = childIndex;
+	m_parents[childIndex] = nodeIndex;
+	m_parents[childIndex + 1] = nodeIndex;
+
+	int leftCount = splitObject - firstObject;
+	int rightCount = objectCount - leftCount;
+	if ((m_pWorkerPool != NULL) && (leftCount >= PARALLEL_BUILD_OBJECTS))
+	{
+		SubmitBuild(childIndex, firstObject, leftCount, depth + 1);
+	}
+	else
+	{
+		BuildNode(childIndex, firstObject, leftCount, depth + 1);
+	}
+	BuildNode(childIndex + 1, splitObject, rightCount, depth + 1);
+}
+
+/***********************************************************
+ *  SubmitBuild()
+ *
+ *  This method is used for building a subtree on one of the
+ *  worker threads.  Build() waits until the count of pending
+ *  subtrees drops back to zero.
+ ***********************************************************/
+void SceneBVH::SubmitBuild(int nodeIndex, int firstObject, int objectCount, int depth)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_buildMutex);
+		m_pendingBuilds++;
+	}
+
+	m_pWorkerPool->Submit([this, nodeIndex, firstObject, objectCount, depth]() {
+		BuildNode(nodeIndex, firstObject, objectCount, depth);
+
+		std::lock_guard<std::mutex> lock(m_buildMutex);
+		m_pendingBuilds--;
+		if (m_pendingBuilds == 0)
+		{
+			m_buildDone.notify_all();
+		}
+	});
+}
+
+/***********************************************************
+ *  UpdateNodeBounds()
+ *
+ *  This method is used for setting the box of a leaf from
+ *  its objects, or of an inner node from its two children.
+ ***********************************************************/
+void SceneBVH::UpdateNodeBounds(int nodeIndex)
+{
+	BVH_NODE& node = m_nodes[nodeIndex];
+
+	if (node.firstChild >= 0)
+	{
+		const BVH_NODE& left = m_nodes[node.firstChild];
+		const BVH_NODE& right = m_nodes[node.firstChild + 1];
+		node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+		node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+		return;
+	}
+
+	node.boundsMin = glm::vec3(FLT_MAX);
+	node.boundsMax = glm::vec3(-FLT_MAX);
+	for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+	{
+		const BOUNDS& bounds = m_objectBounds[m_objectOrder[i]];
+		node.boundsMin = glm::min(node.boundsMin, bounds.minimum);
+		node.boundsMax = glm::max(node.boundsMax, bounds.maximum);
+	}
+}
+
+/***********************************************************
+ *  UpdateObject()
+ *
+ *  This method is used for changing the box of an object
+ *  after it moves.  Its leaf is listed for the next Refit().
+ ***********************************************************/
+void SceneBVH::UpdateObject(int objectIndex, const BOUNDS& bounds)
+{
+	if ((objectIndex < 0) || (objectIndex >= (int)m_objectBounds.size()))
+	{
+		return;
+	}
+
+	m_objectBounds[objectIndex] = bounds;
+
+	int leaf = m_objectLeaves[objectIndex];
+	if ((leaf >= 0) && (m_bLeafDirty[leaf] == 0))
+	{
+		m_bLeafDirty[leaf] = 1;
+		m_dirtyLeaves.push_back(leaf);
+	}
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used for updating the boxes of the nodes
+ *  above the moved objects.  Each listed leaf is refit, and
+ *  the change is carried towards the root until a node's box
+ *  stays the same.  When many leaves moved, every node is
+ *  refit from the last to the first instead, which visits
+ *  each child before its parent.  The splits are kept, so
+ *  the tree should be built again if the objects move far.
+ ***********************************************************/
+int SceneBVH::Refit()
+{
+	int nodesRefit = 0;
+
+	if ((int)m_dirtyLeaves.size() * 4 > m_nodeCount)
+	{
+		for (int i = m_nodeCount - 1; i >= 0; i--)
+		{
+			UpdateNodeBounds(i);
+		}
+		nodesRefit = m_nodeCount;
+	}
+	else
+	{
+		for (size_t i = 0; i < m_dirtyLeaves.size(); i++)
+		{
+			int nodeIndex = m_dirtyLeaves[i];
+			while (nodeIndex >= 0)
+			{
+				glm::vec3 oldMin = m_nodes[nodeIndex].boundsMin;
+				glm::vec3 oldMax = m_nodes[nodeIndex].boundsMax;
+				UpdateNodeBounds(nodeIndex);
+				nodesRefit++;
+
+				if ((m_nodes[nodeIndex].boundsMin == oldMin) && (m_nodes[nodeIndex].boundsMax == oldMax))
+				{
+					break;
+				}
+				nodeIndex = m_parents[nodeIndex];
+			}
+		}
+	}
+
+	for (size_t i = 0; i < m_dirtyLeaves.size(); i++)
+	{
+		m_bLeafDirty[m_dirtyLeaves[i]] = 0;
+	}
+	m_dirtyLeaves.clear();
+
+	m_stats.nodesRefit = nodesRefit;
+	return(nodesRefit);
+}
+
+/***********************************************************
+ *  CullFrustum()
+ *
+ *  This method is used for finding the objects inside or
+ *  crossing the frustum.  A node outside of any plane is
+ *  skipped with everything below it, and a node entirely
+ *  inside a plane is not tested against it again below.
+ *  When a node is inside all of the planes, its whole range
+ *  of objects is marked without visiting its children.
+ ***********************************************************/
+int SceneBVH::CullFrustum(const glm::vec4* pPlanes, std::vector<unsigned char>& visible)
+{
+	ProfileScope scope("CullFrustum");
+
+	visible.assign(m_objectBounds.size(), 0);
+	m_stats.nodesVisited = 0;
+	if (m_nodeCount == 0)
+	{
+		return(0);
+	}
+
+	int visibleCount = 0;
+	int nodeStack[STACK_SIZE];
+	int maskStack[STACK_SIZE];
+	int stackSize = 0;
+	nodeStack[stackSize] = 0;
+	maskStack[stackSize] = ALL_PLANES;
+	stackSize++;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		const BVH_NODE& node = m_nodes[nodeStack[stackSize]];
+		m_stats.nodesVisited++;
+
+		int planeMask = ClassifyBox(pPlanes, maskStack[stackSize], node.boundsMin, node.boundsMax);
+		if (planeMask < 0)
+		{
+			continue;
+		}
+
+		if (planeMask == 0)
+		{
+			for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				visible[m_objectOrder[i]] = 1;
+			}
+			visibleCount += node.objectCount;
+		}
+		else if (node.firstChild < 0)
+		{
+			for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				int objectIndex = m_objectOrder[i];
+				const BOUNDS& bounds = m_objectBounds[objectIndex];
+				if (ClassifyBox(pPlanes, planeMask, bounds.minimum, bounds.maximum) >= 0)
+				{
+					visible[objectIndex] = 1;
+					visibleCount++;
+				}
+			}
+		}
+		else
+		{
+			nodeStack[stackSize] = node.firstChild;
+			maskStack[stackSize] = planeMask;
+			stackSize++;
+			nodeStack[stackSize] = node.firstChild + 1;
+			maskStack[stackSize] = planeMask;
+			stackSize++;
+		}
+	}
+
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  Raycast()
+ *
+ *  This method is used for finding the nearest object whose
+ *  box is hit by a ray.  The nearer child of each node is
+ *  visited first, and nodes that start beyond the nearest
+ *  hit so far are skipped.
+ ***********************************************************/
+int SceneBVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance)
+{
+	m_stats.nodesVisited = 0;
+	if (m_nodeCount == 0)
+	{
+		return(-1);
+	}
+
+	// a zero component divides to a very large value, so the
+	// slabs of that axis never limit the ray
+	glm::vec3 inverseDirection;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float component = direction[axis];
+		if (std::fabs(component) < 1e-20f)
+		{
+			component = (component < 0.0f) ? -1e-20f : 1e-20f;
+		}
+		inverseDirection[axis] = 1.0f / component;
+	}
+
+	int hitObject = -1;
+	float nearest = FLT_MAX;
+	float entry = 0.0f;
+	if (IntersectRay(origin, inverseDirection, m_nodes[0].boundsMin, m_nodes[0].boundsMax, nearest, entry) == false)
+	{
+		return(-1);
+	}
+
+	int nodeStack[STACK_SIZE];
+	float entryStack[STACK_SIZE];
+	int stackSize = 0;
+	nodeStack[stackSize] = 0;
+	entryStack[stackSize] = entry;
+	stackSize++;
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+		if (entryStack[stackSize] >= nearest)
+		{
+			continue;
+		}
+
+		const BVH_NODE& node = m_nodes[nodeStack[stackSize]];
+		m_stats.nodesVisited++;
+
+		if (node.firstChild < 0)
+		{
+			for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				int objectIndex = m_objectOrder[i];
+				const BOUNDS& bounds = m_objectBounds[objectIndex];
+				if ((IntersectRay(origin, inverseDirection, bounds.minimum, bounds.maximum, nearest, entry) == true) &&
+					(entry < nearest))
+				{
+					nearest = entry;
+					hitObject = objectIndex;
+				}
+			}
+			continue;
+		}
+
+		int first = node.firstChild;
+		int second = node.firstChild + 1;
+		float firstEntry = 0.0f;
+		float secondEntry = 0.0f;
+		bool bFirstHit = IntersectRay(origin, inverseDirection, m_nodes[first].boundsMin, m_nodes[first].boundsMax, nearest, firstEntry);
+		bool bSecondHit = IntersectRay(origin, inverseDirection, m_nodes[second].boundsMin, m_nodes[second].boundsMax, nearest, secondEntry);
+
+		// push the farther child first so the nearer one is popped next
+		if ((bFirstHit == true) && (bSecondHit == true) && (firstEntry < secondEntry))
+		{
+			std::swap(first, second);
+			std::swap(firstEntry, secondEntry);
+		}
+		if (bFirstHit == true)
+		{
+			nodeStack[stackSize] = first;
+			entryStack[stackSize] = firstEntry;
+			stackSize++;
+		}
+		if (bSecondHit == true)
+		{
+			nodeStack[stackSize] = second;
+			entryStack[stackSize] = secondEntry;
+			stackSize++;
+		}
+	}
+
+	distance = nearest;
+	return(hitObject);
+}
+
+/***********************************************************
+ *  QuerySphere()
+ *
+ *  This method is used for finding the objects whose boxes
+ *  touch a sphere, such as the reach of a light.  A box
+ *  touches the sphere when its nearest point to the center
+ *  is within the radius.
+ ***********************************************************/
+int SceneBVH::QuerySphere(const glm::vec3& center, float radius, std::vector<int>& objectIndices)
+{
+	m_stats.nodesVisited = 0;
+	if (m_nodeCount == 0)
+	{
+		return(0);
+	}
+
+	float radiusSquared = radius * radius;
+	int found = 0;
+	int nodeStack[STACK_SIZE];
+	int stackSize = 0;
+	nodeStack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const BVH_NODE& node = m_nodes[nodeStack[--stackSize]];
+		m_stats.nodesVisited++;
+
+		glm::vec3 offset = center - glm::clamp(center, node.boundsMin, node.boundsMax);
+		if (glm::dot(offset, offset) > radiusSquared)
+		{
+			continue;
+		}
+
+		if (node.firstChild >= 0)
+		{
+			nodeStack[stackSize++] = node.firstChild;
+			nodeStack[stackSize++] = node.firstChild + 1;
+			continue;
+		}
+
+		for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+		{
+			int objectIndex = m_objectOrder[i];
+			const BOUNDS& bounds = m_objectBounds[objectIndex];
+			offset = center - glm::clamp(center, bounds.minimum, bounds.maximum);
+			if (glm::dot(offset, offset) <= radiusSquared)
+			{
+				objectIndices.push_back(objectIndex);
+				found++;
+			}
+		}
+	}
+
+	return(found);
+}
+
+/***********************************************************
+ *  MeasureDepth()
+ *
+ *  This method is used for getting the depth of the tree
+ *  below a node, and adding up its leaves.
+ ***********************************************************/
+int SceneBVH::MeasureDepth(int nodeIndex, int& leaves) const
+{
+	const BVH_NODE& node = m_nodes[nodeIndex];
+	if (node.firstChild < 0)
+	{
+		leaves++;
+		return(1);
+	}
+
+	int leftDepth = MeasureDepth(node.firstChild, leaves);
+	int rightDepth = MeasureDepth(node.firstChild + 1, leaves);
+	return(1 + std::max(leftDepth, rightDepth));
+}
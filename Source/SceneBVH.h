@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.h
+// ============
+// bounding volume hierarchy over the world space boxes of the scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+class WorkerPool;
+
+/***********************************************************
+ *  SceneBVH
+ *
+ *  This class keeps a binary tree of boxes over the world
+ *  space bounds of the scene objects, so frustum culling,
+ *  ray picking and light queries only visit the parts of
+ *  the scene they can touch.  The tree is split with the
+ *  surface area heuristic over binned centroids, and the
+ *  large subtrees are built on the worker threads.  When a
+ *  few objects move, their leaves are refit and the change
+ *  is carried up to the root, without building it again.
+ ***********************************************************/
+class SceneBVH
+{
+public:
+	// constructor
+	SceneBVH();
+	// destructor
+	~SceneBVH();
+
+	// world space box of one object
+	struct BOUNDS
+	{
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+	};
+
+	// counts from the last build and query
+	struct BVH_STATS
+	{
+		int objects;
+		int nodes;
+		int leaves;
+		int depth;
+		float buildMilliseconds;
+		int nodesRefit;
+		int nodesVisited;
+	};
+
+	// build the tree over the boxes of the objects - the large
+	// subtrees are built on the pool when one is given
+	void Build(const std::vector<BOUNDS>& objectBounds, WorkerPool* pWorkerPool = NULL);
+	// remove the tree and the boxes
+	void Clear();
+
+	// change the box of an object - the tree is updated by the next Refit()
+	void UpdateObject(int objectIndex, const BOUNDS& bounds);
+	// grow or shrink the nodes above the changed objects,
+	// returning how many nodes were changed
+	int Refit();
+
+	// mark the objects inside or crossing the six frustum planes,
+	// with the normals pointing in, returning how many there are
+	int CullFrustum(const glm::vec4* pPlanes, std::vector<unsigned char>& visible);
+	// find the nearest object whose box the ray hits, or -1 -
+	// the direction does not need to be normalized, and the
+	// distance is in multiples of it
+	int Raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance);
+	// add the objects whose boxes touch a sphere to the list,
+	// returning how many were added
+	int QuerySphere(const glm::vec3& center, float radius, std::vector<int>& objectIndices);
+
+	int GetObjectCount() const { return((int)m_objectBounds.size()); }
+	const BOUNDS& GetObjectBounds(int objectIndex) const { return(m_objectBounds[objectIndex]); }
+	const BVH_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// one node of the tree - a leaf has no children and holds
+	// a range of the object order, and an inner node holds the
+	// range of all of the objects below it
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		int firstChild;
+		glm::vec3 boundsMax;
+		int firstObject;
+		int objectCount;
+	};
+
+	// box of each object, by object index
+	std::vector<BOUNDS> m_objectBounds;
+	// object indices in tree order - the objects of a node are
+	// a contiguous range of it
+	std::vector<int> m_objectOrder;
+	// nodes of the tree, the root first and the two children
+	// of a node next to each other
+	std::vector<BVH_NODE> m_nodes;
+	// parent of each node, -1 for the root
+	std::vector<int> m_parents;
+	// leaf node of each object, by object index
+	std::vector<int> m_objectLeaves;
+	// leaves holding moved objects, and whether a leaf is listed
+	std::vector<int> m_dirtyLeaves;
+	std::vector<unsigned char> m_bLeafDirty;
+	// box centers of the objects, only used while building
+	std::vector<glm::vec3> m_centroids;
+
+	// nodes handed out during a build
+	std::atomic<int> m_nodeCount;
+	// subtrees still being built on the pool
+	int m_pendingBuilds;
+	std::mutex m_buildMutex;
+	std::condition_variable m_buildDone;
+	WorkerPool* m_pWorkerPool;
+
+	BVH_STATS m_stats;
+
+	// split a node, or make it a leaf, and build below it
+	void BuildNode(int nodeIndex, int firstObject, int objectCount, int depth);
+	// the same as BuildNode(), on the worker threads
+	void SubmitBuild(int nodeIndex, int firstObject, int objectCount, int depth);
+	// set the box of a node from its objects or its children
+	void UpdateNodeBounds(int nodeIndex);
+	// get the depth of the tree and its leaf count
+	int MeasureDepth(int nodeIndex, int& leaves) const;
+};
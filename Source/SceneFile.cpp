@@ -0,0 +1,695 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// ============
+// load the meshes, textures, materials, lights and objects of a scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+#include "InstancedMeshes.h"
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// declaration of the global variables and defines
+namespace
+{
+	// "SCN1" - identifies a compiled scene file
+	const uint32_t SCENE_MAGIC = 0x314E4353;
+	// bumped whenever the file layout changes
+	const uint32_t SCENE_VERSION = 3;
+	// alignment of the sections in the file
+	const size_t SECTION_ALIGNMENT = 16;
+	// extension of compiled scene files
+	const char* const BINARY_EXTENSION = ".scnb";
+	// most words on one line of scene text
+	const int MAX_TOKENS = 32;
+
+	// the sections of a compiled scene, in file order
+	enum SECTION
+	{
+		SECTION_MESHES = 0,
+		SECTION_TEXTURES,
+		SECTION_MATERIALS,
+		SECTION_LIGHTS,
+		SECTION_POINT_LIGHTS,
+		SECTION_NODES,
+		SECTION_STRINGS,
+		SECTION_COUNT
+	};
+
+	// where a section starts and how many records it has - the
+	// count of the string section is in bytes
+	struct SCENE_SECTION
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// the start of a compiled scene file
+	struct SCENE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		float ambientColor[3];
+		uint32_t padding;
+		SCENE_SECTION sections[SECTION_COUNT];
+	};
+
+	// the names of the basic meshes in scene text
+	struct MESH_NAME
+	{
+		const char* name;
+		int meshID;
+	};
+	const MESH_NAME MESH_NAMES[] =
+	{
+		{ "plane", InstancedMeshes::PLANE_MESH },
+		{ "box", InstancedMeshes::BOX_MESH },
+		{ "cylinder", InstancedMeshes::CYLINDER_MESH },
+		{ "torus", InstancedMeshes::TORUS_MESH }
+	};
+
+	// one word of a line of scene text, pointing into the text
+	struct TOKEN
+	{
+		const char* pText;
+		size_t length;
+	};
+
+	/***********************************************************
+	 *  AlignUp()
+	 *
+	 *  Round a size up to a multiple of the alignment.
+	 ***********************************************************/
+	size_t AlignUp(size_t size, size_t alignment)
+	{
+		return((size + alignment - 1) / alignment * alignment);
+	}
+
+	/***********************************************************
+	 *  SplitLine()
+	 *
+	 *  Split a line of scene text into words, up to a comment,
+	 *  returning how many there are.  The words point into the
+	 *  text, which is not copied.
+	 ***********************************************************/
+	int SplitLine(const char* pLine, const char* pEnd, TOKEN* pTokens)
+	{
+		int tokenCount = 0;
+		const char* p = pLine;
+		while (p < pEnd)
+		{
+			while ((p < pEnd) && ((*p == ' ') || (*p == '\t') || (*p == '\r')))
+			{
+				p++;
+			}
+			if ((p == pEnd) || (*p == '#'))
+			{
+				break;
+			}
+
+			const char* pStart = p;
+			while ((p < pEnd) && (*p != ' ') && (*p != '\t') && (*p != '\r') && (*p != '#'))
+			{
+				p++;
+			}
+			if (tokenCount == MAX_TOKENS)
+			{
+				return(MAX_TOKENS + 1);
+			}
+			pTokens[tokenCount].pText = pStart;
+			pTokens[tokenCount].length = (size_t)(p - pStart);
+			tokenCount++;
+		}
+
+		return(tokenCount);
+	}
+
+	/***********************************************************
+	 *  TokenEquals()
+	 *
+	 *  Whether a word is the given text.
+	 ***********************************************************/
+	bool TokenEquals(const TOKEN& token, const char* text)
+	{
+		return((strlen(text) == token.length) && (strncmp(token.pText, text, token.length) == 0));
+	}
+
+	/***********************************************************
+	 *  ParseFloats()
+	 *
+	 *  Read a run of words as floats, returning false if any of
+	 *  them is not a whole number.  The mapped text has no
+	 *  terminator, so each word is copied to a small buffer
+	 *  before it is converted.
+	 ***********************************************************/
+	bool ParseFloats(const TOKEN* pTokens, int count, float* pValues)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			char buffer[64];
+			if ((pTokens[i].length == 0) || (pTokens[i].length >= sizeof(buffer)))
+			{
+				return(false);
+			}
+			memcpy(buffer, pTokens[i].pText, pTokens[i].length);
+			buffer[pTokens[i].length] = '\0';
+
+			char* pParsed = NULL;
+			pValues[i] = strtof(buffer, &pParsed);
+			if (pParsed != buffer + pTokens[i].length)
+			{
+				return(false);
+			}
+		}
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  STRING_TABLE
+	 *
+	 *  The strings of a scene being compiled, each stored one
+	 *  time however many records use it.  Offset zero is the
+	 *  empty string.
+	 ***********************************************************/
+	struct STRING_TABLE
+	{
+		std::vector<char> bytes;
+		std::unordered_map<std::string, uint32_t> offsets;
+
+		STRING_TABLE()
+		{
+			bytes.push_back('\0');
+			offsets[""] = 0;
+		}
+
+		uint32_t Add(const TOKEN& token)
+		{
+			std::string text(token.pText, token.length);
+			std::unordered_map<std::string, uint32_t>::const_iterator found = offsets.find(text);
+			if (found != offsets.end())
+			{
+				return(found->second);
+			}
+
+			uint32_t offset = (uint32_t)bytes.size();
+			bytes.insert(bytes.end(), text.begin(), text.end());
+			bytes.push_back('\0');
+			offsets[text] = offset;
+			return(offset);
+		}
+	};
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_pMeshes = NULL;
+	m_pTextures = NULL;
+	m_pMaterials = NULL;
+	m_pLights = NULL;
+	m_pPointLights = NULL;
+	m_pNodes = NULL;
+	m_pStrings = NULL;
+	m_meshCount = 0;
+	m_textureCount = 0;
+	m_materialCount = 0;
+	m_lightCount = 0;
+	m_pointLightCount = 0;
+	m_nodeCount = 0;
+	m_stringBytes = 0;
+	m_ambientColor = glm::vec3(0.0f);
+}
+
+/***********************************************************
+ *  ~SceneFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for opening a scene.  A binary scene
+ *  is mapped as it is.  For a text scene, the binary file
+ *  next to it is mapped when it was compiled from the same
+ *  text, and otherwise the text is compiled again first.
+ ***********************************************************/
+bool SceneFile::Open(const std::string& filename)
+{
+	Close();
+
+	size_t extensionLength = strlen(BINARY_EXTENSION);
+	if ((filename.size() > extensionLength) &&
+		(filename.compare(filename.size() - extensionLength, extensionLength, BINARY_EXTENSION) == 0))
+	{
+		return(OpenBinary(filename, 0));
+	}
+
+	size_t dot = filename.find_last_of('.');
+	size_t slash = filename.find_last_of("/\\");
+	std::string binaryFilename =
+		(((dot != std::string::npos) && ((slash == std::string::npos) || (dot > slash))) ?
+			filename.substr(0, dot) : filename) + BINARY_EXTENSION;
+
+	// without the text, a compiled scene is still used
+	MappedFile text;
+	if (text.Open(filename) == false)
+	{
+		return(OpenBinary(binaryFilename, 0));
+	}
+
+	uint64_t sourceHash = TextureCache::HashBytes(text.GetData(), text.GetSize());
+	if (OpenBinary(binaryFilename, sourceHash) == true)
+	{
+		return(true);
+	}
+
+	std::cout << "SceneFile: compiling " << filename << std::endl;
+	if (CompileText(filename, (const char*)text.GetData(), text.GetSize(), sourceHash, binaryFilename) == false)
+	{
+		return(false);
+	}
+
+	return(OpenBinary(binaryFilename, sourceHash));
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for releasing the mapped scene.  The
+ *  records returned by the Get methods are no longer valid.
+ ***********************************************************/
+void SceneFile::Close()
+{
+	m_file.Close();
+	m_pMeshes = NULL;
+	m_pTextures = NULL;
+	m_pMaterials = NULL;
+	m_pLights = NULL;
+	m_pPointLights = NULL;
+	m_pNodes = NULL;
+	m_pStrings = NULL;
+	m_meshCount = 0;
+	m_textureCount = 0;
+	m_materialCount = 0;
+	m_lightCount = 0;
+	m_pointLightCount = 0;
+	m_nodeCount = 0;
+	m_stringBytes = 0;
+	m_ambientColor = glm::vec3(0.0f);
+}
+
+/***********************************************************
+ *  GetString()
+ *
+ *  This method is used for getting a string of the scene by
+ *  its offset in the string table.  An offset outside of the
+ *  table gives the empty string.
+ ***********************************************************/
+const char* SceneFile::GetString(uint32_t offset) const
+{
+	if ((m_pStrings == NULL) || (offset >= m_stringBytes))
+	{
+		return("");
+	}
+
+	return(m_pStrings + offset);
+}
+
+/***********************************************************
+ *  OpenBinary()
+ *
+ *  This method is used for mapping a binary scene.  The
+ *  header is checked, and every section must lie inside the
+ *  file, but the records are not copied - the sections are
+ *  used where they are mapped.
+ ***********************************************************/
+bool SceneFile::OpenBinary(const std::string& filename, uint64_t sourceHash)
+{
+	if (m_file.Open(filename) == false)
+	{
+		return(false);
+	}
+
+	const unsigned char* pData = m_file.GetData();
+	size_t fileSize = m_file.GetSize();
+	if (fileSize < sizeof(SCENE_HEADER))
+	{
+		m_file.Close();
+		return(false);
+	}
+
+	SCENE_HEADER header;
+	memcpy(&header, pData, sizeof(header));
+	if ((header.magic != SCENE_MAGIC) || (header.version != SCENE_VERSION) ||
+		((sourceHash != 0) && (header.sourceHash != sourceHash)))
+	{
+		m_file.Close();
+		return(false);
+	}
+
+	// size of one record of each section
+	const size_t recordSizes[SECTION_COUNT] =
+	{
+		sizeof(int32_t),
+		sizeof(SCENE_TEXTURE),
+		sizeof(SCENE_MATERIAL),
+		sizeof(SCENE_LIGHT),
+		sizeof(SCENE_POINT_LIGHT),
+		sizeof(SCENE_NODE),
+		1
+	};
+	for (int section = 0; section < SECTION_COUNT; section++)
+	{
+		const SCENE_SECTION& range = header.sections[section];
+		if ((range.offset % SECTION_ALIGNMENT != 0) ||
+			(range.offset > fileSize) ||
+			((uint64_t)range.count * recordSizes[section] > fileSize - range.offset))
+		{
+			m_file.Close();
+			return(false);
+		}
+	}
+
+	// the string table must end with a terminator
+	const SCENE_SECTION& strings = header.sections[SECTION_STRINGS];
+	if ((strings.count == 0) || (pData[strings.offset + strings.count - 1] != '\0'))
+	{
+		m_file.Close();
+		return(false);
+	}
+
+	m_pMeshes = reinterpret_cast<const int32_t*>(pData + header.sections[SECTION_MESHES].offset);
+	m_pTextures = reinterpret_cast<const SCENE_TEXTURE*>(pData + header.sections[SECTION_TEXTURES].offset);
+	m_pMaterials = reinterpret_cast<const SCENE_MATERIAL*>(pData + header.sections[SECTION_MATERIALS].offset);
+	m_pLights = reinterpret_cast<const SCENE_LIGHT*>(pData + header.sections[SECTION_LIGHTS].offset);
+	m_pPointLights = reinterpret_cast<const SCENE_POINT_LIGHT*>(pData + header.sections[SECTION_POINT_LIGHTS].offset);
+	m_pNodes = reinterpret_cast<const SCENE_NODE*>(pData + header.sections[SECTION_NODES].offset);
+	m_pStrings = reinterpret_cast<const char*>(pData + strings.offset);
+	m_meshCount = (int)header.sections[SECTION_MESHES].count;
+	m_textureCount = (int)header.sections[SECTION_TEXTURES].count;
+	m_materialCount = (int)header.sections[SECTION_MATERIALS].count;
+	m_lightCount = (int)header.sections[SECTION_LIGHTS].count;
+	m_pointLightCount = (int)header.sections[SECTION_POINT_LIGHTS].count;
+	m_nodeCount = (int)header.sections[SECTION_NODES].count;
+	m_stringBytes = strings.count;
+	m_ambientColor = ToVec3(header.ambientColor);
+
+	std::cout << "SceneFile: mapped " << filename << " with " << m_nodeCount << " nodes, "
+		<< m_materialCount << " materials, " << m_lightCount << " lights and "
+		<< m_pointLightCount << " point lights" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Compile()
+ *
+ *  This method is used for compiling a text scene into a
+ *  binary scene file ahead of time.
+ ***********************************************************/
+bool SceneFile::Compile(const std::string& textFilename, const std::string& binaryFilename)
+{
+	MappedFile text;
+	if (text.Open(textFilename) == false)
+	{
+		std::cout << "SceneFile: could not open " << textFilename << std::endl;
+		return(false);
+	}
+
+	return(CompileText(
+		textFilename,
+		(const char*)text.GetData(),
+		text.GetSize(),
+		TextureCache::HashBytes(text.GetData(), text.GetSize()),
+		binaryFilename));
+}
+
+/***********************************************************
+ *  CompileText()
+ *
+ *  This method is used for compiling scene text into a
+ *  binary scene file.  The text is read line by line where
+ *  it is mapped, and the records of each section are
+ *  collected before the file is written.  The file is
+ *  written under a temporary name and then renamed, so a
+ *  reader never maps a file that is only partly written.
+ ***********************************************************/
+bool SceneFile::CompileText(
+	const std::string& textFilename,
+	const char* pText,
+	size_t textSize,
+	uint64_t sourceHash,
+	const std::string& binaryFilename)
+{
+	std::vector<int32_t> meshes;
+	std::vector<SCENE_TEXTURE> textures;
+	std::vector<SCENE_MATERIAL> materials;
+	std::vector<SCENE_LIGHT> lights;
+	std::vector<SCENE_POINT_LIGHT> pointLights;
+	std::vector<SCENE_NODE> nodes;
+	STRING_TABLE strings;
+	std::unordered_map<std::string, int> nodeIndices;
+	float ambientColor[3] = { 0.0f, 0.0f, 0.0f };
+
+	const char* pEnd = pText + textSize;
+	const char* pLine = pText;
+	int lineNumber = 0;
+	while (pLine < pEnd)
+	{
+		const char* pLineEnd = (const char*)memchr(pLine, '\n', (size_t)(pEnd - pLine));
+		if (NULL == pLineEnd)
+		{
+			pLineEnd = pEnd;
+		}
+		lineNumber++;
+
+		TOKEN tokens[MAX_TOKENS];
+		int tokenCount = SplitLine(pLine, pLineEnd, tokens);
+		pLine = pLineEnd + 1;
+		if (tokenCount == 0)
+		{
+			continue;
+		}
+
+		const TOKEN& keyword = tokens[0];
+		bool bValid = false;
+		if (TokenEquals(keyword, "ambient") && (tokenCount == 4))
+		{
+			bValid = ParseFloats(&tokens[1], 3, ambientColor);
+		}
+		else if (TokenEquals(keyword, "mesh") && (tokenCount == 2))
+		{
+			for (size_t i = 0; i < sizeof(MESH_NAMES) / sizeof(MESH_NAMES[0]); i++)
+			{
+				if (TokenEquals(tokens[1], MESH_NAMES[i].name))
+				{
+					meshes.push_back(MESH_NAMES[i].meshID);
+					bValid = true;
+				}
+			}
+		}
+		else if (TokenEquals(keyword, "texture") && (tokenCount == 3))
+		{
+			SCENE_TEXTURE texture;
+			texture.tag = strings.Add(tokens[1]);
+			texture.filename = strings.Add(tokens[2]);
+			textures.push_back(texture);
+			bValid = true;
+		}
+		else if (TokenEquals(keyword, "material") && ((tokenCount == 13) || (tokenCount == 14)))
+		{
+			// the opacity is optional, and a material without one
+			// is opaque
+			SCENE_MATERIAL material;
+			material.tag = strings.Add(tokens[1]);
+			material.opacity = 1.0f;
+			bValid =
+				ParseFloats(&tokens[2], 1, &material.ambientStrength) &&
+				ParseFloats(&tokens[3], 3, material.ambientColor) &&
+				ParseFloats(&tokens[6], 3, material.diffuseColor) &&
+				ParseFloats(&tokens[9], 3, material.specularColor) &&
+				ParseFloats(&tokens[12], 1, &material.shininess) &&
+				((tokenCount == 13) || ParseFloats(&tokens[13], 1, &material.opacity)) &&
+				(material.opacity >= 0.0f) && (material.opacity <= 1.0f);
+			materials.push_back(material);
+		}
+		else if (TokenEquals(keyword, "light") && (tokenCount == 12))
+		{
+			SCENE_LIGHT light;
+			light.padding = 0;
+			bValid =
+				ParseFloats(&tokens[1], 3, light.position) &&
+				ParseFloats(&tokens[4], 3, light.diffuseColor) &&
+				ParseFloats(&tokens[7], 3, light.specularColor) &&
+				ParseFloats(&tokens[10], 1, &light.focalStrength) &&
+				ParseFloats(&tokens[11], 1, &light.specularIntensity);
+			lights.push_back(light);
+		}
+		else if (TokenEquals(keyword, "pointlight") && (tokenCount == 13))
+		{
+			SCENE_POINT_LIGHT light;
+			bValid =
+				ParseFloats(&tokens[1], 3, light.position) &&
+				ParseFloats(&tokens[4], 1, &light.radius) &&
+				ParseFloats(&tokens[5], 3, light.diffuseColor) &&
+				ParseFloats(&tokens[8], 3, light.specularColor) &&
+				ParseFloats(&tokens[11], 1, &light.focalStrength) &&
+				ParseFloats(&tokens[12], 1, &light.specularIntensity) &&
+				(light.radius > 0.0f);
+			pointLights.push_back(light);
+		}
+		else if ((TokenEquals(keyword, "node") && (tokenCount == 12)) ||
+			(TokenEquals(keyword, "object") && (tokenCount == 15)))
+		{
+			// an object has its mesh, material and texture
+			// between the parent and the transform
+			bool bObject = TokenEquals(keyword, "object");
+			const TOKEN* pTransform = &tokens[bObject ? 6 : 3];
+
+			SCENE_NODE node;
+			node.name = strings.Add(tokens[1]);
+			node.parent = -1;
+			node.meshID = -1;
+			node.material = 0;
+			node.texture = 0;
+			bValid =
+				ParseFloats(&pTransform[0], 3, node.scale) &&
+				ParseFloats(&pTransform[3], 3, node.rotation) &&
+				ParseFloats(&pTransform[6], 3, node.position);
+
+			if (TokenEquals(tokens[2], "-") == false)
+			{
+				std::unordered_map<std::string, int>::const_iterator parent =
+					nodeIndices.find(std::string(tokens[2].pText, tokens[2].length));
+				if (parent == nodeIndices.end())
+				{
+					bValid = false;
+				}
+				else
+				{
+					node.parent = parent->second;
+				}
+			}
+
+			if (bObject == true)
+			{
+				for (size_t i = 0; i < sizeof(MESH_NAMES) / sizeof(MESH_NAMES[0]); i++)
+				{
+					if (TokenEquals(tokens[3], MESH_NAMES[i].name))
+					{
+						node.meshID = MESH_NAMES[i].meshID;
+					}
+				}
+				node.material = strings.Add(tokens[4]);
+				node.texture = TokenEquals(tokens[5], "-") ? 0 : strings.Add(tokens[5]);
+				bValid = bValid && (node.meshID >= 0);
+			}
+
+			std::string name(tokens[1].pText, tokens[1].length);
+			if (nodeIndices.count(name) != 0)
+			{
+				bValid = false;
+			}
+			nodeIndices[name] = (int)nodes.size();
+			nodes.push_back(node);
+		}
+
+		if (bValid == false)
+		{
+			std::cout << "SceneFile: " << textFilename << ":" << lineNumber << ": could not read '"
+				<< std::string(keyword.pText, (size_t)(pLineEnd - keyword.pText)) << "'" << std::endl;
+			return(false);
+		}
+	}
+
+	// the sections follow the header in order, each aligned
+	SCENE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SCENE_MAGIC;
+	header.version = SCENE_VERSION;
+	header.sourceHash = sourceHash;
+	memcpy(header.ambientColor, ambientColor, sizeof(ambientColor));
+
+	const void* sectionData[SECTION_COUNT] =
+	{
+		meshes.data(), textures.data(), materials.data(), lights.data(), pointLights.data(), nodes.data(),
+		strings.bytes.data()
+	};
+	const size_t sectionBytes[SECTION_COUNT] =
+	{
+		meshes.size() * sizeof(int32_t),
+		textures.size() * sizeof(SCENE_TEXTURE),
+		materials.size() * sizeof(SCENE_MATERIAL),
+		lights.size() * sizeof(SCENE_LIGHT),
+		pointLights.size() * sizeof(SCENE_POINT_LIGHT),
+		nodes.size() * sizeof(SCENE_NODE),
+		strings.bytes.size()
+	};
+	const size_t sectionCounts[SECTION_COUNT] =
+	{
+		meshes.size(), textures.size(), materials.size(), lights.size(), pointLights.size(), nodes.size(),
+		strings.bytes.size()
+	};
+
+	size_t offset = AlignUp(sizeof(SCENE_HEADER), SECTION_ALIGNMENT);
+	for (int section = 0; section < SECTION_COUNT; section++)
+	{
+		header.sections[section].offset = (uint32_t)offset;
+		header.sections[section].count = (uint32_t)sectionCounts[section];
+		offset = AlignUp(offset + sectionBytes[section], SECTION_ALIGNMENT);
+	}
+
+	std::string tempFilename = binaryFilename + ".tmp";
+	FILE* pFile = fopen(tempFilename.c_str(), "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "SceneFile: could not write " << binaryFilename << std::endl;
+		return(false);
+	}
+
+	bool bWritten = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+	const unsigned char padding[SECTION_ALIGNMENT] = { 0 };
+	size_t position = sizeof(header);
+	for (int section = 0; (section < SECTION_COUNT) && (bWritten == true); section++)
+	{
+		size_t paddingSize = header.sections[section].offset - position;
+		bWritten =
+			(fwrite(padding, 1, paddingSize, pFile) == paddingSize) &&
+			(fwrite(sectionData[section], 1, sectionBytes[section], pFile) == sectionBytes[section]);
+		position = header.sections[section].offset + sectionBytes[section];
+	}
+
+	if (fclose(pFile) != 0)
+	{
+		bWritten = false;
+	}
+
+	// an older compiled scene is replaced
+	remove(binaryFilename.c_str());
+	if ((bWritten == false) || (rename(tempFilename.c_str(), binaryFilename.c_str()) != 0))
+	{
+		remove(tempFilename.c_str());
+		std::cout << "SceneFile: could not write " << binaryFilename << std::endl;
+		return(false);
+	}
+
+	return(true);
+}
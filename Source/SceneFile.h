@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// load the meshes, textures, materials, lights and objects of a scene
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class reads a scene description.  Scenes are written
+ *  as text, one item per line, and compiled into a binary
+ *  file next to the text the first time they are opened, or
+ *  after the text changes.  The binary file is mapped and its
+ *  records are read in place - every reference in it is an
+ *  offset or an index, so nothing needs fixing up after it
+ *  is mapped.  The text form is:
+ *
+ *    ambient <r g b>
+ *    mesh <plane|box|cylinder|torus>
+ *    texture <tag> <filename>
+ *    material <tag> <ambient strength> <ambient rgb> <diffuse rgb> <specular rgb> <shininess> [opacity]
+ *    light <position xyz> <diffuse rgb> <specular rgb> <focal strength> <specular intensity>
+ *    pointlight <position xyz> <radius> <diffuse rgb> <specular rgb> <focal strength> <specular intensity>
+ *    node <name> <parent|-> <scale xyz> <rotation xyz> <position xyz>
+ *    object <name> <parent|-> <mesh> <material> <texture> <scale xyz> <rotation xyz> <position xyz>
+ *
+ *  A light reaches the whole scene, while a point light
+ *  fades out at its radius.  A material with an opacity
+ *  below one is drawn blended, after the opaque objects.  A
+ *  parent is the name of a node or object defined earlier,
+ *  and everything after a # is a comment.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// constructor
+	SceneFile();
+	// destructor
+	~SceneFile();
+
+	// a texture to load, by the string offsets of its tag and file
+	struct SCENE_TEXTURE
+	{
+		uint32_t tag;
+		uint32_t filename;
+	};
+
+	// the values of a material, and the string offset of its tag
+	struct SCENE_MATERIAL
+	{
+		float ambientColor[3];
+		float ambientStrength;
+		float diffuseColor[3];
+		float shininess;
+		float specularColor[3];
+		uint32_t tag;
+		float opacity;
+	};
+
+	// the values of a light
+	struct SCENE_LIGHT
+	{
+		float position[3];
+		float focalStrength;
+		float diffuseColor[3];
+		float specularIntensity;
+		float specularColor[3];
+		uint32_t padding;
+	};
+
+	// the values of a point light, in the order of the vectors
+	// the light clusters upload - SetupSceneLights() copies them
+	// into those field by field
+	struct SCENE_POINT_LIGHT
+	{
+		float position[3];
+		float radius;
+		float diffuseColor[3];
+		float focalStrength;
+		float specularColor[3];
+		float specularIntensity;
+	};
+
+	// a node of the scene graph, placed relative to the node
+	// at the parent index - objects have a mesh and the string
+	// offsets of their material and texture tags, and the
+	// nodes of assemblies have a mesh of -1
+	struct SCENE_NODE
+	{
+		int32_t parent;
+		int32_t meshID;
+		uint32_t name;
+		uint32_t material;
+		uint32_t texture;
+		float scale[3];
+		float rotation[3];
+		float position[3];
+	};
+
+	// open a scene - a text scene is compiled first when its
+	// binary file is missing or was compiled from other text
+	bool Open(const std::string& filename);
+	// release the mapped scene
+	void Close();
+	bool IsOpen() const { return(m_file.IsOpen()); }
+
+	// compile a text scene into a binary scene file
+	static bool Compile(const std::string& textFilename, const std::string& binaryFilename);
+
+	// the records of the open scene, used in place
+	int GetMeshCount() const { return(m_meshCount); }
+	const int32_t* GetMeshes() const { return(m_pMeshes); }
+	int GetTextureCount() const { return(m_textureCount); }
+	const SCENE_TEXTURE* GetTextures() const { return(m_pTextures); }
+	int GetMaterialCount() const { return(m_materialCount); }
+	const SCENE_MATERIAL* GetMaterials() const { return(m_pMaterials); }
+	int GetLightCount() const { return(m_lightCount); }
+	const SCENE_LIGHT* GetLights() const { return(m_pLights); }
+	int GetPointLightCount() const { return(m_pointLightCount); }
+	const SCENE_POINT_LIGHT* GetPointLights() const { return(m_pPointLights); }
+	int GetNodeCount() const { return(m_nodeCount); }
+	const SCENE_NODE* GetNodes() const { return(m_pNodes); }
+	glm::vec3 GetAmbientColor() const { return(m_ambientColor); }
+
+	// a string from the string table, by its offset
+	const char* GetString(uint32_t offset) const;
+
+	// make a vector from three floats of a record
+	static glm::vec3 ToVec3(const float values[3]) { return(glm::vec3(values[0], values[1], values[2])); }
+
+private:
+	// the mapped binary scene
+	MappedFile m_file;
+
+	// the sections of the mapped scene
+	const int32_t* m_pMeshes;
+	const SCENE_TEXTURE* m_pTextures;
+	const SCENE_MATERIAL* m_pMaterials;
+	const SCENE_LIGHT* m_pLights;
+	const SCENE_POINT_LIGHT* m_pPointLights;
+	const SCENE_NODE* m_pNodes;
+	const char* m_pStrings;
+	int m_meshCount;
+	int m_textureCount;
+	int m_materialCount;
+	int m_lightCount;
+	int m_pointLightCount;
+	int m_nodeCount;
+	uint32_t m_stringBytes;
+	glm::vec3 m_ambientColor;
+
+	// map a binary scene, checking its layout - a source hash
+	// other than zero must match the one it was compiled from
+	bool OpenBinary(const std::string& filename, uint64_t sourceHash);
+	// compile mapped scene text into a binary scene file
+	static bool CompileText(
+		const std::string& textFilename,
+		const char* pText,
+		size_t textSize,
+		uint64_t sourceHash,
+		const std::string& binaryFilename);
+};
@@ -0,0 +1,289 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegraph.cpp
+// ============
+// a hierarchy of nodes placed relative to their parents
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneGraph.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+// declaration of the global variables and defines
+namespace
+{
+	// depths with fewer nodes than this are built on the
+	// calling thread alone
+	const int PARALLEL_DEPTH_NODES = 4096;
+	// fewest nodes given to one thread
+	const int MIN_RANGE_NODES = 1024;
+}
+
+/***********************************************************
+ *  SceneGraph()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneGraph::SceneGraph()
+{
+	m_bOrderDirty = false;
+	m_pendingRanges = 0;
+	m_depthStarts.push_back(0);
+}
+
+/***********************************************************
+ *  ~SceneGraph()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneGraph::~SceneGraph()
+{
+}
+
+/***********************************************************
+ *  AddNode()
+ *
+ *  This method is used for adding a node under a parent that
+ *  was already added.  The depth sorted arrays are sorted
+ *  again by the next Update().
+ ***********************************************************/
+int SceneGraph::AddNode(int parentNode, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ)
+{
+	if (parentNode >= (int)m_parents.size())
+	{
+		parentNode = -1;
+	}
+
+	int node = m_localTransforms.AddTransform(scaleXYZ, rotationDegrees, positionXYZ);
+	m_parents.push_back(parentNode);
+	m_depths.push_back((parentNode >= 0) ? m_depths[parentNode] + 1 : 0);
+	m_bOrderDirty = true;
+
+	return(node);
+}
+
+/***********************************************************
+ *  SetLocalTransform()
+ *
+ *  This method is used for moving a node relative to its
+ *  parent.  The nodes below it move with it in the next
+ *  Update().
+ ***********************************************************/
+void SceneGraph::SetLocalTransform(int node, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ)
+{
+	m_localTransforms.SetTransform(node, scaleXYZ, rotationDegrees, positionXYZ);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all of the nodes.
+ ***********************************************************/
+void SceneGraph::Clear()
+{
+	m_localTransforms.Clear();
+	m_parents.clear();
+	m_depths.clear();
+	m_slots.clear();
+	m_slotNodes.clear();
+	m_slotParents.clear();
+	m_worldMatrices.clear();
+	m_bSlotChanged.clear();
+	m_depthStarts.assign(1, 0);
+	m_updated.clear();
+	m_bOrderDirty = false;
+}
+
+/***********************************************************
+ *  SortByDepth()
+ *
+ *  This method is used for placing the nodes into the depth
+ *  sorted arrays with a counting sort, keeping the order
+ *  they were added in within each depth.  The parents are
+ *  stored as slots, so building a matrix only reads the
+ *  arrays being built.
+ ***********************************************************/
+void SceneGraph::SortByDepth()
+{
+	int nodeCount = (int)m_parents.size();
+	int depthCount = 0;
+	for (int node = 0; node < nodeCount; node++)
+	{
+		depthCount = std::max(depthCount, m_depths[node] + 1);
+	}
+
+	m_depthStarts.assign(depthCount + 1, 0);
+	for (int node = 0; node < nodeCount; node++)
+	{
+		m_depthStarts[m_depths[node] + 1]++;
+	}
+	for (int depth = 0; depth < depthCount; depth++)
+	{
+		m_depthStarts[depth + 1] += m_depthStarts[depth];
+	}
+
+	std::vector<int> nextSlot(m_depthStarts.begin(), m_depthStarts.end() - 1);
+	m_slots.resize(nodeCount);
+	m_slotNodes.resize(nodeCount);
+	for (int node = 0; node < nodeCount; node++)
+	{
+		int slot = nextSlot[m_depths[node]]++;
+		m_slots[node] = slot;
+		m_slotNodes[slot] = node;
+	}
+
+	m_slotParents.resize(nodeCount);
+	for (int slot = 0; slot < nodeCount; slot++)
+	{
+		int parentNode = m_parents[m_slotNodes[slot]];
+		m_slotParents[slot] = (parentNode >= 0) ? m_slots[parentNode] : -1;
+	}
+
+	m_worldMatrices.assign(nodeCount, glm::mat4(1.0f));
+	m_bSlotChanged.assign(nodeCount, 0);
+	m_bOrderDirty = false;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for building the world matrices of
+ *  the nodes that moved.  The local matrices of the changed
+ *  nodes are built first, then each depth from the shallowest
+ *  changed node down multiplies the matrices of the nodes
+ *  that changed, or whose parent did, by their parent's.
+ *  Nothing is done when no node moved.
+ ***********************************************************/
+int SceneGraph::Update(WorkerPool* pWorkerPool)
+{
+	ProfileScope scope("UpdateSceneGraph");
+
+	m_updated.clear();
+
+	bool bSortAll = m_bOrderDirty;
+	if (bSortAll == true)
+	{
+		SortByDepth();
+	}
+	if ((m_localTransforms.Update() == 0) && (bSortAll == false))
+	{
+		return(0);
+	}
+
+	// flag the moved nodes, or all of them after a sort
+	int nodeCount = (int)m_slotNodes.size();
+	int firstDepth = 0;
+	if (bSortAll == true)
+	{
+		std::fill(m_bSlotChanged.begin(), m_bSlotChanged.end(), 1);
+	}
+	else
+	{
+		std::fill(m_bSlotChanged.begin(), m_bSlotChanged.end(), 0);
+		const std::vector<int>& movedNodes = m_localTransforms.GetUpdatedTransforms();
+		firstDepth = (int)m_depthStarts.size();
+		for (size_t i = 0; i < movedNodes.size(); i++)
+		{
+			m_bSlotChanged[m_slots[movedNodes[i]]] = 1;
+			firstDepth = std::min(firstDepth, m_depths[movedNodes[i]]);
+		}
+	}
+
+	for (int depth = firstDepth; depth < GetDepthCount(); depth++)
+	{
+		UpdateDepth(m_depthStarts[depth], m_depthStarts[depth + 1], pWorkerPool);
+	}
+
+	for (int slot = m_depthStarts[firstDepth]; slot < nodeCount; slot++)
+	{
+		if (m_bSlotChanged[slot] != 0)
+		{
+			m_updated.push_back(m_slotNodes[slot]);
+		}
+	}
+
+	return((int)m_updated.size());
+}
+
+/***********************************************************
+ *  UpdateDepth()
+ *
+ *  This method is used for building the world matrices of
+ *  one depth.  A large depth is split into ranges that are
+ *  built on the pool's threads and on this one, and this
+ *  returns when all of them are finished, since the next
+ *  depth reads their matrices.
+ ***********************************************************/
+void SceneGraph::UpdateDepth(int firstSlot, int lastSlot, WorkerPool* pWorkerPool)
+{
+	int slotCount = lastSlot - firstSlot;
+	if ((pWorkerPool == NULL) || (slotCount < PARALLEL_DEPTH_NODES))
+	{
+		UpdateRange(firstSlot, lastSlot);
+		return;
+	}
+
+	int rangeCount = std::min(pWorkerPool->GetThreadCount() + 1, slotCount / MIN_RANGE_NODES);
+	int rangeSize = (slotCount + rangeCount - 1) / rangeCount;
+
+	{
+		std::lock_guard<std::mutex> lock(m_rangeMutex);
+		m_pendingRanges += rangeCount - 1;
+	}
+	for (int range = 1; range < rangeCount; range++)
+	{
+		int rangeFirst = firstSlot + range * rangeSize;
+		int rangeLast = std::min(rangeFirst + rangeSize, lastSlot);
+		pWorkerPool->Submit([this, rangeFirst, rangeLast]() {
+			UpdateRange(rangeFirst, rangeLast);
+
+			std::lock_guard<std::mutex> lock(m_rangeMutex);
+			m_pendingRanges--;
+			if (m_pendingRanges == 0)
+			{
+				m_rangesDone.notify_all();
+			}
+		});
+	}
+
+	// build the first range here while the others run
+	UpdateRange(firstSlot, std::min(firstSlot + rangeSize, lastSlot));
+
+	std::unique_lock<std::mutex> lock(m_rangeMutex);
+	m_rangesDone.wait(lock, [this]() { return(m_pendingRanges == 0); });
+}
+
+/***********************************************************
+ *  UpdateRange()
+ *
+ *  This method is used for building the world matrices of a
+ *  range of slots in one depth.  Only the flags and matrices
+ *  of the range are written.
+ ***********************************************************/
+void SceneGraph::UpdateRange(int firstSlot, int lastSlot)
+{
+	for (int slot = firstSlot; slot < lastSlot; slot++)
+	{
+		int parentSlot = m_slotParents[slot];
+		if ((parentSlot >= 0) && (m_bSlotChanged[parentSlot] != 0))
+		{
+			m_bSlotChanged[slot] = 1;
+		}
+		if (m_bSlotChanged[slot] == 0)
+		{
+			continue;
+		}
+
+		const glm::mat4& localMatrix = m_localTransforms.GetMatrix(m_slotNodes[slot]);
+		if (parentSlot >= 0)
+		{
+			m_worldMatrices[slot] = m_worldMatrices[parentSlot] * localMatrix;
+		}
+		else
+		{
+			m_worldMatrices[slot] = localMatrix;
+		}
+	}
+}
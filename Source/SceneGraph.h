@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegraph.h
+// ============
+// a hierarchy of nodes placed relative to their parents
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TransformStore.h"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+class WorkerPool;
+
+/***********************************************************
+ *  SceneGraph
+ *
+ *  This class keeps a tree of nodes, each placed by a local
+ *  transform relative to its parent, so the parts of an
+ *  assembly move together when the assembly node moves.
+ *  The world matrices are kept in an array sorted by depth,
+ *  where every parent comes before its children and each
+ *  depth is a contiguous range.  Update() goes through the
+ *  depths in order, and the nodes of one depth only read the
+ *  finished matrices of the depth above, so a large depth is
+ *  split between the worker threads.  Only the nodes whose
+ *  local transform or whose parent changed are multiplied.
+ ***********************************************************/
+class SceneGraph
+{
+public:
+	// constructor
+	SceneGraph();
+	// destructor
+	~SceneGraph();
+
+	// add a node under a parent, or a root node for parent -1,
+	// returning its index
+	int AddNode(int parentNode, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ);
+	// change the transform of a node relative to its parent
+	void SetLocalTransform(int node, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ);
+	// remove all of the nodes
+	void Clear();
+
+	// build the world matrices of the changed nodes and the
+	// nodes below them, returning how many were built - the
+	// larger depths are split between the pool's threads
+	int Update(WorkerPool* pWorkerPool = NULL);
+
+	// world matrix of a node as of the last Update()
+	const glm::mat4& GetWorldMatrix(int node) const { return(m_worldMatrices[m_slots[node]]); }
+	int GetParent(int node) const { return(m_parents[node]); }
+	int GetNodeCount() const { return((int)m_parents.size()); }
+	int GetDepthCount() const { return((int)m_depthStarts.size() - 1); }
+
+	// nodes whose world matrices were built by the last Update()
+	const std::vector<int>& GetUpdatedNodes() const { return(m_updated); }
+	int GetLastUpdateCount() const { return((int)m_updated.size()); }
+
+private:
+	// local transforms and matrices, by node index
+	TransformStore m_localTransforms;
+	// parent and depth of each node, by node index
+	std::vector<int> m_parents;
+	std::vector<int> m_depths;
+	// slot of each node in the depth sorted arrays
+	std::vector<int> m_slots;
+
+	// node index, parent slot and world matrix of each slot,
+	// sorted by depth
+	std::vector<int> m_slotNodes;
+	std::vector<int> m_slotParents;
+	std::vector<glm::mat4> m_worldMatrices;
+	// whether the world matrix of a slot changes in this Update()
+	std::vector<unsigned char> m_bSlotChanged;
+	// first slot of each depth, and the slot count at the end
+	std::vector<int> m_depthStarts;
+	// nodes were added since the arrays were sorted
+	bool m_bOrderDirty;
+
+	// nodes built by the last Update()
+	std::vector<int> m_updated;
+
+	// ranges of a depth still being built on the pool
+	int m_pendingRanges;
+	std::mutex m_rangeMutex;
+	std::condition_variable m_rangesDone;
+
+	// sort the nodes into the depth sorted arrays
+	void SortByDepth();
+	// build the world matrices of a range of one depth
+	void UpdateRange(int firstSlot, int lastSlot);
+	// build one depth, split between the pool's threads
+	void UpdateDepth(int firstSlot, int lastSlot, WorkerPool* pWorkerPool);
+};
@@ -8,33 +8,39 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
-
-#ifndef STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-#endif
+#include "Profiler.h"
 
 #include <glm/gtx/transform.hpp>
 
-// declaration of global variables
-namespace
-{
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
-	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
-	const char* g_UseLightingName = "bUseLighting";
-}
+#include <iostream>
 
 /***********************************************************
  *  SceneManager()
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
+SceneManager::SceneManager(
+	ShaderManager *pShaderManager,
+	UniformCache *pUniformCache,
+	UniformBuffers *pUniformBuffers,
+	WorkerPool *pWorkerPool)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pUniformCache = pUniformCache;
+	m_pUniformBuffers = pUniformBuffers;
+	m_pWorkerPool = pWorkerPool;
+	m_sceneFilename = "scenes/desk.scene";
+	m_instancedMeshes = new InstancedMeshes();
+	m_textureManager = new TextureManager();
+	m_textureLoader = new TextureLoader(pWorkerPool, m_textureManager);
+
+	m_cullStats = FrustumCuller::CULL_STATS();
+	m_bPickHeld = false;
+	m_renderMode = FORWARD_RENDERING;
+	m_pProgramCache = NULL;
+	m_opaqueRuns = 0;
+	m_fixedTimeStep = 0.0f;
+	m_lightCount = 0;
 }
 
 /***********************************************************
@@ -45,323 +51,527 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
-	delete m_basicMeshes;
-	m_basicMeshes = NULL;
+	m_pUniformCache = NULL;
+	m_pUniformBuffers = NULL;
+	m_pWorkerPool = NULL;
+	m_pProgramCache = NULL;
+	delete m_instancedMeshes;
+	m_instancedMeshes = NULL;
+	// the loader waits for its decode jobs before the
+	// texture manager they upload into is freed
+	delete m_textureLoader;
+	m_textureLoader = NULL;
+	delete m_textureManager;
+	m_textureManager = NULL;
 }
 
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for starting to load a texture from
+ *  an image file.  The image is decoded on a worker thread,
+ *  and the texture is drawn with a placeholder until it has
+ *  been uploaded.
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
+	return(m_textureLoader->QueueTexture(filename, tag) >= 0);
+}
+
+/***********************************************************
+ *  SetTextureCompression()
+ *
+ *  This method is used for setting whether the textures are
+ *  block compressed when they are cooked, and how hard the
+ *  encoder works at it.
+ ***********************************************************/
+void SceneManager::SetTextureCompression(bool bCompress, BlockCompressor::QUALITY quality)
+{
+	m_textureLoader->SetCompression(bCompress, quality);
+}
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+/***********************************************************
+ *  SetShaderSources()
+ *
+ *  This method is used for setting the program cache and
+ *  the GLSL files the shader variants are built from.
+ ***********************************************************/
+void SceneManager::SetShaderSources(
+	ProgramCache* pProgramCache,
+	const std::string& vertexFilename,
+	const std::string& fragmentFilename)
+{
+	m_shaderVariants.SetSources(pProgramCache, vertexFilename, fragmentFilename);
+	m_gbufferVariants.SetSources(pProgramCache, vertexFilename, fragmentFilename, ShaderPermutations::GBUFFER_PASS);
+	m_pProgramCache = pProgramCache;
+	m_vertexFilename = vertexFilename;
+	m_fragmentFilename = fragmentFilename;
+}
 
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+/***********************************************************
+ *  BuildShaderVariants()
+ *
+ *  This method is used for building the shader variants with
+ *  the light loop unrolled for the lights of the scene, and
+ *  the cluster lookup left out when it has no point lights,
+ *  for both render paths, and the depth prepass program.
+ *  It is called again when the shaders or the lights
+ *  change.
+ ***********************************************************/
+bool SceneManager::BuildShaderVariants()
+{
+	ProfileScope scope("BuildShaderVariants");
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	int lightCount = m_lightCount;
+	bool bClusteredLights = (m_lightClusters.GetLightCount() > 0);
 
-		return true;
+	bool bBuilt = m_shaderVariants.Build(lightCount, bClusteredLights);
+	if (m_gbufferVariants.Build(lightCount, bClusteredLights) == false)
+	{
+		bBuilt = false;
+	}
+	if (m_deferredRenderer.BuildProgram(m_pProgramCache, m_vertexFilename, m_fragmentFilename, lightCount, bClusteredLights) == false)
+	{
+		bBuilt = false;
+	}
+	if (m_depthPrepass.BuildProgram(m_pProgramCache, m_vertexFilename, m_fragmentFilename) == false)
+	{
+		bBuilt = false;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	return(bBuilt);
+}
+
+/***********************************************************
+ *  SetRenderMode()
+ *
+ *  This method is used for selecting whether the scene is
+ *  drawn with forward or deferred shading.
+ ***********************************************************/
+void SceneManager::SetRenderMode(RENDER_MODE renderMode)
+{
+	if (renderMode == m_renderMode)
+	{
+		return;
+	}
 
-	// Error loading the image
-	return false;
+	m_renderMode = renderMode;
+	std::cout << "SceneManager: drawing with "
+		<< ((m_renderMode == DEFERRED_RENDERING) ? "deferred" : "forward") << " shading" << std::endl;
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for packing the loaded textures into
+ *  texture arrays and binding the arrays to texture units.
+ *  The sampler array in the shader gets one unit per array.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	m_textureManager->BuildTextures();
+	m_textureManager->BindTextures();
+
+	SetTextureUnits();
+}
+
+/***********************************************************
+ *  SetTextureUnits()
+ *
+ *  This method is used for pointing the sampler array of the
+ *  bound program at the texture units of the arrays.  A
+ *  program that was linked again needs them set again.
+ ***********************************************************/
+void SceneManager::SetTextureUnits()
+{
+	if (NULL != m_pUniformCache)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		GLint textureUnits[TextureManager::MAX_TEXTURE_ARRAYS];
+		for (int i = 0; i < TextureManager::MAX_TEXTURE_ARRAYS; i++)
+		{
+			textureUnits[i] = i;
+		}
+		m_pUniformCache->SetIntArray(UniformCache::UNIFORM_OBJECT_TEXTURES,
+			TextureManager::MAX_TEXTURE_ARRAYS, textureUnits);
 	}
 }
 
 /***********************************************************
  *  DestroyGLTextures()
  *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  This method is used for freeing the memory of all the
+ *  loaded textures.
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glGenTextures(1, &m_textureIDs[i].ID);
-	}
+	m_textureManager->DestroyTextures();
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  FindTextureIndex()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for getting the texture table index
+ *  of the loaded texture associated with the passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+int SceneManager::FindTextureIndex(std::string tag)
 {
-	int textureID = -1;
+	return(m_textureManager->FindTexture(tag));
+}
+
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  This method is used for getting the index in the material
+ *  table of the defined material associated with the passed
+ *  in tag.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(std::string tag)
+{
+	int materialIndex = -1;
 	int index = 0;
 	bool bFound = false;
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	while ((index < (int)m_objectMaterials.size()) && (bFound == false))
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
 		{
-			textureID = m_textureIDs[index].ID;
+			materialIndex = index;
 			bFound = true;
 		}
 		else
 			index++;
 	}
 
-	return(textureID);
+	return(materialIndex);
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  AddSceneObject()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for adding an object to the scene.
+ *  The material and texture tags are resolved here, one
+ *  time, so rendering the object needs no string lookups.
+ *  It is placed by a scene graph node under the parent node,
+ *  so it moves with the assembly it is a part of.  The
+ *  bounds of the objects are put into the scene's tree once
+ *  they are all placed.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+int SceneManager::AddSceneObject(
+	int meshID,
+	std::string materialTag,
+	std::string textureTag,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	int parentNode)
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
+	SCENE_OBJECT object;
+	object.meshID = meshID;
+	object.materialID = FindMaterialIndex(materialTag);
+	object.textureID = FindTextureIndex(textureTag);
+	object.UVscale = glm::vec2(1.0f, 1.0f);
+	object.nodeID = AddSceneNode(parentNode, scaleXYZ,
+		XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
+
+	m_nodeObjects[object.nodeID] = (int)m_sceneObjects.size();
+	m_sceneObjects.push_back(object);
+
+	return(object.nodeID);
+}
 
-	while ((index < m_loadedTextures) && (bFound == false))
-	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
-	}
+/***********************************************************
+ *  AddSceneNode()
+ *
+ *  This method is used for adding a scene graph node that
+ *  places the objects of an assembly, such as the parts of
+ *  the monitor, relative to it.  It draws nothing itself.
+ ***********************************************************/
+int SceneManager::AddSceneNode(
+	int parentNode,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	int nodeID = m_sceneGraph.AddNode(
+		parentNode,
+		scaleXYZ,
+		glm::vec3(XrotationDegrees, YrotationDegrees, ZrotationDegrees),
+		positionXYZ);
+	m_nodeObjects.push_back(-1);
+
+	return(nodeID);
+}
 
-	return(textureSlot);
+/***********************************************************
+ *  ComputeObjectBounds()
+ *
+ *  This method is used for getting the world space box of a
+ *  placed object from the bounds of its mesh and its built
+ *  matrix.
+ ***********************************************************/
+SceneBVH::BOUNDS SceneManager::ComputeObjectBounds(int objectIndex)
+{
+	glm::vec3 localCenter;
+	glm::vec3 localExtent;
+	glm::vec3 center;
+	glm::vec3 extent;
+	m_instancedMeshes->GetMeshBounds(m_sceneObjects[objectIndex].meshID, localCenter, localExtent);
+	FrustumCuller::TransformBox(
+		m_sceneGraph.GetWorldMatrix(m_sceneObjects[objectIndex].nodeID),
+		localCenter, localExtent, center, extent);
+
+	SceneBVH::BOUNDS bounds;
+	bounds.minimum = center - extent;
+	bounds.maximum = center + extent;
+	return(bounds);
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  BuildSceneBVH()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for building the tree over the boxes
+ *  of the placed objects, which is used for culling and
+ *  picking.  The object index is the index of its box in
+ *  the tree.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+void SceneManager::BuildSceneBVH()
 {
-	if (m_objectMaterials.size() == 0)
-	{
-		return(false);
-	}
+	ProfileScope scope("BuildSceneBVH");
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	// build the matrices of the objects placed so far
+	m_sceneGraph.Update(m_pWorkerPool);
+
+	std::vector<SceneBVH::BOUNDS> objectBounds(m_sceneObjects.size());
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
-		{
-			index++;
-		}
+		objectBounds[i] = ComputeObjectBounds((int)i);
 	}
 
-	return(true);
+	m_sceneBVH.Build(objectBounds, m_pWorkerPool);
+	m_visibleObjects.assign(m_sceneObjects.size(), 1);
+
+	const SceneBVH::BVH_STATS& stats = m_sceneBVH.GetStats();
+	std::cout << "SceneManager: built the scene tree over " << stats.objects << " objects, "
+		<< stats.nodes << " nodes, depth " << stats.depth << ", in "
+		<< stats.buildMilliseconds << "ms" << std::endl;
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  SetNodeTransform()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for moving an object or an assembly
+ *  node relative to its parent.  Only its transformation
+ *  values are changed here - the matrices of the node and
+ *  everything under it, and their boxes in the tree, are
+ *  updated before the next frame is culled.
  ***********************************************************/
-void SceneManager::SetTransformations(
+void SceneManager::SetNodeTransform(
+	int nodeID,
 	glm::vec3 scaleXYZ,
 	float XrotationDegrees,
 	float YrotationDegrees,
 	float ZrotationDegrees,
 	glm::vec3 positionXYZ)
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
-
-	modelView = translation * rotationZ * rotationY * rotationX * scale;
-
-	if (NULL != m_pShaderManager)
+	if ((nodeID < 0) || (nodeID >= m_sceneGraph.GetNodeCount()))
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		return;
 	}
+
+	m_sceneGraph.SetLocalTransform(
+		nodeID,
+		scaleXYZ,
+		glm::vec3(XrotationDegrees, YrotationDegrees, ZrotationDegrees),
+		positionXYZ);
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  PickObject()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for finding the nearest object whose
+ *  box is hit by a ray from the given origin.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+int SceneManager::PickObject(const glm::vec3& origin, const glm::vec3& direction, float& distance)
 {
-	// variables for this method
-	glm::vec4 currentColor;
+	return(m_sceneBVH.Raycast(origin, glm::normalize(direction), distance));
+}
+
+/***********************************************************
+ *  QueueDrawRuns()
+ *
+ *  This method is used for sorting the submitted draw
+ *  packets and queueing them as indirect draw commands.
+ *  Each run of packets that share a shader, texture and mesh
+ *  becomes one command, and the commands that share a shader
+ *  form a draw run that is drawn with one multi-draw call.
+ *  Every texture array is bound for the whole frame, so a
+ *  texture change is only a different index in the draw
+ *  records.  The opaque runs come first, then the
+ *  transparent ones.
+ ***********************************************************/
+void SceneManager::QueueDrawRuns()
+{
+	ProfileScope scope("QueueDrawRuns");
+
+	m_renderQueue.Sort();
+	m_renderQueue.CountStateChanges();
+	m_pUniformBuffers->CommitFrame();
+
+	m_drawRuns.clear();
+	m_opaqueRuns = 0;
 
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+	int packetCount = m_renderQueue.GetPacketCount();
+	int first = 0;
 
-	if (NULL != m_pShaderManager)
+	while (first < packetCount)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		const RenderQueue::DRAW_PACKET& packet = m_renderQueue.GetSortedPacket(first);
+
+		// the packets are sorted by shader first within each
+		// bucket, so a new draw run starts at each switch
+		if ((m_drawRuns.empty() == true) ||
+			(m_drawRuns.back().shaderID != packet.shaderID) ||
+			(m_drawRuns.back().bTransparent != packet.bTransparent))
+		{
+			DRAW_RUN run;
+			run.shaderID = packet.shaderID;
+			run.firstCommand = m_instancedMeshes->GetQueuedCommandCount();
+			run.commandCount = 0;
+			run.bTransparent = packet.bTransparent;
+			m_drawRuns.push_back(run);
+			if (packet.bTransparent == false)
+			{
+				m_opaqueRuns = (int)m_drawRuns.size();
+			}
+		}
+
+		// find the end of the run of packets sharing this mesh
+		int last = first + 1;
+		while (last < packetCount)
+		{
+			const RenderQueue::DRAW_PACKET& next = m_renderQueue.GetSortedPacket(last);
+			if ((next.shaderID != packet.shaderID) ||
+				(next.textureID != packet.textureID) ||
+				(next.meshID != packet.meshID) ||
+				(next.bTransparent != packet.bTransparent))
+			{
+				break;
+			}
+			last++;
+		}
+		int runLength = last - first;
+
+		// every instance carries its own transform and material
+		m_batchInstances.resize(runLength);
+		for (int i = 0; i < runLength; i++)
+		{
+			const RenderQueue::DRAW_PACKET& instance = m_renderQueue.GetSortedPacket(first + i);
+			m_batchInstances[i].model = instance.model;
+			m_batchInstances[i].objectColor = glm::vec4(1.0f);
+			m_batchInstances[i].materialIndex = (instance.materialID >= 0) ? instance.materialID : 0;
+			m_batchInstances[i].textureIndex = instance.textureID;
+			m_batchInstances[i].UVscale = instance.UVscale;
+		}
+
+		int commandCount = m_instancedMeshes->GetQueuedCommandCount();
+		m_instancedMeshes->QueueDraw(packet.meshID, m_batchInstances.data(), runLength);
+		if (m_instancedMeshes->GetQueuedCommandCount() > commandCount)
+		{
+			m_drawRuns.back().commandCount++;
+			m_renderQueue.CountDrawCommand(runLength);
+		}
+
+		first = last;
 	}
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  DrawRuns()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for drawing a range of the queued
+ *  draw runs.  The shader ID of a run selects its program
+ *  from the given variants.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+void SceneManager::DrawRuns(const ShaderPermutations& variants, int firstRun, int lastRun)
 {
-	if (NULL != m_pShaderManager)
+	for (int i = firstRun; i < lastRun; i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		const DRAW_RUN& run = m_drawRuns[i];
+		if (run.commandCount == 0)
+		{
+			continue;
+		}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		if (variants.GetProgram(run.shaderID) != 0)
+		{
+			glUseProgram(variants.GetProgram(run.shaderID));
+		}
+		m_instancedMeshes->DrawQueuedRange(run.firstCommand, run.commandCount, false);
+		m_renderQueue.CountDrawCall();
 	}
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  DrawOpaqueRuns()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for drawing the opaque draw runs,
+ *  with blending off.  When the depth prepass is on, their
+ *  depth is written first with one multi-draw call over the
+ *  position stream, and they are then shaded only where
+ *  they are in front.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+void SceneManager::DrawOpaqueRuns(const ShaderPermutations& variants)
 {
-	if (NULL != m_pShaderManager)
+	ProfileScope scope("DrawOpaqueRuns");
+
+	int opaqueCommands = 0;
+	if (m_opaqueRuns > 0)
+	{
+		opaqueCommands = m_drawRuns[m_opaqueRuns - 1].firstCommand + m_drawRuns[m_opaqueRuns - 1].commandCount;
+	}
+
+	if ((m_depthPrepass.IsEnabled() == true) && (m_depthPrepass.IsReady() == true) && (opaqueCommands > 0))
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		m_gpuTimers.Begin(DEPTH_TIMER);
+		m_depthPrepass.BeginDepthPass();
+		m_instancedMeshes->DrawQueuedRange(0, opaqueCommands, true);
+		m_renderQueue.CountDrawCall();
+		m_depthPrepass.EndDepthPass();
+		m_pShaderManager->use();
+		m_gpuTimers.End(DEPTH_TIMER);
 	}
+
+	m_depthPrepass.BeginShading();
+	DrawRuns(variants, 0, m_opaqueRuns);
+	m_depthPrepass.EndShading();
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  DrawTransparentRuns()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for drawing the transparent draw
+ *  runs, farthest first, blended over what was drawn before.
+ *  They are tested against the depth but do not write it,
+ *  so they do not hide each other.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+void SceneManager::DrawTransparentRuns(const ShaderPermutations& variants)
 {
-	if (m_objectMaterials.size() > 0)
-	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+	ProfileScope scope("DrawTransparentRuns");
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+	if (m_opaqueRuns >= (int)m_drawRuns.size())
+	{
+		return;
 	}
+
+	glEnable(GL_BLEND);
+	glDepthMask(GL_FALSE);
+	DrawRuns(variants, m_opaqueRuns, (int)m_drawRuns.size());
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
 }
 
 /**************************************************************/
@@ -387,6 +597,9 @@ float movementSpeed = 2.5f; // Initial movement speed
 bool firstMouse = true;
 enum ProjectionMode { PERSPECTIVE, ORTHOGRAPHIC };
 ProjectionMode currentProjectionMode = PERSPECTIVE;
+// false while the camera is driven by a path rather than by
+// the keyboard and mouse
+bool cameraInputEnabled = true;
 
 
 // Constants for orthographic camera position
@@ -399,59 +612,337 @@ void mouse_callback(double xpos, double ypos);
 void scroll_callback(double xoffset, double yoffset);
 void ProcessInput();
 
+/***********************************************************
+ *  SetupSceneLights()
+ *
+ *  This method is used for setting the lights of the scene
+ *  description into the per-frame block, and its point
+ *  lights into the light clusters.
+ ***********************************************************/
 void SceneManager::SetupSceneLights()
 {
 	// Enable custom lighting in the shaders
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	m_pUniformBuffers->SetUseLighting(true);
+
+	m_pUniformBuffers->SetGlobalAmbientColor(m_sceneFile.GetAmbientColor());
 
-	m_pShaderManager->setVec3Value("globalAmbientColor", 0.09f, 0.09f, 0.06f); //slight yellow overall so the blue from the monitor stands out
+	const SceneFile::SCENE_LIGHT* pLights = m_sceneFile.GetLights();
+	int lightCount = m_sceneFile.GetLightCount();
+	if (lightCount > UniformBuffers::TOTAL_LIGHTS)
+	{
+		std::cout << "SceneManager: the scene has " << lightCount << " lights, only the first "
+			<< UniformBuffers::TOTAL_LIGHTS << " are used" << std::endl;
+		lightCount = UniformBuffers::TOTAL_LIGHTS;
+	}
+	m_lightCount = lightCount;
 
-	// Overhead light (white light)
-	m_pShaderManager->setVec3Value("lightSources[0].position", 0.0f, 7.0f, 3.0f);
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", 1.0f, 1.0f, 1.0f);
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", 1.0f, 1.0f, 1.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 64.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.15f);
+	for (int i = 0; i < lightCount; i++)
+	{
+		m_pUniformBuffers->SetLightSource(i,
+			SceneFile::ToVec3(pLights[i].position),
+			SceneFile::ToVec3(pLights[i].diffuseColor),
+			SceneFile::ToVec3(pLights[i].specularColor),
+			pLights[i].focalStrength,
+			pLights[i].specularIntensity);
+	}
 
-	// Monitor light (directional)
-	m_pShaderManager->setVec3Value("lightSources[1].position", 0.0f, .5f, -1.3f); // Slightly in front of the screen
-	m_pShaderManager->setVec3Value("lightSources[1].direction", 0.0f, -0.5f, 1.0f); // Direction towards the front
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", 0.5f, 0.5f, 5.0f);
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", 0.5f, 0.5f, 1.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 16.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.01f);
+	// the point lights are only shaded by the clusters they
+	// reach, so a scene can have any number of them
+	const SceneFile::SCENE_POINT_LIGHT* pPointLights = m_sceneFile.GetPointLights();
+	std::vector<LightClusters::POINT_LIGHT> pointLights(m_sceneFile.GetPointLightCount());
+	for (size_t i = 0; i < pointLights.size(); i++)
+	{
+		pointLights[i].positionRadius = glm::vec4(SceneFile::ToVec3(pPointLights[i].position), pPointLights[i].radius);
+		pointLights[i].diffuseColor = glm::vec4(SceneFile::ToVec3(pPointLights[i].diffuseColor), pPointLights[i].focalStrength);
+		pointLights[i].specularColor = glm::vec4(SceneFile::ToVec3(pPointLights[i].specularColor), pPointLights[i].specularIntensity);
+	}
+	m_lightClusters.SetLights(pointLights.data(), (int)pointLights.size());
 }
 
 
+/***********************************************************
+ *  DefineObjectMaterials()
+ *
+ *  This method is used for defining the materials of the
+ *  scene description, by tag.  The material table of the
+ *  shaders has room for MAX_MATERIALS, so the materials
+ *  after those are left out, and the objects that use them
+ *  are drawn with the first material, as when their tag is
+ *  not found.
+ ***********************************************************/
 void SceneManager::DefineObjectMaterials()
 {
-	OBJECT_MATERIAL satinMaterial;
-	satinMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.2f);
-	satinMaterial.ambientStrength = 0.3f;
-	satinMaterial.diffuseColor = glm::vec3(0.8f, 0.8f, 0.8f);
-	satinMaterial.specularColor = glm::vec3(0.5f, 0.5f, 0.5f);
-	satinMaterial.shininess = 22.0f; // Moderate shininess for a satin finish
-	satinMaterial.tag = "satin";
-	m_objectMaterials.push_back(satinMaterial);
+	m_objectMaterials.clear();
+	const SceneFile::SCENE_MATERIAL* pMaterials = m_sceneFile.GetMaterials();
+	int materialCount = m_sceneFile.GetMaterialCount();
+	if (materialCount > UniformBuffers::MAX_MATERIALS)
+	{
+		std::cout << "SceneManager: the scene has " << materialCount << " materials, only the first "
+			<< UniformBuffers::MAX_MATERIALS << " are used" << std::endl;
+		materialCount = UniformBuffers::MAX_MATERIALS;
+	}
+
+	for (int i = 0; i < materialCount; i++)
+	{
+		OBJECT_MATERIAL material;
+		material.ambientColor = SceneFile::ToVec3(pMaterials[i].ambientColor);
+		material.ambientStrength = pMaterials[i].ambientStrength;
+		material.diffuseColor = SceneFile::ToVec3(pMaterials[i].diffuseColor);
+		material.specularColor = SceneFile::ToVec3(pMaterials[i].specularColor);
+		material.shininess = pMaterials[i].shininess;
+		material.opacity = pMaterials[i].opacity;
+		material.tag = m_sceneFile.GetString(pMaterials[i].tag);
+		m_objectMaterials.push_back(material);
+	}
+
+	// build the material table - a material switch is then only
+	// a change of the index in the per-draw block
+	for (int i = 0; i < (int)m_objectMaterials.size(); i++)
+	{
+		m_pUniformBuffers->SetMaterial(i,
+			m_objectMaterials[i].ambientColor,
+			m_objectMaterials[i].ambientStrength,
+			m_objectMaterials[i].diffuseColor,
+			m_objectMaterials[i].specularColor,
+			m_objectMaterials[i].shininess,
+			m_objectMaterials[i].opacity);
+	}
+}
+
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  This method is used for placing the nodes and objects of
+ *  the scene description.  The records are read where the
+ *  scene file is mapped, and a parent always comes before
+ *  the nodes placed relative to it.
+ ***********************************************************/
+void SceneManager::DefineSceneObjects()
+{
+	ProfileScope scope("DefineSceneObjects");
+
+	const SceneFile::SCENE_NODE* pNodes = m_sceneFile.GetNodes();
+	int nodeCount = m_sceneFile.GetNodeCount();
+
+	// scene graph node of each node of the file
+	std::vector<int> fileNodes(nodeCount, -1);
+	for (int i = 0; i < nodeCount; i++)
+	{
+		const SceneFile::SCENE_NODE& node = pNodes[i];
+		int parentNode = ((node.parent >= 0) && (node.parent < i)) ? fileNodes[node.parent] : -1;
+
+		if (node.meshID < 0)
+		{
+			fileNodes[i] = AddSceneNode(parentNode,
+				SceneFile::ToVec3(node.scale),
+				node.rotation[0], node.rotation[1], node.rotation[2],
+				SceneFile::ToVec3(node.position));
+		}
+		else
+		{
+			fileNodes[i] = AddSceneObject(node.meshID,
+				m_sceneFile.GetString(node.material),
+				m_sceneFile.GetString(node.texture),
+				SceneFile::ToVec3(node.scale),
+				node.rotation[0], node.rotation[1], node.rotation[2],
+				SceneFile::ToVec3(node.position),
+				parentNode);
+		}
+	}
+}
+
+/***********************************************************
+ *  LoadSceneMeshes()
+ *
+ *  This method is used for loading the meshes the scene
+ *  lists that are not loaded yet.  All of the meshes share
+ *  one vertex and index buffer so the whole scene can be
+ *  drawn with multi-draw-indirect.
+ ***********************************************************/
+void SceneManager::LoadSceneMeshes()
+{
+	ProfileScope scope("LoadSceneMeshes");
+
+	for (int i = 0; i < m_sceneFile.GetMeshCount(); i++)
+	{
+		int meshID = m_sceneFile.GetMeshes()[i];
+		if (m_instancedMeshes->IsMeshLoaded(meshID) == true)
+		{
+			continue;
+		}
+
+		switch (meshID)
+		{
+		case MESH_PLANE:
+			m_instancedMeshes->LoadPlaneMesh();
+			break;
+		case MESH_BOX:
+			m_instancedMeshes->LoadBoxMesh();
+			break;
+		case MESH_CYLINDER:
+			m_instancedMeshes->LoadCylinderMesh();
+			break;
+		case MESH_TORUS:
+			m_instancedMeshes->LoadTorusMesh();
+			break;
+		}
+	}
+}
+
+/***********************************************************
+ *  LoadSceneTextures()
+ *
+ *  This method is used for starting to load the textures the
+ *  scene lists whose tags are not loaded yet, returning how
+ *  many were started.  The image file of each texture is
+ *  kept by its index, so an edited image can be found.
+ ***********************************************************/
+int SceneManager::LoadSceneTextures()
+{
+	ProfileScope scope("LoadSceneTextures");
 
-	OBJECT_MATERIAL monitorMaterial;
-	monitorMaterial.ambientColor = glm::vec3(0.8f, 0.8f, 10.0f); // Very emissive
-	monitorMaterial.ambientStrength = 1.0f; // Maximum ambient strength
-	monitorMaterial.diffuseColor = glm::vec3(0.6f, 0.6f, 1.0f); // Very bright blue light
-	monitorMaterial.specularColor = glm::vec3(0.5f, 0.5f, 1.0f); // Very bright specular
-	monitorMaterial.shininess = 60.0f; // Higher shininess for more reflection
-	monitorMaterial.tag = "monitor";
-	m_objectMaterials.push_back(monitorMaterial);
+	int textureCount = 0;
+	const SceneFile::SCENE_TEXTURE* pTextures = m_sceneFile.GetTextures();
+	for (int i = 0; i < m_sceneFile.GetTextureCount(); i++)
+	{
+		const char* filename = m_sceneFile.GetString(pTextures[i].filename);
+		const char* tag = m_sceneFile.GetString(pTextures[i].tag);
+		if ((FindTextureIndex(tag) >= 0) || (CreateGLTexture(filename, tag) == false))
+		{
+			continue;
+		}
 
-	OBJECT_MATERIAL greenMaterial;
-	greenMaterial.ambientColor = glm::vec3(0.0f, 3.0f, 0.0f); // Bright green
-	greenMaterial.ambientStrength = 1.0f;
-	greenMaterial.diffuseColor = glm::vec3(0.0f, 3.0f, 0.0f);
-	greenMaterial.specularColor = glm::vec3(0.0f, 3.0f, 0.0f);
-	greenMaterial.shininess = 1.0f;
-	greenMaterial.tag = "green";
-	m_objectMaterials.push_back(greenMaterial);
+		int textureIndex = FindTextureIndex(tag);
+		if (textureIndex >= (int)m_textureFiles.size())
+		{
+			m_textureFiles.resize(textureIndex + 1);
+		}
+		m_textureFiles[textureIndex] = filename;
+		textureCount++;
+	}
 
+	return(textureCount);
+}
+
+/***********************************************************
+ *  GetSourceFiles()
+ *
+ *  This method is used for listing the files the scene was
+ *  loaded from - the scene description and the images of
+ *  its textures.
+ ***********************************************************/
+void SceneManager::GetSourceFiles(std::vector<std::string>& filenames) const
+{
+	filenames.push_back(m_sceneFilename);
+	for (size_t i = 0; i < m_textureFiles.size(); i++)
+	{
+		if (m_textureFiles[i].empty() == false)
+		{
+			filenames.push_back(m_textureFiles[i]);
+		}
+	}
+}
+
+/***********************************************************
+ *  ReloadFile()
+ *
+ *  This method is used for loading a source file of the
+ *  scene again after it was edited, returning false when it
+ *  is not one of them or could not be loaded.  An edited
+ *  image is loaded into its texture in the background.
+ ***********************************************************/
+bool SceneManager::ReloadFile(const std::string& filename)
+{
+	if (filename == m_sceneFilename)
+	{
+		return(ReloadScene());
+	}
+
+	for (size_t i = 0; i < m_textureFiles.size(); i++)
+	{
+		if (m_textureFiles[i] == filename)
+		{
+			return(m_textureLoader->ReloadTexture((int)i, filename.c_str()));
+		}
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  ReloadScene()
+ *
+ *  This method is used for applying an edited scene
+ *  description to the live scene.  The materials and lights
+ *  are set again, and only new meshes and textures are
+ *  loaded.  When the nodes still have the same parents and
+ *  meshes, they are moved in place, so only the matrices and
+ *  boxes of the nodes that moved are rebuilt - otherwise the
+ *  objects are placed again and the tree is rebuilt.
+ ***********************************************************/
+bool SceneManager::ReloadScene()
+{
+	if (m_sceneFile.Open(m_sceneFilename) == false)
+	{
+		std::cout << "SceneManager: could not load the scene " << m_sceneFilename
+			<< " again, the current scene is kept" << std::endl;
+		return(false);
+	}
+
+	LoadSceneMeshes();
+	if (LoadSceneTextures() > 0)
+	{
+		BindGLTextures();
+	}
+	DefineObjectMaterials();
+	SetupSceneLights();
+	if ((m_lightCount != m_shaderVariants.GetLightCount()) ||
+		((m_lightClusters.GetLightCount() > 0) != m_shaderVariants.HasClusteredLights()))
+	{
+		BuildShaderVariants();
+	}
+
+	const SceneFile::SCENE_NODE* pNodes = m_sceneFile.GetNodes();
+	int nodeCount = m_sceneFile.GetNodeCount();
+
+	// the graph nodes were added in the order of the file, so
+	// a node of the file has the same index in the graph
+	bool bSameNodes = (nodeCount == m_sceneGraph.GetNodeCount());
+	for (int i = 0; (i < nodeCount) && (bSameNodes == true); i++)
+	{
+		int parentNode = ((pNodes[i].parent >= 0) && (pNodes[i].parent < i)) ? pNodes[i].parent : -1;
+		int meshID = (m_nodeObjects[i] >= 0) ? m_sceneObjects[m_nodeObjects[i]].meshID : -1;
+		bSameNodes = (parentNode == m_sceneGraph.GetParent(i)) && (pNodes[i].meshID == meshID);
+	}
+
+	if (bSameNodes == true)
+	{
+		for (int i = 0; i < nodeCount; i++)
+		{
+			const SceneFile::SCENE_NODE& node = pNodes[i];
+			SetNodeTransform(i,
+				SceneFile::ToVec3(node.scale),
+				node.rotation[0], node.rotation[1], node.rotation[2],
+				SceneFile::ToVec3(node.position));
+
+			if (m_nodeObjects[i] >= 0)
+			{
+				SCENE_OBJECT& object = m_sceneObjects[m_nodeObjects[i]];
+				object.materialID = FindMaterialIndex(m_sceneFile.GetString(node.material));
+				object.textureID = FindTextureIndex(m_sceneFile.GetString(node.texture));
+			}
+		}
+	}
+	else
+	{
+		m_sceneGraph.Clear();
+		m_nodeObjects.clear();
+		m_sceneObjects.clear();
+		DefineSceneObjects();
+		BuildSceneBVH();
+	}
+
+	return(true);
 }
 
 /***********************************************************
@@ -463,54 +954,59 @@ void SceneManager::DefineObjectMaterials()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	ProfileScope scope("PrepareScene");
+
+	// the meshes, textures, materials, lights and objects all
+	// come from the scene description, which is mapped from its
+	// compiled file rather than parsed
+	if (m_sceneFile.Open(m_sceneFilename) == false)
+	{
+		std::cout << "SceneManager: could not open the scene " << m_sceneFilename << std::endl;
+	}
+
 	// only one instance of a particular mesh needs to be
 	// loaded in memory no matter how many times it is drawn
 	// in the rendered 3D scene
-
-	//Load the plane mesh for the desk
-	m_basicMeshes->LoadPlaneMesh();
-	
-	// Load the box mesh for the keyboard, monitor, and PC tower
-	m_basicMeshes->LoadBoxMesh();
-	
-	// Load the cylinder mesh for the mouse
-	m_basicMeshes->LoadCylinderMesh();
-
-	// Load the torus mesh for the power button
-	m_basicMeshes->LoadTorusMesh();
+	LoadSceneMeshes();
 	
 	// Set up input callbacks
 	glfwSetCursorPosCallback(glfwGetCurrentContext(), [](GLFWwindow*, double xpos, double ypos) { mouse_callback(xpos, ypos); });
 	glfwSetScrollCallback(glfwGetCurrentContext(), [](GLFWwindow*, double xoffset, double yoffset) { scroll_callback(xoffset, yoffset); });
 
-	// Load desk texture
-	CreateGLTexture("textures/desk.jpg", "desk");
-
-	// Load monitor texture
-	CreateGLTexture("textures/monitor.jpg", "monitor");
-
-	// Load keyboard texture
-	CreateGLTexture("textures/keyboard.jpg", "keyboard");
-
-	// Load mouse texture
-	CreateGLTexture("textures/mouse.jpg", "mouse");
-
-	// Load PC tower texture
-	CreateGLTexture("textures/pc_tower.jpg", "pc_tower");
+	// start loading the textures in the background
+	LoadSceneTextures();
 
-	// after the texture image data is loaded into memory, the
-	// loaded textures need to be bound to texture slots - there
-	// are a total of 16 available slots for scene textures
+	// the queued textures are placed into texture arrays that
+	// are bound to texture units for the whole frame, and their
+	// pixels are uploaded by RenderScene() as they are decoded
 	BindGLTextures();
 
 	// Define the materials
 	DefineObjectMaterials();
 
-	// Setup the scene lights
+	// Setup the scene lights, with buffers for the point
+	// lights and the clusters they are listed by
+	m_lightClusters.CreateBuffers();
 	SetupSceneLights();
+
+	// build the shader variants for that many lights
+	BuildShaderVariants();
+
+	// queries for the GPU time of each pass
+	m_gpuTimers.CreateQueries();
+
+	// Place the objects in the scene
+	DefineSceneObjects();
+
+	// build the tree over the placed objects
+	BuildSceneBVH();
 }
 
 void ProcessInput() {
+	if (cameraInputEnabled == false) {
+		return;
+	}
+
 	cameraRight = glm::normalize(glm::cross(cameraFront, cameraUp)); // Calculate the right vector
 	float cameraSpeed = movementSpeed * deltaTime; // Adjust speed based on deltaTime
 
@@ -554,6 +1050,11 @@ void mouse_callback(double xpos, double ypos) {
 	lastX = xpos;
 	lastY = ypos;
 
+	// the mouse is followed, but does not turn the camera
+	if (cameraInputEnabled == false) {
+		return;
+	}
+
 	float sensitivity = 0.1f; 
 	xoffset *= sensitivity;
 	yoffset *= sensitivity;
@@ -580,6 +1081,83 @@ void scroll_callback(double xoffset, double yoffset) {
 		movementSpeed = 1.0f;
 }
 
+/***********************************************************
+ *  SetCamera()
+ *
+ *  This method is used for placing the perspective camera
+ *  from a script rather than from the keyboard and mouse.
+ *  It holds until the camera is moved again.
+ ***********************************************************/
+void SceneManager::SetCamera(const glm::vec3& position, const glm::vec3& target)
+{
+	// the angles the mouse turns the camera from
+	glm::vec3 direction = glm::normalize(target - position);
+	float yawDegrees = glm::degrees(atan2(direction.z, direction.x));
+	float pitchDegrees = glm::degrees(asin(glm::clamp(direction.y, -1.0f, 1.0f)));
+
+	SetCameraView(position, yawDegrees, pitchDegrees);
+}
+
+/***********************************************************
+ *  SetCameraView()
+ *
+ *  This method is used for placing the perspective camera
+ *  at a position, turned by the same angles the mouse turns
+ *  it by, so a camera path can be played back.
+ ***********************************************************/
+void SceneManager::SetCameraView(const glm::vec3& position, float yawDegrees, float pitchDegrees)
+{
+	yaw = yawDegrees;
+	pitch = glm::clamp(pitchDegrees, -89.0f, 89.0f);
+
+	glm::vec3 front;
+	front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+	front.y = sin(glm::radians(pitch));
+	front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+
+	cameraPos = position;
+	cameraFront = glm::normalize(front);
+	currentProjectionMode = PERSPECTIVE;
+}
+
+/***********************************************************
+ *  GetCameraView()
+ *
+ *  This method is used for getting where the perspective
+ *  camera is and the angles it is turned by, so a camera
+ *  path can be recorded.
+ ***********************************************************/
+void SceneManager::GetCameraView(glm::vec3& position, float& yawDegrees, float& pitchDegrees) const
+{
+	position = cameraPos;
+	yawDegrees = yaw;
+	pitchDegrees = pitch;
+}
+
+/***********************************************************
+ *  SetCameraInput()
+ *
+ *  This method is used for letting the keyboard and mouse
+ *  move the camera, or not while a path moves it.
+ ***********************************************************/
+void SceneManager::SetCameraInput(bool bEnabled)
+{
+	cameraInputEnabled = bEnabled;
+	firstMouse = true;
+}
+
+/***********************************************************
+ *  FinishLoading()
+ *
+ *  This method is used for waiting until every texture of
+ *  the scene is loaded and uploaded, for frames that must
+ *  not show the placeholder.
+ ***********************************************************/
+void SceneManager::FinishLoading()
+{
+	m_textureLoader->Finish();
+}
+
 /***********************************************************
  *  RenderScene()
  *
@@ -588,14 +1166,25 @@ void scroll_callback(double xoffset, double yoffset) {
  ***********************************************************/
 void SceneManager::RenderScene()
 {
-	// Update deltaTime
+	ProfileScope scope("RenderScene");
+
+	// Update deltaTime - by the fixed step when one is set, so
+	// every run moves the same
 	float currentFrame = glfwGetTime();
-	deltaTime = currentFrame - lastFrame;
+	deltaTime = (m_fixedTimeStep > 0.0f) ? m_fixedTimeStep : currentFrame - lastFrame;
 	lastFrame = currentFrame;
 
 	// Process keyboard input for camera movement
 	ProcessInput();
 
+	// F and G select forward and deferred shading
+	if (glfwGetKey(glfwGetCurrentContext(), GLFW_KEY_F) == GLFW_PRESS) {
+		SetRenderMode(FORWARD_RENDERING);
+	}
+	if (glfwGetKey(glfwGetCurrentContext(), GLFW_KEY_G) == GLFW_PRESS) {
+		SetRenderMode(DEFERRED_RENDERING);
+	}
+
 	// Calculate view matrix based on current projection mode
 	glm::mat4 view;
 	if (currentProjectionMode == PERSPECTIVE) {
@@ -606,10 +1195,16 @@ void SceneManager::RenderScene()
 		view = glm::lookAt(ORTHO_CAMERA_POS, ORTHO_CAMERA_POS + ORTHO_CAMERA_FRONT, ORTHO_CAMERA_UP);
 	}
 
+	// the shape of the viewport, whether it is the window or
+	// an offscreen target
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	float aspectRatio = (viewport[3] > 0) ? (float)viewport[2] / (float)viewport[3] : 1.0f;
+
 	// Calculate projection matrix based on current projection mode
 	glm::mat4 projection;
 	if (currentProjectionMode == PERSPECTIVE) {
-		projection = glm::perspective(glm::radians(45.0f), (float)800 / (float)600, 0.1f, 100.0f);
+		projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 100.0f);
 	}
 	else {
 		float left = -5.0f, right = 5.0f, bottom = -5.0f, top = 5.0f, zNear = 0.1f, zFar = 100.0f;
@@ -617,117 +1212,126 @@ void SceneManager::RenderScene()
 	}
 	
 	
-	glm::mat4 model = glm::mat4(1.0f);
-
-	// Set shader uniforms for view and projection
-	m_pShaderManager->setMat4Value("view", view);
-	m_pShaderManager->setMat4Value("projection", projection);
-	m_pShaderManager->setVec3Value("viewPosition", cameraPos);
-
-	// Apply transformations
-	glm::vec3 scaleXYZ = glm::vec3(5.0f, 1.0f, 3.0f);
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
-	
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-
-
-	//Render the Scene
-
-
-	// Render the desk
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("satin");
-	SetShaderTexture("desk");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawPlaneMesh();
-
-	// Render the monitor
-
-	// Screen
-	scaleXYZ = glm::vec3(2.0f, 1.2f, 0.1f);
-	XrotationDegrees = -5.0f; // Tilt the screen back by 5 degrees
-	positionXYZ = glm::vec3(0.0f, 1.1f, -1.75f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, 0.0f, 0.0f, positionXYZ);
-	SetShaderMaterial("monitor");
-	SetShaderTexture("monitor");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
-
-	// Body
-	scaleXYZ = glm::vec3(2.1f, 1.3f, 0.3f);
-	XrotationDegrees = -5.0f; 
-	positionXYZ = glm::vec3(0.0f, 1.1f, -1.9f);
+	// upload the textures that finished decoding - until then
+	// they are drawn with the placeholder
+	m_textureLoader->Update();
+
+	// Set the view and projection into the per-frame block
+	m_pUniformBuffers->SetViewProjection(view, projection, cameraPos);
+
+	// list the point lights that reach each cluster of the view
+	m_lightClusters.Assign(view, projection, viewport[2], viewport[3], m_pWorkerPool);
+	m_lightClusters.Upload();
+
+	// build the matrices of the nodes moved since the last
+	// frame and of everything under them, and carry the boxes
+	// of their objects up the tree - the matrices of the nodes
+	// that did not move are reused
+	if (m_sceneGraph.Update(m_pWorkerPool) > 0)
+	{
+		const std::vector<int>& movedNodes = m_sceneGraph.GetUpdatedNodes();
+		for (size_t i = 0; i < movedNodes.size(); i++)
+		{
+			int objectIndex = m_nodeObjects[movedNodes[i]];
+			if (objectIndex >= 0)
+			{
+				m_sceneBVH.UpdateObject(objectIndex, ComputeObjectBounds(objectIndex));
+			}
+		}
+		m_sceneBVH.Refit();
+	}
 
-	SetTransformations(scaleXYZ, XrotationDegrees, 0.0f, 0.0f, positionXYZ);
-	SetShaderMaterial("satin");
-	SetShaderTexture("pc_tower");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
+	// walk the tree of object bounds against the frustum
+	m_frustumCuller.SetFrustum(projection * view);
+	m_cullStats.boxes = (int)m_sceneObjects.size();
+	m_cullStats.visible = m_sceneBVH.CullFrustum(m_frustumCuller.GetPlanes(), m_visibleObjects);
+	m_cullStats.culled = m_cullStats.boxes - m_cullStats.visible;
 
-	// Stand
-	scaleXYZ = glm::vec3(0.3f, 1.0f, 0.25f);
-	XrotationDegrees = 0.0f; 
-	positionXYZ = glm::vec3(0.0f, 0.5f, -1.9f);
+	// pick the object in the middle of the view when the left
+	// mouse button goes down
+	bool bPickDown = (glfwGetMouseButton(glfwGetCurrentContext(), GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS);
+	if ((bPickDown == true) && (m_bPickHeld == false))
+	{
+		glm::vec3 pickOrigin = (currentProjectionMode == PERSPECTIVE) ? cameraPos : ORTHO_CAMERA_POS;
+		glm::vec3 pickDirection = (currentProjectionMode == PERSPECTIVE) ? cameraFront : ORTHO_CAMERA_FRONT;
+		float distance = 0.0f;
+		int objectIndex = PickObject(pickOrigin, pickDirection, distance);
+		if (objectIndex >= 0)
+		{
+			std::cout << "SceneManager: picked object " << objectIndex
+				<< " at distance " << distance << std::endl;
+		}
+	}
+	m_bPickHeld = bPickDown;
 
-	SetTransformations(scaleXYZ, XrotationDegrees, 0.0f, 0.0f, positionXYZ);
-	SetShaderMaterial("satin");
-	SetShaderTexture("pc_tower");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
+	// submit a draw packet for every visible object in the
+	// scene - the queue decides the order that they are drawn in
+	{
+		ProfileScope scope("SubmitDraws");
+		m_instancedMeshes->BeginFrame();
+		m_renderQueue.Clear();
+		m_renderQueue.SetViewPosition(cameraPos);
 
+		// every object is lit while the scene has lights
+		bool bLit = (m_lightCount > 0) || (m_lightClusters.GetLightCount() > 0);
 
-	// Render the keyboard
-	//keys
-	scaleXYZ = glm::vec3(2.4f, 0.2f, 1.0f);
-	positionXYZ = glm::vec3(0.0f, 0.09f, -1.0f);
-	
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("satin");
-	SetShaderTexture("keyboard");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
-
-	//body
-	scaleXYZ = glm::vec3(2.5f, 0.15f, 1.1f);
-	positionXYZ = glm::vec3(0.0f, 0.1f, -1.0f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("satin");
-	SetShaderTexture("pc_tower");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
-
-	// Render the mouse
-	scaleXYZ = glm::vec3(0.3f, 0.1f, 0.4f);
-	positionXYZ = glm::vec3(1.5f, 0.0f, 0.5f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("satin");
-	SetShaderTexture("mouse");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-
-	// Render the PC tower
-	scaleXYZ = glm::vec3(1.0f, 2.5f, 1.5f);
-	positionXYZ = glm::vec3(3.0f, 1.26f, -0.5f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderMaterial("satin");
-	SetShaderTexture("pc_tower");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
-
-	// Render the power button
-	scaleXYZ = glm::vec3(0.1f, 0.1f, 0.1f); // Torus size
-	positionXYZ = glm::vec3(2.7f, 2.0f, 0.25f); // Position on the front of the PC tower
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("mouse");
-	SetShaderMaterial("green");
-	m_basicMeshes->DrawTorusMesh();
+		for (size_t i = 0; i < m_sceneObjects.size(); i++)
+		{
+			if (m_visibleObjects[i] == 0)
+			{
+				continue;
+			}
+
+			const SCENE_OBJECT& object = m_sceneObjects[i];
+			RenderQueue::DRAW_PACKET packet;
+
+			packet.shaderID = ShaderPermutations::ChooseVariant(object.textureID >= 0, bLit);
+			packet.meshID = object.meshID;
+			packet.materialID = object.materialID;
+			packet.textureID = object.textureID;
+			packet.UVscale = object.UVscale;
+			packet.model = m_sceneGraph.GetWorldMatrix(object.nodeID);
+			packet.bTransparent = (object.materialID >= 0) &&
+				(object.materialID < (int)m_objectMaterials.size()) &&
+				(m_objectMaterials[object.materialID].opacity < 1.0f);
+
+			m_renderQueue.Submit(packet);
+		}
+	}
+	QueueDrawRuns();
+
+	// the deferred path draws the opaque surfaces into the
+	// G-buffer and shades them in a second pass - it falls back
+	// to the forward path while the G-buffer cannot be made.
+	// The transparent objects are blended over either one with
+	// the forward variants.
+	if (m_renderMode == DEFERRED_RENDERING)
+	{
+		m_deferredRenderer.Resize(viewport[2], viewport[3]);
+	}
+	if ((m_renderMode == DEFERRED_RENDERING) && (m_deferredRenderer.IsReady() == true))
+	{
+		m_gpuTimers.Begin(GEOMETRY_TIMER);
+		m_deferredRenderer.BeginGeometryPass();
+		DrawOpaqueRuns(m_gbufferVariants);
+		m_deferredRenderer.EndGeometryPass();
+		m_gpuTimers.End(GEOMETRY_TIMER);
+
+		m_gpuTimers.Begin(LIGHTING_TIMER);
+		m_deferredRenderer.LightingPass(view, projection);
+		m_pShaderManager->use();
+		m_gpuTimers.End(LIGHTING_TIMER);
+	}
+	else
+	{
+		m_gpuTimers.Begin(FORWARD_TIMER);
+		DrawOpaqueRuns(m_shaderVariants);
+		m_gpuTimers.End(FORWARD_TIMER);
+	}
+	m_gpuTimers.Begin(TRANSPARENT_TIMER);
+	DrawTransparentRuns(m_shaderVariants);
+	m_gpuTimers.End(TRANSPARENT_TIMER);
+	m_gpuTimers.EndFrame();
+	m_depthPrepass.EndFrame();
 	/****************************************************************/
 }
@@ -10,7 +10,22 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "UniformCache.h"
+#include "UniformBuffers.h"
+#include "RenderQueue.h"
+#include "InstancedMeshes.h"
+#include "FrustumCuller.h"
+#include "LightClusters.h"
+#include "DeferredRenderer.h"
+#include "DepthPrepass.h"
+#include "GpuTimers.h"
+#include "SceneBVH.h"
+#include "SceneGraph.h"
+#include "SceneFile.h"
+#include "ShaderPermutations.h"
+#include "TextureManager.h"
+#include "TextureLoader.h"
+#include "WorkerPool.h"
 
 #include <string>
 #include <vector>
@@ -25,16 +40,14 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	SceneManager(
+		ShaderManager *pShaderManager,
+		UniformCache *pUniformCache,
+		UniformBuffers *pUniformBuffers,
+		WorkerPool *pWorkerPool);
 	// destructor
 	~SceneManager();
 
-	struct TEXTURE_INFO
-	{
-		std::string tag;
-		uint32_t ID;
-	};
-
 	struct OBJECT_MATERIAL
 	{
 		float ambientStrength;
@@ -42,60 +55,184 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
+		float opacity;
 		std::string tag;
 	};
 
+	// the basic meshes that scene objects can be drawn with
+	enum MESH_ID
+	{
+		MESH_PLANE = InstancedMeshes::PLANE_MESH,
+		MESH_BOX = InstancedMeshes::BOX_MESH,
+		MESH_CYLINDER = InstancedMeshes::CYLINDER_MESH,
+		MESH_TORUS = InstancedMeshes::TORUS_MESH,
+		MESH_COUNT = InstancedMeshes::MESH_COUNT
+	};
+
+	// the ways the scene can be drawn - forward shades each
+	// fragment as it is drawn, deferred draws the surfaces into
+	// a G-buffer and shades each pixel once
+	enum RENDER_MODE
+	{
+		FORWARD_RENDERING = 0,
+		DEFERRED_RENDERING
+	};
+
+	// the passes timed on the GPU
+	enum PASS_TIMER
+	{
+		FORWARD_TIMER = 0,
+		GEOMETRY_TIMER,
+		LIGHTING_TIMER,
+		DEPTH_TIMER,
+		TRANSPARENT_TIMER
+	};
+
+	// look of one object in the scene, with the material and
+	// texture tags already resolved to indices, and the scene
+	// graph node it is placed by
+	struct SCENE_OBJECT
+	{
+		int meshID;
+		int materialID;
+		int textureID;
+		glm::vec2 UVscale;
+		int nodeID;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
-	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	// pointer to resolved shader uniform handles
+	UniformCache* m_pUniformCache;
+	// pointer to the shared uniform buffer blocks
+	UniformBuffers* m_pUniformBuffers;
+	// pointer to the basic shapes in the shared mesh buffers
+	InstancedMeshes* m_instancedMeshes;
+	// per-instance values of the batch being queued
+	std::vector<InstancedMeshes::INSTANCE_DATA> m_batchInstances;
+	// loaded textures, packed into texture arrays
+	TextureManager* m_textureManager;
+	// loads the cooked texture images on the worker threads
+	TextureLoader* m_textureLoader;
+	// the scene description, and the file it is opened from
+	SceneFile m_sceneFile;
+	std::string m_sceneFilename;
+	// image file of each texture, by texture index
+	std::vector<std::string> m_textureFiles;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// objects placed in the scene
+	std::vector<SCENE_OBJECT> m_sceneObjects;
+	// placement of the objects and of the assemblies they are
+	// parts of
+	SceneGraph m_sceneGraph;
+	// object placed by each scene graph node, or -1 for the
+	// nodes of assemblies
+	std::vector<int> m_nodeObjects;
+	// draw packets for the current frame
+	RenderQueue m_renderQueue;
+	// programs specialized for textured and lit draws, selected
+	// by the shader ID of a draw packet
+	ShaderPermutations m_shaderVariants;
+	// the same variants built to write the G-buffer, and the
+	// G-buffer with the program that shades it
+	ShaderPermutations m_gbufferVariants;
+	DeferredRenderer m_deferredRenderer;
+	RENDER_MODE m_renderMode;
+	// where the lighting pass is built from
+	ProgramCache* m_pProgramCache;
+	std::string m_vertexFilename;
+	std::string m_fragmentFilename;
+	// GPU time of each pass
+	GpuTimers m_gpuTimers;
+	// writes the depth of the opaque draws before they are shaded
+	DepthPrepass m_depthPrepass;
 
-	// load texture images and convert to OpenGL texture data
+	// the queued commands of a frame that share a shader, and
+	// whether they are blended
+	struct DRAW_RUN
+	{
+		int shaderID;
+		int firstCommand;
+		int commandCount;
+		bool bTransparent;
+	};
+	std::vector<DRAW_RUN> m_drawRuns;
+	// number of runs before the transparent ones
+	int m_opaqueRuns;
+	// worker threads the larger jobs of the scene are run on
+	WorkerPool* m_pWorkerPool;
+	// planes of the view frustum
+	FrustumCuller m_frustumCuller;
+	// tree over the world space bounds of the scene objects
+	SceneBVH m_sceneBVH;
+	// result of the last frustum cull, by object index
+	std::vector<unsigned char> m_visibleObjects;
+	FrustumCuller::CULL_STATS m_cullStats;
+	// number of lights the shader variants are built for
+	int m_lightCount;
+	// the point lights, listed by the view clusters they reach
+	LightClusters m_lightClusters;
+	// whether the pick button was down in the last frame
+	bool m_bPickHeld;
+	// seconds each frame steps the time by, or zero to use the
+	// clock
+	float m_fixedTimeStep;
+
+	// start loading a texture image in the background
 	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
+	// pack the loaded textures into arrays and bind them
 	void BindGLTextures();
+	// load the meshes of the scene that are not loaded yet
+	void LoadSceneMeshes();
+	// start loading the textures of the scene that are not loaded yet
+	int LoadSceneTextures();
+	// apply an edited scene description to the live scene
+	bool ReloadScene();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
-	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
-
-	// set the transformation values 
-	// into the transform buffer
-	void SetTransformations(
+	// find the texture table index of a loaded texture by tag
+	int FindTextureIndex(std::string tag);
+	// find the material table index of a defined material by tag
+	int FindMaterialIndex(std::string tag);
+
+	// get the world space box of a placed object
+	SceneBVH::BOUNDS ComputeObjectBounds(int objectIndex);
+	// build the tree over the placed objects
+	void BuildSceneBVH();
+
+	// add an assembly node that objects can be placed under,
+	// returning its node
+	int AddSceneNode(
+		int parentNode,
 		glm::vec3 scaleXYZ,
 		float XrotationDegrees,
 		float YrotationDegrees,
 		float ZrotationDegrees,
 		glm::vec3 positionXYZ);
 
-	// set the color values into the shader
-	void SetShaderColor(
-		float redColorValue,
-		float greenColorValue,
-		float blueColorValue,
-		float alphaValue);
-
-	// set the texture data into the shader
-	void SetShaderTexture(
-		std::string textureTag);
-
-	// set the UV scale for the texture mapping
-	void SetTextureUVScale(
-		float u, float v);
+	// add an object to the scene, placed relative to a parent
+	// node or to the world, returning its node
+	int AddSceneObject(
+		int meshID,
+		std::string materialTag,
+		std::string textureTag,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		int parentNode = -1);
 
-	// set the object material into the shader
-	void SetShaderMaterial(
-		std::string materialTag);
+	// sort the draw packets and queue them as indirect commands
+	void QueueDrawRuns();
+	// draw a range of the queued runs, one multi-draw call each
+	void DrawRuns(const ShaderPermutations& variants, int firstRun, int lastRun);
+	// draw the opaque runs, after their depth when the prepass is on
+	void DrawOpaqueRuns(const ShaderPermutations& variants);
+	// blend the transparent runs over the opaque ones
+	void DrawTransparentRuns(const ShaderPermutations& variants);
 
 public:
 
@@ -103,6 +240,70 @@ public:
 
 	void DefineObjectMaterials();
 
+	void DefineSceneObjects();
+
+	// set the scene description to load - call before PrepareScene()
+	void SetSceneFile(const std::string& filename) { m_sceneFilename = filename; }
+	// set how the textures are cooked - call before PrepareScene()
+	void SetTextureCompression(bool bCompress, BlockCompressor::QUALITY quality);
+	// set where the shader variants are built from - call before PrepareScene()
+	void SetShaderSources(ProgramCache* pProgramCache, const std::string& vertexFilename, const std::string& fragmentFilename);
+	// build the shader variants for the lights of the scene
+	bool BuildShaderVariants();
+
+	// state change counters of the last rendered frame
+	const RenderQueue::QUEUE_STATS& GetRenderStats() const { return(m_renderQueue.GetStats()); }
+	// visible and culled object counts of the last rendered frame
+	const FrustumCuller::CULL_STATS& GetCullStats() const { return(m_cullStats); }
+	// scene graph matrices built for the last rendered frame
+	int GetMatricesRebuilt() const { return(m_sceneGraph.GetLastUpdateCount()); }
+	// point light counts of the clusters of the last rendered frame
+	const LightClusters::CLUSTER_STATS& GetLightClusterStats() const { return(m_lightClusters.GetStats()); }
+	// average GPU time of each pass, by PASS_TIMER
+	const GpuTimers& GetGpuTimers() const { return(m_gpuTimers); }
+
+	// select how the scene is drawn from the next frame on
+	void SetRenderMode(RENDER_MODE renderMode);
+	RENDER_MODE GetRenderMode() const { return(m_renderMode); }
+	// write the depth of the opaque objects before they are shaded
+	void SetDepthPrepass(bool bEnabled) { m_depthPrepass.SetEnabled(bEnabled); }
+	// fragments shaded and saved by the depth prepass
+	const DepthPrepass& GetDepthPrepass() const { return(m_depthPrepass); }
+
+	// move a scene graph node relative to its parent, with
+	// everything below it - the matrices are built and the
+	// tree is refit before the next frame is culled
+	void SetNodeTransform(
+		int nodeID,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
+	// find the nearest object along a ray, or -1
+	int PickObject(const glm::vec3& origin, const glm::vec3& direction, float& distance);
+
+	// place the camera at a position, looking at a target
+	void SetCamera(const glm::vec3& position, const glm::vec3& target);
+	// place the camera at a position, turned by angles in degrees
+	void SetCameraView(const glm::vec3& position, float yawDegrees, float pitchDegrees);
+	void GetCameraView(glm::vec3& position, float& yawDegrees, float& pitchDegrees) const;
+	// let the keyboard and mouse move the camera, or not
+	void SetCameraInput(bool bEnabled);
+	// step the frame time by a fixed number of seconds rather
+	// than by the clock - zero goes back to the clock
+	void SetFixedTimeStep(float seconds) { m_fixedTimeStep = seconds; }
+	// wait for the textures of the scene to finish loading
+	void FinishLoading();
+
+	// list the files the scene was loaded from
+	void GetSourceFiles(std::vector<std::string>& filenames) const;
+	// load one of those files again after it was edited
+	bool ReloadFile(const std::string& filename);
+	// point the sampler array of the bound program at the
+	// texture arrays - needed after the program is linked again
+	void SetTextureUnits();
+
 	// The following methods are for the students to 
 	// customize for their own 3D scene
 	void PrepareScene();
@@ -0,0 +1,181 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.cpp
+// ============
+// specialized variants of the scene shader program
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPermutations.h"
+#include "ProgramCache.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  ShaderPermutations()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderPermutations::ShaderPermutations()
+{
+	m_pProgramCache = NULL;
+	m_renderPass = FORWARD_PASS;
+	for (int variant = 0; variant < VARIANT_COUNT; variant++)
+	{
+		m_programs[variant] = 0;
+	}
+	m_lightCount = 0;
+	m_bClusteredLights = false;
+}
+
+/***********************************************************
+ *  ~ShaderPermutations()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderPermutations::~ShaderPermutations()
+{
+	Destroy();
+	m_pProgramCache = NULL;
+}
+
+/***********************************************************
+ *  SetSources()
+ *
+ *  This method is used for setting where the variants are
+ *  built from, and which pass they are built for.  It must
+ *  be called before Build().
+ ***********************************************************/
+void ShaderPermutations::SetSources(
+	ProgramCache* pProgramCache,
+	const std::string& vertexFilename,
+	const std::string& fragmentFilename,
+	RENDER_PASS renderPass)
+{
+	m_pProgramCache = pProgramCache;
+	m_vertexFilename = vertexFilename;
+	m_fragmentFilename = fragmentFilename;
+	m_renderPass = renderPass;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the program of every
+ *  variant through the program cache, so after the first
+ *  launch they are loaded as binaries.  The new variants
+ *  only replace the old ones when all of them were built.
+ ***********************************************************/
+bool ShaderPermutations::Build(int lightCount, bool bClusteredLights)
+{
+	if (NULL == m_pProgramCache)
+	{
+		return(false);
+	}
+
+	GLuint programs[VARIANT_COUNT];
+	bool bSuccess = true;
+	for (int variant = 0; variant < VARIANT_COUNT; variant++)
+	{
+		std::vector<std::string> defines;
+		GetDefines(variant, lightCount, bClusteredLights, m_renderPass, defines);
+		programs[variant] = m_pProgramCache->LoadProgram(m_vertexFilename.c_str(), m_fragmentFilename.c_str(), defines);
+		if (programs[variant] == 0)
+		{
+			bSuccess = false;
+		}
+	}
+
+	if (bSuccess == false)
+	{
+		for (int variant = 0; variant < VARIANT_COUNT; variant++)
+		{
+			glDeleteProgram(programs[variant]);
+		}
+		std::cout << "ShaderPermutations: the variants did not build, the old ones are kept" << std::endl;
+		return(false);
+	}
+
+	Destroy();
+	for (int variant = 0; variant < VARIANT_COUNT; variant++)
+	{
+		m_programs[variant] = programs[variant];
+	}
+	m_lightCount = lightCount;
+	m_bClusteredLights = bClusteredLights;
+
+	std::cout << "ShaderPermutations: built " << VARIANT_COUNT << " variants for "
+		<< lightCount << " lights" << ((bClusteredLights == true) ? " and clustered point lights" : "") << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the variant programs.
+ ***********************************************************/
+void ShaderPermutations::Destroy()
+{
+	for (int variant = 0; variant < VARIANT_COUNT; variant++)
+	{
+		if (m_programs[variant] != 0)
+		{
+			glDeleteProgram(m_programs[variant]);
+			m_programs[variant] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  ChooseVariant()
+ *
+ *  This method is used for getting the variant that draws an
+ *  object with or without a texture and lighting.
+ ***********************************************************/
+int ShaderPermutations::ChooseVariant(bool bTextured, bool bLit)
+{
+	int variant = 0;
+	if (bTextured == true)
+	{
+		variant |= VARIANT_TEXTURED;
+	}
+	if (bLit == true)
+	{
+		variant |= VARIANT_LIT;
+	}
+	return(variant);
+}
+
+/***********************************************************
+ *  GetDefines()
+ *
+ *  This method is used for getting the defines that the
+ *  shaders are built with for a variant of a pass.
+ ***********************************************************/
+void ShaderPermutations::GetDefines(
+	int variant,
+	int lightCount,
+	bool bClusteredLights,
+	RENDER_PASS renderPass,
+	std::vector<std::string>& defines)
+{
+	defines.push_back(((variant & VARIANT_TEXTURED) != 0) ? "USE_TEXTURE 1" : "USE_TEXTURE 0");
+	defines.push_back(((variant & VARIANT_LIT) != 0) ? "USE_LIGHTING 1" : "USE_LIGHTING 0");
+	defines.push_back("LIGHT_COUNT " + std::to_string(lightCount));
+	defines.push_back((bClusteredLights == true) ? "CLUSTERED_LIGHTS 1" : "CLUSTERED_LIGHTS 0");
+	defines.push_back("RENDER_PASS " + std::to_string((int)renderPass));
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  This method is used for getting the program of a variant.
+ ***********************************************************/
+GLuint ShaderPermutations::GetProgram(int variant) const
+{
+	if ((variant < 0) || (variant >= VARIANT_COUNT))
+	{
+		return(0);
+	}
+	return(m_programs[variant]);
+}
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.h
+// ============
+// specialized variants of the scene shader program
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+class ProgramCache;
+
+/***********************************************************
+ *  ShaderPermutations
+ *
+ *  This class builds one program for each combination of
+ *  the choices the fragment shader would otherwise make per
+ *  fragment - whether the draw is textured and whether it is
+ *  lit - with the number of lights, and whether there are
+ *  point lights to look up by cluster, fixed as well.  The
+ *  choices are passed as defines, so each variant has no
+ *  branches on them and a light loop that is unrolled.  A
+ *  draw packet selects its variant by its shader ID.
+ ***********************************************************/
+class ShaderPermutations
+{
+public:
+	// constructor
+	ShaderPermutations();
+	// destructor
+	~ShaderPermutations();
+
+	// the choices made by a variant - the variant index is a
+	// combination of these flags
+	enum VARIANT_FLAG
+	{
+		VARIANT_TEXTURED = 1,
+		VARIANT_LIT = 2,
+		VARIANT_COUNT = 4
+	};
+
+	// the passes the variants can be built for - these must
+	// match the defines in the shader code
+	enum RENDER_PASS
+	{
+		FORWARD_PASS = 0,
+		GBUFFER_PASS = 1,
+		LIGHTING_PASS = 2,
+		DEPTH_PASS = 3
+	};
+
+	// set the cache and the GLSL files the variants are built
+	// from, and the pass they draw
+	void SetSources(
+		ProgramCache* pProgramCache,
+		const std::string& vertexFilename,
+		const std::string& fragmentFilename,
+		RENDER_PASS renderPass = FORWARD_PASS);
+	// build every variant for a number of lights, with or
+	// without the clustered point lights - the old variants
+	// are kept when any of the new ones fail to build
+	bool Build(int lightCount, bool bClusteredLights);
+	// free the programs of the variants
+	void Destroy();
+
+	// get the variant index for a draw
+	static int ChooseVariant(bool bTextured, bool bLit);
+	// get the defines that build a variant
+	static void GetDefines(
+		int variant,
+		int lightCount,
+		bool bClusteredLights,
+		RENDER_PASS renderPass,
+		std::vector<std::string>& defines);
+
+	// get the program of a variant, or 0 before they are built
+	GLuint GetProgram(int variant) const;
+	// number of lights the variants were built for
+	int GetLightCount() const { return(m_lightCount); }
+	bool HasClusteredLights() const { return(m_bClusteredLights); }
+	bool IsBuilt() const { return(m_programs[0] != 0); }
+
+private:
+	ProgramCache* m_pProgramCache;
+	std::string m_vertexFilename;
+	std::string m_fragmentFilename;
+	RENDER_PASS m_renderPass;
+	// program of each variant, by variant index
+	GLuint m_programs[VARIANT_COUNT];
+	int m_lightCount;
+	bool m_bClusteredLights;
+};
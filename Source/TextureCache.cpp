@@ -0,0 +1,575 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// cook texture images into memory mappable files with their mip chains
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#ifndef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// "TXC1" - identifies a cooked texture file
+	const uint32_t CACHE_MAGIC = 0x31435854;
+	// bumped whenever the file layout changes
+	const uint32_t CACHE_VERSION = 2;
+	// alignment of the level data in the file
+	const size_t DATA_ALIGNMENT = 16;
+	// bytes in one RGBA texel
+	const int TEXEL_BYTES = 4;
+	// more levels than a 2^31 texture has means a corrupt file
+	const uint32_t MAX_LEVELS = 32;
+
+	// layout of the start of a cooked file
+	struct CACHE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		uint32_t encoderSettings;
+		uint32_t padding;
+		uint64_t sourceHash;
+	};
+
+	// layout of each entry of the level table after the header
+	struct CACHE_LEVEL
+	{
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	/***********************************************************
+	 *  AlignUp()
+	 *
+	 *  Round a size up to a multiple of the alignment.
+	 ***********************************************************/
+	size_t AlignUp(size_t size, size_t alignment)
+	{
+		return((size + alignment - 1) / alignment * alignment);
+	}
+
+	/***********************************************************
+	 *  FlipRows()
+	 *
+	 *  Flip an RGBA image vertically in place, so the first row
+	 *  is the bottom of the image as OpenGL expects.
+	 ***********************************************************/
+	void FlipRows(unsigned char* pPixels, int width, int height)
+	{
+		size_t rowBytes = (size_t)width * TEXEL_BYTES;
+		std::vector<unsigned char> row(rowBytes);
+
+		for (int y = 0; y < height / 2; y++)
+		{
+			unsigned char* pTop = pPixels + y * rowBytes;
+			unsigned char* pBottom = pPixels + (height - 1 - y) * rowBytes;
+			memcpy(row.data(), pTop, rowBytes);
+			memcpy(pTop, pBottom, rowBytes);
+			memcpy(pBottom, row.data(), rowBytes);
+		}
+	}
+
+	/***********************************************************
+	 *  Downsample()
+	 *
+	 *  Build the next mip level of an RGBA image by averaging
+	 *  each 2x2 block.  The last row or column of an odd sized
+	 *  level is averaged with itself.
+	 ***********************************************************/
+	void Downsample(
+		const unsigned char* pSource,
+		int sourceWidth,
+		int sourceHeight,
+		unsigned char* pDestination,
+		int width,
+		int height)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			int y0 = std::min(y * 2, sourceHeight - 1);
+			int y1 = std::min(y * 2 + 1, sourceHeight - 1);
+			const unsigned char* pRow0 = pSource + (size_t)y0 * sourceWidth * TEXEL_BYTES;
+			const unsigned char* pRow1 = pSource + (size_t)y1 * sourceWidth * TEXEL_BYTES;
+
+			for (int x = 0; x < width; x++)
+			{
+				int x0 = std::min(x * 2, sourceWidth - 1) * TEXEL_BYTES;
+				int x1 = std::min(x * 2 + 1, sourceWidth - 1) * TEXEL_BYTES;
+				unsigned char* pTexel = pDestination + ((size_t)y * width + x) * TEXEL_BYTES;
+
+				for (int channel = 0; channel < TEXEL_BYTES; channel++)
+				{
+					int sum = pRow0[x0 + channel] + pRow0[x1 + channel] +
+						pRow1[x0 + channel] + pRow1[x1 + channel];
+					pTexel[channel] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  MakeDirectory()
+	 *
+	 *  Create a directory, which is fine when it already exists.
+	 ***********************************************************/
+	void MakeDirectory(const std::string& path)
+	{
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	}
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache(const std::string& cacheDirectory)
+{
+	m_cacheDirectory = cacheDirectory;
+	m_bCompress = true;
+	m_quality = BlockCompressor::QUALITY_NORMAL;
+}
+
+/***********************************************************
+ *  ~TextureCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureCache::~TextureCache()
+{
+}
+
+/***********************************************************
+ *  SetCompression()
+ *
+ *  This method is used for setting how the levels are
+ *  cooked.  It must be called before any texture is loaded.
+ ***********************************************************/
+void TextureCache::SetCompression(bool bCompress, BlockCompressor::QUALITY quality)
+{
+	m_bCompress = bCompress;
+	m_quality = quality;
+}
+
+/***********************************************************
+ *  ChooseFormat()
+ *
+ *  This method is used for getting the format an image is
+ *  cooked to from the channel count in its header, so the
+ *  format is known before the image is decoded.
+ ***********************************************************/
+int TextureCache::ChooseFormat(int colorChannels) const
+{
+	if (m_bCompress == false)
+	{
+		return(FORMAT_RGBA8);
+	}
+
+	// grey with alpha, or RGB with alpha
+	if ((colorChannels == 2) || (colorChannels == 4))
+	{
+		return(FORMAT_BC3);
+	}
+
+	return(FORMAT_BC1);
+}
+
+/***********************************************************
+ *  GetEncoderSettings()
+ *
+ *  This method is used for getting the compression settings
+ *  as they are stored in a cooked file - 0 for uncompressed,
+ *  and one more than the quality otherwise.
+ ***********************************************************/
+uint32_t TextureCache::GetEncoderSettings() const
+{
+	return((m_bCompress == true) ? (uint32_t)m_quality + 1 : 0);
+}
+
+/***********************************************************
+ *  GetLevelSize()
+ *
+ *  This method is used for getting the number of bytes in a
+ *  level of a format.
+ ***********************************************************/
+size_t TextureCache::GetLevelSize(int format, int width, int height)
+{
+	switch (format)
+	{
+	case FORMAT_RGBA8:
+		return((size_t)width * height * TEXEL_BYTES);
+	case FORMAT_BC1:
+		return(BlockCompressor::GetCompressedSize(width, height, BlockCompressor::BC1_BLOCK_BYTES));
+	case FORMAT_BC3:
+		return(BlockCompressor::GetCompressedSize(width, height, BlockCompressor::BC3_BLOCK_BYTES));
+	}
+	return(0);
+}
+
+/***********************************************************
+ *  HashBytes()
+ *
+ *  This method is used for hashing a block of bytes with the
+ *  64-bit FNV-1a hash.
+ ***********************************************************/
+uint64_t TextureCache::HashBytes(const unsigned char* pData, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= pData[i];
+		hash *= 1099511628211ull;
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  GetCachePath()
+ *
+ *  This method is used for getting the name of the cooked
+ *  file for a source hash.
+ ***********************************************************/
+std::string TextureCache::GetCachePath(uint64_t sourceHash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)sourceHash);
+	return(m_cacheDirectory + "/" + name);
+}
+
+/***********************************************************
+ *  LoadTexture()
+ *
+ *  This method is used for getting every mip level of a
+ *  source image.  The source file is mapped and hashed, and
+ *  when a cooked file with that hash exists its levels are
+ *  used straight from the mapping.  Otherwise the image is
+ *  decoded, its mip chain built, and the cooked file written
+ *  for the next run.
+ ***********************************************************/
+bool TextureCache::LoadTexture(const std::string& sourceFilename, CACHED_TEXTURE& texture)
+{
+	MappedFile source;
+	if (source.Open(sourceFilename) == false)
+	{
+		return(false);
+	}
+
+	uint64_t sourceHash = HashBytes(source.GetData(), source.GetSize());
+	std::string cachePath = GetCachePath(sourceHash);
+
+	if (texture.file.Open(cachePath) == true)
+	{
+		if (ReadCacheFile(sourceHash, texture) == true)
+		{
+			return(true);
+		}
+
+		std::cout << "TextureCache: cooking again over " << cachePath << std::endl;
+		texture.file.Close();
+	}
+
+	if (CookImage(source.GetData(), source.GetSize(), texture) == false)
+	{
+		return(false);
+	}
+
+	// a failed write only costs the next run another decode
+	WriteCacheFile(cachePath, sourceHash, texture);
+
+	return(true);
+}
+
+/***********************************************************
+ *  CookTexture()
+ *
+ *  This method is used for cooking a source image ahead of
+ *  time, when there is no valid cooked file for it yet.
+ ***********************************************************/
+bool TextureCache::CookTexture(const std::string& sourceFilename)
+{
+	CACHED_TEXTURE texture;
+	if (LoadTexture(sourceFilename, texture) == false)
+	{
+		std::cout << "TextureCache: could not cook " << sourceFilename << std::endl;
+		return(false);
+	}
+
+	std::cout << "TextureCache: " << sourceFilename << " " << texture.width << "x" << texture.height
+		<< ", " << texture.levels.size() << " levels" << ((texture.bFromCache == true) ? ", already cooked" : ", cooked") << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  ReadCacheFile()
+ *
+ *  This method is used for checking the header and level
+ *  table of a mapped cooked file and pointing the levels of
+ *  the texture into the mapping.
+ ***********************************************************/
+bool TextureCache::ReadCacheFile(uint64_t sourceHash, CACHED_TEXTURE& texture) const
+{
+	const unsigned char* pData = texture.file.GetData();
+	size_t fileSize = texture.file.GetSize();
+
+	if (fileSize < sizeof(CACHE_HEADER))
+	{
+		return(false);
+	}
+
+	CACHE_HEADER header;
+	memcpy(&header, pData, sizeof(header));
+	if ((header.magic != CACHE_MAGIC) || (header.version != CACHE_VERSION) ||
+		(header.sourceHash != sourceHash) || (header.encoderSettings != GetEncoderSettings()) ||
+		(header.levelCount == 0) || (header.levelCount > MAX_LEVELS))
+	{
+		return(false);
+	}
+
+	size_t tableEnd = sizeof(CACHE_HEADER) + header.levelCount * sizeof(CACHE_LEVEL);
+	if (tableEnd > fileSize)
+	{
+		return(false);
+	}
+
+	texture.levels.resize(header.levelCount);
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		CACHE_LEVEL level;
+		memcpy(&level, pData + sizeof(CACHE_HEADER) + i * sizeof(CACHE_LEVEL), sizeof(level));
+
+		if ((level.size != GetLevelSize((int)header.format, (int)level.width, (int)level.height)) || (level.size == 0) ||
+			(level.offset > fileSize) || (level.size > fileSize - level.offset))
+		{
+			texture.levels.clear();
+			return(false);
+		}
+
+		texture.levels[i].width = (int)level.width;
+		texture.levels[i].height = (int)level.height;
+		texture.levels[i].pData = pData + level.offset;
+		texture.levels[i].size = (size_t)level.size;
+	}
+
+	texture.format = (int)header.format;
+	texture.width = (int)header.width;
+	texture.height = (int)header.height;
+	texture.bFromCache = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  CookImage()
+ *
+ *  This method is used for decoding a source image into RGBA
+ *  pixels and building its whole mip chain, down to 1x1.
+ *  Each level is then block compressed unless the format is
+ *  RGBA.  The levels are kept one after another in the
+ *  texture's own pixels, at the alignment used by the
+ *  cooked file.
+ ***********************************************************/
+bool TextureCache::CookImage(const unsigned char* pSource, size_t sourceSize, CACHED_TEXTURE& texture) const
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	// the vertical flip setting of stb_image is shared by every
+	// thread, so the rows are flipped here instead
+	unsigned char* pImage = stbi_load_from_memory(pSource, (int)sourceSize, &width, &height, &colorChannels, TEXEL_BYTES);
+	if (NULL == pImage)
+	{
+		return(false);
+	}
+	FlipRows(pImage, width, height);
+
+	int format = ChooseFormat(colorChannels);
+
+	// lay out the RGBA levels, and the cooked levels
+	std::vector<MIP_LEVEL> rgbaLevels;
+	std::vector<MIP_LEVEL> levels;
+	size_t rgbaSize = 0;
+	size_t totalSize = 0;
+	int levelWidth = width;
+	int levelHeight = height;
+	while (true)
+	{
+		MIP_LEVEL level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.pData = NULL;
+
+		level.size = GetLevelSize(FORMAT_RGBA8, levelWidth, levelHeight);
+		rgbaLevels.push_back(level);
+		rgbaSize = AlignUp(rgbaSize + level.size, DATA_ALIGNMENT);
+
+		level.size = GetLevelSize(format, levelWidth, levelHeight);
+		levels.push_back(level);
+		totalSize = AlignUp(totalSize + level.size, DATA_ALIGNMENT);
+
+		if ((levelWidth == 1) && (levelHeight == 1))
+		{
+			break;
+		}
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+
+	std::vector<unsigned char> rgbaPixels(rgbaSize);
+	size_t offset = 0;
+	for (size_t i = 0; i < rgbaLevels.size(); i++)
+	{
+		rgbaLevels[i].pData = rgbaPixels.data() + offset;
+		offset = AlignUp(offset + rgbaLevels[i].size, DATA_ALIGNMENT);
+	}
+
+	memcpy((unsigned char*)rgbaLevels[0].pData, pImage, rgbaLevels[0].size);
+	stbi_image_free(pImage);
+
+	for (size_t i = 1; i < rgbaLevels.size(); i++)
+	{
+		Downsample(rgbaLevels[i - 1].pData, rgbaLevels[i - 1].width, rgbaLevels[i - 1].height,
+			(unsigned char*)rgbaLevels[i].pData, rgbaLevels[i].width, rgbaLevels[i].height);
+	}
+
+	if (format == FORMAT_RGBA8)
+	{
+		// swapping keeps the level pointers valid
+		texture.pixels.swap(rgbaPixels);
+		levels = rgbaLevels;
+	}
+	else
+	{
+		BlockCompressor compressor(m_quality);
+
+		texture.pixels.resize(totalSize);
+		offset = 0;
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			unsigned char* pBlocks = texture.pixels.data() + offset;
+			if (format == FORMAT_BC1)
+			{
+				compressor.CompressBC1(rgbaLevels[i].pData, levels[i].width, levels[i].height, pBlocks);
+			}
+			else
+			{
+				compressor.CompressBC3(rgbaLevels[i].pData, levels[i].width, levels[i].height, pBlocks);
+			}
+			levels[i].pData = pBlocks;
+			offset = AlignUp(offset + levels[i].size, DATA_ALIGNMENT);
+		}
+	}
+
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	texture.levels = levels;
+	texture.bFromCache = false;
+
+	return(true);
+}
+
+/***********************************************************
+ *  WriteCacheFile()
+ *
+ *  This method is used for writing the levels of a texture
+ *  to a cooked file.  The file is written under a temporary
+ *  name and then renamed, so a reader never maps a file that
+ *  is only partly written.
+ ***********************************************************/
+bool TextureCache::WriteCacheFile(const std::string& cachePath, uint64_t sourceHash, const CACHED_TEXTURE& texture) const
+{
+	MakeDirectory(m_cacheDirectory);
+
+	// every thread writes its own temporary file
+	std::string tempPath = cachePath + "." +
+		std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+	FILE* pFile = fopen(tempPath.c_str(), "wb");
+	if (NULL == pFile)
+	{
+		return(false);
+	}
+
+	CACHE_HEADER header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.format = (uint32_t)texture.format;
+	header.width = (uint32_t)texture.width;
+	header.height = (uint32_t)texture.height;
+	header.levelCount = (uint32_t)texture.levels.size();
+	header.encoderSettings = GetEncoderSettings();
+	header.padding = 0;
+	header.sourceHash = sourceHash;
+
+	size_t dataStart = AlignUp(sizeof(CACHE_HEADER) + texture.levels.size() * sizeof(CACHE_LEVEL), DATA_ALIGNMENT);
+	std::vector<CACHE_LEVEL> table(texture.levels.size());
+	size_t offset = dataStart;
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		table[i].width = (uint32_t)texture.levels[i].width;
+		table[i].height = (uint32_t)texture.levels[i].height;
+		table[i].offset = offset;
+		table[i].size = texture.levels[i].size;
+		offset = AlignUp(offset + texture.levels[i].size, DATA_ALIGNMENT);
+	}
+
+	bool bWritten =
+		(fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+		(fwrite(table.data(), sizeof(CACHE_LEVEL), table.size(), pFile) == table.size());
+
+	// padding up to each level's offset, then the level
+	const unsigned char padding[DATA_ALIGNMENT] = { 0 };
+	size_t position = sizeof(CACHE_HEADER) + table.size() * sizeof(CACHE_LEVEL);
+	for (size_t i = 0; (i < texture.levels.size()) && (bWritten == true); i++)
+	{
+		size_t paddingSize = (size_t)table[i].offset - position;
+		bWritten =
+			(fwrite(padding, 1, paddingSize, pFile) == paddingSize) &&
+			(fwrite(texture.levels[i].pData, 1, texture.levels[i].size, pFile) == texture.levels[i].size);
+		position = (size_t)table[i].offset + texture.levels[i].size;
+	}
+
+	if (fclose(pFile) != 0)
+	{
+		bWritten = false;
+	}
+
+	// another thread or run may have written the same file first
+	if ((bWritten == false) || (rename(tempPath.c_str(), cachePath.c_str()) != 0))
+	{
+		remove(tempPath.c_str());
+		return(false);
+	}
+
+	return(true);
+}
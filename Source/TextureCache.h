@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// cook texture images into memory mappable files with their mip chains
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+#include "BlockCompressor.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class keeps a directory of cooked textures.  A cooked
+ *  texture file holds a header, a table of mip levels and the
+ *  pixels of every level, ready to be uploaded as they are.
+ *  The levels are block compressed unless compression is
+ *  turned off - BC1 for opaque images and BC3 for images
+ *  with an alpha channel.
+ *  The file is named by a hash of the source image's bytes,
+ *  so an edited image is cooked again and an unchanged one
+ *  is never decoded twice.  The methods only use their own
+ *  locals and can be called from several threads at once.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// constructor
+	TextureCache(const std::string& cacheDirectory = "texture_cache");
+	// destructor
+	~TextureCache();
+
+	// pixel formats of the cooked levels
+	enum TEXTURE_FORMAT
+	{
+		FORMAT_RGBA8 = 0,
+		FORMAT_BC1,
+		FORMAT_BC3,
+		FORMAT_COUNT
+	};
+
+	// one mip level, pointing into the mapped file or the
+	// texture's own pixels
+	struct MIP_LEVEL
+	{
+		int width;
+		int height;
+		const unsigned char* pData;
+		size_t size;
+	};
+
+	// a texture with all of its mip levels
+	struct CACHED_TEXTURE
+	{
+		int format;
+		int width;
+		int height;
+		std::vector<MIP_LEVEL> levels;
+		// true when the levels were read from a cooked file
+		bool bFromCache;
+		// the cooked file, when the levels are read from it
+		MappedFile file;
+		// the levels when they were just cooked
+		std::vector<unsigned char> pixels;
+	};
+
+	// get the cooked texture for a source image, cooking it
+	// first when there is no cooked file for it yet
+	bool LoadTexture(const std::string& sourceFilename, CACHED_TEXTURE& texture);
+	// cook a source image when there is no cooked file for it yet
+	bool CookTexture(const std::string& sourceFilename);
+
+	// set whether the cooked levels are block compressed, and
+	// how hard the encoder works - cooked files made with other
+	// settings are cooked again
+	void SetCompression(bool bCompress, BlockCompressor::QUALITY quality);
+	// format that an image with this many channels is cooked to
+	int ChooseFormat(int colorChannels) const;
+
+	// bytes in one level of a format
+	static size_t GetLevelSize(int format, int width, int height);
+	// FNV-1a hash of a block of bytes
+	static uint64_t HashBytes(const unsigned char* pData, size_t size);
+
+private:
+	// directory the cooked files are kept in
+	std::string m_cacheDirectory;
+	// block compression settings for cooking
+	bool m_bCompress;
+	BlockCompressor::QUALITY m_quality;
+
+	// the compression settings as stored in a cooked file
+	uint32_t GetEncoderSettings() const;
+	// get the cooked file name for a source hash
+	std::string GetCachePath(uint64_t sourceHash) const;
+	// read the levels of a cooked file that is already mapped
+	bool ReadCacheFile(uint64_t sourceHash, CACHED_TEXTURE& texture) const;
+	// decode a source image and build its mip chain
+	bool CookImage(const unsigned char* pSource, size_t sourceSize, CACHED_TEXTURE& texture) const;
+	// write the levels of a texture to a cooked file
+	bool WriteCacheFile(const std::string& cachePath, uint64_t sourceHash, const CACHED_TEXTURE& texture) const;
+};
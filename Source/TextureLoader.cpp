@@ -0,0 +1,290 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.cpp
+// ============
+// load cooked textures on the worker pool and upload them as they finish
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+#include "Profiler.h"
+
+#include "stb_image.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	/***********************************************************
+	 *  MillisecondsSince()
+	 *
+	 *  Time passed since a point in time, in milliseconds.
+	 ***********************************************************/
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		return(elapsed.count());
+	}
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader(WorkerPool* pWorkerPool, TextureManager* pTextureManager)
+{
+	m_pWorkerPool = pWorkerPool;
+	m_pTextureManager = pTextureManager;
+	m_runningJobs = 0;
+	m_pendingCount = 0;
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class.  It waits for the load
+ *  jobs that are still running, since they write into this
+ *  object, and frees the textures that were never uploaded.
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_jobDone.wait(lock, [this]() { return(m_runningJobs == 0); });
+
+	for (size_t i = 0; i < m_loaded.size(); i++)
+	{
+		delete m_loaded[i].pTexture;
+	}
+	m_loaded.clear();
+
+	m_pWorkerPool = NULL;
+	m_pTextureManager = NULL;
+}
+
+/***********************************************************
+ *  SetCompression()
+ *
+ *  This method is used for setting how the textures are
+ *  cooked.  It must be called before any texture is queued.
+ ***********************************************************/
+void TextureLoader::SetCompression(bool bCompress, BlockCompressor::QUALITY quality)
+{
+	m_textureCache.SetCompression(bCompress, quality);
+}
+
+/***********************************************************
+ *  QueueTexture()
+ *
+ *  This method is used for starting to load a texture.  Only
+ *  the image header is read here, for the size to reserve
+ *  the texture with - the texture is loaded on the worker
+ *  pool, and it is drawn with a placeholder until Update()
+ *  uploads it.
+ ***********************************************************/
+int TextureLoader::QueueTexture(const char* filename, const std::string& tag)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	if (stbi_info(filename, &width, &height, &colorChannels) == 0)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+		return(-1);
+	}
+
+	int textureIndex = m_pTextureManager->ReserveTexture(tag, width, height,
+		m_textureCache.ChooseFormat(colorChannels));
+	if (textureIndex < 0)
+	{
+		return(-1);
+	}
+
+	StartLoad(textureIndex, filename);
+
+	return(textureIndex);
+}
+
+/***********************************************************
+ *  ReloadTexture()
+ *
+ *  This method is used for loading the image file of a
+ *  texture again after it was edited.  The texture is drawn
+ *  with its old pixels until Update() uploads the new ones,
+ *  into the room it already has - an image that changed its
+ *  size or format does not fit there, and is not loaded.
+ ***********************************************************/
+bool TextureLoader::ReloadTexture(int textureIndex, const char* filename)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	if (stbi_info(filename, &width, &height, &colorChannels) == 0)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+		return(false);
+	}
+
+	int placedWidth = 0;
+	int placedHeight = 0;
+	int placedFormat = 0;
+	if (m_pTextureManager->GetTextureSize(textureIndex, placedWidth, placedHeight, placedFormat) == false)
+	{
+		return(false);
+	}
+
+	if ((width != placedWidth) || (height != placedHeight) ||
+		(m_textureCache.ChooseFormat(colorChannels) != placedFormat))
+	{
+		std::cout << "TextureLoader: " << filename << " is now " << width << "x" << height
+			<< " with " << colorChannels << " channels, and is only loaded again on restart" << std::endl;
+		return(false);
+	}
+
+	StartLoad(textureIndex, filename);
+
+	return(true);
+}
+
+/***********************************************************
+ *  StartLoad()
+ *
+ *  This method is used for counting a texture as pending and
+ *  starting the job that loads it.
+ ***********************************************************/
+void TextureLoader::StartLoad(int textureIndex, const std::string& filename)
+{
+	if (m_pendingCount == 0)
+	{
+		m_batchStart = CLOCK::now();
+	}
+	m_pendingCount++;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_runningJobs++;
+	}
+
+	m_pWorkerPool->Submit([this, textureIndex, filename]() { LoadTexture(textureIndex, filename); });
+}
+
+/***********************************************************
+ *  LoadTexture()
+ *
+ *  This method is used for getting the mip levels of an image
+ *  file on a worker thread.  An image that was cooked before
+ *  is only mapped from the texture cache - otherwise it is
+ *  decoded and cooked here, once.
+ ***********************************************************/
+void TextureLoader::LoadTexture(int textureIndex, const std::string& filename)
+{
+	ProfileScope scope("LoadTexture");
+	CLOCK::time_point start = CLOCK::now();
+
+	LOADED_TEXTURE loaded;
+	loaded.textureIndex = textureIndex;
+	loaded.filename = filename;
+	loaded.pTexture = new TextureCache::CACHED_TEXTURE;
+
+	if (m_textureCache.LoadTexture(filename, *loaded.pTexture) == false)
+	{
+		delete loaded.pTexture;
+		loaded.pTexture = NULL;
+	}
+
+	loaded.loadMilliseconds = MillisecondsSince(start);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loaded.push_back(loaded);
+		m_runningJobs--;
+	}
+	m_jobDone.notify_all();
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for waiting until every queued image
+ *  has been decoded, then uploading all of them.  It is for
+ *  frames that must not be drawn with the placeholder.
+ ***********************************************************/
+int TextureLoader::Finish()
+{
+	ProfileScope scope("FinishTextures");
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobDone.wait(lock, [this]() { return(m_runningJobs == 0); });
+	}
+
+	return(Update());
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for uploading the images that have
+ *  finished decoding since the last call.  It must be called
+ *  on the rendering thread.
+ ***********************************************************/
+int TextureLoader::Update()
+{
+	ProfileScope scope("UploadTextures");
+	std::vector<LOADED_TEXTURE> loaded;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		loaded.swap(m_loaded);
+	}
+
+	if (loaded.empty() == true)
+	{
+		return(0);
+	}
+
+	int uploaded = 0;
+	for (size_t i = 0; i < loaded.size(); i++)
+	{
+		const LOADED_TEXTURE& texture = loaded[i];
+		m_pendingCount--;
+
+		// a texture that failed to load keeps the placeholder
+		if (NULL == texture.pTexture)
+		{
+			std::cout << "Could not load image:" << texture.filename << std::endl;
+			continue;
+		}
+
+		CLOCK::time_point start = CLOCK::now();
+		bool bUploaded = true;
+		const std::vector<TextureCache::MIP_LEVEL>& levels = texture.pTexture->levels;
+		for (size_t level = 0; (level < levels.size()) && (bUploaded == true); level++)
+		{
+			bUploaded = m_pTextureManager->UploadTextureLevel(texture.textureIndex, (int)level, texture.pTexture->format,
+				levels[level].pData, levels[level].width, levels[level].height);
+		}
+		double uploadMilliseconds = MillisecondsSince(start);
+
+		if (bUploaded == true)
+		{
+			std::cout << "Successfully loaded image:" << texture.filename << ", width:" << texture.pTexture->width
+				<< ", height:" << texture.pTexture->height << ", levels:" << levels.size()
+				<< ((texture.pTexture->bFromCache == true) ? ", cached:" : ", cooked:") << texture.loadMilliseconds
+				<< "ms, upload:" << uploadMilliseconds << "ms" << std::endl;
+			uploaded++;
+		}
+
+		delete texture.pTexture;
+	}
+
+	m_pTextureManager->FlushUploads();
+
+	if (m_pendingCount == 0)
+	{
+		std::cout << "TextureLoader: all textures loaded " << MillisecondsSince(m_batchStart)
+			<< "ms after queueing, on " << m_pWorkerPool->GetThreadCount() << " worker threads" << std::endl;
+	}
+
+	return(uploaded);
+}
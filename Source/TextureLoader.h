@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.h
+// ============
+// load cooked textures on the worker pool and upload them as they finish
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WorkerPool.h"
+#include "TextureManager.h"
+#include "TextureCache.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class loads texture images without blocking the
+ *  rendering thread.  Queueing a texture reads only the size
+ *  from the image header and reserves the texture, then a
+ *  job on the worker pool maps the cooked texture from the
+ *  texture cache, cooking it first if needed.  Update() is
+ *  called on the rendering thread each frame to upload the
+ *  mip levels of the textures that have finished loading.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// constructor
+	TextureLoader(WorkerPool* pWorkerPool, TextureManager* pTextureManager);
+	// destructor
+	~TextureLoader();
+
+	// set whether the textures are block compressed, and how hard
+	// the encoder works
+	void SetCompression(bool bCompress, BlockCompressor::QUALITY quality);
+	// reserve a texture and start decoding its image file,
+	// returning the texture index
+	int QueueTexture(const char* filename, const std::string& tag);
+	// load the image file of a placed texture again, keeping
+	// its old pixels until the new ones are uploaded
+	bool ReloadTexture(int textureIndex, const char* filename);
+	// upload the loaded textures, returning how many were uploaded
+	int Update();
+	// wait for every queued texture to load, and upload them
+	int Finish();
+
+	// number of queued textures that are not uploaded yet
+	int GetPendingCount() const { return(m_pendingCount); }
+
+private:
+	typedef std::chrono::steady_clock CLOCK;
+
+	// a texture loaded by a worker, waiting to be uploaded
+	struct LOADED_TEXTURE
+	{
+		int textureIndex;
+		std::string filename;
+		// NULL when the texture could not be loaded
+		TextureCache::CACHED_TEXTURE* pTexture;
+		double loadMilliseconds;
+	};
+
+	// worker pool that loads the textures
+	WorkerPool* m_pWorkerPool;
+	// texture manager that owns the textures
+	TextureManager* m_pTextureManager;
+
+	// cooked texture files
+	TextureCache m_textureCache;
+
+	// textures loaded since the last Update(), guarded by the mutex
+	std::vector<LOADED_TEXTURE> m_loaded;
+	std::mutex m_mutex;
+	// signalled when a load job finishes
+	std::condition_variable m_jobDone;
+	// load jobs that have not finished, guarded by the mutex
+	int m_runningJobs;
+
+	// textures queued but not uploaded yet
+	int m_pendingCount;
+	// when the first texture of the current batch was queued
+	CLOCK::time_point m_batchStart;
+
+	// count a texture as pending and start loading it
+	void StartLoad(int textureIndex, const std::string& filename);
+	// load the cooked texture of an image file - runs on a worker thread
+	void LoadTexture(int textureIndex, const std::string& filename);
+};
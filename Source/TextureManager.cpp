@@ -0,0 +1,866 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturemanager.cpp
+// ============
+// pack the scene textures into texture arrays and atlas pages
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// smallest number of same sized textures that get their
+	// own texture array instead of going into the atlas
+	const int MIN_ARRAY_LAYERS = 2;
+	// border of repeated edge texels around each atlas image,
+	// which keeps the filtering of the first mip levels from
+	// reaching into the neighboring images
+	const int ATLAS_GUTTER = 8;
+	// mip levels of the atlas - the last one still has a
+	// gutter of one texel
+	const int ATLAS_LEVELS = 4;
+	// gutter of block compressed atlas images - the last level
+	// still has a gutter of one block, since compressed images
+	// can only be written a whole block at a time
+	const int BLOCK_ATLAS_GUTTER = BlockCompressor::BLOCK_SIZE << (ATLAS_LEVELS - 1);
+	// bytes in one RGBA texel
+	const int TEXEL_BYTES = 4;
+
+	/***********************************************************
+	 *  AtlasGutter()
+	 *
+	 *  Gutter around the atlas images of a format.  The images
+	 *  also start on multiples of it, so that every atlas level
+	 *  of an image lands on whole texels, or whole blocks.
+	 ***********************************************************/
+	int AtlasGutter(int format)
+	{
+		return((format == TextureCache::FORMAT_RGBA8) ? ATLAS_GUTTER : BLOCK_ATLAS_GUTTER);
+	}
+
+	/***********************************************************
+	 *  InternalFormat()
+	 *
+	 *  OpenGL storage format of a texture format.
+	 ***********************************************************/
+	GLenum InternalFormat(int format)
+	{
+		switch (format)
+		{
+		case TextureCache::FORMAT_BC1:
+			return(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+		case TextureCache::FORMAT_BC3:
+			return(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+		}
+		return(GL_RGBA8);
+	}
+
+	/***********************************************************
+	 *  BlockBytes()
+	 *
+	 *  Bytes in one block of a block compressed format.
+	 ***********************************************************/
+	size_t BlockBytes(int format)
+	{
+		return((format == TextureCache::FORMAT_BC1) ? BlockCompressor::BC1_BLOCK_BYTES : BlockCompressor::BC3_BLOCK_BYTES);
+	}
+
+	/***********************************************************
+	 *  MipLevelCount()
+	 *
+	 *  Number of mip levels down to 1x1 for a texture size.
+	 ***********************************************************/
+	int MipLevelCount(int width, int height)
+	{
+		int levels = 1;
+		int size = std::max(width, height);
+		while (size > 1)
+		{
+			size >>= 1;
+			levels++;
+		}
+		return(levels);
+	}
+
+	/***********************************************************
+	 *  CopyWithGutter()
+	 *
+	 *  Copy an image into a destination with the passed in row
+	 *  stride, surrounded by a gutter of its edge texels.
+	 ***********************************************************/
+	void CopyWithGutter(
+		unsigned char* pDestination,
+		size_t destinationStride,
+		const unsigned char* pPixels,
+		int width,
+		int height,
+		int gutter)
+	{
+		const size_t rowBytes = (size_t)width * TEXEL_BYTES;
+
+		for (int y = -gutter; y < height + gutter; y++)
+		{
+			int sourceY = std::min(std::max(y, 0), height - 1);
+			const unsigned char* pSource = pPixels + sourceY * rowBytes;
+			unsigned char* pRow = pDestination + (y + gutter) * destinationStride;
+
+			// left gutter, image row, right gutter
+			for (int x = 0; x < gutter; x++)
+			{
+				memcpy(pRow + x * TEXEL_BYTES, pSource, TEXEL_BYTES);
+			}
+			memcpy(pRow + gutter * TEXEL_BYTES, pSource, rowBytes);
+			for (int x = 0; x < gutter; x++)
+			{
+				memcpy(pRow + (gutter + width + x) * TEXEL_BYTES,
+					pSource + rowBytes - TEXEL_BYTES, TEXEL_BYTES);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  CopyBlocksWithGutter()
+	 *
+	 *  Copy the blocks of a compressed image into a destination
+	 *  surrounded by a gutter of its edge blocks.  The gutter
+	 *  blocks are mirrored, so the texels next to the image
+	 *  repeat its edge texels the way CopyWithGutter() does.
+	 ***********************************************************/
+	void CopyBlocksWithGutter(
+		unsigned char* pDestination,
+		const unsigned char* pBlocks,
+		int blocksWide,
+		int blocksHigh,
+		int gutterBlocks,
+		size_t blockBytes)
+	{
+		int destinationWide = blocksWide + 2 * gutterBlocks;
+
+		for (int y = -gutterBlocks; y < blocksHigh + gutterBlocks; y++)
+		{
+			int sourceY = std::min(std::max(y, 0), blocksHigh - 1);
+			bool bMirrorY = (y < 0) || (y >= blocksHigh);
+
+			for (int x = -gutterBlocks; x < blocksWide + gutterBlocks; x++)
+			{
+				int sourceX = std::min(std::max(x, 0), blocksWide - 1);
+				bool bMirrorX = (x < 0) || (x >= blocksWide);
+
+				unsigned char* pBlock = pDestination +
+					((size_t)(y + gutterBlocks) * destinationWide + (x + gutterBlocks)) * blockBytes;
+				memcpy(pBlock, pBlocks + ((size_t)sourceY * blocksWide + sourceX) * blockBytes, blockBytes);
+				BlockCompressor::MirrorBlock(pBlock, blockBytes, bMirrorX, bMirrorY);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureManager::TextureManager()
+{
+	m_placeholderArray = -1;
+	m_tableBuffer = 0;
+	m_bTableDirty = false;
+	m_uploadBuffer = 0;
+	m_uploadCapacity = 0;
+	m_residentBytes = 0;
+}
+
+/***********************************************************
+ *  ~TextureManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureManager::~TextureManager()
+{
+	DestroyTextures();
+}
+
+/***********************************************************
+ *  AddTexture()
+ *
+ *  This method is used for adding the RGBA pixels of a
+ *  texture.  The pixels are copied and kept until the next
+ *  call to BuildTextures(), and the returned index is what
+ *  draws use to select the texture.
+ ***********************************************************/
+int TextureManager::AddTexture(
+	const std::string& tag,
+	const unsigned char* pPixels,
+	int width,
+	int height)
+{
+	if (NULL == pPixels)
+	{
+		return(-1);
+	}
+
+	int textureIndex = AddPending(tag, width, height, TextureCache::FORMAT_RGBA8);
+	if (textureIndex >= 0)
+	{
+		m_images.back().pixels.assign(pPixels, pPixels + (size_t)width * height * TEXEL_BYTES);
+	}
+
+	return(textureIndex);
+}
+
+/***********************************************************
+ *  ReserveTexture()
+ *
+ *  This method is used for adding a texture by its size and
+ *  format alone.  It is placed by the next call to
+ *  BuildTextures(), and its levels are passed to
+ *  UploadTextureLevel() once they are available.
+ ***********************************************************/
+int TextureManager::ReserveTexture(const std::string& tag, int width, int height, int format)
+{
+	return(AddPending(tag, width, height, format));
+}
+
+/***********************************************************
+ *  AddPending()
+ *
+ *  This method is used for adding a texture to the table
+ *  with a pending image of the passed in size.
+ ***********************************************************/
+int TextureManager::AddPending(const std::string& tag, int width, int height, int format)
+{
+	if ((width <= 0) || (height <= 0))
+	{
+		return(-1);
+	}
+
+	if ((int)m_tags.size() >= MAX_TEXTURES)
+	{
+		std::cout << "TextureManager: no room for texture " << tag << ", the limit is " << MAX_TEXTURES << std::endl;
+		return(-1);
+	}
+
+	int textureIndex = (int)m_tags.size();
+
+	PENDING_IMAGE image;
+	image.textureIndex = textureIndex;
+	image.width = width;
+	image.height = height;
+	image.format = format;
+	m_images.push_back(image);
+
+	// the entry is filled in when the texture is placed, and
+	// until then it selects no texture
+	TEXTURE_BLOCK entry = TEXTURE_BLOCK();
+	entry.arrayIndex = -1;
+	m_entries.push_back(entry);
+
+	TEXTURE_PLACEMENT placement = TEXTURE_PLACEMENT();
+	placement.arrayIndex = -1;
+	m_placements.push_back(placement);
+
+	m_tags.push_back(tag);
+
+	return(textureIndex);
+}
+
+/***********************************************************
+ *  BuildTextures()
+ *
+ *  This method is used for placing the added textures into
+ *  texture arrays.  The largest groups of textures with the
+ *  same size and format each get an array, and the remaining
+ *  textures are packed into the atlas of their format.
+ *  Textures whose pixels are already known are uploaded, and
+ *  reserved textures are drawn with the placeholder until
+ *  their pixels arrive.
+ ***********************************************************/
+bool TextureManager::BuildTextures()
+{
+	if (m_tableBuffer == 0)
+	{
+		glCreateBuffers(1, &m_tableBuffer);
+		glNamedBufferData(m_tableBuffer, sizeof(TEXTURE_BLOCK) * MAX_TEXTURES, NULL, GL_STATIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, TEXTURE_BLOCK_BINDING, m_tableBuffer);
+	}
+
+	if (m_images.empty())
+	{
+		return(true);
+	}
+
+	// group the images by their size and format
+	std::vector<std::vector<int> > groups;
+	bool bNeedsPlaceholder = false;
+	bool bFormatUsed[TextureCache::FORMAT_COUNT] = { false };
+	for (int i = 0; i < (int)m_images.size(); i++)
+	{
+		size_t group = 0;
+		while ((group < groups.size()) &&
+			((m_images[groups[group][0]].width != m_images[i].width) ||
+			 (m_images[groups[group][0]].height != m_images[i].height) ||
+			 (m_images[groups[group][0]].format != m_images[i].format)))
+		{
+			group++;
+		}
+
+		if (group == groups.size())
+		{
+			groups.push_back(std::vector<int>());
+		}
+		groups[group].push_back(i);
+
+		if (m_images[i].pixels.empty() == true)
+		{
+			bNeedsPlaceholder = true;
+		}
+		bFormatUsed[m_images[i].format] = true;
+	}
+
+	if ((bNeedsPlaceholder == true) && (m_placeholderArray < 0))
+	{
+		CreatePlaceholder();
+	}
+
+	// the largest groups get the arrays, keeping one for the
+	// atlas of each format
+	std::stable_sort(groups.begin(), groups.end(),
+		[](const std::vector<int>& a, const std::vector<int>& b) { return(a.size() > b.size()); });
+
+	int arraysLeft = MAX_TEXTURE_ARRAYS - (int)m_arrays.size();
+	for (int format = 0; format < TextureCache::FORMAT_COUNT; format++)
+	{
+		if (bFormatUsed[format] == true)
+		{
+			arraysLeft--;
+		}
+	}
+	std::vector<int> atlasImages[TextureCache::FORMAT_COUNT];
+	bool bSuccess = true;
+
+	for (size_t group = 0; group < groups.size(); group++)
+	{
+		const PENDING_IMAGE& image = m_images[groups[group][0]];
+		int gutter = AtlasGutter(image.format);
+		bool bFitsAtlas =
+			(image.width + 3 * gutter <= ATLAS_PAGE_SIZE) &&
+			(image.height + 3 * gutter <= ATLAS_PAGE_SIZE);
+
+		if ((arraysLeft > 0) && (((int)groups[group].size() >= MIN_ARRAY_LAYERS) || (bFitsAtlas == false)))
+		{
+			CreateArray(groups[group]);
+			arraysLeft--;
+		}
+		else if (bFitsAtlas == true)
+		{
+			std::vector<int>& formatImages = atlasImages[image.format];
+			formatImages.insert(formatImages.end(), groups[group].begin(), groups[group].end());
+		}
+		else
+		{
+			std::cout << "TextureManager: no texture array left for " << image.width << "x" << image.height << " textures" << std::endl;
+			bSuccess = false;
+		}
+	}
+
+	for (int format = 0; format < TextureCache::FORMAT_COUNT; format++)
+	{
+		if ((atlasImages[format].size() > 0) && ((int)m_arrays.size() < MAX_TEXTURE_ARRAYS))
+		{
+			CreateAtlas(atlasImages[format]);
+		}
+	}
+
+	// upload the pixels that are already here
+	for (size_t i = 0; i < m_images.size(); i++)
+	{
+		const PENDING_IMAGE& image = m_images[i];
+		if (m_placements[image.textureIndex].arrayIndex < 0)
+		{
+			continue;
+		}
+
+		if (image.pixels.empty() == false)
+		{
+			UploadTexture(image.textureIndex, image.pixels.data(), image.width, image.height);
+		}
+		else
+		{
+			TEXTURE_BLOCK& entry = m_entries[image.textureIndex];
+			entry.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+			entry.arrayIndex = m_placeholderArray;
+			entry.layer = 0;
+			entry.bAtlas = 0;
+		}
+	}
+
+	m_bTableDirty = true;
+	FlushUploads();
+
+	std::cout << "TextureManager: " << m_images.size() << " textures placed, "
+		<< m_tags.size() << " textures in " << m_arrays.size() << " texture arrays, "
+		<< m_residentBytes / 1024 << "KB of texture memory" << std::endl;
+
+	// the pixels are in texture memory now
+	m_images.clear();
+
+	return(bSuccess);
+}
+
+/***********************************************************
+ *  CreateArrayStorage()
+ *
+ *  This method is used for creating a texture array with
+ *  immutable storage for all of its layers and mip levels.
+ ***********************************************************/
+int TextureManager::CreateArrayStorage(int width, int height, int layers, int levels, bool bAtlas, int format)
+{
+	TEXTURE_ARRAY textureArray;
+	textureArray.width = width;
+	textureArray.height = height;
+	textureArray.layers = layers;
+	textureArray.levels = levels;
+	textureArray.format = format;
+	textureArray.bAtlas = bAtlas;
+	textureArray.bMipmapsDirty = false;
+
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureArray.textureID);
+	glTextureStorage3D(textureArray.textureID, levels, InternalFormat(format), width, height, layers);
+
+	for (int level = 0; level < levels; level++)
+	{
+		m_residentBytes += TextureCache::GetLevelSize(format,
+			std::max(width >> level, 1), std::max(height >> level, 1)) * layers;
+	}
+
+	// atlas images wrap in the shader, inside of their rectangle
+	GLint wrapMode = (bAtlas == true) ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+	glTextureParameteri(textureArray.textureID, GL_TEXTURE_WRAP_S, wrapMode);
+	glTextureParameteri(textureArray.textureID, GL_TEXTURE_WRAP_T, wrapMode);
+	glTextureParameteri(textureArray.textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(textureArray.textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// the space between the atlas images is never written -
+	// compressed images cannot be cleared, and their gutters
+	// keep the filtering off of it
+	if ((bAtlas == true) && (format == TextureCache::FORMAT_RGBA8))
+	{
+		glClearTexImage(textureArray.textureID, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+
+	m_arrays.push_back(textureArray);
+
+	return((int)m_arrays.size() - 1);
+}
+
+/***********************************************************
+ *  CreateArray()
+ *
+ *  This method is used for creating a texture array with one
+ *  layer for each of the passed in same sized images.
+ ***********************************************************/
+void TextureManager::CreateArray(const std::vector<int>& imageIndices)
+{
+	int width = m_images[imageIndices[0]].width;
+	int height = m_images[imageIndices[0]].height;
+	int arrayIndex = CreateArrayStorage(width, height, (int)imageIndices.size(),
+		MipLevelCount(width, height), false, m_images[imageIndices[0]].format);
+
+	for (int layer = 0; layer < (int)imageIndices.size(); layer++)
+	{
+		TEXTURE_PLACEMENT& placement = m_placements[m_images[imageIndices[layer]].textureIndex];
+		placement.arrayIndex = arrayIndex;
+		placement.layer = layer;
+		placement.x = 0;
+		placement.y = 0;
+		placement.width = width;
+		placement.height = height;
+		placement.gutter = 0;
+		placement.bAtlas = false;
+	}
+}
+
+/***********************************************************
+ *  CreateAtlas()
+ *
+ *  This method is used for packing images of any size into
+ *  the pages of an atlas texture array.  The images are
+ *  placed on shelves, tallest first, and a new page is
+ *  started when a page is full.  The shader wraps the UVs
+ *  inside of each image's rectangle.
+ ***********************************************************/
+void TextureManager::CreateAtlas(const std::vector<int>& imageIndices)
+{
+	std::vector<int> order = imageIndices;
+	std::stable_sort(order.begin(), order.end(),
+		[this](int a, int b) { return(m_images[a].height > m_images[b].height); });
+
+	// the atlas is the next array to be created
+	int arrayIndex = (int)m_arrays.size();
+	int format = m_images[order[0]].format;
+	int gutter = AtlasGutter(format);
+	int pageCount = 0;
+	int cursorX = 0;
+	int cursorY = 0;
+	int shelfHeight = 0;
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const PENDING_IMAGE& image = m_images[order[i]];
+		int packedWidth = (image.width + gutter - 1) / gutter * gutter + 2 * gutter;
+		int packedHeight = (image.height + gutter - 1) / gutter * gutter + 2 * gutter;
+
+		// start a new shelf, or a new page, when the image does not fit
+		if (cursorX + packedWidth > ATLAS_PAGE_SIZE)
+		{
+			cursorX = 0;
+			cursorY += shelfHeight;
+			shelfHeight = 0;
+		}
+		if ((pageCount == 0) || (cursorY + packedHeight > ATLAS_PAGE_SIZE))
+		{
+			pageCount++;
+			cursorX = 0;
+			cursorY = 0;
+			shelfHeight = 0;
+		}
+
+		TEXTURE_PLACEMENT& placement = m_placements[image.textureIndex];
+		placement.arrayIndex = arrayIndex;
+		placement.layer = pageCount - 1;
+		placement.x = cursorX;
+		placement.y = cursorY;
+		placement.width = image.width;
+		placement.height = image.height;
+		placement.gutter = gutter;
+		placement.bAtlas = true;
+
+		cursorX += packedWidth;
+		shelfHeight = std::max(shelfHeight, packedHeight);
+	}
+
+	CreateArrayStorage(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, pageCount, ATLAS_LEVELS, true, format);
+
+	std::cout << "TextureManager: packed " << order.size() << " textures into " << pageCount << " atlas pages" << std::endl;
+}
+
+/***********************************************************
+ *  CreatePlaceholder()
+ *
+ *  This method is used for creating the one texel gray array
+ *  that reserved textures are drawn with.
+ ***********************************************************/
+void TextureManager::CreatePlaceholder()
+{
+	const unsigned char gray[TEXEL_BYTES] = { 128, 128, 128, 255 };
+
+	m_placeholderArray = CreateArrayStorage(1, 1, 1, 1, false, TextureCache::FORMAT_RGBA8);
+	glTextureSubImage3D(m_arrays[m_placeholderArray].textureID, 0, 0, 0, 0,
+		1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+}
+
+/***********************************************************
+ *  MakeEntry()
+ *
+ *  This method is used for building the texture table entry
+ *  that draws a placed texture.
+ ***********************************************************/
+TextureManager::TEXTURE_BLOCK TextureManager::MakeEntry(const TEXTURE_PLACEMENT& placement) const
+{
+	TEXTURE_BLOCK entry = TEXTURE_BLOCK();
+	entry.arrayIndex = placement.arrayIndex;
+	entry.layer = placement.layer;
+
+	if (placement.bAtlas == true)
+	{
+		entry.uvRect = glm::vec4(
+			(float)(placement.x + placement.gutter) / ATLAS_PAGE_SIZE,
+			(float)(placement.y + placement.gutter) / ATLAS_PAGE_SIZE,
+			(float)placement.width / ATLAS_PAGE_SIZE,
+			(float)placement.height / ATLAS_PAGE_SIZE);
+		entry.bAtlas = 1;
+	}
+	else
+	{
+		entry.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		entry.bAtlas = 0;
+	}
+
+	return(entry);
+}
+
+/***********************************************************
+ *  UploadTexture()
+ *
+ *  This method is used for copying the pixels of a placed
+ *  RGBA texture into its array.  The rest of the mip levels
+ *  of the array are generated by the next FlushUploads().
+ ***********************************************************/
+bool TextureManager::UploadTexture(int textureIndex, const unsigned char* pPixels, int width, int height)
+{
+	if (UploadTextureLevel(textureIndex, 0, TextureCache::FORMAT_RGBA8, pPixels, width, height) == false)
+	{
+		return(false);
+	}
+
+	m_arrays[m_placements[textureIndex].arrayIndex].bMipmapsDirty = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  UploadTextureLevel()
+ *
+ *  This method is used for copying one mip level of a placed
+ *  texture into its array.  The level is written into a
+ *  mapped pixel unpack buffer, with the gutter added for
+ *  atlas images, and copied to the texture from there so
+ *  the copy does not stall on the draws using the array.
+ *  Levels past the ones the array has are skipped.
+ ***********************************************************/
+bool TextureManager::UploadTextureLevel(int textureIndex, int level, int format, const unsigned char* pData, int width, int height)
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_placements.size()) || (NULL == pData) || (level < 0))
+	{
+		return(false);
+	}
+
+	const TEXTURE_PLACEMENT& placement = m_placements[textureIndex];
+	if (placement.arrayIndex < 0)
+	{
+		return(false);
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[placement.arrayIndex];
+	if (textureArray.format != format)
+	{
+		std::cout << "TextureManager: texture " << m_tags[textureIndex] << " was reserved in another format" << std::endl;
+		return(false);
+	}
+	if (level >= textureArray.levels)
+	{
+		return(true);
+	}
+
+	int levelWidth = std::max(placement.width >> level, 1);
+	int levelHeight = std::max(placement.height >> level, 1);
+	if ((levelWidth != width) || (levelHeight != height))
+	{
+		std::cout << "TextureManager: texture " << m_tags[textureIndex] << " level " << level << " is " << width << "x" << height
+			<< ", but " << levelWidth << "x" << levelHeight << " was reserved" << std::endl;
+		return(false);
+	}
+
+	int gutter = placement.gutter >> level;
+	int x = placement.x >> level;
+	int y = placement.y >> level;
+
+	if (format == TextureCache::FORMAT_RGBA8)
+	{
+		int uploadWidth = width + 2 * gutter;
+		int uploadHeight = height + 2 * gutter;
+		size_t uploadStride = (size_t)uploadWidth * TEXEL_BYTES;
+
+		unsigned char* pMapped = MapUploadBuffer(uploadStride * uploadHeight);
+		if (NULL == pMapped)
+		{
+			return(false);
+		}
+		CopyWithGutter(pMapped, uploadStride, pData, width, height, gutter);
+		glUnmapNamedBuffer(m_uploadBuffer);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+		glTextureSubImage3D(textureArray.textureID, level, x, y, placement.layer,
+			uploadWidth, uploadHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	else
+	{
+		// compressed images are written in whole blocks, so an
+		// atlas image covers the partial blocks at its edges too
+		size_t blockBytes = BlockBytes(format);
+		int blocksWide = (width + BlockCompressor::BLOCK_SIZE - 1) / BlockCompressor::BLOCK_SIZE;
+		int blocksHigh = (height + BlockCompressor::BLOCK_SIZE - 1) / BlockCompressor::BLOCK_SIZE;
+		int gutterBlocks = gutter / BlockCompressor::BLOCK_SIZE;
+		int uploadBlocksWide = blocksWide + 2 * gutterBlocks;
+		int uploadBlocksHigh = blocksHigh + 2 * gutterBlocks;
+		size_t uploadBytes = (size_t)uploadBlocksWide * uploadBlocksHigh * blockBytes;
+
+		unsigned char* pMapped = MapUploadBuffer(uploadBytes);
+		if (NULL == pMapped)
+		{
+			return(false);
+		}
+		CopyBlocksWithGutter(pMapped, pData, blocksWide, blocksHigh, gutterBlocks, blockBytes);
+		glUnmapNamedBuffer(m_uploadBuffer);
+
+		// a whole level is written at its own size, which need
+		// not be a whole number of blocks
+		int uploadWidth = (placement.bAtlas == true) ? uploadBlocksWide * BlockCompressor::BLOCK_SIZE : width;
+		int uploadHeight = (placement.bAtlas == true) ? uploadBlocksHigh * BlockCompressor::BLOCK_SIZE : height;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uploadBuffer);
+		glCompressedTextureSubImage3D(textureArray.textureID, level, x, y, placement.layer,
+			uploadWidth, uploadHeight, 1, InternalFormat(format), (GLsizei)uploadBytes, (const void*)0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	if (level == 0)
+	{
+		m_entries[textureIndex] = MakeEntry(placement);
+		m_bTableDirty = true;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  MapUploadBuffer()
+ *
+ *  This method is used for mapping the pixel unpack buffer
+ *  for writing an upload, growing it first when the upload
+ *  does not fit.
+ ***********************************************************/
+unsigned char* TextureManager::MapUploadBuffer(size_t uploadBytes)
+{
+	if (m_uploadBuffer == 0)
+	{
+		glCreateBuffers(1, &m_uploadBuffer);
+	}
+	if (uploadBytes > m_uploadCapacity)
+	{
+		m_uploadCapacity = uploadBytes;
+		glNamedBufferData(m_uploadBuffer, m_uploadCapacity, NULL, GL_STREAM_DRAW);
+	}
+
+	// invalidating lets the driver hand out fresh storage while
+	// the previous upload is still being read
+	return((unsigned char*)glMapNamedBufferRange(m_uploadBuffer, 0, uploadBytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+
+/***********************************************************
+ *  FlushUploads()
+ *
+ *  This method is used for rebuilding the mipmaps of the
+ *  arrays that were uploaded to, and uploading the texture
+ *  table when entries have changed.
+ ***********************************************************/
+void TextureManager::FlushUploads()
+{
+	for (size_t i = 0; i < m_arrays.size(); i++)
+	{
+		if (m_arrays[i].bMipmapsDirty == true)
+		{
+			glGenerateTextureMipmap(m_arrays[i].textureID);
+			m_arrays[i].bMipmapsDirty = false;
+		}
+	}
+
+	if ((m_bTableDirty == true) && (m_tableBuffer != 0) && (m_entries.size() > 0))
+	{
+		glNamedBufferSubData(m_tableBuffer, 0, sizeof(TEXTURE_BLOCK) * m_entries.size(), m_entries.data());
+		m_bTableDirty = false;
+	}
+}
+
+/***********************************************************
+ *  BindTextures()
+ *
+ *  This method is used for binding each texture array to the
+ *  texture unit matching its index.
+ ***********************************************************/
+void TextureManager::BindTextures()
+{
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		glBindTextureUnit(i, m_arrays[i].textureID);
+	}
+}
+
+/***********************************************************
+ *  DestroyTextures()
+ *
+ *  This method is used for freeing the texture arrays and
+ *  the texture table and upload buffers.
+ ***********************************************************/
+void TextureManager::DestroyTextures()
+{
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		glDeleteTextures(1, &m_arrays[i].textureID);
+	}
+	m_arrays.clear();
+	m_placeholderArray = -1;
+	m_residentBytes = 0;
+
+	if (m_tableBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_tableBuffer);
+		m_tableBuffer = 0;
+	}
+	if (m_uploadBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_uploadBuffer);
+		m_uploadBuffer = 0;
+		m_uploadCapacity = 0;
+	}
+
+	m_tags.clear();
+	m_entries.clear();
+	m_placements.clear();
+	m_images.clear();
+}
+
+/***********************************************************
+ *  FindTexture()
+ *
+ *  This method is used for getting the index of the texture
+ *  associated with the passed in tag.
+ ***********************************************************/
+int TextureManager::FindTexture(const std::string& tag) const
+{
+	int textureIndex = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < (int)m_tags.size()) && (bFound == false))
+	{
+		if (m_tags[index].compare(tag) == 0)
+		{
+			textureIndex = index;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(textureIndex);
+}
+
+/***********************************************************
+ *  GetTextureSize()
+ *
+ *  This method is used for getting the size and format a
+ *  placed texture was given room for.  New pixels must
+ *  match them to be uploaded in its place.
+ ***********************************************************/
+bool TextureManager::GetTextureSize(int textureIndex, int& width, int& height, int& format) const
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_placements.size()) ||
+		(m_placements[textureIndex].arrayIndex < 0))
+	{
+		return(false);
+	}
+
+	const TEXTURE_PLACEMENT& placement = m_placements[textureIndex];
+	width = placement.width;
+	height = placement.height;
+	format = m_arrays[placement.arrayIndex].format;
+	return(true);
+}
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturemanager.h
+// ============
+// pack the scene textures into texture arrays and atlas pages
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "TextureCache.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureManager
+ *
+ *  This class keeps every scene texture resident in a small
+ *  number of GL_TEXTURE_2D_ARRAY objects.  Textures that
+ *  share a size and format become layers of one array, and
+ *  the rest are packed into the pages of an atlas array for
+ *  their format.  A draw selects its texture by an index
+ *  into a table of array, layer and UV rectangle, so
+ *  textured objects no longer need their own texture unit
+ *  and can share one draw call.
+ *
+ *  A texture can be reserved by its size before its pixels
+ *  are available.  It is placed like any other texture, and
+ *  draws with a placeholder until UploadTexture() is called.
+ ***********************************************************/
+class TextureManager
+{
+public:
+	// constructor
+	TextureManager();
+	// destructor
+	~TextureManager();
+
+	// these must match the defines in the shader code
+	static const int MAX_TEXTURES = 256;
+	static const int MAX_TEXTURE_ARRAYS = 8;
+
+	// uniform buffer binding of the texture table - bindings
+	// 0 and 1 are used by the blocks of UniformBuffers
+	static const GLuint TEXTURE_BLOCK_BINDING = 2;
+
+	// width and height of an atlas page
+	static const int ATLAS_PAGE_SIZE = 2048;
+
+	// std140 layout of one entry in the texture table - the
+	// UV rectangle is offset in xy and size in zw, and the
+	// location is the array, the layer and the atlas flag
+	struct TEXTURE_BLOCK
+	{
+		glm::vec4 uvRect;
+		int arrayIndex;
+		int layer;
+		int bAtlas;
+		int padding;
+	};
+
+	// add the RGBA pixels of a texture, returning its index
+	int AddTexture(const std::string& tag, const unsigned char* pPixels, int width, int height);
+	// add a texture whose pixels are uploaded later, returning its index
+	int ReserveTexture(const std::string& tag, int width, int height, int format = TextureCache::FORMAT_RGBA8);
+	// pack the added textures into the arrays and upload them
+	bool BuildTextures();
+	// bind the texture arrays to texture units 0 and up
+	void BindTextures();
+	// free the texture arrays and the texture table
+	void DestroyTextures();
+
+	// upload the RGBA pixels of a reserved texture through the
+	// pixel unpack buffer - the texture is drawn with them
+	// after the next FlushUploads()
+	bool UploadTexture(int textureIndex, const unsigned char* pPixels, int width, int height);
+	// upload one precomputed mip level of a reserved texture, in
+	// the format it was reserved with
+	bool UploadTextureLevel(int textureIndex, int level, int format, const unsigned char* pData, int width, int height);
+	// rebuild the mipmaps of arrays uploaded to without them,
+	// and the texture table, after uploads
+	void FlushUploads();
+
+	// find the index of a texture by tag
+	int FindTexture(const std::string& tag) const;
+	// get the size and format a placed texture has room for
+	bool GetTextureSize(int textureIndex, int& width, int& height, int& format) const;
+	// number of added textures and of texture arrays built
+	int GetTextureCount() const { return((int)m_tags.size()); }
+	int GetArrayCount() const { return((int)m_arrays.size()); }
+
+private:
+	// size and pixels of an added texture until it is placed
+	struct PENDING_IMAGE
+	{
+		int textureIndex;
+		int width;
+		int height;
+		int format;
+		std::vector<unsigned char> pixels;
+	};
+
+	// where a texture was placed in the texture arrays
+	struct TEXTURE_PLACEMENT
+	{
+		int arrayIndex;
+		int layer;
+		int x;
+		int y;
+		int width;
+		int height;
+		int gutter;
+		bool bAtlas;
+	};
+
+	// one texture array and the size of its layers
+	struct TEXTURE_ARRAY
+	{
+		GLuint textureID;
+		int width;
+		int height;
+		int layers;
+		int levels;
+		int format;
+		bool bAtlas;
+		bool bMipmapsDirty;
+	};
+
+	// tag of each texture, in texture index order
+	std::vector<std::string> m_tags;
+	// table entry of each texture, in texture index order
+	std::vector<TEXTURE_BLOCK> m_entries;
+	// placement of each texture, arrayIndex -1 until placed
+	std::vector<TEXTURE_PLACEMENT> m_placements;
+	// textures waiting to be placed
+	std::vector<PENDING_IMAGE> m_images;
+	// built texture arrays - the index is the texture unit
+	std::vector<TEXTURE_ARRAY> m_arrays;
+	// array drawn for reserved textures, -1 until it is needed
+	int m_placeholderArray;
+	// uniform buffer with the texture table
+	GLuint m_tableBuffer;
+	bool m_bTableDirty;
+	// pixel unpack buffer for uploads, and its size in bytes
+	GLuint m_uploadBuffer;
+	size_t m_uploadCapacity;
+	// bytes of texture memory taken by the arrays
+	size_t m_residentBytes;
+
+	// add a texture to the table with a pending image
+	int AddPending(const std::string& tag, int width, int height, int format);
+	// create a texture array with storage for its layers
+	int CreateArrayStorage(int width, int height, int layers, int levels, bool bAtlas, int format);
+	// place the same sized images as the layers of a new array
+	void CreateArray(const std::vector<int>& imageIndices);
+	// place the same format images into the pages of a new atlas array
+	void CreateAtlas(const std::vector<int>& imageIndices);
+	// create the one texel array drawn for reserved textures
+	void CreatePlaceholder();
+	// map the pixel unpack buffer for an upload of this size
+	unsigned char* MapUploadBuffer(size_t uploadBytes);
+	// get the table entry that draws a placed texture
+	TEXTURE_BLOCK MakeEntry(const TEXTURE_PLACEMENT& placement) const;
+};
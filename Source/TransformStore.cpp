@@ -0,0 +1,171 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformstore.cpp
+// ============
+// keep the transformation values and world matrices of the scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformStore.h"
+
+#include <cmath>
+
+/***********************************************************
+ *  TransformStore()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransformStore::TransformStore()
+{
+}
+
+/***********************************************************
+ *  ~TransformStore()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TransformStore::~TransformStore()
+{
+}
+
+/***********************************************************
+ *  AddTransform()
+ *
+ *  This method is used for adding the transformation values
+ *  of a new object.  Its matrix is built by the next
+ *  Update(), with any other changed transforms.
+ ***********************************************************/
+int TransformStore::AddTransform(glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ)
+{
+	int index = (int)m_matrices.size();
+
+	m_scales.push_back(scaleXYZ);
+	m_rotations.push_back(rotationDegrees);
+	m_positions.push_back(positionXYZ);
+	m_matrices.push_back(glm::mat4(1.0f));
+	m_bDirty.push_back(0);
+	MarkDirty(index);
+
+	return(index);
+}
+
+/***********************************************************
+ *  SetTransform()
+ *
+ *  This method is used for changing the transformation
+ *  values of an object.  Setting the values it already has
+ *  does not list it to be built again.
+ ***********************************************************/
+void TransformStore::SetTransform(int index, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ)
+{
+	if ((index < 0) || (index >= (int)m_matrices.size()))
+	{
+		return;
+	}
+
+	if ((m_scales[index] == scaleXYZ) &&
+		(m_rotations[index] == rotationDegrees) &&
+		(m_positions[index] == positionXYZ))
+	{
+		return;
+	}
+
+	m_scales[index] = scaleXYZ;
+	m_rotations[index] = rotationDegrees;
+	m_positions[index] = positionXYZ;
+	MarkDirty(index);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all of the transforms.
+ ***********************************************************/
+void TransformStore::Clear()
+{
+	m_scales.clear();
+	m_rotations.clear();
+	m_positions.clear();
+	m_matrices.clear();
+	m_bDirty.clear();
+	m_dirty.clear();
+	m_updated.clear();
+}
+
+/***********************************************************
+ *  MarkDirty()
+ *
+ *  This method is used for listing a transform to be built
+ *  by the next Update(), one time however often it changes.
+ ***********************************************************/
+void TransformStore::MarkDirty(int index)
+{
+	if (m_bDirty[index] == 0)
+	{
+		m_bDirty[index] = 1;
+		m_dirty.push_back(index);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for building the matrices of the
+ *  transforms changed since the last call.  The list of
+ *  them is kept until the next call, for anything else that
+ *  depends on the matrices, such as the bounds of objects.
+ ***********************************************************/
+int TransformStore::Update()
+{
+	m_updated.swap(m_dirty);
+	m_dirty.clear();
+
+	for (size_t i = 0; i < m_updated.size(); i++)
+	{
+		int index = m_updated[i];
+		m_matrices[index] = ComposeMatrix(m_scales[index], m_rotations[index], m_positions[index]);
+		m_bDirty[index] = 0;
+	}
+
+	return((int)m_updated.size());
+}
+
+/***********************************************************
+ *  ComposeMatrix()
+ *
+ *  This method is used for building the matrix of
+ *  translation * rotationZ * rotationY * rotationX * scale
+ *  directly from the sines and cosines of the angles.  The
+ *  columns of the rotation are scaled by the matching scale
+ *  value, and the position is the last column, which gives
+ *  the same matrix as multiplying the five of them.
+ ***********************************************************/
+glm::mat4 TransformStore::ComposeMatrix(const glm::vec3& scaleXYZ, const glm::vec3& rotationDegrees, const glm::vec3& positionXYZ)
+{
+	float sinX = std::sin(glm::radians(rotationDegrees.x));
+	float cosX = std::cos(glm::radians(rotationDegrees.x));
+	float sinY = std::sin(glm::radians(rotationDegrees.y));
+	float cosY = std::cos(glm::radians(rotationDegrees.y));
+	float sinZ = std::sin(glm::radians(rotationDegrees.z));
+	float cosZ = std::cos(glm::radians(rotationDegrees.z));
+
+	// glm matrices are indexed by column, then row
+	glm::mat4 matrix;
+	matrix[0] = glm::vec4(
+		cosZ * cosY,
+		sinZ * cosY,
+		-sinY,
+		0.0f) * scaleXYZ.x;
+	matrix[1] = glm::vec4(
+		cosZ * sinY * sinX - sinZ * cosX,
+		sinZ * sinY * sinX + cosZ * cosX,
+		cosY * sinX,
+		0.0f) * scaleXYZ.y;
+	matrix[2] = glm::vec4(
+		cosZ * sinY * cosX + sinZ * sinX,
+		sinZ * sinY * cosX - cosZ * sinX,
+		cosY * cosX,
+		0.0f) * scaleXYZ.z;
+	matrix[3] = glm::vec4(positionXYZ, 1.0f);
+
+	return(matrix);
+}
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformstore.h
+// ============
+// keep the transformation values and world matrices of the scene objects
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  TransformStore
+ *
+ *  This class keeps the scale, rotation and position of each
+ *  scene object in separate arrays, along with the world
+ *  matrix built from them.  A matrix is only built again
+ *  after its values are changed - the changed transforms are
+ *  listed, and Update() rebuilds all of them together, so a
+ *  static scene builds no matrices after its first frame.
+ ***********************************************************/
+class TransformStore
+{
+public:
+	// constructor
+	TransformStore();
+	// destructor
+	~TransformStore();
+
+	// add a transform, returning its index - its matrix is
+	// built by the next Update()
+	int AddTransform(glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ);
+	// change the values of a transform
+	void SetTransform(int index, glm::vec3 scaleXYZ, glm::vec3 rotationDegrees, glm::vec3 positionXYZ);
+	// remove all of the transforms
+	void Clear();
+
+	// build the matrices of the changed transforms, returning
+	// how many were built
+	int Update();
+
+	// world matrix of a transform as of the last Update()
+	const glm::mat4& GetMatrix(int index) const { return(m_matrices[index]); }
+	const glm::vec3& GetScale(int index) const { return(m_scales[index]); }
+	const glm::vec3& GetRotation(int index) const { return(m_rotations[index]); }
+	const glm::vec3& GetPosition(int index) const { return(m_positions[index]); }
+	int GetTransformCount() const { return((int)m_matrices.size()); }
+
+	// transforms whose matrices were built by the last Update()
+	const std::vector<int>& GetUpdatedTransforms() const { return(m_updated); }
+	int GetLastUpdateCount() const { return((int)m_updated.size()); }
+
+	// build the matrix that scales, rotates about X, then Y,
+	// then Z, and then translates
+	static glm::mat4 ComposeMatrix(const glm::vec3& scaleXYZ, const glm::vec3& rotationDegrees, const glm::vec3& positionXYZ);
+
+private:
+	// transformation values, one array for each
+	std::vector<glm::vec3> m_scales;
+	std::vector<glm::vec3> m_rotations;
+	std::vector<glm::vec3> m_positions;
+	// world matrices built from the values
+	std::vector<glm::mat4> m_matrices;
+	// whether a transform is listed as changed
+	std::vector<unsigned char> m_bDirty;
+	// transforms changed since the last Update()
+	std::vector<int> m_dirty;
+	// transforms built by the last Update()
+	std::vector<int> m_updated;
+
+	// list a transform to be built by the next Update()
+	void MarkDirty(int index);
+};
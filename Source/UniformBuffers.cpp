@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformbuffers.cpp
+// ============
+// manage the std140 uniform buffer blocks shared by the shaders
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformBuffers.h"
+
+/***********************************************************
+ *  UniformBuffers()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformBuffers::UniformBuffers()
+{
+	m_frameBuffer = 0;
+	m_materialBuffer = 0;
+
+	// value initialization zeroes the padding and flags
+	m_frameBlock = FRAME_BLOCK();
+	for (int i = 0; i < MAX_MATERIALS; i++)
+	{
+		m_materials[i] = MATERIAL_BLOCK();
+	}
+	m_frameBlock.view = glm::mat4(1.0f);
+	m_frameBlock.projection = glm::mat4(1.0f);
+
+	m_bFrameDirty = true;
+	m_bMaterialsDirty = true;
+	m_materialCount = 0;
+	m_frameUploads = 0;
+	m_lastFrameUploads = 0;
+}
+
+/***********************************************************
+ *  ~UniformBuffers()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformBuffers::~UniformBuffers()
+{
+	DestroyBuffers();
+}
+
+/***********************************************************
+ *  CreateBuffers()
+ *
+ *  This method is used for creating the uniform buffer
+ *  objects and binding each of them to the binding point
+ *  used by its block in the shader code.
+ ***********************************************************/
+void UniformBuffers::CreateBuffers()
+{
+	glGenBuffers(1, &m_frameBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FRAME_BLOCK), NULL, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &m_materialBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(m_materials), NULL, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, m_frameBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialBuffer);
+
+	m_bFrameDirty = true;
+	m_bMaterialsDirty = true;
+}
+
+/***********************************************************
+ *  DestroyBuffers()
+ *
+ *  This method is used for freeing the uniform buffer objects.
+ ***********************************************************/
+void UniformBuffers::DestroyBuffers()
+{
+	if (m_frameBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_frameBuffer);
+		m_frameBuffer = 0;
+	}
+	if (m_materialBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_materialBuffer);
+		m_materialBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  SetViewProjection()
+ *
+ *  This method is used for setting the camera values into
+ *  the per-frame block.
+ ***********************************************************/
+void UniformBuffers::SetViewProjection(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& viewPosition)
+{
+	m_frameBlock.view = view;
+	m_frameBlock.projection = projection;
+	m_frameBlock.viewPosition = glm::vec4(viewPosition, 1.0f);
+	m_bFrameDirty = true;
+}
+
+/***********************************************************
+ *  SetGlobalAmbientColor()
+ *
+ *  This method is used for setting the global ambient color
+ *  into the per-frame block.
+ ***********************************************************/
+void UniformBuffers::SetGlobalAmbientColor(const glm::vec3& color)
+{
+	m_frameBlock.globalAmbientColor = glm::vec4(color, 1.0f);
+	m_bFrameDirty = true;
+}
+
+/***********************************************************
+ *  SetLightSource()
+ *
+ *  This method is used for setting the values of one light
+ *  source into the per-frame block.
+ ***********************************************************/
+void UniformBuffers::SetLightSource(
+	int index,
+	const glm::vec3& position,
+	const glm::vec3& diffuseColor,
+	const glm::vec3& specularColor,
+	float focalStrength,
+	float specularIntensity)
+{
+	if ((index < 0) || (index >= TOTAL_LIGHTS))
+	{
+		return;
+	}
+
+	LIGHT_BLOCK& light = m_frameBlock.lightSources[index];
+	light.position = glm::vec4(position, 1.0f);
+	light.diffuseColor = glm::vec4(diffuseColor, 1.0f);
+	light.specularColor = glm::vec4(specularColor, 1.0f);
+	light.focalStrength = focalStrength;
+	light.specularIntensity = specularIntensity;
+	m_bFrameDirty = true;
+}
+
+/***********************************************************
+ *  SetUseLighting()
+ *
+ *  This method is used for turning the custom lighting in
+ *  the shaders on or off.
+ ***********************************************************/
+void UniformBuffers::SetUseLighting(bool bUseLighting)
+{
+	m_frameBlock.bUseLighting = bUseLighting ? 1 : 0;
+	m_bFrameDirty = true;
+}
+
+/***********************************************************
+ *  SetMaterial()
+ *
+ *  This method is used for setting one entry of the material
+ *  table.  The table is uploaded before the next draw.
+ ***********************************************************/
+void UniformBuffers::SetMaterial(
+	int index,
+	const glm::vec3& ambientColor,
+	float ambientStrength,
+	const glm::vec3& diffuseColor,
+	const glm::vec3& specularColor,
+	float shininess,
+	float opacity)
+{
+	if ((index < 0) || (index >= MAX_MATERIALS))
+	{
+		return;
+	}
+
+	m_materials[index].ambientColor = glm::vec4(ambientColor, ambientStrength);
+	m_materials[index].diffuseColor = glm::vec4(diffuseColor, opacity);
+	m_materials[index].specularColor = glm::vec4(specularColor, shininess);
+	if (index >= m_materialCount)
+	{
+		m_materialCount = index + 1;
+	}
+	m_bMaterialsDirty = true;
+}
+
+/***********************************************************
+ *  CommitFrame()
+ *
+ *  This method is used for uploading the blocks before the
+ *  draws of a frame.  The per-frame block and the material
+ *  table are only uploaded when they have changed.
+ ***********************************************************/
+void UniformBuffers::CommitFrame()
+{
+	if (m_bFrameDirty == true)
+	{
+		glNamedBufferSubData(m_frameBuffer, 0, sizeof(FRAME_BLOCK), &m_frameBlock);
+		m_bFrameDirty = false;
+		m_frameUploads++;
+	}
+
+	if ((m_bMaterialsDirty == true) && (m_materialCount > 0))
+	{
+		glNamedBufferSubData(m_materialBuffer, 0, sizeof(MATERIAL_BLOCK) * m_materialCount, m_materials);
+		m_bMaterialsDirty = false;
+		m_frameUploads++;
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame of upload
+ *  counting, keeping the count from the last frame.
+ ***********************************************************/
+void UniformBuffers::BeginFrame()
+{
+	m_lastFrameUploads = m_frameUploads;
+	m_frameUploads = 0;
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformbuffers.h
+// ============
+// manage the std140 uniform buffer blocks shared by the shaders
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  UniformBuffers
+ *
+ *  This class owns the uniform buffer objects that replace
+ *  the individual uniform calls - one block with the values
+ *  that change once per frame and one table with every
+ *  defined material.  The per-draw values are kept by
+ *  InstancedMeshes in a shader storage buffer.
+ *  The layouts must match the blocks in the GLSL files.
+ ***********************************************************/
+class UniformBuffers
+{
+public:
+	// constructor
+	UniformBuffers();
+	// destructor
+	~UniformBuffers();
+
+	// these must match the defines in the shader code
+	static const int TOTAL_LIGHTS = 2;
+	static const int MAX_MATERIALS = 64;
+
+	// binding points of the uniform blocks
+	enum BLOCK_BINDING
+	{
+		FRAME_BLOCK_BINDING = 0,
+		MATERIAL_BLOCK_BINDING = 1
+	};
+
+	// std140 layout of one light source
+	struct LIGHT_BLOCK
+	{
+		glm::vec4 position;
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+		float focalStrength;
+		float specularIntensity;
+		float padding[2];
+	};
+
+	// std140 layout of the per-frame block
+	struct FRAME_BLOCK
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;
+		glm::vec4 globalAmbientColor;
+		LIGHT_BLOCK lightSources[TOTAL_LIGHTS];
+		int bUseLighting;
+		int padding[3];
+	};
+
+	// std140 layout of one entry in the material table - the
+	// ambient strength, the opacity and the shininess are
+	// packed into w
+	struct MATERIAL_BLOCK
+	{
+		glm::vec4 ambientColor;
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+	};
+
+	// create the buffers and attach them to their binding points
+	void CreateBuffers();
+	// free the buffers
+	void DestroyBuffers();
+
+	// set the per-frame values
+	void SetViewProjection(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition);
+	void SetGlobalAmbientColor(const glm::vec3& color);
+	void SetLightSource(int index, const glm::vec3& position, const glm::vec3& diffuseColor,
+		const glm::vec3& specularColor, float focalStrength, float specularIntensity);
+	void SetUseLighting(bool bUseLighting);
+
+	// set one entry of the material table
+	void SetMaterial(int index, const glm::vec3& ambientColor, float ambientStrength,
+		const glm::vec3& diffuseColor, const glm::vec3& specularColor, float shininess,
+		float opacity = 1.0f);
+
+	// upload any changed blocks before the draws of a frame
+	void CommitFrame();
+
+	// number of buffer uploads made during the last frame
+	void BeginFrame();
+	int GetLastFrameUploads() const { return(m_lastFrameUploads); }
+
+private:
+	// buffer object for each of the blocks
+	GLuint m_frameBuffer;
+	GLuint m_materialBuffer;
+
+	// local copies of the block values
+	FRAME_BLOCK m_frameBlock;
+	MATERIAL_BLOCK m_materials[MAX_MATERIALS];
+
+	// which of the local copies need to be uploaded
+	bool m_bFrameDirty;
+	bool m_bMaterialsDirty;
+	// highest material index that has been set
+	int m_materialCount;
+
+	// buffer uploads made since the last BeginFrame()
+	int m_frameUploads;
+	int m_lastFrameUploads;
+};
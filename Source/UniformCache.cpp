@@ -0,0 +1,335 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.cpp
+// ============
+// resolve shader uniform locations once and set them by handle
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// names of the well-known uniforms, in UNIFORM_ID order
+	const char* g_WellKnownNames[UniformCache::UNIFORM_COUNT] =
+	{
+		"objectTextures"
+	};
+
+	/***********************************************************
+	 *  HashName()
+	 *
+	 *  FNV-1a hash of a uniform name.
+	 ***********************************************************/
+	uint32_t HashName(const char* name)
+	{
+		uint32_t hash = 2166136261u;
+		while (*name != '\0')
+		{
+			hash ^= (uint8_t)(*name);
+			hash *= 16777619u;
+			name++;
+		}
+		return(hash);
+	}
+}
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache()
+{
+	m_programID = 0;
+	m_frameLookups = 0;
+	m_lastFrameLookups = 0;
+}
+
+/***********************************************************
+ *  ~UniformCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformCache::~UniformCache()
+{
+	m_uniforms.clear();
+	m_hashSlots.clear();
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for reading every active uniform of
+ *  the currently bound shader program and storing its
+ *  location in the hash table.  Array uniforms are also
+ *  registered per element so that names like
+ *  "lightSources[1].position" resolve to a handle.
+ ***********************************************************/
+bool UniformCache::Build()
+{
+	GLint programID = 0;
+	GLint activeUniforms = 0;
+	GLint maxNameLength = 0;
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &programID);
+	if (programID == 0)
+	{
+		std::cout << "UniformCache: no shader program is bound" << std::endl;
+		return(false);
+	}
+
+	m_programID = (GLuint)programID;
+	m_uniforms.clear();
+	m_hashSlots.assign(16, -1);
+
+	// the well-known uniforms always occupy the first handles,
+	// even when the shader compiler has optimized them away
+	for (int i = 0; i < UNIFORM_COUNT; i++)
+	{
+		AddUniform(g_WellKnownNames[i], -1);
+	}
+
+	glGetProgramiv(m_programID, GL_ACTIVE_UNIFORMS, &activeUniforms);
+	glGetProgramiv(m_programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(maxNameLength + 1, '\0');
+	for (GLint i = 0; i < activeUniforms; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = 0;
+
+		glGetActiveUniform(m_programID, (GLuint)i, maxNameLength, &nameLength,
+			&arraySize, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), nameLength);
+		GLint location = glGetUniformLocation(m_programID, name.c_str());
+
+		// uniforms inside of uniform blocks have no location
+		if (location < 0)
+		{
+			continue;
+		}
+
+		// plain arrays are reported as "name[0]" - register the
+		// base name and each of the elements
+		std::string baseName = name;
+		size_t bracket = name.rfind("[0]");
+		if ((bracket != std::string::npos) && (bracket + 3 == name.size()))
+		{
+			baseName = name.substr(0, bracket);
+		}
+
+		if ((baseName != name) || (arraySize > 1))
+		{
+			AddUniform(baseName, location);
+			for (GLint element = 0; element < arraySize; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				AddUniform(elementName, glGetUniformLocation(m_programID, elementName.c_str()));
+			}
+		}
+		else
+		{
+			AddUniform(name, location);
+		}
+	}
+
+	m_frameLookups = 0;
+
+	std::cout << "UniformCache: resolved " << m_uniforms.size() << " uniforms from " << activeUniforms << " active" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  FindUniform()
+ *
+ *  This method is used for getting the handle of a uniform
+ *  by its name.  Each call is counted as a lookup for the
+ *  current frame.
+ ***********************************************************/
+int UniformCache::FindUniform(const char* name)
+{
+	m_frameLookups++;
+	return(FindEntry(name, HashName(name)));
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame of lookup
+ *  counting, keeping the count from the last frame.
+ ***********************************************************/
+void UniformCache::BeginFrame()
+{
+	m_lastFrameLookups = m_frameLookups;
+	m_frameLookups = 0;
+}
+
+/***********************************************************
+ *  AddUniform()
+ *
+ *  This method is used for adding a name and location to
+ *  the uniform entries, or updating the location of an
+ *  entry that already exists.
+ ***********************************************************/
+int UniformCache::AddUniform(const std::string& name, GLint location)
+{
+	uint32_t hash = HashName(name.c_str());
+
+	// update the location when the name is already known
+	int index = FindEntry(name.c_str(), hash);
+	if (index >= 0)
+	{
+		m_uniforms[index].location = location;
+		return(index);
+	}
+
+	UNIFORM_ENTRY entry;
+	entry.name = name;
+	entry.hash = hash;
+	entry.location = location;
+	m_uniforms.push_back(entry);
+	index = (int)m_uniforms.size() - 1;
+
+	// keep the table at most half full
+	if (m_uniforms.size() * 2 > m_hashSlots.size())
+	{
+		RebuildSlots();
+	}
+	else
+	{
+		size_t mask = m_hashSlots.size() - 1;
+		size_t slot = hash & mask;
+		while (m_hashSlots[slot] >= 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_hashSlots[slot] = index;
+	}
+
+	return(index);
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used for probing the hash slots for the
+ *  entry with the passed in name.
+ ***********************************************************/
+int UniformCache::FindEntry(const char* name, uint32_t hash) const
+{
+	if (m_hashSlots.empty())
+	{
+		return(-1);
+	}
+
+	size_t mask = m_hashSlots.size() - 1;
+	size_t slot = hash & mask;
+	while (m_hashSlots[slot] >= 0)
+	{
+		const UNIFORM_ENTRY& entry = m_uniforms[m_hashSlots[slot]];
+		if ((entry.hash == hash) && (entry.name.compare(name) == 0))
+		{
+			return(m_hashSlots[slot]);
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  RebuildSlots()
+ *
+ *  This method is used for rebuilding the open addressing
+ *  table, keeping it at most half full.
+ ***********************************************************/
+void UniformCache::RebuildSlots()
+{
+	size_t slotCount = 16;
+	while (slotCount < m_uniforms.size() * 2)
+	{
+		slotCount *= 2;
+	}
+
+	m_hashSlots.assign(slotCount, -1);
+	size_t mask = slotCount - 1;
+	for (size_t i = 0; i < m_uniforms.size(); i++)
+	{
+		size_t slot = m_uniforms[i].hash & mask;
+		while (m_hashSlots[slot] >= 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_hashSlots[slot] = (int)i;
+	}
+}
+
+/***********************************************************
+ *  GetLocation()
+ *
+ *  This method is used for getting the uniform location
+ *  stored for a handle.
+ ***********************************************************/
+GLint UniformCache::GetLocation(int handle) const
+{
+	if ((handle < 0) || (handle >= (int)m_uniforms.size()))
+	{
+		return(-1);
+	}
+	return(m_uniforms[handle].location);
+}
+
+/***********************************************************
+ *  Set*()
+ *
+ *  These methods are used for setting the passed in value
+ *  into the bound shader program.  Uniforms that are not
+ *  active in the program are silently ignored by OpenGL.
+ ***********************************************************/
+void UniformCache::SetBool(int handle, bool value)
+{
+	glUniform1i(GetLocation(handle), (int)value);
+}
+
+void UniformCache::SetInt(int handle, int value)
+{
+	glUniform1i(GetLocation(handle), value);
+}
+
+void UniformCache::SetIntArray(int handle, int count, const GLint* pValues)
+{
+	glUniform1iv(GetLocation(handle), count, pValues);
+}
+
+void UniformCache::SetFloat(int handle, float value)
+{
+	glUniform1f(GetLocation(handle), value);
+}
+
+void UniformCache::SetVec2(int handle, const glm::vec2& value)
+{
+	glUniform2fv(GetLocation(handle), 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetVec3(int handle, const glm::vec3& value)
+{
+	glUniform3fv(GetLocation(handle), 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetVec4(int handle, const glm::vec4& value)
+{
+	glUniform4fv(GetLocation(handle), 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetMat4(int handle, const glm::mat4& value)
+{
+	glUniformMatrix4fv(GetLocation(handle), 1, GL_FALSE, glm::value_ptr(value));
+}
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.h
+// ============
+// resolve shader uniform locations once and set them by handle
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class introspects the active uniforms of a linked
+ *  shader program one time and stores their locations in a
+ *  flat hash table, so the per-frame code can set uniform
+ *  values through integer handles instead of names.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// constructor
+	UniformCache();
+	// destructor
+	~UniformCache();
+
+	// handles for the uniforms that are set on every frame -
+	// these are resolved when the cache is built and can be
+	// passed straight to the setter methods.  The rest of the
+	// per-frame values live in the blocks of UniformBuffers.
+	enum UNIFORM_ID
+	{
+		UNIFORM_OBJECT_TEXTURES = 0,
+		UNIFORM_COUNT
+	};
+
+	// introspect the uniforms of the currently bound program
+	bool Build();
+	// find the handle for a uniform name - this hashes the
+	// string, so it should only be called outside the frame loop
+	int FindUniform(const char* name);
+
+	// set uniform values by handle into the bound program
+	void SetBool(int handle, bool value);
+	void SetInt(int handle, int value);
+	void SetIntArray(int handle, int count, const GLint* pValues);
+	void SetFloat(int handle, float value);
+	void SetVec2(int handle, const glm::vec2& value);
+	void SetVec3(int handle, const glm::vec3& value);
+	void SetVec4(int handle, const glm::vec4& value);
+	void SetMat4(int handle, const glm::mat4& value);
+
+	// reset the per-frame lookup counter
+	void BeginFrame();
+	// number of string lookups made during the last frame
+	int GetLastFrameLookups() const { return(m_lastFrameLookups); }
+
+private:
+	struct UNIFORM_ENTRY
+	{
+		std::string name;
+		uint32_t hash;
+		GLint location;
+	};
+
+	// the program the uniforms were resolved from
+	GLuint m_programID;
+	// resolved uniforms - the entry index is the handle
+	std::vector<UNIFORM_ENTRY> m_uniforms;
+	// open addressing table of entry indices, -1 when empty
+	std::vector<int> m_hashSlots;
+	// string lookups made since the last BeginFrame()
+	int m_frameLookups;
+	int m_lastFrameLookups;
+
+	// add a uniform name and location to the table
+	int AddUniform(const std::string& name, GLint location);
+	// find the table entry for a name without counting it
+	int FindEntry(const char* name, uint32_t hash) const;
+	// rebuild the hash slots for the current entries
+	void RebuildSlots();
+	// get the location for a handle
+	GLint GetLocation(int handle) const;
+};
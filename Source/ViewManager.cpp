@@ -8,6 +8,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "Profiler.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
@@ -20,8 +21,6 @@ namespace
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -47,10 +46,12 @@ namespace
  *  The constructor for the class
  ***********************************************************/
 ViewManager::ViewManager(
-	ShaderManager *pShaderManager)
+	ShaderManager *pShaderManager,
+	UniformBuffers *pUniformBuffers)
 {
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
+	m_pUniformBuffers = pUniformBuffers;
 	m_pWindow = NULL;
 	g_pCamera = new Camera();
 	// default camera view parameters
@@ -70,6 +71,7 @@ ViewManager::~ViewManager()
 {
 	// free up allocated memory
 	m_pShaderManager = NULL;
+	m_pUniformBuffers = NULL;
 	m_pWindow = NULL;
 	if (NULL != g_pCamera)
 	{
@@ -107,8 +109,43 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// this callback is used to receive mouse moving events
 	glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback);
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
+	// blending for transparent rendering - it is only turned
+	// on while the transparent objects are drawn
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	m_pWindow = window;
+
+	return(window);
+}
+
+/***********************************************************
+ *  CreateHeadlessWindow()
+ *
+ *  This method is used to create a window that is never
+ *  shown, for rendering with no display.  The frames are
+ *  drawn into an offscreen target, so the window is only
+ *  there for its OpenGL context, and takes no input.
+ ***********************************************************/
+GLFWwindow* ViewManager::CreateHeadlessWindow(const char* windowTitle, int width, int height)
+{
+	GLFWwindow* window = nullptr;
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	window = glfwCreateWindow(
+		width,
+		height,
+		windowTitle,
+		NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create the headless OpenGL context" << std::endl;
+		glfwTerminate();
+		return NULL;
+	}
+	glfwMakeContextCurrent(window);
+
+	// blending for transparent rendering - it is only turned
+	// on while the transparent objects are drawn
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_pWindow = window;
@@ -190,6 +227,8 @@ void ViewManager::ProcessKeyboardEvents()
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
+	ProfileScope scope("PrepareSceneView");
+
 	glm::mat4 view;
 	glm::mat4 projection;
 
@@ -208,14 +247,11 @@ void ViewManager::PrepareSceneView()
 	// define the current projection matrix
 	projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 
-	// if the shader manager object is valid
-	if (NULL != m_pShaderManager)
+	// if the uniform buffers object is valid
+	if (NULL != m_pUniformBuffers)
 	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		// set the view and projection matrices and the view position
+		// of the camera into the per-frame block for proper rendering
+		m_pUniformBuffers->SetViewProjection(view, projection, g_pCamera->Position);
 	}
 }
\ No newline at end of file
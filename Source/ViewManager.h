@@ -10,6 +10,7 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "UniformBuffers.h"
 #include "camera.h"
 
 // GLFW library
@@ -20,7 +21,8 @@ class ViewManager
 public:
 	// constructor
 	ViewManager(
-		ShaderManager* pShaderManager);
+		ShaderManager* pShaderManager,
+		UniformBuffers* pUniformBuffers);
 	// destructor
 	~ViewManager();
 
@@ -30,6 +32,8 @@ public:
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// pointer to the shared uniform buffer blocks
+	UniformBuffers* m_pUniformBuffers;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
 
@@ -39,6 +43,8 @@ private:
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
+	// create a window that is never shown, only for its context
+	GLFWwindow* CreateHeadlessWindow(const char* windowTitle, int width, int height);
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// workerpool.cpp
+// ============
+// a fixed pool of worker threads that run queued jobs
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "WorkerPool.h"
+#include "Profiler.h"
+
+#include <iostream>
+#include <string>
+
+/***********************************************************
+ *  WorkerPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+WorkerPool::WorkerPool(int threadCount)
+{
+	m_activeJobs = 0;
+	m_bStopping = false;
+
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+		if (threadCount < 1)
+		{
+			threadCount = 1;
+		}
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		m_threads.push_back(std::thread(&WorkerPool::WorkerMain, this, i));
+	}
+
+	std::cout << "WorkerPool: started " << threadCount << " worker threads" << std::endl;
+}
+
+/***********************************************************
+ *  ~WorkerPool()
+ *
+ *  The destructor for the class.  The jobs that are still
+ *  queued are run before the threads exit.
+ ***********************************************************/
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_jobReady.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+	m_threads.clear();
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for adding a job to the queue.  One
+ *  waiting worker thread is woken up to run it.
+ ***********************************************************/
+void WorkerPool::Submit(const JOB& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+	}
+	m_jobReady.notify_one();
+}
+
+/***********************************************************
+ *  WaitIdle()
+ *
+ *  This method is used for blocking until every submitted
+ *  job has finished running.
+ ***********************************************************/
+void WorkerPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return((m_jobs.empty() == true) && (m_activeJobs == 0)); });
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is used for running queued jobs until the
+ *  pool is stopped and the queue is empty.
+ ***********************************************************/
+void WorkerPool::WorkerMain(int workerIndex)
+{
+	std::string threadName = "worker " + std::to_string(workerIndex + 1);
+	Profiler::SetThreadName(threadName.c_str());
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_jobReady.wait(lock, [this]() { return((m_bStopping == true) || (m_jobs.empty() == false)); });
+
+		if (m_jobs.empty() == true)
+		{
+			// stopping, and nothing is left to run
+			break;
+		}
+
+		JOB job = m_jobs.front();
+		m_jobs.pop_front();
+		m_activeJobs++;
+
+		lock.unlock();
+		{
+			ProfileScope scope("Job");
+			job();
+		}
+		lock.lock();
+
+		m_activeJobs--;
+		if ((m_jobs.empty() == true) && (m_activeJobs == 0))
+		{
+			m_idle.notify_all();
+		}
+	}
+}
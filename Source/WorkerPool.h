@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// workerpool.h
+// ============
+// a fixed pool of worker threads that run queued jobs
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  WorkerPool
+ *
+ *  This class runs jobs on a fixed set of worker threads.
+ *  Jobs are taken from a shared queue in the order they were
+ *  submitted.  The jobs must not make OpenGL calls, since the
+ *  context is only current on the main thread.
+ ***********************************************************/
+class WorkerPool
+{
+public:
+	// a unit of work run on one of the worker threads
+	typedef std::function<void()> JOB;
+
+	// constructor - zero threads means one less than the
+	// number of hardware threads, leaving one for rendering
+	WorkerPool(int threadCount = 0);
+	// destructor
+	~WorkerPool();
+
+	// add a job to the queue
+	void Submit(const JOB& job);
+	// wait until the queue is empty and no job is running
+	void WaitIdle();
+
+	// number of worker threads
+	int GetThreadCount() const { return((int)m_threads.size()); }
+
+private:
+	// the worker threads
+	std::vector<std::thread> m_threads;
+	// jobs waiting to be run
+	std::deque<JOB> m_jobs;
+	// guards the queue and the counters
+	std::mutex m_mutex;
+	// signalled when a job is queued or the pool is stopping
+	std::condition_variable m_jobReady;
+	// signalled when the pool becomes idle
+	std::condition_variable m_idle;
+	// jobs currently being run
+	int m_activeJobs;
+	// set when the threads should exit
+	bool m_bStopping;
+
+	// loop run by each of the worker threads, numbered from zero
+	void WorkerMain(int workerIndex);
+};
@@ -1,102 +1,336 @@
 #version 440 core
 
+// ambient strength is packed into ambientColor.w, opacity
+// into diffuseColor.w and shininess into specularColor.w
 struct Material 
 {
-    vec3 diffuseColor;
-    vec3 specularColor;
-    float shininess;
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
 }; 
 
 struct LightSource 
 {
-    vec3 position;	
-    vec3 diffuseColor;
-    vec3 specularColor;
+    vec4 position;
+    vec4 diffuseColor;
+    vec4 specularColor;
     float focalStrength;
     float specularIntensity;
 };
 
 #define TOTAL_LIGHTS 2
+#define MAX_MATERIALS 64
+#define MAX_TEXTURES 256
+#define MAX_TEXTURE_ARRAYS 8
 
+// permutation defines - ShaderPermutations sets these to 0 or 1
+// and the number of lights, which turns the choices below into
+// constants that the compiler folds away.  Left at -1, the
+// shader chooses per fragment from the draw and the frame.
+// CLUSTERED_LIGHTS is 0 for scenes without point lights.
+#ifndef USE_TEXTURE
+#define USE_TEXTURE -1
+#endif
+#ifndef USE_LIGHTING
+#define USE_LIGHTING -1
+#endif
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT TOTAL_LIGHTS
+#endif
+#ifndef CLUSTERED_LIGHTS
+#define CLUSTERED_LIGHTS 1
+#endif
+
+// the pass the shader is built for - the forward pass shades
+// the fragments of the draws, the G-buffer pass writes their
+// surfaces into the G-buffer, and the lighting pass shades the
+// G-buffer with one triangle that covers the screen.  The
+// depth pass only writes the depth of the opaque draws.
+#define FORWARD_PASS 0
+#define GBUFFER_PASS 1
+#define LIGHTING_PASS 2
+#define DEPTH_PASS 3
+#ifndef RENDER_PASS
+#define RENDER_PASS FORWARD_PASS
+#endif
+
+// where a texture lives - location is the texture array,
+// the layer and whether it is an atlas image
+struct TextureEntry
+{
+    vec4 uvRect;
+    ivec4 location;
+};
+
+#if RENDER_PASS == LIGHTING_PASS
+// the G-buffer, on the texture units after the texture arrays -
+// must match DeferredRenderer::GBUFFER_TEXTURE_UNIT
+layout (binding = 8) uniform sampler2D gbufferAlbedo;
+layout (binding = 9) uniform sampler2D gbufferNormal;
+layout (binding = 10) uniform usampler2D gbufferMaterial;
+layout (binding = 11) uniform sampler2D gbufferDepth;
+
+// turns a screen position and depth back into a world position
+uniform mat4 inverseViewProjection;
+#elif RENDER_PASS != DEPTH_PASS
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+flat in int fragmentMaterialIndex;
+flat in int fragmentTextureIndex;
+flat in vec4 fragmentObjectColor;
+#endif
 
+#if RENDER_PASS == GBUFFER_PASS
+// must match DeferredRenderer::GBUFFER_TARGET - the normal has
+// whether the surface is lit in w
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal;
+layout (location = 2) out uint outMaterial;
+#else
 out vec4 outFragmentColor;
+#endif
+
+// per-frame values - must match UniformBuffers::FRAME_BLOCK
+layout (std140, binding = 0) uniform FrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPosition;
+    vec4 globalAmbientColor;
+    LightSource lightSources[TOTAL_LIGHTS];
+    int bUseLighting;
+};
+
+// every defined material - must match UniformBuffers::MATERIAL_BLOCK
+layout (std140, binding = 1) uniform MaterialBlock
+{
+    Material materials[MAX_MATERIALS];
+};
 
-uniform bool bUseTexture=false;
-uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
-uniform sampler2D objectTexture;
-uniform vec3 viewPosition;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
-uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
-uniform vec3 globalAmbientColor;
+// every loaded texture - must match TextureManager::TEXTURE_BLOCK
+layout (std140, binding = 2) uniform TextureBlock
+{
+    TextureEntry textures[MAX_TEXTURES];
+};
+
+// point lights of the scene - must match LightClusters::POINT_LIGHT.
+// the radius is packed into positionRadius.w, the focal strength
+// into diffuseColor.w and the specular intensity into specularColor.w
+struct PointLight
+{
+    vec4 positionRadius;
+    vec4 diffuseColor;
+    vec4 specularColor;
+};
+
+layout (std430, binding = 1) readonly buffer PointLights
+{
+    PointLight pointLights[];
+};
+
+// the grid of view space clusters - must match LightClusters::CLUSTER_HEADER,
+// followed by the offset and count of each cluster's light indices
+layout (std430, binding = 2) readonly buffer LightClusters
+{
+    uvec4 clusterGridSize;
+    vec4 clusterSliceParams;
+    uvec2 clusterRanges[];
+};
+
+layout (std430, binding = 3) readonly buffer LightIndices
+{
+    uint clusterLightIndices[];
+};
+
+// one sampler for each texture array, on texture units 0 and up
+layout (binding = 0) uniform sampler2DArray objectTextures[MAX_TEXTURE_ARRAYS];
     
 
 // function prototypes
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcLighting(int materialIndex, vec3 lightNormal, vec3 position);
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcClusterLights(Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec4 SampleObjectTexture(int textureIndex, vec2 uv, vec2 uvDx, vec2 uvDy);
 
 void main()
 {
-   if(bUseLighting == true)
+#if RENDER_PASS == DEPTH_PASS
+   // the depth is all this pass writes
+#elif RENDER_PASS == LIGHTING_PASS
+   // the surface written by the G-buffer pass - pixels that
+   // no draw covered keep the cleared color
+   ivec2 pixel = ivec2(gl_FragCoord.xy);
+   float depth = texelFetch(gbufferDepth, pixel, 0).r;
+   if(depth >= 1.0)
    {
-      // properties
-      vec3 lightNormal = normalize(fragmentVertexNormal);
-      vec3 viewDirection = normalize(viewPosition - fragmentPosition);
-      vec3 phongResult = vec3(0.0f);
+      discard;
+   }
+   vec4 albedo = texelFetch(gbufferAlbedo, pixel, 0);
+   vec4 normal = texelFetch(gbufferNormal, pixel, 0);
+   int materialIndex = int(texelFetch(gbufferMaterial, pixel, 0).r);
 
-      for(int i = 0; i < TOTAL_LIGHTS; i++)
-      {
-         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
-      }   
-    
-      if(bUseTexture == true)
-      {
-         vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-         outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
-      }
-      else
-      {
-         outFragmentColor = vec4(phongResult * objectColor.xyz, objectColor.w);
-      }
+   vec2 screenPosition = gl_FragCoord.xy / vec2(textureSize(gbufferDepth, 0));
+   vec4 worldPosition = inverseViewProjection * vec4(vec3(screenPosition, depth) * 2.0 - 1.0, 1.0);
+   vec3 position = worldPosition.xyz / worldPosition.w;
+
+   if(normal.w > 0.5)
+   {
+      outFragmentColor = vec4(CalcLighting(materialIndex, normalize(normal.xyz), position) * albedo.rgb, albedo.a);
    }
-   else 
+   else
    {
-      if(bUseTexture == true)
-      {
-         outFragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-      }
-      else
+      outFragmentColor = albedo;
+   }
+
+   // later draws are depth tested against the surfaces
+   gl_FragDepth = depth;
+#else
+#if USE_TEXTURE < 0
+   bool bTextured = (fragmentTextureIndex >= 0);
+#else
+   const bool bTextured = (USE_TEXTURE != 0);
+#endif
+#if USE_LIGHTING < 0
+   bool bLit = (bUseLighting != 0);
+#else
+   const bool bLit = (USE_LIGHTING != 0);
+#endif
+
+   // the derivatives must be taken outside of the branches
+   vec2 uvDx = dFdx(fragmentTextureCoordinate);
+   vec2 uvDy = dFdy(fragmentTextureCoordinate);
+
+   vec4 baseColor = fragmentObjectColor;
+   if(bTextured)
+   {
+      baseColor = SampleObjectTexture(fragmentTextureIndex, fragmentTextureCoordinate, uvDx, uvDy);
+      // lit textures are drawn opaque
+      if(bLit)
       {
-         outFragmentColor = objectColor;
+         baseColor.a = 1.0;
       }
    }
+   // the opacity of the material - draws below one are blended
+   baseColor.a *= materials[fragmentMaterialIndex].diffuseColor.a;
+
+#if RENDER_PASS == GBUFFER_PASS
+   outAlbedo = baseColor;
+   outNormal = vec4(normalize(fragmentVertexNormal), bLit ? 1.0 : 0.0);
+   outMaterial = uint(fragmentMaterialIndex);
+#else
+   if(bLit)
+   {
+      outFragmentColor = vec4(CalcLighting(fragmentMaterialIndex, normalize(fragmentVertexNormal), fragmentPosition) * baseColor.rgb, baseColor.a);
+   }
+   else
+   {
+      outFragmentColor = baseColor;
+   }
+#endif
+#endif
+}
+
+// calculates the light that reaches a surface from every light
+// source and from the point lights of its cluster
+vec3 CalcLighting(int materialIndex, vec3 lightNormal, vec3 position)
+{
+   Material material = materials[materialIndex];
+   vec3 viewDirection = normalize(viewPosition.xyz - position);
+   vec3 phongResult = vec3(0.0f);
+
+   // a constant trip count, so the loop is unrolled
+   for(int i = 0; i < LIGHT_COUNT; i++)
+   {
+      phongResult += CalcLightSource(lightSources[i], material, lightNormal, position, viewDirection); 
+   }   
+#if CLUSTERED_LIGHTS != 0
+   // only the point lights that reach this fragment's cluster
+   phongResult += CalcClusterLights(material, lightNormal, position, viewDirection);
+#endif
+   return phongResult;
 }
 
 // calculates the color when using a directional light.
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
 {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
 
     // Calculate Ambient lighting
-    ambient = globalAmbientColor;
+    ambient = globalAmbientColor.rgb;
 
     // Calculate Diffuse lighting
-    vec3 lightDirection = normalize(light.position - vertexPosition); 
+    vec3 lightDirection = normalize(light.position.xyz - vertexPosition); 
 
     float impact = max(dot(lightNormal, lightDirection), 0.0);
-    diffuse = light.diffuseColor * impact * material.diffuseColor;
+    diffuse = light.diffuseColor.rgb * impact * material.diffuseColor.rgb;
 
     // Calculate Specular lighting
     vec3 reflectDir = reflect(-lightDirection, lightNormal);
     float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength);
-    specular = light.specularColor * (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
+    specular = light.specularColor.rgb * (light.specularIntensity * material.specularColor.w) * specularComponent * material.specularColor.rgb;
 
     return (ambient + diffuse + specular);
 }
 
+// calculates the color from the point lights of the fragment's
+// cluster - the screen tile it is in and the slice of its view
+// depth.  Each light fades out smoothly at its radius.
+vec3 CalcClusterLights(Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterSliceParams.xy * vec2(clusterGridSize.xy)), clusterGridSize.xy - 1u);
+    float depth = max(-(view * vec4(vertexPosition, 1.0)).z, 0.0001);
+    int slice = clamp(int(floor(log(depth) * clusterSliceParams.z + clusterSliceParams.w)), 0, int(clusterGridSize.z) - 1);
+    uvec2 range = clusterRanges[tile.x + clusterGridSize.x * (tile.y + clusterGridSize.y * uint(slice))];
+
+    vec3 result = vec3(0.0);
+    for(uint i = 0u; i < range.y; i++)
+    {
+        PointLight light = pointLights[clusterLightIndices[range.x + i]];
+        vec3 toLight = light.positionRadius.xyz - vertexPosition;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - (distance * distance) / (light.positionRadius.w * light.positionRadius.w), 0.0, 1.0);
+        vec3 lightDirection = toLight / max(distance, 0.0001);
 
+        float impact = max(dot(lightNormal, lightDirection), 0.0);
+        vec3 diffuse = light.diffuseColor.rgb * impact * material.diffuseColor.rgb;
+
+        vec3 reflectDir = reflect(-lightDirection, lightNormal);
+        float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.diffuseColor.w);
+        vec3 specular = light.specularColor.rgb * (light.specularColor.w * material.specularColor.w) * specularComponent * material.specularColor.rgb;
+
+        result += (diffuse + specular) * (falloff * falloff);
+    }
+    return result;
+}
+
+#if RENDER_PASS != LIGHTING_PASS
+// samples a texture from its texture array.  Atlas images wrap
+// inside of their rectangle, with the derivatives scaled to the
+// rectangle so the mip level matches the image.
+vec4 SampleObjectTexture(int textureIndex, vec2 uv, vec2 uvDx, vec2 uvDy)
+{
+    TextureEntry entry = textures[textureIndex];
+    if(entry.location.z != 0)
+    {
+        uv = entry.uvRect.xy + fract(uv) * entry.uvRect.zw;
+        uvDx *= entry.uvRect.zw;
+        uvDy *= entry.uvRect.zw;
+    }
+    vec3 coordinate = vec3(uv, float(entry.location.y));
+
+    // a sampler array may only be indexed by a dynamically
+    // uniform value, so the loop counter selects the sampler
+    vec4 color = vec4(1.0);
+    for(int i = 0; i < MAX_TEXTURE_ARRAYS; i++)
+    {
+        if(i == entry.location.x)
+        {
+            color = textureGrad(objectTextures[i], coordinate, uvDx, uvDy);
+        }
+    }
+    return color;
+}
+#endif
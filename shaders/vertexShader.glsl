@@ -1,20 +1,87 @@
-#version 330 core
+#version 440 core
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
 
+// index of this instance's draw record, offset by the base
+// instance of the indirect draw command
+layout (location = 3) in uint inDrawIndex;
+
+struct LightSource 
+{
+    vec4 position;
+    vec4 diffuseColor;
+    vec4 specularColor;
+    float focalStrength;
+    float specularIntensity;
+};
+
+#define TOTAL_LIGHTS 2
+
+// the pass the shader is built for - must match fragmentShader.glsl
+#define LIGHTING_PASS 2
+#define DEPTH_PASS 3
+#ifndef RENDER_PASS
+#define RENDER_PASS 0
+#endif
+
+// the depth pass and the passes drawn against its depth with
+// an equal test must make the same positions
+invariant gl_Position;
+
+// per-frame values - must match UniformBuffers::FRAME_BLOCK
+layout (std140, binding = 0) uniform FrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPosition;
+    vec4 globalAmbientColor;
+    LightSource lightSources[TOTAL_LIGHTS];
+    int bUseLighting;
+};
+
+// per-draw values - must match InstancedMeshes::INSTANCE_DATA
+struct DrawRecord
+{
+    mat4 model;
+    vec4 objectColor;
+    int materialIndex;
+    int textureIndex;
+    vec2 UVscale;
+};
+
+layout (std430, binding = 0) readonly buffer DrawRecords
+{
+    DrawRecord draws[];
+};
+
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+flat out int fragmentMaterialIndex;
+flat out int fragmentTextureIndex;
+flat out vec4 fragmentObjectColor;
 
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
+#if RENDER_PASS == LIGHTING_PASS
+   // one triangle that covers the screen, made from the vertex
+   // index with no vertex buffers
+   vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+   gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+#elif RENDER_PASS == DEPTH_PASS
+   // only the position is read from the position stream
+   gl_Position = projection * view * draws[inDrawIndex].model * vec4(inVertexPosition, 1.0f);
+#else
+   DrawRecord draw = draws[inDrawIndex];
+   mat4 objectModel = draw.model;
+   fragmentMaterialIndex = draw.materialIndex;
+   fragmentTextureIndex = draw.textureIndex;
+   fragmentObjectColor = draw.objectColor;
+
+   fragmentPosition = vec3(objectModel * vec4(inVertexPosition, 1.0));
+   gl_Position = projection * view * objectModel * vec4(inVertexPosition, 1.0f);
    fragmentVertexNormal = inVertexNormal;
-   fragmentTextureCoordinate = inTextureCoordinate;
-}
\ No newline at end of file
+   fragmentTextureCoordinate = inTextureCoordinate * draw.UVscale;
+#endif
+}